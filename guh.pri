@@ -6,7 +6,7 @@ GUH_PLUGINS_PATH=/usr/lib/$$system('dpkg-architecture -q DEB_HOST_MULTIARCH')/gu
 
 # define protocol versions
 JSON_PROTOCOL_VERSION_MAJOR=0
-JSON_PROTOCOL_VERSION_MINOR=54
+JSON_PROTOCOL_VERSION_MINOR=62
 REST_API_VERSION=1
 
 DEFINES += GUH_VERSION_STRING=\\\"$${GUH_VERSION_STRING}\\\" \
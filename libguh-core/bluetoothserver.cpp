@@ -37,7 +37,6 @@
 #include "bluetoothserver.h"
 #include "loggingcategories.h"
 
-#include <QJsonDocument>
 #include <QBluetoothLocalDevice>
 
 namespace guhserver {
@@ -72,8 +71,10 @@ void BluetoothServer::sendData(const QUuid &clientId, const QByteArray &data)
 {
     QBluetoothSocket *client = 0;
     client = m_clientList.value(clientId);
-    if (client)
-        client->write(QJsonDocument::fromVariant(data).toJson(QJsonDocument::Compact) + '\n');
+    if (client) {
+        client->write(data);
+        client->write("\n", 1);
+    }
 }
 
 /*! Send the given \a data to the \a clients. */
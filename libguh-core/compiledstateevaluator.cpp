@@ -0,0 +1,285 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class guhserver::CompiledStateEvaluator
+    \brief A flattened, pre-resolved execution plan of a \l StateEvaluator.
+
+    \ingroup rules
+    \inmodule core
+
+    The \l StateEvaluator tree of a \l Rule gets compiled whenever the rule gets added or one of the
+    involved \l{Device}{Devices} changes. The nodes are stored in postfix order in a contiguous
+    list and each \l StateDescriptor is resolved to the \l Device and the index of the \l State it
+    describes. Evaluating the compiled tree does not need any \l Device lookup and does not allocate.
+
+    Each node caches its last result. Once the cache has been filled using refresh(), a \l State change
+    only re-evaluates the affected leaves and the nodes on their path to the root, see updateState().
+    An AND/OR node keeps the number of its true children, so updating a parent costs O(1).
+
+    \sa StateEvaluator, RuleEngine
+*/
+
+#include "compiledstateevaluator.h"
+#include "guhcore.h"
+#include "devicemanager.h"
+#include "loggingcategories.h"
+
+namespace guhserver {
+
+/*! Constructs an empty \l CompiledStateEvaluator. An empty evaluator always evaluates to true. */
+CompiledStateEvaluator::CompiledStateEvaluator()
+{
+
+}
+
+/*! Returns the \l CompiledStateEvaluator for the given \a stateEvaluator. The \l{Device}{Devices}
+    will be resolved with the current configuration of the \l DeviceManager. */
+CompiledStateEvaluator CompiledStateEvaluator::compile(const StateEvaluator &stateEvaluator)
+{
+    CompiledStateEvaluator compiled;
+    compiled.compileNode(stateEvaluator);
+    compiled.refresh();
+    return compiled;
+}
+
+/*! Returns true if this \l CompiledStateEvaluator has no nodes. */
+bool CompiledStateEvaluator::isEmpty() const
+{
+    return m_nodes.isEmpty();
+}
+
+/*! Returns true if this \l CompiledStateEvaluator depends on a \l Device with the given \a deviceId. */
+bool CompiledStateEvaluator::containsDevice(const DeviceId &deviceId) const
+{
+    foreach (const Leaf &leaf, m_leaves) {
+        if (leaf.deviceId == deviceId) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*! Returns the same result as \l StateEvaluator::evaluate() of the compiled evaluator. */
+bool CompiledStateEvaluator::evaluate() const
+{
+    if (m_nodes.isEmpty())
+        return true;
+
+    return evaluateNode(m_nodes.count() - 1);
+}
+
+/*! Returns the cached result of the root node. The cache is valid after refresh() and gets
+    updated by updateState(). */
+bool CompiledStateEvaluator::result() const
+{
+    if (m_nodes.isEmpty())
+        return true;
+
+    return m_nodes.last().result;
+}
+
+/*! Returns the cached results of all nodes in postfix order. This is the post-order of the
+    compiled \l StateEvaluator tree, the last value is the result of the root evaluator. */
+QList<bool> CompiledStateEvaluator::results() const
+{
+    QList<bool> ret;
+    foreach (const Node &node, m_nodes) {
+        ret.append(node.result);
+    }
+    return ret;
+}
+
+/*! Re-evaluates all leaves and nodes and fills the result cache. */
+void CompiledStateEvaluator::refresh()
+{
+    for (int i = 0; i < m_leaves.count(); i++) {
+        m_leaves[i].result = evaluateLeaf(m_leaves.at(i));
+    }
+
+    // Postfix order: the children are always up to date before their parent
+    for (int i = 0; i < m_nodes.count(); i++) {
+        Node &node = m_nodes[i];
+        node.trueChildren = 0;
+        for (int j = node.firstChild; j < node.firstChild + node.childCount; j++) {
+            if (m_nodes.at(m_children.at(j)).result) {
+                node.trueChildren++;
+            }
+        }
+        node.result = nodeResult(node);
+    }
+}
+
+/*! Re-evaluates the leaves describing the \l State with the given \a stateTypeId of the
+    \l Device with the given \a deviceId. Only the nodes on the path from a changed leaf to the
+    root get updated, and only as long as their result changes. Returns the new result of the root node.
+*/
+bool CompiledStateEvaluator::updateState(const DeviceId &deviceId, const StateTypeId &stateTypeId)
+{
+    foreach (int leafIndex, m_leafIndex.value(QPair<QUuid, QUuid>(deviceId, stateTypeId))) {
+        bool leafResult = evaluateLeaf(m_leaves.at(leafIndex));
+        if (leafResult == m_leaves.at(leafIndex).result)
+            continue;
+
+        m_leaves[leafIndex].result = leafResult;
+
+        int index = m_leaves.at(leafIndex).node;
+        while (index >= 0) {
+            Node &node = m_nodes[index];
+            bool result = nodeResult(node);
+            if (result == node.result)
+                break;
+
+            node.result = result;
+            if (node.parent >= 0)
+                m_nodes[node.parent].trueChildren += result ? 1 : -1;
+
+            index = node.parent;
+        }
+    }
+
+    return result();
+}
+
+int CompiledStateEvaluator::compileNode(const StateEvaluator &stateEvaluator)
+{
+    // Children first, they end up in front of their parent
+    QVector<int> children;
+    foreach (const StateEvaluator &childEvaluator, stateEvaluator.childEvaluators()) {
+        children.append(compileNode(childEvaluator));
+    }
+
+    int index = m_nodes.count();
+    foreach (int child, children) {
+        m_nodes[child].parent = index;
+    }
+
+    Node node;
+    node.leaf = -1;
+    node.operatorType = stateEvaluator.operatorType();
+    node.firstChild = m_children.count();
+    node.childCount = children.count();
+    node.parent = -1;
+    node.trueChildren = 0;
+    node.result = false;
+    m_children += children;
+
+    StateDescriptor stateDescriptor = stateEvaluator.stateDescriptor();
+    if (stateDescriptor.isValid()) {
+        Leaf leaf;
+        leaf.deviceId = stateDescriptor.deviceId();
+        leaf.stateTypeId = stateDescriptor.stateTypeId();
+        leaf.device = GuhCore::instance()->deviceManager()->findConfiguredDevice(stateDescriptor.deviceId());
+        leaf.stateIndex = -1;
+        leaf.value = stateDescriptor.stateValue();
+        leaf.operatorType = stateDescriptor.operatorType();
+        leaf.node = index;
+        leaf.result = false;
+
+        if (leaf.device.isNull()) {
+            qCWarning(dcRuleEngine) << "Device not existing!";
+        } else {
+            QList<State> states = leaf.device->states();
+            for (int i = 0; i < states.count(); i++) {
+                if (states.at(i).stateTypeId() == stateDescriptor.stateTypeId()) {
+                    leaf.stateIndex = i;
+                    break;
+                }
+            }
+            if (leaf.stateIndex < 0) {
+                qCWarning(dcRuleEngine) << "Device found, but it does not appear to have such a state!";
+            }
+        }
+
+        node.leaf = m_leaves.count();
+        m_leafIndex[QPair<QUuid, QUuid>(leaf.deviceId, leaf.stateTypeId)].append(node.leaf);
+        m_leaves.append(leaf);
+    }
+
+    m_nodes.append(node);
+    return index;
+}
+
+bool CompiledStateEvaluator::evaluateNode(int index) const
+{
+    const Node &node = m_nodes.at(index);
+    if (node.leaf >= 0 && !evaluateLeaf(m_leaves.at(node.leaf)))
+        return false;
+
+    if (node.operatorType == Types::StateOperatorOr) {
+        for (int i = node.firstChild; i < node.firstChild + node.childCount; i++) {
+            if (evaluateNode(m_children.at(i))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    for (int i = node.firstChild; i < node.firstChild + node.childCount; i++) {
+        if (!evaluateNode(m_children.at(i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CompiledStateEvaluator::nodeResult(const Node &node) const
+{
+    if (node.leaf >= 0 && !m_leaves.at(node.leaf).result)
+        return false;
+
+    if (node.operatorType == Types::StateOperatorOr)
+        return node.trueChildren > 0;
+
+    return node.trueChildren == node.childCount;
+}
+
+bool CompiledStateEvaluator::evaluateLeaf(const Leaf &leaf) const
+{
+    if (leaf.stateIndex < 0 || leaf.device.isNull())
+        return false;
+
+    // Note: the state list is implicitly shared, this does not copy the states
+    const QList<State> states = leaf.device->states();
+    if (leaf.stateIndex >= states.count())
+        return false;
+
+    QVariant value = states.at(leaf.stateIndex).value();
+    if (value.userType() != leaf.value.userType())
+        value.convert(leaf.value.type());
+
+    switch (leaf.operatorType) {
+    case Types::ValueOperatorEquals:
+        return leaf.value == value;
+    case Types::ValueOperatorGreater:
+        return value > leaf.value;
+    case Types::ValueOperatorGreaterOrEqual:
+        return value >= leaf.value;
+    case Types::ValueOperatorLess:
+        return value < leaf.value;
+    case Types::ValueOperatorLessOrEqual:
+        return value <= leaf.value;
+    case Types::ValueOperatorNotEquals:
+        return leaf.value != value;
+    }
+    return false;
+}
+
+}
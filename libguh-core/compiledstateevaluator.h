@@ -0,0 +1,89 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef COMPILEDSTATEEVALUATOR_H
+#define COMPILEDSTATEEVALUATOR_H
+
+#include "stateevaluator.h"
+#include "plugin/device.h"
+
+#include <QHash>
+#include <QPair>
+#include <QVector>
+#include <QPointer>
+#include <QVariant>
+
+namespace guhserver {
+
+class CompiledStateEvaluator
+{
+public:
+    CompiledStateEvaluator();
+
+    static CompiledStateEvaluator compile(const StateEvaluator &stateEvaluator);
+
+    bool isEmpty() const;
+    bool containsDevice(const DeviceId &deviceId) const;
+
+    bool evaluate() const;
+
+    bool result() const;
+    QList<bool> results() const;
+
+    void refresh();
+    bool updateState(const DeviceId &deviceId, const StateTypeId &stateTypeId);
+
+private:
+    struct Leaf {
+        DeviceId deviceId;
+        StateTypeId stateTypeId;
+        QPointer<Device> device;
+        int stateIndex;
+        QVariant value;
+        Types::ValueOperator operatorType;
+        int node;
+        bool result;
+    };
+
+    struct Node {
+        int leaf;
+        Types::StateOperator operatorType;
+        int firstChild;
+        int childCount;
+        int parent;
+        int trueChildren;
+        bool result;
+    };
+
+    int compileNode(const StateEvaluator &stateEvaluator);
+
+    bool evaluateNode(int index) const;
+    bool evaluateLeaf(const Leaf &leaf) const;
+    bool nodeResult(const Node &node) const;
+
+    QVector<Leaf> m_leaves;
+    QVector<Node> m_nodes; // postfix order, the root node is the last one
+    QVector<int> m_children;
+    QHash<QPair<QUuid, QUuid>, QVector<int> > m_leafIndex; // (DeviceId, StateTypeId) -> leaves
+};
+
+}
+
+#endif // COMPILEDSTATEEVALUATOR_H
@@ -84,6 +84,14 @@
     This signal is emitted when a \a rule was added to the system.
 */
 
+/*! \fn void guhserver::GuhCore::rulesRemoved(const QList<RuleId> &ruleIds);
+    This signal is emitted when a batch of \l{Rule}{Rules} with the given \a ruleIds was removed.
+*/
+
+/*! \fn void guhserver::GuhCore::rulesAdded(const QList<Rule> &rules);
+    This signal is emitted when a batch of \a rules was added to the system.
+*/
+
 /*! \fn void guhserver::GuhCore::ruleConfigurationChanged(const Rule &rule);
     This signal is emitted when the configuration of \a rule changed.
 */
@@ -300,6 +308,20 @@ DeviceManager::DeviceError GuhCore::removeConfiguredDevice(const DeviceId &devic
     return removeError;
 }
 
+/*! Calls the metheod RuleEngine::removeRules(\a ids, \a failedIndex).
+ *  \sa RuleEngine, */
+RuleEngine::RuleError GuhCore::removeRules(const QList<RuleId> &ids, int *failedIndex)
+{
+    RuleEngine::RuleError removeError = m_ruleEngine->removeRules(ids, failedIndex);
+    if (removeError == RuleEngine::RuleErrorNoError) {
+        foreach (const RuleId &id, ids) {
+            m_logger->removeRuleLogs(id);
+        }
+    }
+
+    return removeError;
+}
+
 /*! Calls the metheod DeviceManager::executeAction(\a action).
  *  \sa DeviceManager::executeAction(), */
 DeviceManager::DeviceError GuhCore::executeAction(const Action &action)
@@ -413,6 +435,12 @@ CloudManager *GuhCore::cloudManager() const
     return m_cloudManager;
 }
 
+/*! Returns the pointer to the \l{RecentStateBuffer} holding the latest values of the device states. */
+RecentStateBuffer *GuhCore::recentStateBuffer() const
+{
+    return m_recentStateBuffer;
+}
+
 
 /*! Constructs GuhCore with the given \a parent. This is private.
     Use \l{GuhCore::instance()} to access the single instance.*/
@@ -432,6 +460,9 @@ void GuhCore::init() {
     qCDebug(dcApplication) << "Creating Log Engine";
     m_logger = new LogEngine(GuhSettings::logPath(), this);
 
+    qCDebug(dcApplication) << "Creating Recent State Buffer";
+    m_recentStateBuffer = new RecentStateBuffer(100, 600, this);
+
     qCDebug(dcApplication) << "Creating Device Manager (locale:" << m_configuration->locale() << ")";
     m_deviceManager = new DeviceManager(m_configuration->locale(), this);
 
@@ -473,10 +504,14 @@ void GuhCore::init() {
     connect(m_deviceManager, &DeviceManager::deviceSetupFinished, this, &GuhCore::deviceSetupFinished);
     connect(m_deviceManager, &DeviceManager::deviceReconfigurationFinished, this, &GuhCore::deviceReconfigurationFinished);
     connect(m_deviceManager, &DeviceManager::pairingFinished, this, &GuhCore::pairingFinished);
+    connect(m_deviceManager, &DeviceManager::deviceStateChanged, m_recentStateBuffer, &RecentStateBuffer::onDeviceStateChanged);
+    connect(m_deviceManager, &DeviceManager::deviceRemoved, m_recentStateBuffer, &RecentStateBuffer::removeDevice);
     connect(m_deviceManager, &DeviceManager::loaded, this, &GuhCore::deviceManagerLoaded);
 
     connect(m_ruleEngine, &RuleEngine::ruleAdded, this, &GuhCore::ruleAdded);
     connect(m_ruleEngine, &RuleEngine::ruleRemoved, this, &GuhCore::ruleRemoved);
+    connect(m_ruleEngine, &RuleEngine::rulesAdded, this, &GuhCore::rulesAdded);
+    connect(m_ruleEngine, &RuleEngine::rulesRemoved, this, &GuhCore::rulesRemoved);
     connect(m_ruleEngine, &RuleEngine::ruleConfigurationChanged, this, &GuhCore::ruleConfigurationChanged);
 
     connect(m_timeManager, &TimeManager::dateTimeChanged, this, &GuhCore::onDateTimeChanged);
@@ -658,6 +693,16 @@ void GuhCore::onDeviceDisappeared(const DeviceId &deviceId)
 
 void GuhCore::deviceManagerLoaded()
 {
+    // Route the high rate states into the time series store
+    QList<StateTypeId> timeSeriesStateTypes;
+    foreach (const DeviceClass &deviceClass, m_deviceManager->supportedDevices()) {
+        foreach (const StateType &stateType, deviceClass.stateTypes()) {
+            if (stateType.timeSeries())
+                timeSeriesStateTypes.append(stateType.id());
+        }
+    }
+    m_logger->setTimeSeriesStateTypes(timeSeriesStateTypes);
+
     // Do some houskeeping...
     qCDebug(dcApplication()) << "Starting housekeeping...";
     QDateTime startTime = QDateTime::currentDateTime();
@@ -34,6 +34,7 @@
 #include "ruleengine.h"
 #include "servermanager.h"
 #include "cloudmanager.h"
+#include "recentstatebuffer.h"
 
 #include "time/timemanager.h"
 
@@ -67,6 +68,7 @@ public:
     void executeRuleActions(const QList<RuleAction> ruleActions);
 
     RuleEngine::RuleError removeRule(const RuleId &id);
+    RuleEngine::RuleError removeRules(const QList<RuleId> &ids, int *failedIndex = 0);
 
     GuhConfiguration *configuration() const;
     LogEngine* logEngine() const;
@@ -80,6 +82,7 @@ public:
     NetworkManager *networkManager() const;
     UserManager *userManager() const;
     CloudManager *cloudManager() const;
+    RecentStateBuffer *recentStateBuffer() const;
 
     static QStringList getAvailableLanguages();
 
@@ -101,6 +104,8 @@ signals:
 
     void ruleRemoved(const RuleId &ruleId);
     void ruleAdded(const Rule &rule);
+    void rulesRemoved(const QList<RuleId> &ruleIds);
+    void rulesAdded(const QList<Rule> &rules);
     void ruleActiveChanged(const Rule &rule);
     void ruleConfigurationChanged(const Rule &rule);
 
@@ -115,6 +120,7 @@ private:
     LogEngine *m_logger;
     TimeManager *m_timeManager;
     CloudManager *m_cloudManager;
+    RecentStateBuffer *m_recentStateBuffer;
 
     NetworkManager *m_networkManager;
     UserManager *m_userManager;
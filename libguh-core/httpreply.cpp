@@ -105,6 +105,10 @@
         The \l{HttpReply} can be responded imediatly.
     \value TypeAsync
         The \l{HttpReply} is asynchron and has to be responded later.
+    \value TypeChunked
+        The payload of the \l{HttpReply} is streamed with the chunked transfer encoding.
+
+    \sa setChunkProvider()
 */
 
 /*! \fn void guhserver::HttpReply::finished();
@@ -145,7 +149,8 @@ HttpReply::HttpReply(QObject *parent) :
     m_type(HttpReply::TypeSync),
     m_payload(QByteArray()),
     m_closeConnection(false),
-    m_timedOut(false)
+    m_timedOut(false),
+    m_chunksFinished(false)
 {
     m_timer = new QTimer(this);
     connect(m_timer, &QTimer::timeout, this, &HttpReply::timedOut);
@@ -168,7 +173,8 @@ HttpReply::HttpReply(const HttpReply::HttpStatusCode &statusCode, const HttpRepl
     m_statusCode(statusCode),
     m_type(type),
     m_payload(QByteArray()),
-    m_timedOut(false)
+    m_timedOut(false),
+    m_chunksFinished(false)
 {
     m_timer = new QTimer(this);
     connect(m_timer, &QTimer::timeout, this, &HttpReply::timeout);
@@ -333,6 +339,52 @@ QByteArray HttpReply::data() const
     return m_data;
 }
 
+/*! Streams the payload of this \l{HttpReply} using the chunked transfer encoding. The \l{WebServer} calls
+    the given \a chunkProvider whenever the client connection is ready for more data, until it returns an
+    empty QByteArray. This makes the reply a \l{TypeChunked} reply.
+
+    A client can not send further requests on the connection while the payload is streamed, so the
+    connection gets closed once the last chunk has been written.
+
+    \sa nextChunk()
+*/
+void HttpReply::setChunkProvider(const ChunkProvider &chunkProvider)
+{
+    m_type = TypeChunked;
+    m_chunkProvider = chunkProvider;
+    m_chunksFinished = false;
+    m_payload.clear();
+    m_rawHeaderList.remove(getHeaderType(ContentLenghtHeader));
+    m_rawHeaderList.remove("Keep-Alive");
+    setRawHeader("Transfer-Encoding", "chunked");
+    setHeader(HttpHeaderType::ConnectionHeader, "close");
+    setCloseConnection(true);
+}
+
+/*! Returns the next encoded chunk of this \l{TypeChunked} reply. The last chunk terminates the payload.
+
+    \sa chunksFinished()
+*/
+QByteArray HttpReply::nextChunk()
+{
+    if (m_chunksFinished)
+        return QByteArray();
+
+    QByteArray chunk = m_chunkProvider ? m_chunkProvider() : QByteArray();
+    if (chunk.isEmpty()) {
+        m_chunksFinished = true;
+        return "0\r\n\r\n";
+    }
+
+    return QByteArray::number(chunk.size(), 16) + "\r\n" + chunk + "\r\n";
+}
+
+/*! Returns true if the last chunk of this \l{TypeChunked} reply has been returned by nextChunk(). */
+bool HttpReply::chunksFinished() const
+{
+    return m_chunksFinished;
+}
+
 /*! Return true if the response took to long for the request.*/
 bool HttpReply::timedOut() const
 {
@@ -27,6 +27,8 @@
 #include <QTimer>
 #include <QUuid>
 
+#include <functional>
+
 // Note: RFC 7231 HTTP/1.1 Semantics and Content -> http://tools.ietf.org/html/rfc7231
 
 namespace guhserver {
@@ -70,9 +72,12 @@ public:
 
     enum Type {
         TypeSync,
-        TypeAsync
+        TypeAsync,
+        TypeChunked
     };
 
+    typedef std::function<QByteArray()> ChunkProvider;
+
     HttpReply(QObject *parent = 0);
     HttpReply(const HttpStatusCode &statusCode = HttpStatusCode::Ok, const Type &type = TypeSync, QObject *parent = 0);
 
@@ -104,6 +109,10 @@ public:
 
     QByteArray data() const;
 
+    void setChunkProvider(const ChunkProvider &chunkProvider);
+    QByteArray nextChunk();
+    bool chunksFinished() const;
+
     bool timedOut() const;
 
 private:
@@ -123,6 +132,9 @@ private:
     QTimer *m_timer;
     bool m_timedOut;
 
+    ChunkProvider m_chunkProvider;
+    bool m_chunksFinished;
+
     QByteArray getHttpReasonPhrase(const HttpStatusCode &statusCode);
     QByteArray getHeaderType(const HttpHeaderType &headerType);
 
@@ -269,6 +269,25 @@ DeviceHandler::DeviceHandler(QObject *parent) :
     returns.insert("o:values", states);
     setReturns("GetStateValues", returns);
 
+    params.clear(); returns.clear();
+    setDescription("GetRecentStateValues", "Get the recent values of the given device and the given stateType, "
+                   "oldest first. The values are kept in memory, up to the last 100 values of the last 10 "
+                   "minutes. Use count to get only the last count values and maxAge to get only the values "
+                   "of the last maxAge seconds. The timestamps are given in ms since epoch.");
+    params.insert("deviceId", JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    params.insert("stateTypeId", JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    params.insert("o:count", JsonTypes::basicTypeToString(JsonTypes::Int));
+    params.insert("o:maxAge", JsonTypes::basicTypeToString(JsonTypes::Int));
+    setParams("GetRecentStateValues", params);
+    returns.insert("deviceError", JsonTypes::deviceErrorRef());
+    QVariantList recentValues;
+    QVariantMap recentValue;
+    recentValue.insert("timestamp", JsonTypes::basicTypeToString(JsonTypes::Int));
+    recentValue.insert("value", JsonTypes::basicTypeToString(JsonTypes::Variant));
+    recentValues.append(recentValue);
+    returns.insert("o:values", recentValues);
+    setReturns("GetRecentStateValues", returns);
+
     // Notifications
     params.clear(); returns.clear();
     setDescription("StateChanged", "Emitted whenever a State of a device changes.");
@@ -627,6 +646,55 @@ JsonReply *DeviceHandler::GetStateValues(const QVariantMap &params) const
     return createReply(returns);
 }
 
+JsonReply *DeviceHandler::GetRecentStateValues(const QVariantMap &params) const
+{
+    QVariantMap returns;
+
+    Device *device = GuhCore::instance()->deviceManager()->findConfiguredDevice(DeviceId(params.value("deviceId").toString()));
+    if (!device) {
+        returns.insert("deviceError", JsonTypes::deviceErrorToString(DeviceManager::DeviceErrorDeviceNotFound));
+        return createReply(returns);
+    }
+    StateTypeId stateTypeId = StateTypeId(params.value("stateTypeId").toString());
+    if (!device->hasState(stateTypeId)) {
+        returns.insert("deviceError", JsonTypes::deviceErrorToString(DeviceManager::DeviceErrorStateTypeNotFound));
+        return createReply(returns);
+    }
+
+    int count = params.value("count", -1).toInt();
+    int maxAge = params.value("maxAge", -1).toInt();
+    if ((params.contains("count") && count < 0) || (params.contains("maxAge") && maxAge < 0)) {
+        returns.insert("deviceError", JsonTypes::deviceErrorToString(DeviceManager::DeviceErrorInvalidParameter));
+        return createReply(returns);
+    }
+
+    QVariantList values;
+    foreach (const RecentStateBuffer::Sample &sample, GuhCore::instance()->recentStateBuffer()->samples(device->id(), stateTypeId, count, maxAge)) {
+        QVariantMap value;
+        value.insert("timestamp", sample.first);
+        value.insert("value", sample.second);
+        values.append(value);
+    }
+
+    returns.insert("deviceError", JsonTypes::deviceErrorToString(DeviceManager::DeviceErrorNoError));
+    returns.insert("values", values);
+    return createReply(returns);
+}
+
+/*! Sets \a deviceId to the device the \a notification with the given \a params is about, and
+    \a stateTypeId to the changed state for the StateChanged notification. */
+void DeviceHandler::notificationScope(const QString &notification, const QVariantMap &params, QUuid *deviceId, QUuid *stateTypeId) const
+{
+    if (notification == "StateChanged") {
+        *deviceId = params.value("deviceId").toUuid();
+        *stateTypeId = params.value("stateTypeId").toUuid();
+    } else if (notification == "DeviceRemoved") {
+        *deviceId = params.value("deviceId").toUuid();
+    } else if (notification == "DeviceAdded" || notification == "DeviceChanged") {
+        *deviceId = params.value("device").toMap().value("id").toUuid();
+    }
+}
+
 void DeviceHandler::pluginConfigChanged(const PluginId &id, const ParamList &config)
 {
     QVariantMap params;
@@ -55,6 +55,9 @@ public:
     Q_INVOKABLE JsonReply *GetStateTypes(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *GetStateValue(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *GetStateValues(const QVariantMap &params) const;
+    Q_INVOKABLE JsonReply *GetRecentStateValues(const QVariantMap &params) const;
+
+    void notificationScope(const QString &notification, const QVariantMap &params, QUuid *deviceId, QUuid *stateTypeId) const override;
 
 signals:
     void PluginConfigurationChanged(const QVariantMap &params);
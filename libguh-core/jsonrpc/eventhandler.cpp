@@ -96,4 +96,13 @@ JsonReply* EventHandler::GetEventType(const QVariantMap &params) const
     return createReply(statusToReply(DeviceManager::DeviceErrorEventTypeNotFound));
 }
 
+/*! Sets \a deviceId to the device which triggered the event of the EventTriggered \a notification
+    with the given \a params. The \a stateTypeId stays null. */
+void EventHandler::notificationScope(const QString &notification, const QVariantMap &params, QUuid *deviceId, QUuid *stateTypeId) const
+{
+    Q_UNUSED(stateTypeId)
+    if (notification == "EventTriggered")
+        *deviceId = params.value("event").toMap().value("deviceId").toUuid();
+}
+
 }
@@ -35,6 +35,8 @@ public:
 
     Q_INVOKABLE JsonReply *GetEventType(const QVariantMap &params) const;
 
+    void notificationScope(const QString &notification, const QVariantMap &params, QUuid *deviceId, QUuid *stateTypeId) const override;
+
 signals:
     void EventTriggered(const QVariantMap &params);
 
@@ -107,6 +107,10 @@ bool JsonHandler::hasMethod(const QString &methodName)
     the params are not valid. */
 QPair<bool, QString> JsonHandler::validateParams(const QString &methodName, const QVariantMap &params)
 {
+    QHash<QString, JsonValidator>::const_iterator validator = m_paramValidators.constFind(methodName);
+    if (validator != m_paramValidators.constEnd())
+        return validator.value().validate(params);
+
     QVariantMap paramTemplate = m_params.value(methodName);
     return JsonTypes::validateMap(paramTemplate, params);
 }
@@ -115,10 +119,62 @@ QPair<bool, QString> JsonHandler::validateParams(const QString &methodName, cons
     the params are not valid. */
 QPair<bool, QString> JsonHandler::validateReturns(const QString &methodName, const QVariantMap &returns)
 {
+    QHash<QString, JsonValidator>::const_iterator validator = m_returnValidators.constFind(methodName);
+    if (validator != m_returnValidators.constEnd())
+        return validator.value().validate(returns);
+
     QVariantMap returnsTemplate = m_returns.value(methodName);
     return JsonTypes::validateMap(returnsTemplate, returns);
 }
 
+/*! Compiles the params and returns templates of all methods and notifications into a \l{JsonValidator}.
+    Afterwards validateParams() and validateReturns() do not need to parse the templates any more. This
+    is called once the handler gets registered, after all templates have been set. */
+void JsonHandler::compileValidators()
+{
+    m_paramValidators.clear();
+    foreach (const QString &methodName, m_params.keys()) {
+        m_paramValidators.insert(methodName, JsonValidator(m_params.value(methodName)));
+    }
+    m_returnValidators.clear();
+    foreach (const QString &methodName, m_returns.keys()) {
+        m_returnValidators.insert(methodName, JsonValidator(m_returns.value(methodName)));
+    }
+}
+
+
+/*! Sets \a deviceId and \a stateTypeId to the device and state type the \a notification with the given
+    \a params is about, which lets clients subscribe to the notifications of single devices and states.
+    The default implementation leaves both null, so the notification is not limited to any device. */
+void JsonHandler::notificationScope(const QString &notification, const QVariantMap &params, QUuid *deviceId, QUuid *stateTypeId) const
+{
+    Q_UNUSED(notification)
+    Q_UNUSED(params)
+    Q_UNUSED(deviceId)
+    Q_UNUSED(stateTypeId)
+}
+
+/*! Returns false if the notification with the given \a notification name should not be sent to the
+    client with the given \a clientId. Handlers can reimplement this method to deliver notifications only to
+    the clients subscribed to them, and may reduce the \a params to the part the client is interested in.
+    Notifications covering several devices have to apply the device and state type filter of the client's
+    \a subscription themselves, see notificationScope().
+    The default implementation sends every notification unchanged to every client. */
+bool JsonHandler::filterNotification(const QUuid &clientId, const QString &notification, const NotificationSubscriptions::Subscription &subscription, QVariantMap *params) const
+{
+    Q_UNUSED(clientId)
+    Q_UNUSED(notification)
+    Q_UNUSED(subscription)
+    Q_UNUSED(params)
+    return true;
+}
+
+/*! This method will be called when the client with the given \a clientId has disconnected. Handlers
+    keeping a per client state can reimplement it to clean up. */
+void JsonHandler::clientDisconnected(const QUuid &clientId)
+{
+    Q_UNUSED(clientId)
+}
 
 /*! Sets the \a description of the method with the given \a methodName. */
 void JsonHandler::setDescription(const QString &methodName, const QString &description)
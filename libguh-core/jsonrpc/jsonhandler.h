@@ -23,6 +23,8 @@
 #define JSONHANDLER_H
 
 #include "jsontypes.h"
+#include "jsonvalidator.h"
+#include "notificationsubscriptions.h"
 
 #include <QObject>
 #include <QVariantMap>
@@ -97,6 +99,11 @@ public:
     bool hasMethod(const QString &methodName);
     QPair<bool, QString> validateParams(const QString &methodName, const QVariantMap &params);
     QPair<bool, QString> validateReturns(const QString &methodName, const QVariantMap &returns);
+    void compileValidators();
+
+    virtual void notificationScope(const QString &notification, const QVariantMap &params, QUuid *deviceId, QUuid *stateTypeId) const;
+    virtual bool filterNotification(const QUuid &clientId, const QString &notification, const NotificationSubscriptions::Subscription &subscription, QVariantMap *params) const;
+    virtual void clientDisconnected(const QUuid &clientId);
 
 signals:
     void asyncReply(int id, const QVariantMap &params);
@@ -118,6 +125,8 @@ private:
     QHash<QString, QString> m_descriptions;
     QHash<QString, QVariantMap> m_params;
     QHash<QString, QVariantMap> m_returns;
+    QHash<QString, JsonValidator> m_paramValidators;
+    QHash<QString, JsonValidator> m_returnValidators;
 };
 
 }
@@ -67,7 +67,8 @@ namespace guhserver {
 /*! Constructs a \l{JsonRPCServer} with the given \a sslConfiguration and \a parent. */
 JsonRPCServer::JsonRPCServer(const QSslConfiguration &sslConfiguration, QObject *parent):
     JsonHandler(parent),
-    m_notificationId(0)
+    m_notificationId(0),
+    m_batchId(0)
 {
     Q_UNUSED(sslConfiguration)
     // First, define our own JSONRPC methods
@@ -110,6 +111,22 @@ JsonRPCServer::JsonRPCServer(const QSslConfiguration &sslConfiguration, QObject
     returns.insert("enabled", JsonTypes::basicTypeToString(JsonTypes::Bool));
     setReturns("SetNotificationStatus", returns);
 
+    params.clear(); returns.clear();
+    setDescription("SetNotificationSubscription", "Enable notifications for this connection, limited to the "
+                   "given filters. Only notifications in one of the given namespaces (e.g. \"Devices\") or "
+                   "with one of the given names (e.g. \"Events.EventTriggered\") will be sent. Notifications "
+                   "about a device, like Devices.StateChanged, Events.EventTriggered or Logging.LogEntryAdded, "
+                   "are limited to the given deviceIds, and notifications about a state to the given "
+                   "stateTypeIds. An omitted or empty filter does not limit the notifications. Calling "
+                   "SetNotificationStatus replaces the subscription.");
+    params.insert("o:namespaces", QVariantList() << JsonTypes::basicTypeToString(JsonTypes::String));
+    params.insert("o:notifications", QVariantList() << JsonTypes::basicTypeToString(JsonTypes::String));
+    params.insert("o:deviceIds", QVariantList() << JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    params.insert("o:stateTypeIds", QVariantList() << JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    setParams("SetNotificationSubscription", params);
+    returns.insert("enabled", JsonTypes::basicTypeToString(JsonTypes::Bool));
+    setReturns("SetNotificationSubscription", returns);
+
     params.clear(); returns.clear();
     setDescription("CreateUser", "Create a new user in the API. Currently this is only allowed to be called once when a new guh instance is set up. Call Authenticate after this to obtain a device token for this user.");
     params.insert("username", JsonTypes::basicTypeToString(JsonTypes::String));
@@ -202,6 +219,7 @@ JsonRPCServer::JsonRPCServer(const QSslConfiguration &sslConfiguration, QObject
     QMetaObject::invokeMethod(this, "setup", Qt::QueuedConnection);
 
     connect(GuhCore::instance()->userManager(), &UserManager::pushButtonAuthFinished, this, &JsonRPCServer::onPushButtonAuthFinished);
+    connect(GuhCore::instance()->userManager(), &UserManager::tokensRevoked, this, &JsonRPCServer::onTokensRevoked);
 }
 
 /*! Returns the \e namespace of \l{JsonHandler}. */
@@ -251,9 +269,37 @@ JsonReply* JsonRPCServer::Version(const QVariantMap &params) const
 JsonReply* JsonRPCServer::SetNotificationStatus(const QVariantMap &params)
 {
     QUuid clientId = this->property("clientId").toUuid();
-    m_clientNotifications[clientId] = params.value("enabled").toBool();
+    if (params.value("enabled").toBool()) {
+        m_subscriptions.subscribe(clientId);
+    } else {
+        m_subscriptions.unsubscribe(clientId);
+    }
+    QVariantMap returns;
+    returns.insert("enabled", m_subscriptions.isSubscribed(clientId));
+    return createReply(returns);
+}
+
+JsonReply *JsonRPCServer::SetNotificationSubscription(const QVariantMap &params)
+{
+    QUuid clientId = this->property("clientId").toUuid();
+
+    NotificationSubscriptions::Subscription subscription;
+    foreach (const QVariant &nameSpace, params.value("namespaces").toList()) {
+        subscription.namespaces.insert(nameSpace.toString());
+    }
+    foreach (const QVariant &notification, params.value("notifications").toList()) {
+        subscription.notifications.insert(notification.toString());
+    }
+    foreach (const QVariant &deviceId, params.value("deviceIds").toList()) {
+        subscription.deviceIds.insert(deviceId.toUuid());
+    }
+    foreach (const QVariant &stateTypeId, params.value("stateTypeIds").toList()) {
+        subscription.stateTypeIds.insert(stateTypeId.toUuid());
+    }
+    m_subscriptions.subscribe(clientId, subscription);
+
     QVariantMap returns;
-    returns.insert("enabled", m_clientNotifications[clientId]);
+    returns.insert("enabled", m_subscriptions.isSubscribed(clientId));
     return createReply(returns);
 }
 
@@ -384,44 +430,41 @@ void JsonRPCServer::unregisterTransportInterface(TransportInterface *interface)
     m_interfaces.take(interface);
 }
 
-/*! Send a JSON success response to the client with the given \a clientId,
- * \a commandId and \a params to the inerted \l{TransportInterface}.
- */
-void JsonRPCServer::sendResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QVariantMap &params)
+/*! Returns a JSON success response for the command with the given \a commandId and \a params. */
+QVariantMap JsonRPCServer::createResponse(int commandId, const QVariantMap &params) const
 {
     QVariantMap response;
     response.insert("id", commandId);
     response.insert("status", "success");
     response.insert("params", params);
-
-    QByteArray data = QJsonDocument::fromVariant(response).toJson(QJsonDocument::Compact);
-    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    interface->sendData(clientId, data);
+    return response;
 }
 
-/*! Send a JSON error response to the client with the given \a clientId,
- * \a commandId and \a error to the inerted \l{TransportInterface}.
- */
-void JsonRPCServer::sendErrorResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error)
+/*! Returns a JSON error response for the command with the given \a commandId and \a error. */
+QVariantMap JsonRPCServer::createErrorResponse(int commandId, const QString &error) const
 {
     QVariantMap errorResponse;
     errorResponse.insert("id", commandId);
     errorResponse.insert("status", "error");
     errorResponse.insert("error", error);
-
-    QByteArray data = QJsonDocument::fromVariant(errorResponse).toJson(QJsonDocument::Compact);
-    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    interface->sendData(clientId, data);
+    return errorResponse;
 }
 
-void JsonRPCServer::sendUnauthorizedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error)
+QVariantMap JsonRPCServer::createUnauthorizedResponse(int commandId, const QString &error) const
 {
     QVariantMap errorResponse;
     errorResponse.insert("id", commandId);
     errorResponse.insert("status", "unauthorized");
     errorResponse.insert("error", error);
+    return errorResponse;
+}
 
-    QByteArray data = QJsonDocument::fromVariant(errorResponse).toJson(QJsonDocument::Compact);
+/*! Send the given \a message, a single response or the list of responses of a batch, to the client
+ * with the given \a clientId on the given \a interface.
+ */
+void JsonRPCServer::sendMessage(TransportInterface *interface, const QUuid &clientId, const QVariant &message)
+{
+    QByteArray data = QJsonDocument::fromVariant(message).toJson(QJsonDocument::Compact);
     qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
     interface->sendData(clientId, data);
 }
@@ -468,25 +511,85 @@ void JsonRPCServer::processData(const QUuid &clientId, const QByteArray &data)
 
     if(error.error != QJsonParseError::NoError) {
         qCWarning(dcJsonRpc) << "Failed to parse JSON data" << data << ":" << error.errorString();
-        sendErrorResponse(interface, clientId, -1, QString("Failed to parse JSON data: %1").arg(error.errorString()));
+        sendMessage(interface, clientId, createErrorResponse(-1, QString("Failed to parse JSON data: %1").arg(error.errorString())));
+        return;
+    }
+
+    if (jsonDoc.isArray()) {
+        processBatch(interface, clientId, jsonDoc.toVariant().toList());
+        return;
+    }
+
+    QVariantMap response;
+    JsonReply *reply = processRequest(interface, clientId, jsonDoc.toVariant().toMap(), &response);
+    if (!reply) {
+        sendMessage(interface, clientId, response);
         return;
     }
 
-    QVariantMap message = jsonDoc.toVariant().toMap();
+    m_asyncReplies.insert(reply, interface);
+    connect(reply, &JsonReply::finished, this, &JsonRPCServer::asyncReplyFinished);
+    reply->startWait();
+}
+
+/*! Processes the list of requests in the given \a messages sent as one batch by the client with the given
+ * \a clientId on the given \a interface. The responses are sent back in a single list, in the order of the
+ * requests, once the last asynchronous reply of the batch has finished.
+ */
+void JsonRPCServer::processBatch(TransportInterface *interface, const QUuid &clientId, const QVariantList &messages)
+{
+    if (messages.isEmpty()) {
+        qCWarning(dcJsonRpc) << "Error parsing batch. The batch does not contain any request.";
+        sendMessage(interface, clientId, createErrorResponse(-1, "Error parsing batch. Empty list of requests."));
+        return;
+    }
+
+    int batchId = m_batchId++;
+    Batch batch;
+    batch.interface = interface;
+    batch.clientId = clientId;
+    batch.pendingReplies = 0;
+
+    for (int i = 0; i < messages.count(); i++) {
+        QVariantMap response;
+        JsonReply *reply = processRequest(interface, clientId, messages.at(i).toMap(), &response);
+        batch.responses.append(response);
+        if (!reply)
+            continue;
+
+        batch.pendingReplies++;
+        m_asyncReplies.insert(reply, interface);
+        m_batchReplies.insert(reply, qMakePair(batchId, i));
+        connect(reply, &JsonReply::finished, this, &JsonRPCServer::asyncReplyFinished);
+        reply->startWait();
+    }
+
+    if (batch.pendingReplies == 0) {
+        sendMessage(interface, clientId, batch.responses);
+        return;
+    }
+    m_batches.insert(batchId, batch);
+}
 
+/*! Processes the request in the given \a message from the client with the given \a clientId on the given
+ * \a interface. Returns the pending reply if the method replies asynchronously, otherwise the \a response is
+ * filled in and 0 is returned.
+ */
+JsonReply *JsonRPCServer::processRequest(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message, QVariantMap *response)
+{
     bool success;
     int commandId = message.value("id").toInt(&success);
     if (!success) {
         qCWarning(dcJsonRpc) << "Error parsing command. Missing \"id\":" << message;
-        sendErrorResponse(interface, clientId, commandId, "Error parsing command. Missing 'id'");
-        return;
+        *response = createErrorResponse(commandId, "Error parsing command. Missing 'id'");
+        return nullptr;
     }
 
     QStringList commandList = message.value("method").toString().split('.');
     if (commandList.count() != 2) {
         qCWarning(dcJsonRpc) << "Error parsing method.\nGot:" << message.value("method").toString() << "\nExpected: \"Namespace.method\"";
-        sendErrorResponse(interface, clientId, commandId, QString("Error parsing method. Got: '%1'', Expected: 'Namespace.method'").arg(message.value("method").toString()));
-        return;
+        *response = createErrorResponse(commandId, QString("Error parsing method. Got: '%1'', Expected: 'Namespace.method'").arg(message.value("method").toString()));
+        return nullptr;
     }
     QString targetNamespace = commandList.first();
     QString method = commandList.last();
@@ -494,19 +597,27 @@ void JsonRPCServer::processData(const QUuid &clientId, const QByteArray &data)
     // check if authentication is required for this transport
     if (m_interfaces.value(interface)) {
         QByteArray token = message.value("token").toByteArray();
-        QStringList authExemptMethodsNoUser = {"Introspect", "Hello", "CreateUser", "RequestPushButtonAuth"};
-        QStringList authExemptMethodsWithUser = {"Introspect", "Hello", "Authenticate", "RequestPushButtonAuth"};
+        static const QStringList authExemptMethodsNoUser = {"Introspect", "Hello", "CreateUser", "RequestPushButtonAuth"};
+        static const QStringList authExemptMethodsWithUser = {"Introspect", "Hello", "Authenticate", "RequestPushButtonAuth"};
+
+        // Once verified, the token is bound to the connection until it gets revoked
+        bool authenticated = !token.isEmpty() && m_clientTokens.value(clientId) == token;
+        if (!token.isEmpty() && !authenticated && GuhCore::instance()->userManager()->verifyToken(token)) {
+            m_clientTokens.insert(clientId, token);
+            authenticated = true;
+        }
+
         // if there is no user in the system yet, let's fail unless this is special method for authentication itself
         if (GuhCore::instance()->userManager()->users().isEmpty()) {
-            if (!(targetNamespace == "JSONRPC" && authExemptMethodsNoUser.contains(method)) && (token.isEmpty() || !GuhCore::instance()->userManager()->verifyToken(token))) {
-                sendUnauthorizedResponse(interface, clientId, commandId, "Initial setup required. Call CreateUser first.");
-                return;
+            if (!(targetNamespace == "JSONRPC" && authExemptMethodsNoUser.contains(method)) && !authenticated) {
+                *response = createUnauthorizedResponse(commandId, "Initial setup required. Call CreateUser first.");
+                return nullptr;
             }
         } else {
             // ok, we have a user. if there isn't a valid token, let's fail unless this is a Authenticate, Introspect  Hello call
-            if (!(targetNamespace == "JSONRPC" && authExemptMethodsWithUser.contains(method)) && (token.isEmpty() || !GuhCore::instance()->userManager()->verifyToken(token))) {
-                sendUnauthorizedResponse(interface, clientId, commandId, "Forbidden: Invalid token.");
-                return;
+            if (!(targetNamespace == "JSONRPC" && authExemptMethodsWithUser.contains(method)) && !authenticated) {
+                *response = createUnauthorizedResponse(commandId, "Forbidden: Invalid token.");
+                return nullptr;
             }
         }
     }
@@ -514,20 +625,20 @@ void JsonRPCServer::processData(const QUuid &clientId, const QByteArray &data)
 
     JsonHandler *handler = m_handlers.value(targetNamespace);
     if (!handler) {
-        sendErrorResponse(interface, clientId, commandId, "No such namespace");
-        return;
+        *response = createErrorResponse(commandId, "No such namespace");
+        return nullptr;
     }
     if (!handler->hasMethod(method)) {
-        sendErrorResponse(interface, clientId, commandId, "No such method");
-        return;
+        *response = createErrorResponse(commandId, "No such method");
+        return nullptr;
     }
 
     QVariantMap params = message.value("params").toMap();
 
     QPair<bool, QString> validationResult = handler->validateParams(method, params);
     if (!validationResult.first) {
-        sendErrorResponse(interface, clientId, commandId, "Invalid params: " + validationResult.second);
-        return;
+        *response = createErrorResponse(commandId, "Invalid params: " + validationResult.second);
+        return nullptr;
     }
 
     // Hack: attach some properties to the handler to be able to handle the JSONRPC methods. Do not use this outside of jsonrpcserver
@@ -540,17 +651,16 @@ void JsonRPCServer::processData(const QUuid &clientId, const QByteArray &data)
     JsonReply *reply;
     QMetaObject::invokeMethod(handler, method.toLatin1().data(), Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params));
     if (reply->type() == JsonReply::TypeAsync) {
-        m_asyncReplies.insert(reply, interface);
         reply->setClientId(clientId);
         reply->setCommandId(commandId);
-        connect(reply, &JsonReply::finished, this, &JsonRPCServer::asyncReplyFinished);
-        reply->startWait();
-    } else {
-        Q_ASSERT_X((targetNamespace == "JSONRPC" && method == "Introspect") || handler->validateReturns(method, reply->data()).first
-                   ,"validating return value", formatAssertion(targetNamespace, method, handler, reply->data()).toLatin1().data());
-        sendResponse(interface, clientId, commandId, reply->data());
-        reply->deleteLater();
+        return reply;
     }
+
+    Q_ASSERT_X((targetNamespace == "JSONRPC" && method == "Introspect") || handler->validateReturns(method, reply->data()).first
+               ,"validating return value", formatAssertion(targetNamespace, method, handler, reply->data()).toLatin1().data());
+    *response = createResponse(commandId, reply->data());
+    reply->deleteLater();
+    return nullptr;
 }
 
 QString JsonRPCServer::formatAssertion(const QString &targetNamespace, const QString &method, JsonHandler *handler, const QVariantMap &data) const
@@ -568,14 +678,41 @@ void JsonRPCServer::sendNotification(const QVariantMap &params)
     JsonHandler *handler = qobject_cast<JsonHandler *>(sender());
     QMetaMethod method = handler->metaObject()->method(senderSignalIndex());
 
+    QString notificationName = handler->name() + "." + method.name();
+
     QVariantMap notification;
     notification.insert("id", m_notificationId++);
-    notification.insert("notification", handler->name() + "." + method.name());
-    notification.insert("params", params);
+    notification.insert("notification", notificationName);
+
+    QUuid deviceId;
+    QUuid stateTypeId;
+    handler->notificationScope(method.name(), params, &deviceId, &stateTypeId);
+
+    // Clients getting the unfiltered notification share one encoded payload per transport
+    QHash<TransportInterface *, QList<QUuid> > receivers;
+    foreach (const QUuid &clientId, m_subscriptions.subscribers(notificationName, deviceId, stateTypeId)) {
+        QVariantMap clientParams = params;
+        if (!handler->filterNotification(clientId, method.name(), m_subscriptions.subscription(clientId), &clientParams))
+            continue;
+
+        // Unchanged params still share their data, so this comparison is cheap
+        if (clientParams == params) {
+            receivers[m_clientTransports.value(clientId)].append(clientId);
+            continue;
+        }
 
-    foreach (const QUuid &clientId, m_clientNotifications.keys(true)) {
+        notification.insert("params", clientParams);
         m_clientTransports.value(clientId)->sendData(clientId, QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact));
     }
+
+    if (receivers.isEmpty())
+        return;
+
+    notification.insert("params", params);
+    QByteArray data = QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact);
+    foreach (TransportInterface *transport, receivers.keys()) {
+        transport->sendData(receivers.value(transport), data);
+    }
 }
 
 void JsonRPCServer::asyncReplyFinished()
@@ -587,14 +724,31 @@ void JsonRPCServer::asyncReplyFinished()
         reply->deleteLater();
         return;
     }
+    QVariantMap response;
     if (!reply->timedOut()) {
         Q_ASSERT_X(reply->handler()->validateReturns(reply->method(), reply->data()).first
                    ,"validating return value", formatAssertion(reply->handler()->name(), reply->method(), reply->handler(), reply->data()).toLatin1().data());
-        sendResponse(interface, reply->clientId(), reply->commandId(), reply->data());
+        response = createResponse(reply->commandId(), reply->data());
     } else {
-        sendErrorResponse(interface, reply->clientId(), reply->commandId(), "Command timed out");
+        response = createErrorResponse(reply->commandId(), "Command timed out");
+    }
+
+    if (!m_batchReplies.contains(reply)) {
+        sendMessage(interface, reply->clientId(), response);
+        reply->deleteLater();
+        return;
     }
 
+    // Part of a batch, send all responses together once the last one is in
+    QPair<int, int> position = m_batchReplies.take(reply);
+    QHash<int, Batch>::iterator batch = m_batches.find(position.first);
+    if (batch != m_batches.end()) {
+        batch.value().responses[position.second] = response;
+        if (--batch.value().pendingReplies == 0) {
+            sendMessage(batch.value().interface, batch.value().clientId, batch.value().responses);
+            m_batches.erase(batch);
+        }
+    }
     reply->deleteLater();
 }
 
@@ -647,8 +801,15 @@ void JsonRPCServer::onPushButtonAuthFinished(int transactionId, bool success, co
     transport->sendData(clientId, QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact));
 }
 
+void JsonRPCServer::onTokensRevoked()
+{
+    // Clients verify their token again on their next call
+    m_clientTokens.clear();
+}
+
 void JsonRPCServer::registerHandler(JsonHandler *handler)
 {
+    handler->compileValidators();
     m_handlers.insert(handler->name(), handler);
     for (int i = 0; i < handler->metaObject()->methodCount(); ++i) {
         QMetaMethod method = handler->metaObject()->method(i);
@@ -665,7 +826,8 @@ void JsonRPCServer::clientConnected(const QUuid &clientId)
     m_clientTransports.insert(clientId, interface);
 
     // If authentication is required, notifications are disabled by default. Clients must enable them with a valid token
-    m_clientNotifications.insert(clientId, !interface->configuration().authenticationEnabled);
+    if (!interface->configuration().authenticationEnabled)
+        m_subscriptions.subscribe(clientId);
 
     interface->sendData(clientId, QJsonDocument::fromVariant(createWelcomeMessage(interface)).toJson(QJsonDocument::Compact));
 }
@@ -674,7 +836,11 @@ void JsonRPCServer::clientDisconnected(const QUuid &clientId)
 {
     qCDebug(dcJsonRpc()) << "Client disconnected:" << clientId;
     m_clientTransports.remove(clientId);
-    m_clientNotifications.remove(clientId);
+    m_clientTokens.remove(clientId);
+    m_subscriptions.unsubscribe(clientId);
+    foreach (JsonHandler *handler, m_handlers) {
+        handler->clientDisconnected(clientId);
+    }
     if (m_pushButtonTransactions.values().contains(clientId)) {
         GuhCore::instance()->userManager()->cancelPushButtonAuth(m_pushButtonTransactions.key(clientId));
     }
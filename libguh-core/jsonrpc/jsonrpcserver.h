@@ -24,6 +24,7 @@
 
 #include "plugin/deviceclass.h"
 #include "jsonhandler.h"
+#include "notificationsubscriptions.h"
 #include "transportinterface.h"
 #include "usermanager.h"
 
@@ -51,6 +52,7 @@ public:
     Q_INVOKABLE JsonReply *Introspect(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *Version(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *SetNotificationStatus(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *SetNotificationSubscription(const QVariantMap &params);
 
     Q_INVOKABLE JsonReply *CreateUser(const QVariantMap &params);
     Q_INVOKABLE JsonReply *Authenticate(const QVariantMap &params);
@@ -73,9 +75,13 @@ public:
 private:
     QHash<QString, JsonHandler *> handlers() const;
 
-    void sendResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QVariantMap &params = QVariantMap());
-    void sendErrorResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error);
-    void sendUnauthorizedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error);
+    QVariantMap createResponse(int commandId, const QVariantMap &params = QVariantMap()) const;
+    QVariantMap createErrorResponse(int commandId, const QString &error) const;
+    QVariantMap createUnauthorizedResponse(int commandId, const QString &error) const;
+    void sendMessage(TransportInterface *interface, const QUuid &clientId, const QVariant &message);
+
+    void processBatch(TransportInterface *interface, const QUuid &clientId, const QVariantList &messages);
+    JsonReply *processRequest(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message, QVariantMap *response);
     QVariantMap createWelcomeMessage(TransportInterface *interface) const;
 
 private slots:
@@ -93,6 +99,7 @@ private slots:
     void pairingFinished(QString cognitoUserId, int status, const QString &message);
     void onCloudConnectedChanged(bool connected);
     void onPushButtonAuthFinished(int transactionId, bool success, const QByteArray &token);
+    void onTokensRevoked();
 
 private:
     QMap<TransportInterface*, bool> m_interfaces; // Interface, authenticationRequired
@@ -100,12 +107,24 @@ private:
     QHash<JsonReply *, TransportInterface *> m_asyncReplies;
 
     QHash<QUuid, TransportInterface*> m_clientTransports;
-    QHash<QUuid, bool> m_clientNotifications;
+    QHash<QUuid, QByteArray> m_clientTokens; // the verified token of each authenticated client
+    NotificationSubscriptions m_subscriptions;
     QHash<int, QUuid> m_pushButtonTransactions;
 
     QHash<QString, JsonReply*> m_pairingRequests;
 
+    // The responses of a batch request, sent once all of its async replies have finished
+    struct Batch {
+        TransportInterface *interface;
+        QUuid clientId;
+        QVariantList responses;
+        int pendingReplies;
+    };
+    QHash<int, Batch> m_batches;
+    QHash<JsonReply *, QPair<int, int> > m_batchReplies; // reply -> (batch, index of the response)
+
     int m_notificationId;
+    int m_batchId;
 
     void registerHandler(JsonHandler *handler);
     QString formatAssertion(const QString &targetNamespace, const QString &method, JsonHandler *handler, const QVariantMap &data) const;
@@ -99,6 +99,7 @@ QVariantMap JsonTypes::s_stateType;
 QVariantMap JsonTypes::s_state;
 QVariantMap JsonTypes::s_stateDescriptor;
 QVariantMap JsonTypes::s_stateEvaluator;
+QVariantMap JsonTypes::s_stateEvaluatorResult;
 QVariantMap JsonTypes::s_eventType;
 QVariantMap JsonTypes::s_event;
 QVariantMap JsonTypes::s_eventDescriptor;
@@ -111,7 +112,10 @@ QVariantMap JsonTypes::s_device;
 QVariantMap JsonTypes::s_deviceDescriptor;
 QVariantMap JsonTypes::s_rule;
 QVariantMap JsonTypes::s_ruleDescription;
+QVariantMap JsonTypes::s_newRule;
+QVariantMap JsonTypes::s_ruleStatistics;
 QVariantMap JsonTypes::s_logEntry;
+QVariantMap JsonTypes::s_stateHistoryBucket;
 QVariantMap JsonTypes::s_timeDescriptor;
 QVariantMap JsonTypes::s_calendarItem;
 QVariantMap JsonTypes::s_timeEventItem;
@@ -211,6 +215,12 @@ void JsonTypes::init()
     s_stateEvaluator.insert("o:childEvaluators", QVariantList() << stateEvaluatorRef());
     s_stateEvaluator.insert("o:operator", stateOperatorRef());
 
+    // StateEvaluatorResult
+    s_stateEvaluatorResult.insert("result", basicTypeToString(Bool));
+    s_stateEvaluatorResult.insert("o:stateDescriptor", stateDescriptorRef());
+    s_stateEvaluatorResult.insert("o:childEvaluators", QVariantList() << stateEvaluatorResultRef());
+    s_stateEvaluatorResult.insert("o:operator", stateOperatorRef());
+
     // EventType
     s_eventType.insert("id", basicTypeToString(Uuid));
     s_eventType.insert("name", basicTypeToString(String));
@@ -304,6 +314,24 @@ void JsonTypes::init()
     s_ruleDescription.insert("active", basicTypeToString(Bool));
     s_ruleDescription.insert("executable", basicTypeToString(Bool));
 
+    // NewRule
+    s_newRule.insert("name", basicTypeToString(String));
+    s_newRule.insert("actions", QVariantList() << ruleActionRef());
+    s_newRule.insert("o:timeDescriptor", timeDescriptorRef());
+    s_newRule.insert("o:stateEvaluator", stateEvaluatorRef());
+    s_newRule.insert("o:eventDescriptors", QVariantList() << eventDescriptorRef());
+    s_newRule.insert("o:exitActions", QVariantList() << ruleActionRef());
+    s_newRule.insert("o:enabled", basicTypeToString(Bool));
+    s_newRule.insert("o:executable", basicTypeToString(Bool));
+
+    // RuleStatistics
+    s_ruleStatistics.insert("ruleId", basicTypeToString(Uuid));
+    s_ruleStatistics.insert("evaluations", basicTypeToString(Int));
+    s_ruleStatistics.insert("matches", basicTypeToString(Int));
+    s_ruleStatistics.insert("actionsDispatched", basicTypeToString(Int));
+    s_ruleStatistics.insert("evaluationTime", basicTypeToString(Int));
+    s_ruleStatistics.insert("o:lastTriggered", basicTypeToString(Int));
+
     // LogEntry
     s_logEntry.insert("timestamp", basicTypeToString(Int));
     s_logEntry.insert("loggingLevel", loggingLevelRef());
@@ -315,6 +343,14 @@ void JsonTypes::init()
     s_logEntry.insert("o:eventType", loggingEventTypeRef());
     s_logEntry.insert("o:errorCode", basicTypeToString(String));
 
+    // StateHistoryBucket
+    s_stateHistoryBucket.insert("timestamp", basicTypeToString(Int));
+    s_stateHistoryBucket.insert("count", basicTypeToString(Int));
+    s_stateHistoryBucket.insert("min", basicTypeToString(Double));
+    s_stateHistoryBucket.insert("max", basicTypeToString(Double));
+    s_stateHistoryBucket.insert("avg", basicTypeToString(Double));
+    s_stateHistoryBucket.insert("last", basicTypeToString(Double));
+
     // TimeDescriptor
     s_timeDescriptor.insert("o:calendarItems", QVariantList() << calendarItemRef());
     s_timeDescriptor.insert("o:timeEventItems", QVariantList() << timeEventItemRef());
@@ -424,6 +460,7 @@ QVariantMap JsonTypes::allTypes()
     allTypes.insert("StateType", stateTypeDescription());
     allTypes.insert("StateDescriptor", stateDescriptorDescription());
     allTypes.insert("StateEvaluator", stateEvaluatorDescription());
+    allTypes.insert("StateEvaluatorResult", stateEvaluatorResultDescription());
     allTypes.insert("Event", eventDescription());
     allTypes.insert("EventType", eventTypeDescription());
     allTypes.insert("EventDescriptor", eventDescriptorDescription());
@@ -441,7 +478,10 @@ QVariantMap JsonTypes::allTypes()
     allTypes.insert("Action", actionDescription());
     allTypes.insert("Rule", ruleDescription());
     allTypes.insert("RuleDescription", ruleDescriptionDescription());
+    allTypes.insert("NewRule", newRuleDescription());
+    allTypes.insert("RuleStatistics", ruleStatisticsDescription());
     allTypes.insert("LogEntry", logEntryDescription());
+    allTypes.insert("StateHistoryBucket", stateHistoryBucketDescription());
     allTypes.insert("TimeDescriptor", timeDescriptorDescription());
     allTypes.insert("CalendarItem", calendarItemDescription());
     allTypes.insert("TimeEventItem", timeEventItemDescription());
@@ -634,6 +674,37 @@ QVariantMap JsonTypes::packStateEvaluator(const StateEvaluator &stateEvaluator)
     return variantMap;
 }
 
+static QVariantMap packStateEvaluatorResultNode(const StateEvaluator &stateEvaluator, const QList<bool> &results, int &index)
+{
+    // The compiled results are in post-order, children come first
+    QVariantList childEvaluators;
+    foreach (const StateEvaluator &childEvaluator, stateEvaluator.childEvaluators())
+        childEvaluators.append(packStateEvaluatorResultNode(childEvaluator, results, index));
+
+    QVariantMap variantMap;
+    variantMap.insert("result", index < results.count() ? results.at(index) : false);
+    index++;
+
+    if (stateEvaluator.stateDescriptor().isValid())
+        variantMap.insert("stateDescriptor", JsonTypes::packStateDescriptor(stateEvaluator.stateDescriptor()));
+
+    if (!childEvaluators.isEmpty() || stateEvaluator.stateDescriptor().isValid())
+        variantMap.insert("operator", JsonTypes::stateOperator().at(stateEvaluator.operatorType()));
+
+    if (childEvaluators.count() > 0)
+        variantMap.insert("childEvaluators", childEvaluators);
+
+    return variantMap;
+}
+
+/*! Returns a variant map of the given \a stateEvaluator containing the cached result
+    of each evaluator node from the given \a compiledStateEvaluator. */
+QVariantMap JsonTypes::packStateEvaluatorResult(const StateEvaluator &stateEvaluator, const CompiledStateEvaluator &compiledStateEvaluator)
+{
+    int index = 0;
+    return packStateEvaluatorResultNode(stateEvaluator, compiledStateEvaluator.results(), index);
+}
+
 /*! Returns a variant map of the given \a param. */
 QVariantMap JsonTypes::packParam(const Param &param)
 {
@@ -850,6 +921,22 @@ QVariantMap JsonTypes::packRuleDescription(const Rule &rule)
     return ruleDescriptionMap;
 }
 
+/*! Returns a variant map of the given \a ruleStatistics. The evaluation time is given in microseconds,
+    the last triggered time in milliseconds since the epoch. */
+QVariantMap JsonTypes::packRuleStatistics(const RuleStatistics &ruleStatistics)
+{
+    QVariantMap ruleStatisticsMap;
+    ruleStatisticsMap.insert("ruleId", ruleStatistics.ruleId());
+    ruleStatisticsMap.insert("evaluations", ruleStatistics.evaluations());
+    ruleStatisticsMap.insert("matches", ruleStatistics.matches());
+    ruleStatisticsMap.insert("actionsDispatched", ruleStatistics.actionsDispatched());
+    ruleStatisticsMap.insert("evaluationTime", ruleStatistics.evaluationTime() / 1000);
+    if (ruleStatistics.lastTriggered().isValid())
+        ruleStatisticsMap.insert("lastTriggered", ruleStatistics.lastTriggered().toMSecsSinceEpoch());
+
+    return ruleStatisticsMap;
+}
+
 /*! Returns a variant map of the given \a logEntry. */
 QVariantMap JsonTypes::packLogEntry(const LogEntry &logEntry)
 {
@@ -901,6 +988,19 @@ QVariantMap JsonTypes::packLogEntry(const LogEntry &logEntry)
     return logEntryMap;
 }
 
+/*! Returns a variant map of the given \a stateHistoryBucket. The timestamp is given in seconds like the time range of the request. */
+QVariantMap JsonTypes::packStateHistoryBucket(const StateHistoryBucket &stateHistoryBucket)
+{
+    QVariantMap stateHistoryBucketMap;
+    stateHistoryBucketMap.insert("timestamp", stateHistoryBucket.timestamp().toTime_t());
+    stateHistoryBucketMap.insert("count", stateHistoryBucket.count());
+    stateHistoryBucketMap.insert("min", stateHistoryBucket.minimum());
+    stateHistoryBucketMap.insert("max", stateHistoryBucket.maximum());
+    stateHistoryBucketMap.insert("avg", stateHistoryBucket.average());
+    stateHistoryBucketMap.insert("last", stateHistoryBucket.last());
+    return stateHistoryBucketMap;
+}
+
 /*! Returns a variant list of the given \a createMethods. */
 QVariantList JsonTypes::packCreateMethods(DeviceClass::CreateMethods createMethods)
 {
@@ -1453,6 +1553,19 @@ LogFilter JsonTypes::unpackLogFilter(const QVariantMap &logFilterMap)
         }
     }
 
+    // Pagination
+    if (logFilterMap.contains("limit"))
+        filter.setLimit(logFilterMap.value("limit").toInt());
+
+    if (logFilterMap.contains("offset"))
+        filter.setOffset(logFilterMap.value("offset").toInt());
+
+    if (logFilterMap.contains("cursor"))
+        filter.setCursor(logFilterMap.value("cursor").toString());
+
+    if (logFilterMap.value("descending", false).toBool())
+        filter.setSortOrder(Qt::DescendingOrder);
+
     return filter;
 }
 
@@ -1757,6 +1870,12 @@ QPair<bool, QString> JsonTypes::validateVariant(const QVariant &templateVariant,
                     qCWarning(dcJsonRpc) << "StateEvaluator type not matching";
                     return result;
                 }
+            } else if (refName == stateEvaluatorResultRef()) {
+                QPair<bool, QString> result = validateMap(stateEvaluatorResultDescription(), variant.toMap());
+                if (!result.first) {
+                    qCWarning(dcJsonRpc) << "StateEvaluatorResult type not matching";
+                    return result;
+                }
             } else if (refName == stateDescriptorRef()) {
                 QPair<bool, QString> result = validateMap(stateDescriptorDescription(), variant.toMap());
                 if (!result.first) {
@@ -1781,6 +1900,18 @@ QPair<bool, QString> JsonTypes::validateVariant(const QVariant &templateVariant,
                     qCWarning(dcJsonRpc) << "RuleDescription type not matching";
                     return result;
                 }
+            } else if (refName == newRuleRef()) {
+                QPair<bool, QString> result = validateMap(s_newRule, variant.toMap());
+                if (!result.first) {
+                    qCWarning(dcJsonRpc) << "NewRule type not matching";
+                    return result;
+                }
+            } else if (refName == ruleStatisticsRef()) {
+                QPair<bool, QString> result = validateMap(s_ruleStatistics, variant.toMap());
+                if (!result.first) {
+                    qCWarning(dcJsonRpc) << "RuleStatistics type not matching";
+                    return result;
+                }
             } else if (refName == stateRef()) {
                 QPair<bool, QString> result = validateMap(s_state, variant.toMap());
                 if (!result.first) {
@@ -1799,6 +1930,12 @@ QPair<bool, QString> JsonTypes::validateVariant(const QVariant &templateVariant,
                     qCWarning(dcJsonRpc) << "LogEntry not matching";
                     return result;
                 }
+            } else if (refName == stateHistoryBucketRef()) {
+                QPair<bool, QString> result = validateMap(stateHistoryBucketDescription(), variant.toMap());
+                if (!result.first) {
+                    qCWarning(dcJsonRpc) << "StateHistoryBucket not matching";
+                    return result;
+                }
             } else if (refName == timeDescriptorRef()) {
                 QPair<bool, QString> result = validateMap(timeDescriptorDescription(), variant.toMap());
                 if (!result.first) {
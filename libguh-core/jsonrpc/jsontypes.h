@@ -41,6 +41,7 @@
 #include "logging/logging.h"
 #include "logging/logentry.h"
 #include "logging/logfilter.h"
+#include "logging/statehistorybucket.h"
 
 #include "time/calendaritem.h"
 #include "time/repeatingoption.h"
@@ -145,6 +146,7 @@ public:
     DECLARE_OBJECT(stateDescriptor, "StateDescriptor")
     DECLARE_OBJECT(state, "State")
     DECLARE_OBJECT(stateEvaluator, "StateEvaluator")
+    DECLARE_OBJECT(stateEvaluatorResult, "StateEvaluatorResult")
     DECLARE_OBJECT(eventType, "EventType")
     DECLARE_OBJECT(event, "Event")
     DECLARE_OBJECT(eventDescriptor, "EventDescriptor")
@@ -157,7 +159,10 @@ public:
     DECLARE_OBJECT(deviceDescriptor, "DeviceDescriptor")
     DECLARE_OBJECT(rule, "Rule")
     DECLARE_OBJECT(ruleDescription, "RuleDescription")
+    DECLARE_OBJECT(newRule, "NewRule")
+    DECLARE_OBJECT(ruleStatistics, "RuleStatistics")
     DECLARE_OBJECT(logEntry, "LogEntry")
+    DECLARE_OBJECT(stateHistoryBucket, "StateHistoryBucket")
     DECLARE_OBJECT(timeDescriptor, "TimeDescriptor")
     DECLARE_OBJECT(calendarItem, "CalendarItem")
     DECLARE_OBJECT(timeEventItem, "TimeEventItem")
@@ -181,6 +186,7 @@ public:
     static QVariantMap packStateType(const StateType &stateType);
     static QVariantMap packStateDescriptor(const StateDescriptor &stateDescriptor);
     static QVariantMap packStateEvaluator(const StateEvaluator &stateEvaluator);
+    static QVariantMap packStateEvaluatorResult(const StateEvaluator &stateEvaluator, const CompiledStateEvaluator &compiledStateEvaluator);
     static QVariantMap packParam(const Param &param);
     static QVariantMap packParamType(const ParamType &paramType);
     static QVariantMap packParamDescriptor(const ParamDescriptor &paramDescriptor);
@@ -191,7 +197,9 @@ public:
     static QVariantMap packDeviceDescriptor(const DeviceDescriptor &descriptor);
     static QVariantMap packRule(const Rule &rule);
     static QVariantMap packRuleDescription(const Rule &rule);
+    static QVariantMap packRuleStatistics(const RuleStatistics &ruleStatistics);
     static QVariantMap packLogEntry(const LogEntry &logEntry);
+    static QVariantMap packStateHistoryBucket(const StateHistoryBucket &stateHistoryBucket);
     static QVariantMap packRepeatingOption(const RepeatingOption &option);
     static QVariantMap packCalendarItem(const CalendarItem &calendarItem);
     static QVariantMap packTimeEventItem(const TimeEventItem &timeEventItem);
@@ -0,0 +1,362 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/*!
+    \class guhserver::JsonValidator
+    \brief Validates JSON-RPC params and returns against a precompiled template.
+
+    \ingroup json
+    \inmodule core
+
+    The template of a method, as used by JsonTypes::validateMap(), gets compiled once into a tree of
+    nodes. The keys are stored without their "o:" prefix, every type reference is resolved to the node
+    of its description, and the allowed values of an enum are kept in a hash. Validating a message
+    therefore only walks the message, without parsing the template again.
+
+    The nodes of type references are shared by all validators and live until the server shuts down.
+    This also allows recursive types like the StateEvaluator.
+
+    \sa JsonTypes, JsonHandler
+*/
+
+#include "jsonvalidator.h"
+#include "jsontypes.h"
+#include "loggingcategories.h"
+
+#include <QJsonDocument>
+#include <QStringList>
+#include <QVector>
+#include <QSet>
+
+namespace guhserver {
+
+struct JsonValidator::Node {
+    enum Kind {
+        KindAny,
+        KindProperty,
+        KindBasicType,
+        KindEnum,
+        KindObject,
+        KindList,
+        KindUnhandled
+    };
+
+    struct Field {
+        QString name; // without the "o:" prefix
+        bool optional;
+        const Node *node;
+    };
+
+    Kind kind = KindAny;
+    QString message; // error message, the value is filled into %1 for properties and enums
+
+    QVariant::Type propertyType = QVariant::Invalid; // KindProperty
+    QSet<QString> enumValues; // KindEnum
+    QVector<Field> fields; // KindObject, in the order of the template
+    QSet<QString> fieldNames; // KindObject
+    const Node *entry = nullptr; // KindList
+};
+
+QList<QSharedPointer<JsonValidator::Node> > JsonValidator::s_nodes;
+QHash<QString, const JsonValidator::Node *> JsonValidator::s_refNodes;
+
+/*! Constructs an invalid \l{JsonValidator}. */
+JsonValidator::JsonValidator() :
+    m_root(nullptr)
+{
+}
+
+/*! Constructs a \l{JsonValidator} for the given \a templateMap of a method. */
+JsonValidator::JsonValidator(const QVariantMap &templateMap) :
+    m_root(compileMap(templateMap))
+{
+}
+
+/*! Returns true if this \l{JsonValidator} has been compiled from a template. */
+bool JsonValidator::isValid() const
+{
+    return m_root != nullptr;
+}
+
+/*! Validates the given \a map. Returns the error string and false if the \a map does not match the
+    template, with the same error strings as JsonTypes::validateMap(). */
+QPair<bool, QString> JsonValidator::validate(const QVariantMap &map) const
+{
+    Q_ASSERT(m_root);
+    return validateMap(m_root, map);
+}
+
+JsonValidator::Node *JsonValidator::createNode()
+{
+    Node *node = new Node();
+    s_nodes.append(QSharedPointer<Node>(node));
+    return node;
+}
+
+const JsonValidator::Node *JsonValidator::compile(const QVariant &templateVariant)
+{
+    switch (templateVariant.type()) {
+    case QVariant::String: {
+        QString typeName = templateVariant.toString();
+        if (typeName.startsWith("$ref:"))
+            return compileRef(typeName);
+
+        return compileProperty(typeName);
+    }
+    case QVariant::Map:
+        return compileMap(templateVariant.toMap());
+    case QVariant::List: {
+        QVariantList templateList = templateVariant.toList();
+        Q_ASSERT(templateList.count() == 1);
+        Node *node = createNode();
+        node->kind = Node::KindList;
+        node->entry = compile(templateList.first());
+        return node;
+    }
+    default: {
+        Node *node = createNode();
+        node->kind = Node::KindUnhandled;
+        node->message = QString("Unhandled value %1.").arg(templateVariant.toString());
+        return node;
+    }
+    }
+}
+
+const JsonValidator::Node *JsonValidator::compileMap(const QVariantMap &templateMap)
+{
+    Node *node = createNode();
+    compileFields(node, templateMap);
+    return node;
+}
+
+void JsonValidator::compileFields(Node *node, const QVariantMap &templateMap)
+{
+    node->kind = Node::KindObject;
+    foreach (const QString &key, templateMap.keys()) {
+        Node::Field field;
+        field.optional = key.startsWith("o:");
+        field.name = field.optional ? key.mid(2) : key;
+        field.node = compile(templateMap.value(key));
+        node->fields.append(field);
+        node->fieldNames.insert(field.name);
+    }
+}
+
+const JsonValidator::Node *JsonValidator::compileRef(const QString &refName)
+{
+    if (s_refNodes.contains(refName))
+        return s_refNodes.value(refName);
+
+    // Register the node before compiling the description, types may contain themselves
+    Node *node = createNode();
+    s_refNodes.insert(refName, node);
+
+    static QHash<QString, QVariantMap> objects;
+    static QHash<QString, QVariantList> enums;
+    if (objects.isEmpty()) {
+        objects.insert(JsonTypes::actionRef(), JsonTypes::actionDescription());
+        objects.insert(JsonTypes::eventRef(), JsonTypes::eventDescription());
+        objects.insert(JsonTypes::paramDescriptorRef(), JsonTypes::paramDescriptorDescription());
+        objects.insert(JsonTypes::deviceRef(), JsonTypes::deviceDescription());
+        objects.insert(JsonTypes::deviceDescriptorRef(), JsonTypes::deviceDescriptorDescription());
+        objects.insert(JsonTypes::deviceClassRef(), JsonTypes::deviceClassDescription());
+        objects.insert(JsonTypes::paramTypeRef(), JsonTypes::paramTypeDescription());
+        objects.insert(JsonTypes::ruleActionRef(), JsonTypes::ruleActionDescription());
+        objects.insert(JsonTypes::ruleActionParamRef(), JsonTypes::ruleActionParamDescription());
+        objects.insert(JsonTypes::actionTypeRef(), JsonTypes::actionTypeDescription());
+        objects.insert(JsonTypes::eventTypeRef(), JsonTypes::eventTypeDescription());
+        objects.insert(JsonTypes::stateTypeRef(), JsonTypes::stateTypeDescription());
+        objects.insert(JsonTypes::stateEvaluatorRef(), JsonTypes::stateEvaluatorDescription());
+        objects.insert(JsonTypes::stateEvaluatorResultRef(), JsonTypes::stateEvaluatorResultDescription());
+        objects.insert(JsonTypes::stateDescriptorRef(), JsonTypes::stateDescriptorDescription());
+        objects.insert(JsonTypes::pluginRef(), JsonTypes::pluginDescription());
+        objects.insert(JsonTypes::ruleRef(), JsonTypes::ruleDescription());
+        objects.insert(JsonTypes::ruleDescriptionRef(), JsonTypes::ruleDescriptionDescription());
+        objects.insert(JsonTypes::newRuleRef(), JsonTypes::newRuleDescription());
+        objects.insert(JsonTypes::ruleStatisticsRef(), JsonTypes::ruleStatisticsDescription());
+        objects.insert(JsonTypes::stateRef(), JsonTypes::stateDescription());
+        objects.insert(JsonTypes::eventDescriptorRef(), JsonTypes::eventDescriptorDescription());
+        objects.insert(JsonTypes::logEntryRef(), JsonTypes::logEntryDescription());
+        objects.insert(JsonTypes::stateHistoryBucketRef(), JsonTypes::stateHistoryBucketDescription());
+        objects.insert(JsonTypes::timeDescriptorRef(), JsonTypes::timeDescriptorDescription());
+        objects.insert(JsonTypes::calendarItemRef(), JsonTypes::calendarItemDescription());
+        objects.insert(JsonTypes::repeatingOptionRef(), JsonTypes::repeatingOptionDescription());
+        objects.insert(JsonTypes::timeEventItemRef(), JsonTypes::timeEventItemDescription());
+        objects.insert(JsonTypes::wirelessAccessPointRef(), JsonTypes::wirelessAccessPointDescription());
+        objects.insert(JsonTypes::wiredNetworkDeviceRef(), JsonTypes::wiredNetworkDeviceDescription());
+        objects.insert(JsonTypes::wirelessNetworkDeviceRef(), JsonTypes::wirelessNetworkDeviceDescription());
+        objects.insert(JsonTypes::tokenInfoRef(), JsonTypes::tokenInfoDescription());
+        objects.insert(JsonTypes::serverConfigurationRef(), JsonTypes::serverConfigurationDescription());
+        objects.insert(JsonTypes::webServerConfigurationRef(), JsonTypes::webServerConfigurationDescription());
+
+        enums.insert(JsonTypes::stateOperatorRef(), JsonTypes::stateOperator());
+        enums.insert(JsonTypes::createMethodRef(), JsonTypes::createMethod());
+        enums.insert(JsonTypes::setupMethodRef(), JsonTypes::setupMethod());
+        enums.insert(JsonTypes::valueOperatorRef(), JsonTypes::valueOperator());
+        enums.insert(JsonTypes::deviceErrorRef(), JsonTypes::deviceError());
+        enums.insert(JsonTypes::ruleErrorRef(), JsonTypes::ruleError());
+        enums.insert(JsonTypes::loggingErrorRef(), JsonTypes::loggingError());
+        enums.insert(JsonTypes::loggingSourceRef(), JsonTypes::loggingSource());
+        enums.insert(JsonTypes::loggingLevelRef(), JsonTypes::loggingLevel());
+        enums.insert(JsonTypes::loggingEventTypeRef(), JsonTypes::loggingEventType());
+        enums.insert(JsonTypes::inputTypeRef(), JsonTypes::inputType());
+        enums.insert(JsonTypes::unitRef(), JsonTypes::unit());
+        enums.insert(JsonTypes::basicTagRef(), JsonTypes::basicTag());
+        enums.insert(JsonTypes::deviceIconRef(), JsonTypes::deviceIcon());
+        enums.insert(JsonTypes::repeatingModeRef(), JsonTypes::repeatingMode());
+        enums.insert(JsonTypes::removePolicyRef(), JsonTypes::removePolicy());
+        enums.insert(JsonTypes::configurationErrorRef(), JsonTypes::configurationError());
+        enums.insert(JsonTypes::networkManagerStateRef(), JsonTypes::networkManagerState());
+        enums.insert(JsonTypes::networkManagerErrorRef(), JsonTypes::networkManagerError());
+        enums.insert(JsonTypes::networkDeviceStateRef(), JsonTypes::networkDeviceState());
+        enums.insert(JsonTypes::userErrorRef(), JsonTypes::userError());
+    }
+
+    if (objects.contains(refName)) {
+        compileFields(node, objects.value(refName));
+    } else if (enums.contains(refName)) {
+        QStringList enumStrings;
+        foreach (const QVariant &value, enums.value(refName)) {
+            enumStrings.append(value.toString());
+            node->enumValues.insert(value.toString());
+        }
+        node->kind = Node::KindEnum;
+        node->message = "Value %1 not allowed in " + enumStrings.join(", ");
+    } else if (refName == JsonTypes::basicTypeRef()) {
+        node->kind = Node::KindBasicType;
+    } else if (refName == JsonTypes::paramRef() || refName == JsonTypes::vendorRef()) {
+        // Params and Vendors have never been validated in depth
+        node->kind = Node::KindAny;
+    } else {
+        Q_ASSERT_X(false, "JsonValidator", QString("Unhandled ref: %1").arg(refName).toLatin1().data());
+        node->kind = Node::KindUnhandled;
+        node->message = QString("Unhandled ref %1. Server implementation incomplete.").arg(refName);
+    }
+    return node;
+}
+
+const JsonValidator::Node *JsonValidator::compileProperty(const QString &typeName)
+{
+    Node *node = createNode();
+    node->kind = Node::KindProperty;
+    if (typeName == JsonTypes::basicTypeToString(JsonTypes::Variant)) {
+        node->kind = Node::KindAny;
+    } else if (typeName == JsonTypes::basicTypeToString(QVariant::Uuid)) {
+        node->propertyType = QVariant::Uuid;
+        node->message = "Param %1 is not a uuid.";
+    } else if (typeName == JsonTypes::basicTypeToString(QVariant::String)) {
+        node->propertyType = QVariant::String;
+        node->message = "Param %1 is not a string.";
+    } else if (typeName == JsonTypes::basicTypeToString(QVariant::Bool)) {
+        node->propertyType = QVariant::Bool;
+        node->message = "Param %1 is not a bool.";
+    } else if (typeName == JsonTypes::basicTypeToString(QVariant::Int)) {
+        node->propertyType = QVariant::Int;
+        node->message = "Param %1 is not a int.";
+    } else if (typeName == JsonTypes::basicTypeToString(QVariant::UInt)) {
+        node->propertyType = QVariant::UInt;
+        node->message = "Param %1 is not a uint.";
+    } else if (typeName == JsonTypes::basicTypeToString(QVariant::Double)) {
+        node->propertyType = QVariant::Double;
+        node->message = "Param %1 is not a double.";
+    } else if (typeName == JsonTypes::basicTypeToString(QVariant::Time)) {
+        node->propertyType = QVariant::Time;
+        node->message = "Param %1 is not a time (hh:mm).";
+    } else {
+        node->message = "Unhandled property type: %1 (expected: " + typeName + ")";
+    }
+    return node;
+}
+
+QPair<bool, QString> JsonValidator::validateVariant(const Node *node, const QVariant &variant)
+{
+    switch (node->kind) {
+    case Node::KindAny:
+        break;
+    case Node::KindProperty:
+        if (node->propertyType == QVariant::Invalid || !variant.canConvert(node->propertyType)) {
+            qCWarning(dcJsonRpc) << "property not matching:" << node->message.arg(variant.toString());
+            return qMakePair<bool, QString>(false, node->message.arg(variant.toString()));
+        }
+        break;
+    case Node::KindBasicType:
+        return JsonTypes::validateBasicType(variant);
+    case Node::KindEnum:
+        if (!node->enumValues.contains(variant.toString())) {
+            qCWarning(dcJsonRpc) << node->message.arg(variant.toString());
+            return qMakePair<bool, QString>(false, node->message.arg(variant.toString()));
+        }
+        break;
+    case Node::KindObject:
+        return validateMap(node, variant.toMap());
+    case Node::KindList:
+        foreach (const QVariant &entry, variant.toList()) {
+            QPair<bool, QString> result = validateVariant(node->entry, entry);
+            if (!result.first) {
+                qCWarning(dcJsonRpc) << "List entry not matching template";
+                return result;
+            }
+        }
+        break;
+    case Node::KindUnhandled:
+        qCWarning(dcJsonRpc) << node->message;
+        return qMakePair<bool, QString>(false, node->message);
+    }
+    return qMakePair<bool, QString>(true, QString());
+}
+
+QPair<bool, QString> JsonValidator::validateMap(const Node *node, const QVariantMap &map)
+{
+    // Make sure all values defined in the template are around
+    int matchingKeys = 0;
+    foreach (const Node::Field &field, node->fields) {
+        QVariantMap::const_iterator value = map.constFind(field.name);
+        if (value == map.constEnd()) {
+            if (field.optional)
+                continue;
+
+            qCWarning(dcJsonRpc) << "*** missing key" << field.name;
+            QJsonDocument jsonDoc = QJsonDocument::fromVariant(map);
+            return qMakePair<bool, QString>(false, QString("Missing key %1 in %2").arg(field.name).arg(QString(jsonDoc.toJson(QJsonDocument::Compact))));
+        }
+
+        QPair<bool, QString> result = validateVariant(field.node, value.value());
+        if (!result.first)
+            return result;
+
+        matchingKeys++;
+    }
+
+    // Make sure there aren't any other parameters than the allowed ones
+    if (matchingKeys != map.count()) {
+        foreach (const QString &key, map.keys()) {
+            if (!node->fieldNames.contains(key)) {
+                qCWarning(dcJsonRpc) << "Forbidden param" << key << "in params";
+                QJsonDocument jsonDoc = QJsonDocument::fromVariant(map);
+                return qMakePair<bool, QString>(false, QString("Forbidden key \"%1\" in %2").arg(key).arg(QString(jsonDoc.toJson(QJsonDocument::Compact))));
+            }
+        }
+    }
+
+    return qMakePair<bool, QString>(true, QString());
+}
+
+}
@@ -0,0 +1,66 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef JSONVALIDATOR_H
+#define JSONVALIDATOR_H
+
+#include <QVariant>
+#include <QVariantMap>
+#include <QString>
+#include <QPair>
+#include <QList>
+#include <QHash>
+#include <QSharedPointer>
+
+namespace guhserver {
+
+class JsonValidator
+{
+public:
+    JsonValidator();
+    explicit JsonValidator(const QVariantMap &templateMap);
+
+    bool isValid() const;
+    QPair<bool, QString> validate(const QVariantMap &map) const;
+
+private:
+    struct Node;
+
+    static Node *createNode();
+    static const Node *compile(const QVariant &templateVariant);
+    static const Node *compileMap(const QVariantMap &templateMap);
+    static void compileFields(Node *node, const QVariantMap &templateMap);
+    static const Node *compileRef(const QString &refName);
+    static const Node *compileProperty(const QString &typeName);
+
+    static QPair<bool, QString> validateVariant(const Node *node, const QVariant &variant);
+    static QPair<bool, QString> validateMap(const Node *node, const QVariantMap &map);
+
+    const Node *m_root;
+
+    // All compiled nodes, and the nodes of the type references by their name
+    static QList<QSharedPointer<Node> > s_nodes;
+    static QHash<QString, const Node *> s_refNodes;
+};
+
+}
+
+#endif // JSONVALIDATOR_H
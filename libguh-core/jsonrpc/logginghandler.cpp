@@ -37,6 +37,14 @@
     The \a params contain the map for the notification.
 */
 
+/*! \fn void guhserver::LoggingHandler::LogEntriesAdded(const QVariantMap &params);
+    This signal is emitted to the API notifications with the \l{LogEntry}{LogEntries} added to the database
+    since the last notification. Only clients with a log subscription will receive this notification, filtered
+    by their subscription. The \a params contain the map for the notification.
+
+    \sa SetLogSubscription()
+*/
+
 /*! \fn void guhserver::LoggingHandler::LogDatabaseUpdated(const QVariantMap &params);
     This signal is emitted to the API notifications when the logging aatabase has been updated (i.e. \l{Device} or \l{Rule} removed).
     The \a params contain the map for the notification.
@@ -48,6 +56,10 @@
 #include "loggingcategories.h"
 #include "guhcore.h"
 
+// Log entries will be collected for this amount of milliseconds before they get sent to the subscribed clients
+#define LOG_NOTIFICATION_INTERVAL 500
+#define LOG_NOTIFICATION_MAX_ENTRIES 100
+
 namespace guhserver {
 
 /*! Constructs a new \l LoggingHandler with the given \a parent. */
@@ -62,7 +74,10 @@ LoggingHandler::LoggingHandler(QObject *parent) :
     setDescription("GetLogEntries", "Get the LogEntries matching the given filter. "
                    "Each list element of a given filter will be connected with OR "
                    "to each other. Each of the given filters will be connected with AND "
-                   "to each other.");
+                   "to each other. The entries are sorted by their timestamp, descending if "
+                   "descending is true. Use limit to fetch the entries page by page: if more "
+                   "entries follow, nextCursor can be passed as cursor to get the next page. "
+                   "Alternatively offset skips the given number of entries.");
     timeFilter.insert("o:startDate", JsonTypes::basicTypeToString(JsonTypes::Int));
     timeFilter.insert("o:endDate", JsonTypes::basicTypeToString(JsonTypes::Int));
     params.insert("o:timeFilters", QVariantList() << timeFilter);
@@ -72,17 +87,59 @@ LoggingHandler::LoggingHandler(QObject *parent) :
     params.insert("o:typeIds", QVariantList() << JsonTypes::basicTypeToString(JsonTypes::Uuid));
     params.insert("o:deviceIds", QVariantList() << JsonTypes::basicTypeToString(JsonTypes::Uuid));
     params.insert("o:values", QVariantList() << JsonTypes::basicTypeToString(JsonTypes::Variant));
+    params.insert("o:limit", JsonTypes::basicTypeToString(JsonTypes::Int));
+    params.insert("o:offset", JsonTypes::basicTypeToString(JsonTypes::Int));
+    params.insert("o:cursor", JsonTypes::basicTypeToString(JsonTypes::String));
+    params.insert("o:descending", JsonTypes::basicTypeToString(JsonTypes::Bool));
     setParams("GetLogEntries", params);
     returns.insert("loggingError", JsonTypes::loggingErrorRef());
     returns.insert("o:logEntries", QVariantList() << JsonTypes::logEntryRef());
+    returns.insert("o:nextCursor", JsonTypes::basicTypeToString(JsonTypes::String));
     setReturns("GetLogEntries", returns);
 
+    params.clear(); returns.clear();
+    setDescription("GetStateHistory", "Get the history of a numeric state aggregated in buckets of bucketSize "
+                   "seconds between startDate and endDate, given in seconds since epoch. If endDate is not "
+                   "given, the history ends now. Each bucket contains the count, min, max, avg and last "
+                   "value of the state within the bucket, buckets without values are left out. "
+                   "A history can contain up to 1000 buckets.");
+    params.insert("deviceId", JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    params.insert("stateTypeId", JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    params.insert("startDate", JsonTypes::basicTypeToString(JsonTypes::Int));
+    params.insert("o:endDate", JsonTypes::basicTypeToString(JsonTypes::Int));
+    params.insert("bucketSize", JsonTypes::basicTypeToString(JsonTypes::Int));
+    setParams("GetStateHistory", params);
+    returns.insert("loggingError", JsonTypes::loggingErrorRef());
+    returns.insert("o:stateHistory", QVariantList() << JsonTypes::stateHistoryBucketRef());
+    setReturns("GetStateHistory", returns);
+
+    params.clear(); returns.clear();
+    setDescription("SetLogSubscription", "Subscribe to the log entries matching the given filter. Instead "
+                   "of a LogEntryAdded notification for each entry, a subscribed client receives the new "
+                   "entries in LogEntriesAdded notifications, collected over up to 500 ms. Only the entries "
+                   "matching one of the given loggingSources, one of the loggingLevels and one of the "
+                   "deviceIds will be sent, filters which are not given match all entries. Set enabled "
+                   "to false to remove the subscription and receive LogEntryAdded notifications again.");
+    params.insert("enabled", JsonTypes::basicTypeToString(JsonTypes::Bool));
+    params.insert("o:loggingSources", QVariantList() << JsonTypes::loggingSourceRef());
+    params.insert("o:loggingLevels", QVariantList() << JsonTypes::loggingLevelRef());
+    params.insert("o:deviceIds", QVariantList() << JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    setParams("SetLogSubscription", params);
+    returns.insert("enabled", JsonTypes::basicTypeToString(JsonTypes::Bool));
+    setReturns("SetLogSubscription", returns);
+
     // Notifications
     params.clear();
     setDescription("LogEntryAdded", "Emitted whenever an entry is appended to the logging system. ");
     params.insert("logEntry", JsonTypes::logEntryRef());
     setParams("LogEntryAdded", params);
 
+    params.clear();
+    setDescription("LogEntriesAdded", "Emitted periodically with the entries appended to the logging system "
+                   "which match the subscription of the client. See SetLogSubscription.");
+    params.insert("logEntries", QVariantList() << JsonTypes::logEntryRef());
+    setParams("LogEntriesAdded", params);
+
     params.clear();
     setDescription("LogDatabaseUpdated", "Emitted whenever the database was updated. "
                    "The database will be updated when a log entry was deleted. A log "
@@ -91,6 +148,10 @@ LoggingHandler::LoggingHandler(QObject *parent) :
                    "keep to database in the size limits.");
     setParams("LogDatabaseUpdated", params);
 
+    m_notificationTimer.setSingleShot(true);
+    m_notificationTimer.setInterval(LOG_NOTIFICATION_INTERVAL);
+    connect(&m_notificationTimer, &QTimer::timeout, this, &LoggingHandler::sendPendingLogEntries);
+
     connect(GuhCore::instance()->logEngine(), &LogEngine::logEntryAdded, this, &LoggingHandler::logEntryAdded);
     connect(GuhCore::instance()->logEngine(), &LogEngine::logDatabaseUpdated, this, &LoggingHandler::logDatabaseUpdated);
 }
@@ -104,9 +165,21 @@ QString LoggingHandler::name() const
 void LoggingHandler::logEntryAdded(const LogEntry &logEntry)
 {
     qCDebug(dcJsonRpc) << "Notify \"Logging.LogEntryAdded\"";
+    QVariantMap packedEntry = JsonTypes::packLogEntry(logEntry);
     QVariantMap params;
-    params.insert("logEntry", JsonTypes::packLogEntry(logEntry));
+    params.insert("logEntry", packedEntry);
     emit LogEntryAdded(params);
+
+    // Subscribed clients get the entries in batches
+    if (m_subscriptions.isEmpty())
+        return;
+
+    m_pendingEntries.append(packedEntry);
+    if (m_pendingEntries.count() >= LOG_NOTIFICATION_MAX_ENTRIES) {
+        sendPendingLogEntries();
+    } else if (!m_notificationTimer.isActive()) {
+        m_notificationTimer.start();
+    }
 }
 
 void LoggingHandler::logDatabaseUpdated()
@@ -115,18 +188,158 @@ void LoggingHandler::logDatabaseUpdated()
     emit LogDatabaseUpdated(QVariantMap());
 }
 
+void LoggingHandler::sendPendingLogEntries()
+{
+    m_notificationTimer.stop();
+    if (m_pendingEntries.isEmpty())
+        return;
+
+    qCDebug(dcJsonRpc) << "Notify \"Logging.LogEntriesAdded\" with" << m_pendingEntries.count() << "entries";
+    QVariantMap params;
+    params.insert("logEntries", m_pendingEntries);
+    m_pendingEntries.clear();
+    emit LogEntriesAdded(params);
+}
+
+bool LoggingHandler::matchesSubscription(const LogSubscription &subscription, const QVariantMap &logEntry) const
+{
+    if (!subscription.loggingSources.isEmpty() && !subscription.loggingSources.contains(logEntry.value("source").toString()))
+        return false;
+
+    if (!subscription.loggingLevels.isEmpty() && !subscription.loggingLevels.contains(logEntry.value("loggingLevel").toString()))
+        return false;
+
+    if (!subscription.deviceIds.isEmpty() && !subscription.deviceIds.contains(logEntry.value("deviceId").toString()))
+        return false;
+
+    return true;
+}
+
+/*! Sets \a deviceId to the device of the LogEntryAdded \a notification with the given \a params,
+    and \a stateTypeId to the state type if the entry logs a state change. */
+void LoggingHandler::notificationScope(const QString &notification, const QVariantMap &params, QUuid *deviceId, QUuid *stateTypeId) const
+{
+    if (notification != "LogEntryAdded")
+        return;
+
+    logEntryScope(params.value("logEntry").toMap(), deviceId, stateTypeId);
+}
+
+/*! Returns false if the \a notification should not be sent to the client with the given \a clientId.
+    Subscribed clients receive the LogEntriesAdded notification, reduced in \a params to the entries
+    matching their log subscription and the device and state type filter of their notification
+    \a subscription, all other clients the LogEntryAdded notification.
+*/
+bool LoggingHandler::filterNotification(const QUuid &clientId, const QString &notification, const NotificationSubscriptions::Subscription &subscription, QVariantMap *params) const
+{
+    if (notification == "LogEntryAdded")
+        return !m_subscriptions.contains(clientId);
+
+    if (notification == "LogEntriesAdded") {
+        if (!m_subscriptions.contains(clientId))
+            return false;
+
+        LogSubscription logSubscription = m_subscriptions.value(clientId);
+        QVariantList logEntries;
+        foreach (const QVariant &logEntry, params->value("logEntries").toList()) {
+            QVariantMap logEntryMap = logEntry.toMap();
+            QUuid deviceId;
+            QUuid stateTypeId;
+            logEntryScope(logEntryMap, &deviceId, &stateTypeId);
+            if (NotificationSubscriptions::inScope(subscription, deviceId, stateTypeId) && matchesSubscription(logSubscription, logEntryMap)) {
+                logEntries.append(logEntry);
+            }
+        }
+        if (logEntries.isEmpty())
+            return false;
+
+        params->insert("logEntries", logEntries);
+    }
+    return true;
+}
+
+void LoggingHandler::logEntryScope(const QVariantMap &logEntry, QUuid *deviceId, QUuid *stateTypeId)
+{
+    *deviceId = logEntry.value("deviceId").toUuid();
+    if (logEntry.value("source").toString() == JsonTypes::loggingSourceToString(Logging::LoggingSourceStates))
+        *stateTypeId = logEntry.value("typeId").toUuid();
+}
+
+/*! Removes the log subscription of the client with the given \a clientId. */
+void LoggingHandler::clientDisconnected(const QUuid &clientId)
+{
+    m_subscriptions.remove(clientId);
+}
+
 JsonReply* LoggingHandler::GetLogEntries(const QVariantMap &params) const
 {
     qCDebug(dcJsonRpc) << "Asked for log entries" << params;
 
     LogFilter filter = JsonTypes::unpackLogFilter(params);
+    if (!filter.isValid()) {
+        return createReply(statusToReply(Logging::LoggingErrorInvalidFilterParameter));
+    }
 
+    QString nextCursor;
     QVariantList entries;
-    foreach (const LogEntry &entry, GuhCore::instance()->logEngine()->logEntries(filter)) {
+    foreach (const LogEntry &entry, GuhCore::instance()->logEngine()->logEntries(filter, &nextCursor)) {
         entries.append(JsonTypes::packLogEntry(entry));
     }
     QVariantMap returns = statusToReply(Logging::LoggingErrorNoError);
     returns.insert("logEntries", entries);
+    if (!nextCursor.isEmpty())
+        returns.insert("nextCursor", nextCursor);
+
+    return createReply(returns);
+}
+
+JsonReply *LoggingHandler::GetStateHistory(const QVariantMap &params) const
+{
+    qCDebug(dcJsonRpc) << "Asked for state history" << params;
+
+    DeviceId deviceId(params.value("deviceId").toString());
+    StateTypeId stateTypeId(params.value("stateTypeId").toString());
+    QDateTime startDate = QDateTime::fromTime_t(params.value("startDate").toUInt());
+    QDateTime endDate = params.contains("endDate") ? QDateTime::fromTime_t(params.value("endDate").toUInt()) : QDateTime::currentDateTime().addSecs(1);
+
+    QList<StateHistoryBucket> buckets;
+    Logging::LoggingError error = GuhCore::instance()->logEngine()->stateHistory(deviceId, stateTypeId, startDate, endDate, params.value("bucketSize").toInt(), &buckets);
+    if (error != Logging::LoggingErrorNoError)
+        return createReply(statusToReply(error));
+
+    QVariantList stateHistory;
+    foreach (const StateHistoryBucket &bucket, buckets) {
+        stateHistory.append(JsonTypes::packStateHistoryBucket(bucket));
+    }
+    QVariantMap returns = statusToReply(Logging::LoggingErrorNoError);
+    returns.insert("stateHistory", stateHistory);
+    return createReply(returns);
+}
+
+JsonReply *LoggingHandler::SetLogSubscription(const QVariantMap &params)
+{
+    QUuid clientId = property("clientId").toUuid();
+
+    QVariantMap returns;
+    if (!params.value("enabled").toBool()) {
+        m_subscriptions.remove(clientId);
+        returns.insert("enabled", false);
+        return createReply(returns);
+    }
+
+    LogSubscription subscription;
+    foreach (const QVariant &source, params.value("loggingSources").toList()) {
+        subscription.loggingSources.append(source.toString());
+    }
+    foreach (const QVariant &level, params.value("loggingLevels").toList()) {
+        subscription.loggingLevels.append(level.toString());
+    }
+    foreach (const QVariant &deviceId, params.value("deviceIds").toList()) {
+        subscription.deviceIds.append(DeviceId(deviceId.toString()).toString());
+    }
+    m_subscriptions.insert(clientId, subscription);
+
+    returns.insert("enabled", true);
     return createReply(returns);
 }
 
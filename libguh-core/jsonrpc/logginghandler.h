@@ -25,6 +25,11 @@
 #include "jsonhandler.h"
 #include "logging/logentry.h"
 
+#include <QHash>
+#include <QStringList>
+#include <QTimer>
+#include <QUuid>
+
 namespace guhserver {
 
 class LoggingHandler : public JsonHandler
@@ -35,14 +40,37 @@ public:
     QString name() const override;
 
     Q_INVOKABLE JsonReply *GetLogEntries(const QVariantMap &params) const;
+    Q_INVOKABLE JsonReply *GetStateHistory(const QVariantMap &params) const;
+    Q_INVOKABLE JsonReply *SetLogSubscription(const QVariantMap &params);
+
+    void notificationScope(const QString &notification, const QVariantMap &params, QUuid *deviceId, QUuid *stateTypeId) const override;
+    bool filterNotification(const QUuid &clientId, const QString &notification, const NotificationSubscriptions::Subscription &subscription, QVariantMap *params) const override;
+    void clientDisconnected(const QUuid &clientId) override;
 
 signals:
     void LogEntryAdded(const QVariantMap &params);
+    void LogEntriesAdded(const QVariantMap &params);
     void LogDatabaseUpdated(const QVariantMap &params);
 
 private slots:
     void logEntryAdded(const LogEntry &entry);
     void logDatabaseUpdated();
+    void sendPendingLogEntries();
+
+private:
+    // The filter of a client subscription, holding the strings as packed in a LogEntry
+    struct LogSubscription {
+        QStringList loggingSources;
+        QStringList loggingLevels;
+        QStringList deviceIds;
+    };
+
+    bool matchesSubscription(const LogSubscription &subscription, const QVariantMap &logEntry) const;
+    static void logEntryScope(const QVariantMap &logEntry, QUuid *deviceId, QUuid *stateTypeId);
+
+    QHash<QUuid, LogSubscription> m_subscriptions;
+    QVariantList m_pendingEntries;
+    QTimer m_notificationTimer;
 
 };
 
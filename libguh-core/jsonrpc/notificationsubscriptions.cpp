@@ -0,0 +1,198 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/*!
+    \class guhserver::NotificationSubscriptions
+    \brief Keeps track of the notifications each JSON-RPC client is subscribed to.
+
+    \ingroup server
+    \inmodule core
+
+    A client can subscribe to whole namespaces, single notifications, and limit the notifications
+    concerning devices to the given devices and state types. The subscriptions are indexed by namespace
+    and notification name as well as by device and state type, so looking up the receivers of a
+    notification only visits the clients interested in it, not every connected client.
+
+    \sa JsonRPCServer
+*/
+
+#include "notificationsubscriptions.h"
+
+namespace guhserver {
+
+template <typename Key>
+static const QSet<QUuid> *bucket(const QHash<Key, QSet<QUuid> > &index, const Key &key)
+{
+    static const QSet<QUuid> empty;
+    typename QHash<Key, QSet<QUuid> >::const_iterator it = index.constFind(key);
+    return it == index.constEnd() ? &empty : &it.value();
+}
+
+/*! Subscribes the client with the given \a clientId to the notifications matching the given
+    \a subscription, replacing any previous subscription of this client. The default subscription
+    matches all notifications. */
+void NotificationSubscriptions::subscribe(const QUuid &clientId, const Subscription &subscription)
+{
+    unsubscribe(clientId);
+
+    m_subscriptions.insert(clientId, subscription);
+    if (subscription.namespaces.isEmpty() && subscription.notifications.isEmpty()) {
+        m_unfilteredClients.insert(clientId);
+    } else {
+        foreach (const QString &name, subscription.namespaces + subscription.notifications) {
+            m_nameIndex[name].insert(clientId);
+        }
+    }
+
+    if (subscription.deviceIds.isEmpty()) {
+        m_allDevicesClients.insert(clientId);
+    } else {
+        addToIndex(m_deviceIndex, subscription.deviceIds, clientId);
+    }
+
+    if (subscription.stateTypeIds.isEmpty()) {
+        m_allStateTypesClients.insert(clientId);
+    } else {
+        addToIndex(m_stateTypeIndex, subscription.stateTypeIds, clientId);
+    }
+}
+
+/*! Removes the subscription of the client with the given \a clientId. */
+void NotificationSubscriptions::unsubscribe(const QUuid &clientId)
+{
+    if (!m_subscriptions.contains(clientId))
+        return;
+
+    Subscription subscription = m_subscriptions.take(clientId);
+    m_unfilteredClients.remove(clientId);
+    foreach (const QString &name, subscription.namespaces + subscription.notifications) {
+        QHash<QString, QSet<QUuid> >::iterator it = m_nameIndex.find(name);
+        if (it == m_nameIndex.end())
+            continue;
+
+        it.value().remove(clientId);
+        if (it.value().isEmpty())
+            m_nameIndex.erase(it);
+    }
+
+    m_allDevicesClients.remove(clientId);
+    removeFromIndex(m_deviceIndex, subscription.deviceIds, clientId);
+    m_allStateTypesClients.remove(clientId);
+    removeFromIndex(m_stateTypeIndex, subscription.stateTypeIds, clientId);
+}
+
+/*! Returns true if the client with the given \a clientId is subscribed to any notifications. */
+bool NotificationSubscriptions::isSubscribed(const QUuid &clientId) const
+{
+    return m_subscriptions.contains(clientId);
+}
+
+/*! Returns the subscription of the client with the given \a clientId. */
+NotificationSubscriptions::Subscription NotificationSubscriptions::subscription(const QUuid &clientId) const
+{
+    return m_subscriptions.value(clientId);
+}
+
+/*! Returns the clients subscribed to the \a notification given as "Namespace.Notification". If the
+    notification concerns the device with the given \a deviceId or the state type with the given
+    \a stateTypeId, clients limited to other devices or state types are left out. */
+QList<QUuid> NotificationSubscriptions::subscribers(const QString &notification, const QUuid &deviceId, const QUuid &stateTypeId) const
+{
+    // Each filter gives the candidates as union of some index buckets, only the smallest one gets visited
+    QList<QList<const QSet<QUuid> *> > filters;
+    filters.append(QList<const QSet<QUuid> *>()
+                   << &m_unfilteredClients
+                   << bucket(m_nameIndex, notification.section('.', 0, 0))
+                   << bucket(m_nameIndex, notification));
+    if (!deviceId.isNull())
+        filters.append(QList<const QSet<QUuid> *>() << &m_allDevicesClients << bucket(m_deviceIndex, deviceId));
+
+    if (!stateTypeId.isNull())
+        filters.append(QList<const QSet<QUuid> *>() << &m_allStateTypesClients << bucket(m_stateTypeIndex, stateTypeId));
+
+    QList<const QSet<QUuid> *> candidates;
+    int candidateCount = -1;
+    foreach (const QList<const QSet<QUuid> *> &filter, filters) {
+        int count = 0;
+        foreach (const QSet<QUuid> *clients, filter) {
+            count += clients->count();
+        }
+        if (candidateCount < 0 || count < candidateCount) {
+            candidates = filter;
+            candidateCount = count;
+        }
+    }
+
+    QSet<QUuid> clients;
+    foreach (const QSet<QUuid> *candidateClients, candidates) {
+        foreach (const QUuid &clientId, *candidateClients) {
+            if (matches(m_subscriptions.constFind(clientId).value(), notification, deviceId, stateTypeId))
+                clients.insert(clientId);
+        }
+    }
+    return clients.toList();
+}
+
+/*! Returns true if something about the device with the given \a deviceId and the state type with the
+    given \a stateTypeId passes the device and state type filter of the \a subscription. Null ids are not
+    filtered. Handlers use this to filter the parts of a notification covering several devices. */
+bool NotificationSubscriptions::inScope(const Subscription &subscription, const QUuid &deviceId, const QUuid &stateTypeId)
+{
+    if (!deviceId.isNull() && !subscription.deviceIds.isEmpty() && !subscription.deviceIds.contains(deviceId))
+        return false;
+
+    if (!stateTypeId.isNull() && !subscription.stateTypeIds.isEmpty() && !subscription.stateTypeIds.contains(stateTypeId))
+        return false;
+
+    return true;
+}
+
+bool NotificationSubscriptions::matches(const Subscription &subscription, const QString &notification, const QUuid &deviceId, const QUuid &stateTypeId)
+{
+    if (!subscription.namespaces.isEmpty() || !subscription.notifications.isEmpty()) {
+        if (!subscription.notifications.contains(notification) && !subscription.namespaces.contains(notification.section('.', 0, 0)))
+            return false;
+    }
+
+    return inScope(subscription, deviceId, stateTypeId);
+}
+
+void NotificationSubscriptions::addToIndex(QHash<QUuid, QSet<QUuid> > &index, const QSet<QUuid> &ids, const QUuid &clientId)
+{
+    foreach (const QUuid &id, ids) {
+        index[id].insert(clientId);
+    }
+}
+
+void NotificationSubscriptions::removeFromIndex(QHash<QUuid, QSet<QUuid> > &index, const QSet<QUuid> &ids, const QUuid &clientId)
+{
+    foreach (const QUuid &id, ids) {
+        QHash<QUuid, QSet<QUuid> >::iterator it = index.find(id);
+        if (it == index.end())
+            continue;
+
+        it.value().remove(clientId);
+        if (it.value().isEmpty())
+            index.erase(it);
+    }
+}
+
+}
@@ -0,0 +1,70 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef NOTIFICATIONSUBSCRIPTIONS_H
+#define NOTIFICATIONSUBSCRIPTIONS_H
+
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QString>
+#include <QUuid>
+
+namespace guhserver {
+
+class NotificationSubscriptions
+{
+public:
+    // An empty set does not filter the notifications at all
+    struct Subscription {
+        QSet<QString> namespaces;
+        QSet<QString> notifications; // "Namespace.Notification"
+        QSet<QUuid> deviceIds;
+        QSet<QUuid> stateTypeIds;
+    };
+
+    void subscribe(const QUuid &clientId, const Subscription &subscription = Subscription());
+    void unsubscribe(const QUuid &clientId);
+
+    bool isSubscribed(const QUuid &clientId) const;
+    Subscription subscription(const QUuid &clientId) const;
+
+    QList<QUuid> subscribers(const QString &notification, const QUuid &deviceId = QUuid(), const QUuid &stateTypeId = QUuid()) const;
+
+    static bool inScope(const Subscription &subscription, const QUuid &deviceId, const QUuid &stateTypeId);
+
+private:
+    static bool matches(const Subscription &subscription, const QString &notification, const QUuid &deviceId, const QUuid &stateTypeId);
+    static void addToIndex(QHash<QUuid, QSet<QUuid> > &index, const QSet<QUuid> &ids, const QUuid &clientId);
+    static void removeFromIndex(QHash<QUuid, QSet<QUuid> > &index, const QSet<QUuid> &ids, const QUuid &clientId);
+
+    QHash<QUuid, Subscription> m_subscriptions;
+    QSet<QUuid> m_unfilteredClients; // clients without a namespace or notification filter
+    QHash<QString, QSet<QUuid> > m_nameIndex; // namespace or "Namespace.Notification" -> clients
+    QSet<QUuid> m_allDevicesClients; // clients without a device filter
+    QHash<QUuid, QSet<QUuid> > m_deviceIndex; // deviceId -> clients limited to this device
+    QSet<QUuid> m_allStateTypesClients; // clients without a state type filter
+    QHash<QUuid, QSet<QUuid> > m_stateTypeIndex; // stateTypeId -> clients limited to this state type
+};
+
+}
+
+#endif // NOTIFICATIONSUBSCRIPTIONS_H
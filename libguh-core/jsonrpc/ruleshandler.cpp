@@ -42,6 +42,16 @@
     The \a params contain the map for the notification.
 */
 
+/*! \fn void guhserver::RulesHandler::RulesRemoved(const QVariantMap &params);
+    This signal is emitted to the API notifications when a batch of \l{Rule}{Rules} was removed.
+    The \a params contain the map for the notification.
+*/
+
+/*! \fn void guhserver::RulesHandler::RulesAdded(const QVariantMap &params);
+    This signal is emitted to the API notifications when a batch of \l{Rule}{Rules} was added.
+    The \a params contain the map for the notification.
+*/
+
 /*! \fn void guhserver::RulesHandler::RuleActiveChanged(const QVariantMap &params);
     This signal is emitted to the API notifications when a \l{Rule} has changed the active status.
     The \a params contain the map for the notification.
@@ -83,6 +93,15 @@ RulesHandler::RulesHandler(QObject *parent) :
     returns.insert("ruleError", JsonTypes::ruleErrorRef());
     setReturns("GetRuleDetails", returns);
 
+    params.clear(); returns.clear();
+    setDescription("GetStateEvaluatorResult", "Get the last evaluation result of each node in the stateEvaluator of the rule "
+                   "identified by ruleId. This is meant for debugging rules. The nodes are not re-evaluated by this call.");
+    params.insert("ruleId", JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    setParams("GetStateEvaluatorResult", params);
+    returns.insert("o:stateEvaluatorResult", JsonTypes::stateEvaluatorResultRef());
+    returns.insert("ruleError", JsonTypes::ruleErrorRef());
+    setReturns("GetStateEvaluatorResult", returns);
+
     params.clear(); returns.clear();
     setDescription("AddRule", "Add a rule. You can describe rules by one or many EventDesciptors and a StateEvaluator. Note that only "
                    "one of either eventDescriptor or eventDescriptorList may be passed at a time. A rule can be created but left disabled, "
@@ -100,6 +119,18 @@ RulesHandler::RulesHandler(QObject *parent) :
     returns.insert("o:ruleId", JsonTypes::basicTypeToString(JsonTypes::Uuid));
     setReturns("AddRule", returns);
 
+    params.clear(); returns.clear();
+    setDescription("AddRules", "Add a list of rules at once. The rules are described like in Rules.AddRule. All rules will be "
+                   "validated before any of them gets added, so either all or none of the rules will be added. If a rule is "
+                   "not valid, failedIndex contains its position in the given list. If successfull, the notification "
+                   "\"Rules.RulesAdded\" will be emitted once for all rules.");
+    params.insert("rules", QVariantList() << JsonTypes::newRuleRef());
+    setParams("AddRules", params);
+    returns.insert("ruleError", JsonTypes::ruleErrorRef());
+    returns.insert("o:ruleIds", QVariantList() << JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    returns.insert("o:failedIndex", JsonTypes::basicTypeToString(JsonTypes::Int));
+    setReturns("AddRules", returns);
+
     params.clear(); returns.clear();
     setDescription("EditRule", "Edit the parameters of a rule. The configuration of the rule with the given ruleId "
                    "will be replaced with the new given configuration. In ordert to enable or disable a Rule, please use the "
@@ -126,6 +157,16 @@ RulesHandler::RulesHandler(QObject *parent) :
     returns.insert("ruleError", JsonTypes::ruleErrorRef());
     setReturns("RemoveRule", returns);
 
+    params.clear(); returns.clear();
+    setDescription("RemoveRules", "Remove a list of rules at once. If one of the rules can not be found, none of the rules will "
+                   "be removed and failedIndex contains the position of the unknown ruleId in the given list. If successfull, "
+                   "the notification \"Rules.RulesRemoved\" will be emitted once for all rules.");
+    params.insert("ruleIds", QVariantList() << JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    setParams("RemoveRules", params);
+    returns.insert("ruleError", JsonTypes::ruleErrorRef());
+    returns.insert("o:failedIndex", JsonTypes::basicTypeToString(JsonTypes::Int));
+    setReturns("RemoveRules", returns);
+
     params.clear(); returns.clear();
     setDescription("FindRules", "Find a list of rules containing any of the given parameters.");
     params.insert("deviceId", JsonTypes::basicTypeToString(JsonTypes::Uuid));
@@ -163,6 +204,34 @@ RulesHandler::RulesHandler(QObject *parent) :
     returns.insert("ruleError", JsonTypes::ruleErrorRef());
     setReturns("ExecuteExitActions", returns);
 
+    params.clear(); returns.clear();
+    setDescription("GetStatistics", "Get the evaluation statistics of the rule with the given ruleId, or of all rules if no "
+                   "ruleId is given. The evaluationTime is the cumulative time in microseconds spent evaluating the rule, "
+                   "lastTriggered is given in milliseconds since the epoch. Statistics are only collected while "
+                   "statisticsEnabled is true, see Rules.SetStatisticsEnabled.");
+    params.insert("o:ruleId", JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    setParams("GetStatistics", params);
+    returns.insert("ruleError", JsonTypes::ruleErrorRef());
+    returns.insert("statisticsEnabled", JsonTypes::basicTypeToString(JsonTypes::Bool));
+    returns.insert("o:ruleStatistics", QVariantList() << JsonTypes::ruleStatisticsRef());
+    setReturns("GetStatistics", returns);
+
+    params.clear(); returns.clear();
+    setDescription("ResetStatistics", "Reset the evaluation statistics of the rule with the given ruleId, or of all rules if no "
+                   "ruleId is given.");
+    params.insert("o:ruleId", JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    setParams("ResetStatistics", params);
+    returns.insert("ruleError", JsonTypes::ruleErrorRef());
+    setReturns("ResetStatistics", returns);
+
+    params.clear(); returns.clear();
+    setDescription("SetStatisticsEnabled", "Enable or disable the collection of rule evaluation statistics. The statistics "
+                   "are disabled by default and are not kept across restarts.");
+    params.insert("enabled", JsonTypes::basicTypeToString(JsonTypes::Bool));
+    setParams("SetStatisticsEnabled", params);
+    returns.insert("ruleError", JsonTypes::ruleErrorRef());
+    setReturns("SetStatisticsEnabled", returns);
+
     // Notifications
     params.clear(); returns.clear();
     setDescription("RuleRemoved", "Emitted whenever a Rule was removed.");
@@ -174,6 +243,16 @@ RulesHandler::RulesHandler(QObject *parent) :
     params.insert("rule", JsonTypes::ruleRef());
     setParams("RuleAdded", params);
 
+    params.clear(); returns.clear();
+    setDescription("RulesRemoved", "Emitted whenever a list of Rules was removed with Rules.RemoveRules.");
+    params.insert("ruleIds", QVariantList() << JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    setParams("RulesRemoved", params);
+
+    params.clear(); returns.clear();
+    setDescription("RulesAdded", "Emitted whenever a list of Rules was added with Rules.AddRules.");
+    params.insert("rules", QVariantList() << JsonTypes::ruleRef());
+    setParams("RulesAdded", params);
+
     params.clear(); returns.clear();
     setDescription("RuleActiveChanged", "Emitted whenever the active state of a Rule changed.");
     params.insert("ruleId", JsonTypes::basicTypeToString(JsonTypes::Uuid));
@@ -187,6 +266,8 @@ RulesHandler::RulesHandler(QObject *parent) :
 
     connect(GuhCore::instance(), &GuhCore::ruleAdded, this, &RulesHandler::ruleAddedNotification);
     connect(GuhCore::instance(), &GuhCore::ruleRemoved, this, &RulesHandler::ruleRemovedNotification);
+    connect(GuhCore::instance(), &GuhCore::rulesAdded, this, &RulesHandler::rulesAddedNotification);
+    connect(GuhCore::instance(), &GuhCore::rulesRemoved, this, &RulesHandler::rulesRemovedNotification);
     connect(GuhCore::instance(), &GuhCore::ruleActiveChanged, this, &RulesHandler::ruleActiveChangedNotification);
     connect(GuhCore::instance(), &GuhCore::ruleConfigurationChanged, this, &RulesHandler::ruleConfigurationChangedNotification);
 }
@@ -219,6 +300,18 @@ JsonReply *RulesHandler::GetRuleDetails(const QVariantMap &params)
     return createReply(returns);
 }
 
+JsonReply *RulesHandler::GetStateEvaluatorResult(const QVariantMap &params)
+{
+    RuleId ruleId = RuleId(params.value("ruleId").toString());
+    Rule rule = GuhCore::instance()->ruleEngine()->findRule(ruleId);
+    if (rule.id().isNull()) {
+        return createReply(statusToReply(RuleEngine::RuleErrorRuleNotFound));
+    }
+    QVariantMap returns = statusToReply(RuleEngine::RuleErrorNoError);
+    returns.insert("stateEvaluatorResult", JsonTypes::packStateEvaluatorResult(rule.stateEvaluator(), GuhCore::instance()->ruleEngine()->compiledStateEvaluator(ruleId)));
+    return createReply(returns);
+}
+
 JsonReply* RulesHandler::AddRule(const QVariantMap &params)
 {
     Rule rule = JsonTypes::unpackRule(params);
@@ -233,6 +326,31 @@ JsonReply* RulesHandler::AddRule(const QVariantMap &params)
     return createReply(returns);
 }
 
+JsonReply *RulesHandler::AddRules(const QVariantMap &params)
+{
+    QList<Rule> rules;
+    foreach (const QVariant &ruleVariant, params.value("rules").toList()) {
+        Rule rule = JsonTypes::unpackRule(ruleVariant.toMap());
+        rule.setId(RuleId::createRuleId());
+        rules.append(rule);
+    }
+
+    int failedIndex = -1;
+    RuleEngine::RuleError status = GuhCore::instance()->ruleEngine()->addRules(rules, &failedIndex);
+    QVariantMap returns;
+    if (status == RuleEngine::RuleErrorNoError) {
+        QVariantList ruleIds;
+        foreach (const Rule &rule, rules) {
+            ruleIds.append(rule.id().toString());
+        }
+        returns.insert("ruleIds", ruleIds);
+    } else if (failedIndex >= 0) {
+        returns.insert("failedIndex", failedIndex);
+    }
+    returns.insert("ruleError", JsonTypes::ruleErrorToString(status));
+    return createReply(returns);
+}
+
 JsonReply *RulesHandler::EditRule(const QVariantMap &params)
 {
     Rule rule = JsonTypes::unpackRule(params);
@@ -254,6 +372,23 @@ JsonReply* RulesHandler::RemoveRule(const QVariantMap &params)
     return createReply(returns);
 }
 
+JsonReply *RulesHandler::RemoveRules(const QVariantMap &params)
+{
+    QList<RuleId> ruleIds;
+    foreach (const QVariant &ruleId, params.value("ruleIds").toList()) {
+        ruleIds.append(RuleId(ruleId.toString()));
+    }
+
+    int failedIndex = -1;
+    RuleEngine::RuleError status = GuhCore::instance()->removeRules(ruleIds, &failedIndex);
+    QVariantMap returns;
+    if (status != RuleEngine::RuleErrorNoError && failedIndex >= 0) {
+        returns.insert("failedIndex", failedIndex);
+    }
+    returns.insert("ruleError", JsonTypes::ruleErrorToString(status));
+    return createReply(returns);
+}
+
 JsonReply *RulesHandler::FindRules(const QVariantMap &params)
 {
     DeviceId deviceId = DeviceId(params.value("deviceId").toString());
@@ -297,6 +432,50 @@ JsonReply *RulesHandler::ExecuteExitActions(const QVariantMap &params)
     return createReply(returns);
 }
 
+JsonReply *RulesHandler::GetStatistics(const QVariantMap &params)
+{
+    RuleEngine *ruleEngine = GuhCore::instance()->ruleEngine();
+
+    QList<RuleStatistics> ruleStatistics;
+    if (params.contains("ruleId")) {
+        RuleStatistics statistics = ruleEngine->ruleStatistics(RuleId(params.value("ruleId").toString()));
+        if (statistics.ruleId().isNull()) {
+            return createReply(statusToReply(RuleEngine::RuleErrorRuleNotFound));
+        }
+        ruleStatistics.append(statistics);
+    } else {
+        ruleStatistics = ruleEngine->ruleStatistics();
+    }
+
+    QVariantList ruleStatisticsList;
+    foreach (const RuleStatistics &statistics, ruleStatistics) {
+        ruleStatisticsList.append(JsonTypes::packRuleStatistics(statistics));
+    }
+
+    QVariantMap returns = statusToReply(RuleEngine::RuleErrorNoError);
+    returns.insert("statisticsEnabled", ruleEngine->statisticsEnabled());
+    returns.insert("ruleStatistics", ruleStatisticsList);
+    return createReply(returns);
+}
+
+JsonReply *RulesHandler::ResetStatistics(const QVariantMap &params)
+{
+    RuleId ruleId;
+    if (params.contains("ruleId")) {
+        ruleId = RuleId(params.value("ruleId").toString());
+        if (ruleId.isNull()) {
+            return createReply(statusToReply(RuleEngine::RuleErrorInvalidRuleId));
+        }
+    }
+    return createReply(statusToReply(GuhCore::instance()->ruleEngine()->resetStatistics(ruleId)));
+}
+
+JsonReply *RulesHandler::SetStatisticsEnabled(const QVariantMap &params)
+{
+    GuhCore::instance()->ruleEngine()->setStatisticsEnabled(params.value("enabled").toBool());
+    return createReply(statusToReply(RuleEngine::RuleErrorNoError));
+}
+
 void RulesHandler::ruleRemovedNotification(const RuleId &ruleId)
 {
     QVariantMap params;
@@ -313,6 +492,32 @@ void RulesHandler::ruleAddedNotification(const Rule &rule)
     emit RuleAdded(params);
 }
 
+void RulesHandler::rulesRemovedNotification(const QList<RuleId> &ruleIds)
+{
+    QVariantList ruleIdList;
+    foreach (const RuleId &ruleId, ruleIds) {
+        ruleIdList.append(ruleId);
+    }
+
+    QVariantMap params;
+    params.insert("ruleIds", ruleIdList);
+
+    emit RulesRemoved(params);
+}
+
+void RulesHandler::rulesAddedNotification(const QList<Rule> &rules)
+{
+    QVariantList ruleList;
+    foreach (const Rule &rule, rules) {
+        ruleList.append(JsonTypes::packRule(rule));
+    }
+
+    QVariantMap params;
+    params.insert("rules", ruleList);
+
+    emit RulesAdded(params);
+}
+
 void RulesHandler::ruleActiveChangedNotification(const Rule &rule)
 {
     QVariantMap params;
@@ -36,10 +36,13 @@ public:
 
     Q_INVOKABLE JsonReply *GetRules(const QVariantMap &params);
     Q_INVOKABLE JsonReply *GetRuleDetails(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *GetStateEvaluatorResult(const QVariantMap &params);
 
     Q_INVOKABLE JsonReply *AddRule(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *AddRules(const QVariantMap &params);
     Q_INVOKABLE JsonReply *EditRule(const QVariantMap &params);
     Q_INVOKABLE JsonReply *RemoveRule(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *RemoveRules(const QVariantMap &params);
     Q_INVOKABLE JsonReply *FindRules(const QVariantMap &params);
 
     Q_INVOKABLE JsonReply *EnableRule(const QVariantMap &params);
@@ -48,15 +51,23 @@ public:
     Q_INVOKABLE JsonReply *ExecuteActions(const QVariantMap &params);
     Q_INVOKABLE JsonReply *ExecuteExitActions(const QVariantMap &params);
 
+    Q_INVOKABLE JsonReply *GetStatistics(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *ResetStatistics(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *SetStatisticsEnabled(const QVariantMap &params);
+
 signals:
     void RuleRemoved(const QVariantMap &params);
     void RuleAdded(const QVariantMap &params);
+    void RulesRemoved(const QVariantMap &params);
+    void RulesAdded(const QVariantMap &params);
     void RuleActiveChanged(const QVariantMap &params);
     void RuleConfigurationChanged(const QVariantMap &params);
 
 private slots:
     void ruleRemovedNotification(const RuleId &ruleId);
     void ruleAddedNotification(const Rule &rule);
+    void rulesRemovedNotification(const QList<RuleId> &ruleIds);
+    void rulesAddedNotification(const QList<Rule> &rules);
     void ruleActiveChangedNotification(const Rule &rule);
     void ruleConfigurationChangedNotification(const Rule &rule);
 
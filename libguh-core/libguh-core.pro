@@ -23,6 +23,12 @@ HEADERS += guhcore.h \
     ruleengine.h \
     rule.h \
     stateevaluator.h \
+    compiledstateevaluator.h \
+    rulestorage.h \
+    settingsrulestorage.h \
+    sqlrulestorage.h \
+    rulestatistics.h \
+    recentstatebuffer.h \
     webserver.h \
     transportinterface.h \
     servermanager.h \
@@ -35,6 +41,7 @@ HEADERS += guhcore.h \
     jsonrpc/jsonhandler.h \
     jsonrpc/devicehandler.h \
     jsonrpc/jsontypes.h \
+    jsonrpc/jsonvalidator.h \
     jsonrpc/ruleshandler.h \
     jsonrpc/actionhandler.h \
     jsonrpc/eventhandler.h \
@@ -42,11 +49,15 @@ HEADERS += guhcore.h \
     jsonrpc/logginghandler.h \
     jsonrpc/configurationhandler.h \
     jsonrpc/networkmanagerhandler.h \
+    jsonrpc/notificationsubscriptions.h \
     logging/logging.h \
     logging/logengine.h \
     logging/logfilter.h \
     logging/logentry.h \
     logging/logvaluetool.h \
+    logging/logwriter.h \
+    logging/statehistorybucket.h \
+    logging/timeseriesstore.h \
     rest/restserver.h \
     rest/restresource.h \
     rest/devicesresource.h \
@@ -85,6 +96,12 @@ SOURCES += guhcore.cpp \
     ruleengine.cpp \
     rule.cpp \
     stateevaluator.cpp \
+    compiledstateevaluator.cpp \
+    rulestorage.cpp \
+    settingsrulestorage.cpp \
+    sqlrulestorage.cpp \
+    rulestatistics.cpp \
+    recentstatebuffer.cpp \
     webserver.cpp \
     transportinterface.cpp \
     servermanager.cpp \
@@ -97,6 +114,7 @@ SOURCES += guhcore.cpp \
     jsonrpc/jsonhandler.cpp \
     jsonrpc/devicehandler.cpp \
     jsonrpc/jsontypes.cpp \
+    jsonrpc/jsonvalidator.cpp \
     jsonrpc/ruleshandler.cpp \
     jsonrpc/actionhandler.cpp \
     jsonrpc/eventhandler.cpp \
@@ -104,10 +122,14 @@ SOURCES += guhcore.cpp \
     jsonrpc/logginghandler.cpp \
     jsonrpc/configurationhandler.cpp \
     jsonrpc/networkmanagerhandler.cpp \
+    jsonrpc/notificationsubscriptions.cpp \
     logging/logengine.cpp \
     logging/logfilter.cpp \
     logging/logentry.cpp \
     logging/logvaluetool.cpp \
+    logging/logwriter.cpp \
+    logging/statehistorybucket.cpp \
+    logging/timeseriesstore.cpp \
     rest/restserver.cpp \
     rest/restresource.cpp \
     rest/devicesresource.cpp \
@@ -30,6 +30,28 @@
     happening in the system. The database can be accessed from the API's. To controll the size of the database the
     limit of the databse are 8000 entries.
 
+    New entries are written asynchronously by a \l{LogWriter} thread in batches. The batching can be
+    configured with the \tt flushInterval (in ms) and \tt maxBatchSize keys in the \tt LogEngine group
+    of the guhd settings. Reading from the database always includes the entries still waiting in the queue.
+
+    Old entries are removed in chunks of \tt housekeepingChunkSize entries whenever the event loop is idle, so
+    the housekeeping never blocks for long. The database keeps the entries of the latest maxLogEntries ids.
+    The \tt id of the entries is an \tt AUTOINCREMENT primary key, so ids are never reused once the newest
+    entries got deleted. The housekeeping, the purges and the pagination cursors rely on ids growing in the
+    order the entries have been written.
+    Additionally each \l{Logging::LoggingSource} can get a maximum age in seconds in the \tt Retention group
+    within the \tt LogEngine group, i.e. \tt LoggingSourceStates=86400 keeps state changes for one day.
+
+    The entries of removed devices and rules are purged in the background as well. Each purge is queued
+    and deletes one chunk per idle event loop run, reporting purgeProgress() after each chunk and
+    purgeFinished() followed by logDatabaseUpdated() once done. Until then reads may still return some
+    of the purged entries. A chunk which can't be deleted is retried after a delay growing up to one minute.
+
+    Changes of numeric states with the \tt timeSeries flag in their plugin JSON are not written to the database,
+    but appended to the \l{TimeSeriesStore} next to it. The history of these states is available with
+    stateHistory(), and the retention policy of \l{Logging::LoggingSourceStates} drops their expired segments.
+    Their samples are written to disk within the same \tt flushInterval as the database entries.
+
 
     \sa LogEntry, LogFilter, LogsResource, LoggingHandler
 */
@@ -40,6 +62,20 @@
     \sa LogEntry
 */
 
+/*! \fn void guhserver::LogEngine::purgeProgress(const QUuid &id, int deletedEntries);
+    This signal is emitted after each chunk deleted while purging the entries of the device or rule
+    with the given \a id. \a deletedEntries is the number of entries deleted so far.
+
+    \sa removeDeviceLogs(), removeRuleLogs()
+*/
+
+/*! \fn void guhserver::LogEngine::purgeFinished(const QUuid &id, int deletedEntries);
+    This signal is emitted when all \a deletedEntries of the device or rule with the given \a id
+    have been purged.
+
+    \sa removeDeviceLogs(), removeRuleLogs()
+*/
+
 /*! \fn void guhserver::LogEngine::logDatabaseUpdated();
     This signal is emitted when the log database was updated. The log database
     will be updated when a \l{LogEntry} was added or when a device was removed
@@ -115,6 +151,7 @@
 #include "loggingcategories.h"
 #include "logging.h"
 #include "logvaluetool.h"
+#include "logwriter.h"
 
 #include <QCoreApplication>
 #include <QSqlDatabase>
@@ -126,8 +163,11 @@
 #include <QDateTime>
 #include <QFileInfo>
 #include <QTime>
+#include <QHash>
 
-#define DB_SCHEMA_VERSION 3
+#define DB_SCHEMA_VERSION 7
+#define STATE_HISTORY_MAX_BUCKETS 1000
+#define QUERY_CACHE_SIZE 16
 
 namespace guhserver {
 
@@ -139,6 +179,7 @@ LogEngine::LogEngine(const QString &logPath, QObject *parent):
     m_db.setDatabaseName(logPath);
     m_dbMaxSize = 50000;
     m_overflow = 100;
+    m_queryCache.setMaxCost(QUERY_CACHE_SIZE);
 
     if (QCoreApplication::instance()->organizationName() == "guh-test") {
         m_dbMaxSize = 20;
@@ -164,78 +205,286 @@ LogEngine::LogEngine(const QString &logPath, QObject *parent):
         }
     }
 
+    GuhSettings settings(GuhSettings::SettingsRoleGlobal);
+    settings.beginGroup("LogEngine");
+    m_writer = new LogWriter(m_db.databaseName(), this);
+    m_writer->setFlushInterval(settings.value("flushInterval", 500).toInt());
+    m_writer->setMaxBatchSize(settings.value("maxBatchSize", 200).toInt());
+    m_housekeepingChunkSize = qMax(1, settings.value("housekeepingChunkSize", 500).toInt());
+
+    QMetaEnum sources = Logging::staticMetaObject.enumerator(Logging::staticMetaObject.indexOfEnumerator("LoggingSource"));
+    settings.beginGroup("Retention");
+    for (int i = 0; i < sources.keyCount(); i++) {
+        int maxAge = settings.value(sources.key(i), 0).toInt();
+        if (maxAge > 0)
+            m_retentionPolicies.insert(static_cast<Logging::LoggingSource>(sources.value(i)), maxAge);
+    }
+    settings.endGroup();
+    settings.endGroup();
+    m_writer->start();
+
+    m_timeSeriesStore = new TimeSeriesStore(m_db.databaseName() + ".timeseries", this);
+    m_timeSeriesStore->setFlushInterval(m_writer->flushInterval());
+
     connect(&m_housekeepingTimer, &QTimer::timeout, this, &LogEngine::checkDBSize);
     m_housekeepingTimer.setInterval(1); // Trigger on next idle event loop run
     m_housekeepingTimer.setSingleShot(true);
 
-    checkDBSize();
+    // Entries expire without new entries being logged
+    connect(&m_retentionTimer, &QTimer::timeout, this, &LogEngine::checkRetention);
+    m_retentionTimer.setInterval(60000);
+    m_retentionTimer.start();
+
+    connect(&m_purgeTimer, &QTimer::timeout, this, &LogEngine::purgeChunk);
+    m_purgeTimer.setInterval(1);
+    m_purgeTimer.setSingleShot(true);
+
+    m_housekeepingTimer.start();
 }
 
 /*! Destructs the \l{LogEngine}. */
 LogEngine::~LogEngine()
 {
     qCDebug(dcApplication) << "Shutting down \"Log Engine\"";
+    m_writer->stop();
+    m_queryCache.clear();
     m_db.close();
 }
 
 /*! Returns the list of \l{LogEntry}{LogEntries} of the database matching the given \a filter.
 
+    If the \a filter has a limit and more entries follow the returned page, \a nextCursor will be set to
+    the cursor of the next page. Otherwise it will be cleared.
+
   \sa LogEntry, LogFilter
 */
-QList<LogEntry> LogEngine::logEntries(const LogFilter &filter) const
+QList<LogEntry> LogEngine::logEntries(const LogFilter &filter, QString *nextCursor) const
 {
     qCDebug(dcLogEngine) << "Read logging database" << m_db.databaseName();
+    m_writer->flush();
 
-    QList<LogEntry> results;
-    QSqlQuery query;
+    if (nextCursor)
+        nextCursor->clear();
 
-    QString queryCall = "SELECT * FROM entries ORDER BY timestamp;";
+    // Fetch one more entry than requested to know if there is a next page
+    LogFilter pageFilter = filter;
+    if (filter.limit() >= 0)
+        pageFilter.setLimit(filter.limit() + 1);
+
+    QList<LogEntry> results;
+    QString queryCall;
     if (filter.isEmpty()) {
-        query = m_db.exec(queryCall);
+        queryCall = QString("SELECT * FROM entries %1;").arg(pageFilter.orderString());
     } else {
-        queryCall = QString("SELECT * FROM entries WHERE %1 ORDER BY timestamp;").arg(filter.queryString());
-        query = m_db.exec(queryCall);
+        queryCall = QString("SELECT * FROM entries WHERE %1 %2;").arg(filter.queryString()).arg(pageFilter.orderString());
     }
 
-    if (m_db.lastError().isValid()) {
-        qCWarning(dcLogEngine) << "Error fetching log entries. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+    QSqlQuery *query = preparedQuery(queryCall);
+    if (!query)
         return QList<LogEntry>();
+
+    QVariantList bindValues = pageFilter.bindValues();
+    for (int i = 0; i < bindValues.count(); i++) {
+        query->bindValue(i, bindValues.at(i));
     }
 
-    while (query.next()) {
+    if (!query->exec()) {
+        qCWarning(dcLogEngine) << "Error fetching log entries. Driver error:" << query->lastError().driverText() << "Database error:" << query->lastError().databaseText();
+        query->finish();
+        return QList<LogEntry>();
+    }
+
+    qint64 lastTimestamp = 0;
+    qint64 lastRowId = -1;
+    while (query->next()) {
+        if (filter.limit() >= 0 && results.count() == filter.limit()) {
+            if (nextCursor && lastRowId >= 0)
+                *nextCursor = LogFilter::createCursor(lastTimestamp, lastRowId);
+
+            break;
+        }
+
+        lastTimestamp = query->value("timestamp").toLongLong();
+        lastRowId = query->value("id").toLongLong();
+
         LogEntry entry(
-                    QDateTime::fromTime_t(query.value("timestamp").toLongLong()),
-                    (Logging::LoggingLevel)query.value("loggingLevel").toInt(),
-                    (Logging::LoggingSource)query.value("sourceType").toInt(),
-                    query.value("errorCode").toInt());
-        entry.setTypeId(query.value("typeId").toUuid());
-        entry.setDeviceId(DeviceId(query.value("deviceId").toString()));
-        entry.setValue(LogValueTool::convertVariantToString(LogValueTool::deserializeValue(query.value("value").toString())));
-        entry.setEventType((Logging::LoggingEventType)query.value("loggingEventType").toInt());
-        entry.setActive(query.value("active").toBool());
+                    QDateTime::fromTime_t(lastTimestamp),
+                    (Logging::LoggingLevel)query->value("loggingLevel").toInt(),
+                    (Logging::LoggingSource)query->value("sourceType").toInt(),
+                    query->value("errorCode").toInt());
+        entry.setTypeId(query->value("typeId").toUuid());
+        entry.setDeviceId(DeviceId(query->value("deviceId").toString()));
+        int valueType = query->value("valueType").toInt();
+        LogValueTool::ValueColumn valueColumn = LogValueTool::valueColumn(valueType);
+        if (valueColumn != LogValueTool::ValueColumnNone)
+            entry.setValue(LogValueTool::convertVariantToString(LogValueTool::restoreValue(valueType, query->value(LogValueTool::valueColumnName(valueColumn)))));
+        entry.setEventType((Logging::LoggingEventType)query->value("loggingEventType").toInt());
+        entry.setActive(query->value("active").toBool());
         results.append(entry);
     }
-    qCDebug(dcLogEngine) << "Fetched" << results.count() << "entries for db query:" << queryCall;
+    // Reset the statement, an unfinished read would keep the database snapshot open
+    query->finish();
+    qCDebug(dcLogEngine) << "Fetched" << results.count() << "entries for db query:" << queryCall << bindValues;
 
     return results;
 }
 
+/*! Aggregates the logged values of the numeric state with the given \a stateTypeId of the device with
+    the given \a deviceId between \a startDate and \a endDate into \a buckets of \a bucketSize seconds.
+    Only buckets containing values are returned. The aggregation runs in SQLite on the device index,
+    so the result only grows with the number of buckets, which is limited to 1000. States stored in the
+    \l{TimeSeriesStore} are aggregated from the segments overlapping the range.
+
+    Returns \l{Logging::LoggingErrorInvalidFilterParameter} if the range or the bucket size are invalid.
+*/
+Logging::LoggingError LogEngine::stateHistory(const DeviceId &deviceId, const StateTypeId &stateTypeId, const QDateTime &startDate, const QDateTime &endDate, int bucketSize, QList<StateHistoryBucket> *buckets) const
+{
+    if (deviceId.isNull() || stateTypeId.isNull() || !startDate.isValid() || !endDate.isValid() || bucketSize <= 0)
+        return Logging::LoggingErrorInvalidFilterParameter;
+
+    qint64 start = startDate.toTime_t();
+    qint64 end = endDate.toTime_t();
+    if (end <= start || (end - start + bucketSize - 1) / bucketSize > STATE_HISTORY_MAX_BUCKETS)
+        return Logging::LoggingErrorInvalidFilterParameter;
+
+    buckets->clear();
+    if (m_timeSeriesStateTypes.contains(stateTypeId)) {
+        // The samples are sorted, so the last one of a bucket is its latest value
+        QHash<qint64, int> bucketIndexes;
+        foreach (const TimeSeriesStore::Sample &sample, m_timeSeriesStore->samples(deviceId, stateTypeId, startDate, endDate)) {
+            qint64 bucket = (sample.first / 1000 - start) / bucketSize;
+            double value = sample.second;
+            if (!bucketIndexes.contains(bucket)) {
+                bucketIndexes.insert(bucket, buckets->count());
+                buckets->append(StateHistoryBucket(QDateTime::fromTime_t(static_cast<uint>(start + bucket * bucketSize)), 1, value, value, value, value));
+                continue;
+            }
+
+            StateHistoryBucket &current = (*buckets)[bucketIndexes.value(bucket)];
+            current = StateHistoryBucket(current.timestamp(), current.count() + 1,
+                                         qMin(current.minimum(), value), qMax(current.maximum(), value),
+                                         current.average() + (value - current.average()) / (current.count() + 1), value);
+        }
+        return Logging::LoggingErrorNoError;
+    }
+
+    m_writer->flush();
+
+    // The last value of a bucket is the one of the entry written last. Entries of a state are written in the
+    // order they have been logged and ids are never reused, so MAX(id) also orders entries within the same second.
+    QSqlQuery *query = preparedQuery("SELECT bucket, count, minimum, maximum, average, "
+                                     "(SELECT COALESCE(valueReal, valueInt) FROM entries WHERE id = lastId) AS last FROM "
+                                     "(SELECT (timestamp - ?) / ? AS bucket, COUNT(*) AS count, MIN(COALESCE(valueReal, valueInt)) AS minimum, "
+                                     "MAX(COALESCE(valueReal, valueInt)) AS maximum, AVG(COALESCE(valueReal, valueInt)) AS average, MAX(id) AS lastId "
+                                     "FROM entries WHERE deviceId = ? AND typeId = ? AND sourceType = ? AND timestamp >= ? AND timestamp < ? "
+                                     "AND (valueInt IS NOT NULL OR valueReal IS NOT NULL) GROUP BY bucket) ORDER BY bucket;");
+    if (!query)
+        return Logging::LoggingErrorInvalidFilterParameter;
+
+    query->bindValue(0, start);
+    query->bindValue(1, bucketSize);
+    query->bindValue(2, deviceId.toString());
+    query->bindValue(3, stateTypeId.toString());
+    query->bindValue(4, Logging::LoggingSourceStates);
+    query->bindValue(5, start);
+    query->bindValue(6, end);
+    if (!query->exec()) {
+        qCWarning(dcLogEngine) << "Error fetching state history. Driver error:" << query->lastError().driverText() << "Database error:" << query->lastError().databaseText();
+        query->finish();
+        return Logging::LoggingErrorInvalidFilterParameter;
+    }
+
+    while (query->next()) {
+        qint64 bucket = query->value("bucket").toLongLong();
+        buckets->append(StateHistoryBucket(QDateTime::fromTime_t(static_cast<uint>(start + bucket * bucketSize)),
+                                           query->value("count").toInt(),
+                                           query->value("minimum").toDouble(),
+                                           query->value("maximum").toDouble(),
+                                           query->value("average").toDouble(),
+                                           query->value("last").toDouble()));
+    }
+    query->finish();
+    return Logging::LoggingErrorNoError;
+}
+
+/*! Blocks until all \l{LogEntry}{LogEntries} logged so far have been written to the database. */
+void LogEngine::flush()
+{
+    m_writer->flush();
+    m_timeSeriesStore->flush();
+}
+
+/*! Keeps the latest \a maxLogEntries entries in the database. The housekeeping starts once \a overflow
+    more entries have been logged. The database is trimmed before this method returns.
+*/
 void LogEngine::setMaxLogEntries(int maxLogEntries, int overflow)
 {
     m_dbMaxSize = maxLogEntries;
     m_overflow = overflow;
-    checkDBSize();
+
+    m_writer->flush();
+    int deletions = 0;
+    int deleted = 0;
+    while ((deleted = trimChunk()) > 0) {
+        deletions += deleted;
+    }
+    if (deletions > 0)
+        emit logDatabaseUpdated();
+}
+
+/*! Returns the \l{TimeSeriesStore} keeping the values of the time series states. */
+TimeSeriesStore *LogEngine::timeSeriesStore() const
+{
+    return m_timeSeriesStore;
+}
+
+/*! Returns the list of \l{StateType}{StateTypes} stored in the \l{TimeSeriesStore}. */
+QList<StateTypeId> LogEngine::timeSeriesStateTypes() const
+{
+    return m_timeSeriesStateTypes.toList();
+}
+
+/*! Stores the changes of the numeric states with the given \a stateTypeIds in the \l{TimeSeriesStore}
+    instead of the database.
+
+    \sa StateType::timeSeries()
+*/
+void LogEngine::setTimeSeriesStateTypes(const QList<StateTypeId> &stateTypeIds)
+{
+    m_timeSeriesStateTypes = stateTypeIds.toSet();
+}
+
+/*! Returns the maximum age in seconds of the entries from the given \a source, 0 if they don't expire. */
+int LogEngine::retentionPolicy(Logging::LoggingSource source) const
+{
+    return m_retentionPolicies.value(source, 0);
+}
+
+/*! Sets the maximum age of the entries from the given \a source to \a maxAge seconds. A \a maxAge of 0
+    keeps the entries until the maximum number of entries is reached. Expired entries are removed in the
+    background.
+*/
+void LogEngine::setRetentionPolicy(Logging::LoggingSource source, int maxAge)
+{
+    if (maxAge > 0) {
+        m_retentionPolicies.insert(source, maxAge);
+        m_housekeepingTimer.start();
+    } else {
+        m_retentionPolicies.remove(source);
+    }
 }
 
 /*! Removes all entries from the database. This method will be used for the tests. */
 void LogEngine::clearDatabase()
 {
     qCWarning(dcLogEngine) << "Clear logging database.";
+    m_writer->flush();
 
     QString queryDeleteString = QString("DELETE FROM entries;");
     if (m_db.exec(queryDeleteString).lastError().type() != QSqlError::NoError) {
         qCWarning(dcLogEngine) << "Could not clear logging database. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
     }
+    m_timeSeriesStore->clear();
 
     emit logDatabaseUpdated();
 }
@@ -273,6 +522,18 @@ void LogEngine::logEvent(const Event &event)
     } else {
         entry.setValue(valueList);
     }
+
+    // Numeric time series states bypass the database
+    if (event.isStateChangeEvent() && m_timeSeriesStateTypes.contains(StateTypeId(event.eventTypeId().toString()))) {
+        bool isNumber = false;
+        double value = entry.value().toDouble(&isNumber);
+        if (isNumber) {
+            m_timeSeriesStore->append(event.deviceId(), StateTypeId(event.eventTypeId().toString()), entry.timestamp(), value);
+            emit logEntryAdded(entry);
+            return;
+        }
+    }
+
     appendLogEntry(entry);
 }
 
@@ -338,66 +599,59 @@ void LogEngine::logRuleExitActionsExecuted(const Rule &rule)
     appendLogEntry(entry);
 }
 
+/*! Queues the removal of all entries of the device with the given \a deviceId. The entries are
+    deleted in chunks in the background, see purgeFinished(). The time series of the device are
+    removed immediately. */
 void LogEngine::removeDeviceLogs(const DeviceId &deviceId)
 {
     qCDebug(dcLogEngine) << "Deleting log entries from device" << deviceId.toString();
-
-    QString queryDeleteString = QString("DELETE FROM entries WHERE deviceId = '%1';").arg(deviceId.toString());
-    if (m_db.exec(queryDeleteString).lastError().type() != QSqlError::NoError) {
-        qCWarning(dcLogEngine) << "Error deleting log entries from device" << deviceId.toString() << ". Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
-    } else {
-        emit logDatabaseUpdated();
-    }
+    m_timeSeriesStore->removeSeries(deviceId);
+    enqueuePurge("deviceId", deviceId);
 }
 
+/*! Queues the removal of all entries of the rule with the given \a ruleId. The entries are
+    deleted in chunks in the background, see purgeFinished(). */
 void LogEngine::removeRuleLogs(const RuleId &ruleId)
 {
     qCDebug(dcLogEngine) << "Deleting log entries from rule" << ruleId.toString();
+    enqueuePurge("typeId", ruleId);
+}
 
-    QString queryDeleteString = QString("DELETE FROM entries WHERE typeId = '%1';").arg(ruleId.toString());
-    if (m_db.exec(queryDeleteString).lastError().type() != QSqlError::NoError) {
-        qCWarning(dcLogEngine) << "Error deleting log entries from rule" << ruleId.toString() << ". Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
-    } else {
-        emit logDatabaseUpdated();
-    }
+/*! Returns the number of device and rule purges which have not finished yet. */
+int LogEngine::pendingPurges() const
+{
+    return m_purgeJobs.count();
 }
 
 QList<DeviceId> LogEngine::devicesInLogs() const
 {
+    m_writer->flush();
+
     QString queryString = QString("SELECT deviceId FROM entries WHERE deviceId != \"%1\" GROUP BY deviceId;").arg(QUuid().toString());
     QSqlQuery result = m_db.exec(queryString);
-    QList<DeviceId> ret;
+    QList<DeviceId> ret = m_timeSeriesStore->devices();
     if (result.lastError().type() != QSqlError::NoError) {
         qCWarning(dcLogEngine()) << "Error fetching device entries from log database:" << m_db.lastError().driverText() << m_db.lastError().databaseText();
         return ret;
     }
-    if (!result.first()) {
-        return ret;
+    while (result.next()) {
+        DeviceId deviceId = DeviceId::fromUuid(result.value("deviceId").toUuid());
+        if (!ret.contains(deviceId))
+            ret.append(deviceId);
+    }
+
+    // Devices which are being purged are gone already
+    foreach (const PurgeJob &job, m_purgeJobs) {
+        if (job.column == "deviceId")
+            ret.removeAll(DeviceId::fromUuid(job.id));
     }
-    do {
-        ret.append(DeviceId::fromUuid(result.value("deviceId").toUuid()));
-    } while (result.next());
     return ret;
 }
 
 void LogEngine::appendLogEntry(const LogEntry &entry)
 {
-    QString queryString = QString("INSERT INTO entries (timestamp, loggingEventType, loggingLevel, sourceType, typeId, deviceId, value, active, errorCode) values ('%1', '%2', '%3', '%4', '%5', '%6', '%7', '%8', '%9');")
-            .arg(entry.timestamp().toTime_t())
-            .arg(entry.eventType())
-            .arg(entry.level())
-            .arg(entry.source())
-            .arg(entry.typeId().toString())
-            .arg(entry.deviceId().toString())
-            .arg(LogValueTool::serializeValue(entry.value()))
-            .arg(entry.active())
-            .arg(entry.errorCode());
-
-    if (m_db.exec(queryString).lastError().type() != QSqlError::NoError) {
-        qCWarning(dcLogEngine) << "Error writing log entry. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
-        qCWarning(dcLogEngine) << entry;
-        return;
-    }
+    // The writer thread stores the entry, the notification keeps the order of the queue
+    m_writer->enqueue(entry);
 
     emit logEntryAdded(entry);
 
@@ -409,32 +663,158 @@ void LogEngine::appendLogEntry(const LogEntry &entry)
 void LogEngine::checkDBSize()
 {
     QDateTime startTime = QDateTime::currentDateTime();
-    QString queryString = "SELECT COUNT(*) FROM entries;";
-    QSqlQuery result = m_db.exec(queryString);
-    if (m_db.lastError().type() != QSqlError::NoError) {
-        qWarning(dcLogEngine()) << "Failed to query entry count in db:" << m_db.lastError().databaseText();
+    m_writer->flush();
+
+    // Delete one chunk per idle event loop run until nothing is left to do
+    int deleted = trimChunk();
+    if (deleted > 0) {
+        m_housekeepingDeletions += deleted;
+        m_housekeepingTimer.start();
+        qCDebug(dcLogEngine()) << "Deleted" << deleted << "log entries in" << startTime.msecsTo(QDateTime::currentDateTime()) << "ms.";
         return;
     }
-    if (!result.first()) {
-        qWarning(dcLogEngine()) << "Failed retrieving entry count.";
+
+    if (m_housekeepingDeletions > 0) {
+        qCDebug(dcLogEngine()) << "Housekeeping deleted" << m_housekeepingDeletions << "log entries.";
+        m_housekeepingDeletions = 0;
+        emit logDatabaseUpdated();
+    }
+}
+
+void LogEngine::checkRetention()
+{
+    // Dropping segments walks all series directories, so only once per retention interval and not per trimmed chunk
+    if (m_retentionPolicies.contains(Logging::LoggingSourceStates)) {
+        int dropped = m_timeSeriesStore->dropSegments(QDateTime::currentDateTime().addSecs(-m_retentionPolicies.value(Logging::LoggingSourceStates)));
+        if (dropped > 0)
+            qCDebug(dcLogEngine()) << "Dropped" << dropped << "expired time series segments.";
+    }
+
+    checkDBSize();
+}
+
+int LogEngine::trimChunk()
+{
+    // Ids are never reused, the range of the ids is an upper bound of the entry count
+    QSqlQuery result = m_db.exec("SELECT MIN(rowid), MAX(rowid) FROM entries;");
+    if (m_db.lastError().type() != QSqlError::NoError || !result.first()) {
+        qCWarning(dcLogEngine()) << "Failed to query the row ids in db:" << m_db.lastError().databaseText();
+        return -1;
+    }
+
+    QStringList deleteQueries;
+    m_entryCount = 0;
+    if (!result.value(0).isNull()) {
+        qint64 minRowId = result.value(0).toLongLong();
+        qint64 maxRowId = result.value(1).toLongLong();
+        m_entryCount = maxRowId - minRowId + 1;
+        if (m_entryCount > m_dbMaxSize) {
+            if (!m_trimWarningPrinted) {
+                qCDebug(dcLogEngine) << "Deleting oldest entries and keep only the latest" << m_dbMaxSize << "entries.";
+                m_trimWarningPrinted = true;
+            }
+            qint64 lastRowId = qMin(maxRowId - m_dbMaxSize, minRowId + m_housekeepingChunkSize - 1);
+            deleteQueries.append(QString("DELETE FROM entries WHERE rowid <= %1;").arg(lastRowId));
+        }
+    }
+
+    // Expired entries of the sources with a retention policy
+    QDateTime now = QDateTime::currentDateTime();
+    foreach (Logging::LoggingSource source, m_retentionPolicies.keys()) {
+        deleteQueries.append(QString("DELETE FROM entries WHERE rowid IN (SELECT rowid FROM entries WHERE sourceType = %1 AND timestamp < %2 LIMIT %3);")
+                             .arg(source)
+                             .arg(now.addSecs(-m_retentionPolicies.value(source)).toTime_t())
+                             .arg(m_housekeepingChunkSize));
+    }
+
+    // Only one chunk per call
+    foreach (const QString &deleteQuery, deleteQueries) {
+        QSqlQuery query = m_db.exec(deleteQuery);
+        if (m_db.lastError().type() != QSqlError::NoError) {
+            qCWarning(dcLogEngine) << "Error deleting old log entries. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+            return -1;
+        }
+        if (query.numRowsAffected() > 0)
+            return query.numRowsAffected();
+    }
+    return 0;
+}
+
+void LogEngine::enqueuePurge(const QString &column, const QUuid &id)
+{
+    // Entries written after this point belong to a new device or rule with the same id and are kept.
+    // The AUTOINCREMENT id makes sure they never get an id of an entry deleted in the meantime.
+    m_writer->flush();
+    QSqlQuery result = m_db.exec("SELECT MAX(rowid) FROM entries;");
+    if (m_db.lastError().type() != QSqlError::NoError || !result.first()) {
+        qCWarning(dcLogEngine()) << "Failed to query the row ids in db:" << m_db.lastError().databaseText();
         return;
     }
-    m_entryCount = result.value(0).toInt();
+    qint64 maxRowId = result.value(0).toLongLong();
+
+    for (int i = 0; i < m_purgeJobs.count(); i++) {
+        if (m_purgeJobs.at(i).column == column && m_purgeJobs.at(i).id == id) {
+            m_purgeJobs[i].maxRowId = maxRowId;
+            return;
+        }
+    }
+
+    PurgeJob job;
+    job.column = column;
+    job.id = id;
+    job.maxRowId = maxRowId;
+    m_purgeJobs.append(job);
+    m_purgeTimer.start();
+}
 
-    if (m_entryCount >= m_dbMaxSize) {
-        // keep only the latest m_dbMaxSize entries
-        if (!m_trimWarningPrinted) {
-            qCDebug(dcLogEngine) << "Deleting oldest entries" << (m_entryCount - m_dbMaxSize) << "and keep only the latest" << m_dbMaxSize << "entries.";
-            m_trimWarningPrinted = true;
+void LogEngine::purgeChunk()
+{
+    if (m_purgeJobs.isEmpty())
+        return;
+
+    PurgeJob &job = m_purgeJobs.first();
+    QSqlQuery *query = preparedQuery(QString("DELETE FROM entries WHERE rowid IN (SELECT rowid FROM entries WHERE %1 = ? AND rowid <= ? LIMIT ?);").arg(job.column));
+    int deleted = -1;
+    if (query) {
+        query->bindValue(0, job.id.toString());
+        query->bindValue(1, job.maxRowId);
+        query->bindValue(2, m_housekeepingChunkSize);
+        if (query->exec()) {
+            deleted = query->numRowsAffected();
+        } else {
+            qCWarning(dcLogEngine) << "Error deleting log entries of" << job.id.toString() << ". Driver error:" << query->lastError().driverText() << "Database error:" << query->lastError().databaseText();
         }
-        QString queryDeleteString = QString("DELETE FROM entries WHERE ROWID IN (SELECT ROWID FROM entries ORDER BY timestamp DESC LIMIT -1 OFFSET %1);").arg(QString::number(m_dbMaxSize));
-        if (m_db.exec(queryDeleteString).lastError().type() != QSqlError::NoError) {
-            qCWarning(dcLogEngine) << "Error deleting oldest log entries to keep size. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        query->finish();
+    }
+
+    // Keep the job until its entries are gone, the database might only be locked or full for a while
+    if (deleted < 0) {
+        job.failures++;
+        int retryDelay = qMin(1000 << qMin(job.failures - 1, 6), 60000);
+        qCWarning(dcLogEngine) << "Retrying to delete the log entries of" << job.id.toString() << "in" << retryDelay << "ms";
+        m_purgeTimer.start(retryDelay);
+        return;
+    }
+    job.failures = 0;
+    m_purgeTimer.setInterval(1);
+
+    // Delete one chunk per idle event loop run until a chunk is not full any more
+    if (deleted > 0) {
+        job.deleted += deleted;
+        emit purgeProgress(job.id, job.deleted);
+        if (deleted == m_housekeepingChunkSize) {
+            m_purgeTimer.start();
+            return;
         }
-        m_entryCount = m_dbMaxSize;
-        emit logDatabaseUpdated();
     }
-    qCDebug(dcLogEngine()) << "Ran housekeeping on log database in" << startTime.msecsTo(QDateTime::currentDateTime()) << "ms.";
+
+    PurgeJob finishedJob = m_purgeJobs.takeFirst();
+    if (!m_purgeJobs.isEmpty())
+        m_purgeTimer.start();
+
+    qCDebug(dcLogEngine) << "Deleted" << finishedJob.deleted << "log entries of" << finishedJob.id.toString();
+    emit purgeFinished(finishedJob.id, finishedJob.deleted);
+    emit logDatabaseUpdated();
 }
 
 void LogEngine::rotate(const QString &dbName)
@@ -521,8 +901,8 @@ bool LogEngine::migrateDatabaseVersion2to3()
 
     QTime runTime = QTime(0,0,0,0).addMSecs(startTime.msecsTo(QDateTime::currentDateTime()));
     qCDebug(dcLogEngine()) << "Migration of" << migrationCounter << "done in" << runTime.toString("mm:ss.zzz");
-    qCDebug(dcLogEngine()) << "Updating database version to" << DB_SCHEMA_VERSION;
-    m_db.exec(QString("UPDATE metadata SET data = %1 WHERE key = 'version';").arg(DB_SCHEMA_VERSION));
+    qCDebug(dcLogEngine()) << "Updating database version to" << 3;
+    m_db.exec(QString("UPDATE metadata SET data = %1 WHERE key = 'version';").arg(3));
     if (m_db.lastError().isValid()) {
         qCWarning(dcLogEngine) << "Error updating database verion 2 -> 3. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
         return false;
@@ -532,11 +912,264 @@ bool LogEngine::migrateDatabaseVersion2to3()
     return true;
 }
 
+bool LogEngine::migrateDatabaseVersion3to4()
+{
+    // Changelog: add indexes for the device, type and time based queries
+    qCDebug(dcLogEngine()) << "Start migration of log database from version 3 to version 4";
+
+    QDateTime startTime = QDateTime::currentDateTime();
+    if (!m_db.transaction()) {
+        qCWarning(dcLogEngine) << "Error migrating database verion 3 -> 4. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    if (!createIndexes()) {
+        m_db.rollback();
+        return false;
+    }
+
+    m_db.exec(QString("UPDATE metadata SET data = %1 WHERE key = 'version';").arg(4));
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error updating database verion 3 -> 4. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        m_db.rollback();
+        return false;
+    }
+
+    if (!m_db.commit()) {
+        qCWarning(dcLogEngine) << "Error committing database verion 3 -> 4. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    QTime runTime = QTime(0,0,0,0).addMSecs(startTime.msecsTo(QDateTime::currentDateTime()));
+    qCDebug(dcLogEngine()) << "Migrated database verion 3 -> 4 successfully in" << runTime.toString("mm:ss.zzz");
+    return true;
+}
+
+bool LogEngine::migrateDatabaseVersion4to5()
+{
+    // Changelog: store the values in typed columns instead of base64 encoded QDataStream strings
+    qCDebug(dcLogEngine()) << "Start migration of log database from version 4 to version 5";
+
+    QDateTime startTime = QDateTime::currentDateTime();
+    if (!m_db.transaction()) {
+        qCWarning(dcLogEngine) << "Error migrating database verion 4 -> 5. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    QStringList columns;
+    columns << "valueType int DEFAULT 0" << "valueInt integer" << "valueReal real" << "valueText text" << "valueBlob blob";
+    foreach (const QString &column, columns) {
+        m_db.exec(QString("ALTER TABLE entries ADD COLUMN %1;").arg(column));
+        if (m_db.lastError().isValid()) {
+            qCWarning(dcLogEngine) << "Error migrating database verion 4 -> 5. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+            m_db.rollback();
+            return false;
+        }
+    }
+
+    QSqlQuery selectQuery = m_db.exec("SELECT rowid, value FROM entries WHERE value != '';");
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error migrating database verion 4 -> 5. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        m_db.rollback();
+        return false;
+    }
+
+    // The legacy value column is cleared, SQLite can not drop columns
+    QSqlQuery updateQuery(m_db);
+    updateQuery.prepare("UPDATE entries SET value = NULL, valueType = ?, valueInt = ?, valueReal = ?, valueText = ?, valueBlob = ? WHERE rowid = ?;");
+
+    int migrationCounter = 0;
+    while (selectQuery.next()) {
+        QVariant value = LogValueTool::deserializeValue(selectQuery.value("value").toString());
+        int valueType = LogValueTool::valueType(value);
+        LogValueTool::ValueColumn valueColumn = LogValueTool::valueColumn(valueType);
+        QVariant storageValue = LogValueTool::storageValue(value);
+        updateQuery.bindValue(0, valueType);
+        updateQuery.bindValue(1, valueColumn == LogValueTool::ValueColumnInteger ? storageValue : QVariant());
+        updateQuery.bindValue(2, valueColumn == LogValueTool::ValueColumnReal ? storageValue : QVariant());
+        updateQuery.bindValue(3, valueColumn == LogValueTool::ValueColumnText ? storageValue : QVariant());
+        updateQuery.bindValue(4, valueColumn == LogValueTool::ValueColumnBlob ? storageValue : QVariant());
+        updateQuery.bindValue(5, selectQuery.value("rowid"));
+        if (!updateQuery.exec()) {
+            qCWarning(dcLogEngine) << "Error migrating database verion 4 -> 5. Driver error:" << updateQuery.lastError().driverText() << "Database error:" << updateQuery.lastError().databaseText();
+            m_db.rollback();
+            return false;
+        }
+        migrationCounter++;
+    }
+
+    m_db.exec(QString("UPDATE metadata SET data = %1 WHERE key = 'version';").arg(5));
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error updating database verion 4 -> 5. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        m_db.rollback();
+        return false;
+    }
+
+    if (!m_db.commit()) {
+        qCWarning(dcLogEngine) << "Error committing database verion 4 -> 5. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    QTime runTime = QTime(0,0,0,0).addMSecs(startTime.msecsTo(QDateTime::currentDateTime()));
+    qCDebug(dcLogEngine()) << "Migrated" << migrationCounter << "entries from database verion 4 -> 5 successfully in" << runTime.toString("mm:ss.zzz");
+    return true;
+}
+
+bool LogEngine::migrateDatabaseVersion5to6()
+{
+    // Changelog: add an index for the retention policies of the logging sources
+    qCDebug(dcLogEngine()) << "Start migration of log database from version 5 to version 6";
+
+    if (!m_db.transaction()) {
+        qCWarning(dcLogEngine) << "Error migrating database verion 5 -> 6. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    if (!createIndexes()) {
+        m_db.rollback();
+        return false;
+    }
+
+    m_db.exec(QString("UPDATE metadata SET data = %1 WHERE key = 'version';").arg(6));
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error updating database verion 5 -> 6. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        m_db.rollback();
+        return false;
+    }
+
+    if (!m_db.commit()) {
+        qCWarning(dcLogEngine) << "Error committing database verion 5 -> 6. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    qCDebug(dcLogEngine()) << "Migrated database verion 5 -> 6 successfully";
+    return true;
+}
+
+bool LogEngine::migrateDatabaseVersion6to7()
+{
+    // Changelog: AUTOINCREMENT id column, drop the legacy value column
+    QDateTime startTime = QDateTime::currentDateTime();
+    qCDebug(dcLogEngine()) << "Start migration of log database from version 6 to version 7";
+
+    if (!m_db.transaction()) {
+        qCWarning(dcLogEngine) << "Error migrating database verion 6 -> 7. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    // SQLite can not change the primary key of a table, the entries get copied into a new one keeping their row ids
+    if (!createEntriesTable("entriesMigration")) {
+        m_db.rollback();
+        return false;
+    }
+
+    QStringList queries;
+    queries << "INSERT INTO entriesMigration (id, timestamp, loggingLevel, sourceType, typeId, deviceId, valueType, valueInt, valueReal, valueText, valueBlob, loggingEventType, active, errorCode) "
+               "SELECT rowid, timestamp, loggingLevel, sourceType, typeId, deviceId, valueType, valueInt, valueReal, valueText, valueBlob, loggingEventType, active, errorCode FROM entries ORDER BY rowid;";
+    queries << "DROP TABLE entries;";
+    queries << "ALTER TABLE entriesMigration RENAME TO entries;";
+    queries << QString("UPDATE metadata SET data = %1 WHERE key = 'version';").arg(7);
+    foreach (const QString &query, queries) {
+        m_db.exec(query);
+        if (m_db.lastError().isValid()) {
+            qCWarning(dcLogEngine) << "Error migrating database verion 6 -> 7. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+            m_db.rollback();
+            return false;
+        }
+    }
+
+    if (!createIndexes()) {
+        m_db.rollback();
+        return false;
+    }
+
+    if (!m_db.commit()) {
+        qCWarning(dcLogEngine) << "Error committing database verion 6 -> 7. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    QTime runTime = QTime(0,0,0,0).addMSecs(startTime.msecsTo(QDateTime::currentDateTime()));
+    qCDebug(dcLogEngine()) << "Migrated database verion 6 -> 7 successfully in" << runTime.toString("mm:ss.zzz");
+    return true;
+}
+
+bool LogEngine::createEntriesTable(const QString &tableName)
+{
+    // The id is an alias of the rowid, AUTOINCREMENT keeps SQLite from reusing the ids of deleted entries
+    m_db.exec(QString("CREATE TABLE %1 "
+                      "("
+                      "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+                      "timestamp int,"
+                      "loggingLevel int,"
+                      "sourceType int,"
+                      "typeId varchar(38),"
+                      "deviceId varchar(38),"
+                      "valueType int DEFAULT 0,"
+                      "valueInt integer,"
+                      "valueReal real,"
+                      "valueText text,"
+                      "valueBlob blob,"
+                      "loggingEventType int,"
+                      "active bool,"
+                      "errorCode int,"
+                      "FOREIGN KEY(sourceType) REFERENCES sourceTypes(id),"
+                      "FOREIGN KEY(loggingEventType) REFERENCES loggingEventTypes(id)"
+                      ");").arg(tableName));
+
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error creating log table in database. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+    return true;
+}
+
+bool LogEngine::createIndexes()
+{
+    // (deviceId, timestamp) also covers the GROUP BY deviceId in devicesInLogs()
+    QStringList indexes;
+    indexes << "CREATE INDEX IF NOT EXISTS entries_deviceId_timestamp ON entries (deviceId, timestamp);";
+    indexes << "CREATE INDEX IF NOT EXISTS entries_typeId_timestamp ON entries (typeId, timestamp);";
+    indexes << "CREATE INDEX IF NOT EXISTS entries_timestamp ON entries (timestamp);";
+    indexes << "CREATE INDEX IF NOT EXISTS entries_sourceType_timestamp ON entries (sourceType, timestamp);";
+
+    foreach (const QString &index, indexes) {
+        m_db.exec(index);
+        if (m_db.lastError().isValid()) {
+            qCWarning(dcLogEngine) << "Error creating log index. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+            return false;
+        }
+    }
+    return true;
+}
+
+QSqlQuery *LogEngine::preparedQuery(const QString &statement) const
+{
+    // Filters with the same shape share the statement, so repeated requests only bind their values
+    QSqlQuery *query = m_queryCache.object(statement);
+    if (query)
+        return query;
+
+    query = new QSqlQuery(m_db);
+    query->setForwardOnly(true);
+    if (!query->prepare(statement)) {
+        qCWarning(dcLogEngine) << "Error preparing query" << statement << "Driver error:" << query->lastError().driverText() << "Database error:" << query->lastError().databaseText();
+        delete query;
+        return 0;
+    }
+
+    m_queryCache.insert(statement, query);
+    return query;
+}
+
 bool LogEngine::initDB()
 {
+    m_queryCache.clear();
     m_db.close();
     m_db.open();
 
+    // Let the log writer thread append while other connections read
+    m_db.exec("PRAGMA journal_mode = WAL;");
+
     if (!m_db.tables().contains("metadata")) {
         m_db.exec("CREATE TABLE metadata (key varchar(10), data varchar(40));");
         m_db.exec(QString("INSERT INTO metadata (key, data) VALUES('version', '%1');").arg(DB_SCHEMA_VERSION));
@@ -547,13 +1180,57 @@ bool LogEngine::initDB()
         int version = query.value("data").toInt();
 
         // Migration from 2 -> 3 (serialize values in order to store QVariant information)
-        if (DB_SCHEMA_VERSION == 3 && version == 2) {
+        if (version == 2) {
             if (!migrateDatabaseVersion2to3()) {
                 qCWarning(dcLogEngine()) << "Migration process failed.";
                 return false;
             } else {
                 // Successfully migrated
-                version = DB_SCHEMA_VERSION;
+                version = 3;
+            }
+        }
+
+        // Migration from 3 -> 4 (indexes for device, type and time based queries)
+        if (version == 3) {
+            if (!migrateDatabaseVersion3to4()) {
+                qCWarning(dcLogEngine()) << "Migration process failed.";
+                return false;
+            } else {
+                // Successfully migrated
+                version = 4;
+            }
+        }
+
+        // Migration from 4 -> 5 (typed value columns)
+        if (version == 4) {
+            if (!migrateDatabaseVersion4to5()) {
+                qCWarning(dcLogEngine()) << "Migration process failed.";
+                return false;
+            } else {
+                // Successfully migrated
+                version = 5;
+            }
+        }
+
+        // Migration from 5 -> 6 (index for the retention policies)
+        if (version == 5) {
+            if (!migrateDatabaseVersion5to6()) {
+                qCWarning(dcLogEngine()) << "Migration process failed.";
+                return false;
+            } else {
+                // Successfully migrated
+                version = 6;
+            }
+        }
+
+        // Migration from 6 -> 7 (AUTOINCREMENT id)
+        if (version == 6) {
+            if (!migrateDatabaseVersion6to7()) {
+                qCWarning(dcLogEngine()) << "Migration process failed.";
+                return false;
+            } else {
+                // Successfully migrated
+                version = 7;
             }
         }
 
@@ -588,26 +1265,13 @@ bool LogEngine::initDB()
     }
 
     if (!m_db.tables().contains("entries")) {
-        m_db.exec("CREATE TABLE entries "
-                  "("
-                  "timestamp int,"
-                  "loggingLevel int,"
-                  "sourceType int,"
-                  "typeId varchar(38),"
-                  "deviceId varchar(38),"
-                  "value varchar(100),"
-                  "loggingEventType int,"
-                  "active bool,"
-                  "errorCode int,"
-                  "FOREIGN KEY(sourceType) REFERENCES sourceTypes(id),"
-                  "FOREIGN KEY(loggingEventType) REFERENCES loggingEventTypes(id)"
-                  ");");
-
-        if (m_db.lastError().isValid()) {
-            qCWarning(dcLogEngine) << "Error creating log table in database. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        if (!createEntriesTable("entries")) {
             return false;
         }
 
+        if (!createIndexes()) {
+            return false;
+        }
 
     }
 
@@ -24,16 +24,24 @@
 
 #include "logentry.h"
 #include "logfilter.h"
+#include "statehistorybucket.h"
+#include "timeseriesstore.h"
 #include "types/event.h"
 #include "types/action.h"
 #include "rule.h"
 
 #include <QObject>
 #include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QCache>
 #include <QTimer>
+#include <QMap>
+#include <QSet>
 
 namespace guhserver {
 
+class LogWriter;
+
 class LogEngine: public QObject
 {
     Q_OBJECT
@@ -41,9 +49,17 @@ public:
     LogEngine(const QString &logPath = GuhSettings::logPath(), QObject *parent = 0);
     ~LogEngine();
 
-    QList<LogEntry> logEntries(const LogFilter &filter = LogFilter()) const;
+    QList<LogEntry> logEntries(const LogFilter &filter = LogFilter(), QString *nextCursor = 0) const;
+    Logging::LoggingError stateHistory(const DeviceId &deviceId, const StateTypeId &stateTypeId, const QDateTime &startDate, const QDateTime &endDate, int bucketSize, QList<StateHistoryBucket> *buckets) const;
 
     void setMaxLogEntries(int maxLogEntries, int overflow);
+    int retentionPolicy(Logging::LoggingSource source) const;
+    void setRetentionPolicy(Logging::LoggingSource source, int maxAge);
+
+    TimeSeriesStore *timeSeriesStore() const;
+    QList<StateTypeId> timeSeriesStateTypes() const;
+    void setTimeSeriesStateTypes(const QList<StateTypeId> &stateTypeIds);
+    void flush();
     void clearDatabase();
 
     void logSystemEvent(const QDateTime &dateTime, bool active, Logging::LoggingLevel level = Logging::LoggingLevelInfo);
@@ -56,30 +72,65 @@ public:
     void logRuleExitActionsExecuted(const Rule &rule);
     void removeDeviceLogs(const DeviceId &deviceId);
     void removeRuleLogs(const RuleId &ruleId);
+    int pendingPurges() const;
     QList<DeviceId> devicesInLogs() const;
 
 signals:
     void logEntryAdded(const LogEntry &logEntry);
     void logDatabaseUpdated();
+    void purgeProgress(const QUuid &id, int deletedEntries);
+    void purgeFinished(const QUuid &id, int deletedEntries);
 
 private:
+    // Deletes the entries with the id in the column, which were written before the purge was queued.
+    // Entry ids are never reused (AUTOINCREMENT), so maxRowId bounds the job to the entries existing at that time.
+    struct PurgeJob {
+        QString column;
+        QUuid id;
+        qint64 maxRowId = 0;
+        int deleted = 0;
+        int failures = 0; // consecutive failed chunks, the job is retried with a growing delay
+    };
+
     bool initDB();
     void appendLogEntry(const LogEntry &entry);
     void rotate(const QString &dbName);
 
 
     bool migrateDatabaseVersion2to3();
+    bool migrateDatabaseVersion3to4();
+    bool migrateDatabaseVersion4to5();
+    bool migrateDatabaseVersion5to6();
+    bool migrateDatabaseVersion6to7();
+    bool createEntriesTable(const QString &tableName);
+    bool createIndexes();
+
+    int trimChunk();
+    void enqueuePurge(const QString &column, const QUuid &id);
+    QSqlQuery *preparedQuery(const QString &statement) const;
 
 private slots:
     void checkDBSize();
+    void checkRetention();
+    void purgeChunk();
 
 private:
     QSqlDatabase m_db;
+    mutable QCache<QString, QSqlQuery> m_queryCache; // statement -> prepared query, least recently used ones get dropped
+    LogWriter *m_writer;
+    TimeSeriesStore *m_timeSeriesStore;
+    QSet<StateTypeId> m_timeSeriesStateTypes;
     int m_dbMaxSize;
     int m_overflow;
     bool m_trimWarningPrinted = false;
     int m_entryCount = 0;
+    int m_housekeepingChunkSize = 500;
+    int m_housekeepingDeletions = 0;
+    QMap<Logging::LoggingSource, int> m_retentionPolicies; // source -> maximum age in seconds
     QTimer m_housekeepingTimer;
+    QTimer m_retentionTimer;
+    QList<PurgeJob> m_purgeJobs;
+    QTimer m_purgeTimer;
 };
 
 }
@@ -28,61 +28,54 @@
     A \l{LogFilter} can be used to get \l{LogEntry}{LogEntries} from the \l{LogEngine} matching
     a certain pattern.
 
+    The matching entries can be fetched page by page using setLimit() together with either setOffset()
+    or setCursor(). A cursor is an opaque string pointing behind the last entry of the previous page,
+    unlike the offset it stays stable while new entries are added to the database.
+
     \sa LogEngine, LogEntry, LogsResource, LoggingHandler
 */
 
 #include "logfilter.h"
 #include "loggingcategories.h"
 
+#include <QVariant>
+
 namespace guhserver {
 
 /*! Constructs a new \l{LogFilter}.*/
-LogFilter::LogFilter()
+LogFilter::LogFilter() :
+    m_limit(-1),
+    m_offset(0),
+    m_sortOrder(Qt::AscendingOrder),
+    m_cursorValid(true),
+    m_cursorTimestamp(0),
+    m_cursorRowId(-1)
 {
 
 }
 
-/*! Returns the database query string for this \l{LogFilter}.*/
+/*! Returns the WHERE clause for this \l{LogFilter}. The values of the filter are not part of the
+    string, it contains a \c ? placeholder for each of them instead, which have to be bound in the order
+    of bindValues(). Filters with the same shape, i.e. the same number of elements in each of their lists,
+    result in the same string, so the prepared statement can be reused for them.
+
+    \sa bindValues()
+*/
 QString LogFilter::queryString() const
 {
-    if (isEmpty()) {
-        return QString();
-    }
-
-    QString query;
-    query.append(createDateString());
-
-    if (!query.isEmpty() && !loggingSources().isEmpty()) {
-        query.append("AND ");
-    }
-    query.append(createSourcesString());
-
-    if (!query.isEmpty() && !loggingLevels().isEmpty()) {
-        query.append("AND ");
-    }
-    query.append(createLevelsString());
-
-    if (!query.isEmpty() && !loggingEventTypes().isEmpty()) {
-        query.append("AND ");
-    }
-    query.append(createEventTypesString());
-
-    if (!query.isEmpty() && !typeIds().isEmpty()) {
-        query.append("AND ");
-    }
-    query.append(createTypeIdsString());
-
-    if (!query.isEmpty() && !deviceIds().isEmpty()) {
-        query.append("AND ");
-    }
-    query.append(createDeviceIdString());
+    QVariantList bindValues;
+    return createQueryString(&bindValues);
+}
 
-    if (!query.isEmpty() && !values().isEmpty()) {
-        query.append("AND ");
-    }
-    query.append(createValuesString());
+/*! Returns the values for the placeholders of the queryString() followed by the ones of the orderString(). */
+QVariantList LogFilter::bindValues() const
+{
+    QVariantList bindValues;
+    createQueryString(&bindValues);
+    if (m_limit >= 0 || m_offset > 0)
+        bindValues << m_limit << m_offset;
 
-    return query;
+    return bindValues;
 }
 
 /*! Add a new time filter with the given \a startDate and \a endDate. */
@@ -186,173 +179,233 @@ bool LogFilter::isEmpty() const
             m_eventTypes.isEmpty() &&
             m_typeIds.isEmpty() &&
             m_deviceIds.isEmpty() &&
-            m_values.isEmpty();
-}
-
-QString LogFilter::createDateString() const
-{
-    QString query;
-    if (!m_timeFilters.isEmpty()) {
-        if (m_timeFilters.count() == 1) {
-            QPair<QDateTime, QDateTime> timeFilter = m_timeFilters.first();
-            query.append(createTimeFilterString(timeFilter));
-        } else {
-            query.append("( ");
-            QPair<QDateTime, QDateTime> timeFilter;
-            foreach (timeFilter, m_timeFilters) {
-                query.append(createTimeFilterString(timeFilter));
-                if (timeFilter != m_timeFilters.last())
-                    query.append("OR ");
-            }
-            query.append(") ");
-        }
+            m_values.isEmpty() &&
+            m_cursorRowId < 0;
+}
+
+/*! Returns false if the pagination parameters of this \l{LogFilter} are invalid, i.e. a negative
+    offset or a cursor which could not be parsed. */
+bool LogFilter::isValid() const
+{
+    return m_cursorValid && m_limit >= -1 && m_offset >= 0;
+}
+
+/*! Limit the number of returned entries to the given \a limit. A limit of -1 returns all entries. */
+void LogFilter::setLimit(int limit)
+{
+    m_limit = limit;
+}
+
+/*! Returns the maximum number of returned entries. -1 if the number of entries is not limited. */
+int LogFilter::limit() const
+{
+    return m_limit;
+}
+
+/*! Skip the first \a offset entries matching this \l{LogFilter}. */
+void LogFilter::setOffset(int offset)
+{
+    m_offset = offset;
+}
+
+/*! Returns the number of entries which will be skipped. */
+int LogFilter::offset() const
+{
+    return m_offset;
+}
+
+/*! Set the \a sortOrder of the returned entries. The entries are sorted by their timestamp. */
+void LogFilter::setSortOrder(Qt::SortOrder sortOrder)
+{
+    m_sortOrder = sortOrder;
+}
+
+/*! Returns the sort order of the returned entries. */
+Qt::SortOrder LogFilter::sortOrder() const
+{
+    return m_sortOrder;
+}
+
+/*! Continue after the entry the given \a cursor points to. The \a cursor has to be one returned by the
+    \l{LogEngine} for a previous page with the same filter and sort order. An empty cursor starts at the beginning. */
+void LogFilter::setCursor(const QString &cursor)
+{
+    m_cursor = cursor;
+    m_cursorValid = true;
+    m_cursorTimestamp = 0;
+    m_cursorRowId = -1;
+    if (cursor.isEmpty())
+        return;
+
+    QList<QByteArray> tokens = QByteArray::fromBase64(cursor.toUtf8(), QByteArray::Base64UrlEncoding).split(':');
+    bool timestampValid = false;
+    bool rowIdValid = false;
+    if (tokens.count() == 2) {
+        m_cursorTimestamp = tokens.at(0).toLongLong(&timestampValid);
+        m_cursorRowId = tokens.at(1).toLongLong(&rowIdValid);
+    }
+
+    if (!timestampValid || !rowIdValid || m_cursorRowId < 0) {
+        qCWarning(dcLogEngine()) << "Invalid log cursor" << cursor;
+        m_cursorValid = false;
+        m_cursorTimestamp = 0;
+        m_cursorRowId = -1;
+    }
+}
+
+/*! Returns the cursor this \l{LogFilter} continues after. */
+QString LogFilter::cursor() const
+{
+    return m_cursor;
+}
+
+/*! Returns the ORDER BY, LIMIT and OFFSET clause for this \l{LogFilter}. Entries with the same timestamp
+    are sorted by their insertion order, so the pages do not overlap. The limit and offset are placeholders
+    for the last two bindValues(). */
+QString LogFilter::orderString() const
+{
+    QString order = (m_sortOrder == Qt::AscendingOrder ? "ASC" : "DESC");
+    QString query = QString("ORDER BY timestamp %1, rowid %1").arg(order);
+    if (m_limit >= 0 || m_offset > 0) {
+        query.append(" LIMIT ? OFFSET ?");
     }
     return query;
 }
 
-QString LogFilter::createTimeFilterString(QPair<QDateTime, QDateTime> timeFilter) const
+/*! Returns the opaque cursor pointing behind the entry with the given \a timestamp and \a rowId. */
+QString LogFilter::createCursor(qint64 timestamp, qint64 rowId)
+{
+    return QString::fromUtf8(QByteArray(QByteArray::number(timestamp) + ":" + QByteArray::number(rowId)).toBase64(QByteArray::Base64UrlEncoding));
+}
+
+QString LogFilter::createQueryString(QVariantList *bindValues) const
+{
+    if (isEmpty()) {
+        return QString();
+    }
+
+    QStringList conditions;
+    conditions.append(createDateString(bindValues));
+    conditions.append(createListString("sourceType", m_sources.count()));
+    foreach (const Logging::LoggingSource &source, m_sources) {
+        bindValues->append(source);
+    }
+
+    conditions.append(createListString("loggingLevel", m_levels.count()));
+    foreach (const Logging::LoggingLevel &level, m_levels) {
+        bindValues->append(level);
+    }
+
+    conditions.append(createListString("loggingEventType", m_eventTypes.count()));
+    foreach (const Logging::LoggingEventType &eventType, m_eventTypes) {
+        bindValues->append(eventType);
+    }
+
+    conditions.append(createListString("typeId", m_typeIds.count()));
+    foreach (const QUuid &typeId, m_typeIds) {
+        bindValues->append(typeId.toString());
+    }
+
+    conditions.append(createListString("deviceId", m_deviceIds.count()));
+    foreach (const DeviceId &deviceId, m_deviceIds) {
+        bindValues->append(deviceId.toString());
+    }
+
+    conditions.append(createValuesString(bindValues));
+    conditions.append(createCursorString(bindValues));
+    conditions.removeAll(QString());
+
+    return conditions.join("AND ");
+}
+
+QString LogFilter::createDateString(QVariantList *bindValues) const
+{
+    QStringList timeFilters;
+    QPair<QDateTime, QDateTime> timeFilter;
+    foreach (timeFilter, m_timeFilters) {
+        timeFilters.append(createTimeFilterString(timeFilter, bindValues));
+    }
+    return joinConditions(timeFilters);
+}
+
+QString LogFilter::createTimeFilterString(QPair<QDateTime, QDateTime> timeFilter, QVariantList *bindValues) const
 {
-    QString query;
     QDateTime startDate = timeFilter.first;
     QDateTime endDate = timeFilter.second;
 
     qCDebug(dcLogEngine) << "create timefiler for" << startDate.toString() << endDate.toString();
 
-    query.append("( ");
     if (startDate.isValid() && !endDate.isValid()) {
         // only start date is valid
-        query.append(QString("timestamp BETWEEN '%1' AND '%2' ")
-                     .arg(startDate.toTime_t())
-                     .arg(QDateTime::currentDateTime().toTime_t()));
+        *bindValues << startDate.toTime_t() << QDateTime::currentDateTime().toTime_t();
+        return "( timestamp BETWEEN ? AND ? ) ";
     } else if (!startDate.isValid() && endDate.isValid()) {
         // only end date is valid
-        query.append(QString("timestamp NOT BETWEEN '%1' AND '%2' ")
-                     .arg(endDate.toTime_t())
-                     .arg(QDateTime::currentDateTime().toTime_t()));
+        *bindValues << endDate.toTime_t() << QDateTime::currentDateTime().toTime_t();
+        return "( timestamp NOT BETWEEN ? AND ? ) ";
     } else if (startDate.isValid() && endDate.isValid()) {
         // both dates are valid
-        query.append(QString("timestamp BETWEEN '%1' AND '%2' ")
-                     .arg(startDate.toTime_t())
-                     .arg(endDate.toTime_t()));
+        *bindValues << startDate.toTime_t() << endDate.toTime_t();
+        return "( timestamp BETWEEN ? AND ? ) ";
     }
-    query.append(") ");
-    return query;
+    return "( ) ";
 }
 
-QString LogFilter::createSourcesString() const
-{
-    QString query;
-    if (!m_sources.isEmpty()) {
-        if (m_sources.count() == 1) {
-            query.append(QString("sourceType = '%1' ").arg(m_sources.first()));
-        } else {
-            query.append("( ");
-            foreach (const Logging::LoggingSource &source, m_sources) {
-                query.append(QString("sourceType = '%1' ").arg(source));
-                if (source != m_sources.last())
-                    query.append("OR ");
-            }
-            query.append(") ");
-        }
+QString LogFilter::createListString(const QString &column, int count) const
+{
+    // The values are bound by the caller, one placeholder for each of them
+    QStringList conditions;
+    for (int i = 0; i < count; i++) {
+        conditions.append(QString("%1 = ? ").arg(column));
     }
-    return query;
+    return joinConditions(conditions);
 }
 
-QString LogFilter::createLevelsString() const
-{
-    QString query;
-    if (!m_levels.isEmpty()) {
-        if (m_levels.count() == 1) {
-            query.append(QString("loggingLevel = '%1' ").arg(m_levels.first()));
-        } else {
-            query.append("( ");
-            foreach (const Logging::LoggingLevel &level, m_levels) {
-                query.append(QString("loggingLevel = '%1' ").arg(level));
-                if (level != m_levels.last())
-                    query.append("OR ");
-            }
-            query.append(") ");
-        }
+QString LogFilter::createValuesString(QVariantList *bindValues) const
+{
+    QStringList conditions;
+    foreach (const QString &value, m_values) {
+        conditions.append(createValueString(value, bindValues));
     }
-    return query;
+    return joinConditions(conditions);
 }
 
-QString LogFilter::createEventTypesString() const
-{
-    QString query;
-    if (!m_eventTypes.isEmpty()) {
-        if (m_eventTypes.count() == 1) {
-            query.append(QString("loggingEventType = '%1' ").arg(m_eventTypes.first()));
-        } else {
-            query.append("( ");
-            foreach (const Logging::LoggingEventType &eventType, m_eventTypes) {
-                query.append(QString("loggingEventType = '%1' ").arg(eventType));
-                if (eventType != m_eventTypes.last())
-                    query.append("OR ");
-            }
-            query.append(") ");
-        }
+QString LogFilter::createValueString(const QString &value, QVariantList *bindValues) const
+{
+    // Numbers and booleans are compared with the typed columns, strings with the text column
+    QString query = "( valueText = ? ";
+    bindValues->append(value);
+
+    bool isNumber = false;
+    double number = value.toDouble(&isNumber);
+    if (isNumber) {
+        query.append("OR valueInt = ? OR valueReal = ? ");
+        *bindValues << number << number;
+    } else if (value == "true" || value == "false") {
+        query.append("OR ( valueType = ? AND valueInt = ? ) ");
+        *bindValues << static_cast<int>(QVariant::Bool) << (value == "true" ? 1 : 0);
     }
-    return query;
-}
 
-QString LogFilter::createTypeIdsString() const
-{
-    QString query;
-    if (!m_typeIds.isEmpty()) {
-        if (m_typeIds.count() == 1) {
-            query.append(QString("typeId = '%1' ").arg(m_typeIds.first().toString()));
-        } else {
-            query.append("( ");
-            foreach (const QUuid &typeId, m_typeIds) {
-                query.append(QString("typeId = '%1' ").arg(typeId.toString()));
-                if (typeId != m_typeIds.last())
-                    query.append("OR ");
-            }
-            query.append(") ");
-        }
-    }
+    query.append(") ");
     return query;
 }
 
-QString LogFilter::createDeviceIdString() const
-{
-    QString query;
-    if (!m_deviceIds.isEmpty()) {
-        if (m_deviceIds.count() == 1) {
-            query.append(QString("deviceId = '%1' ").arg(m_deviceIds.first().toString()));
-        } else {
-            query.append("( ");
-            foreach (const DeviceId &deviceId, m_deviceIds) {
-                query.append(QString("deviceId = '%1' ").arg(deviceId.toString()));
-                if (deviceId != m_deviceIds.last())
-                    query.append("OR ");
-            }
-            query.append(") ");
-        }
-    }
-    return query;
+QString LogFilter::createCursorString(QVariantList *bindValues) const
+{
+    if (m_cursorRowId < 0)
+        return QString();
+
+    QString compare = (m_sortOrder == Qt::AscendingOrder ? ">" : "<");
+    *bindValues << m_cursorTimestamp << m_cursorTimestamp << m_cursorRowId;
+    return QString("( timestamp %1 ? OR ( timestamp = ? AND rowid %1 ? ) ) ").arg(compare);
 }
 
-QString LogFilter::createValuesString() const
+QString LogFilter::joinConditions(const QStringList &conditions) const
 {
-    // FIXME: check how to filter for serialized values
+    if (conditions.count() <= 1)
+        return conditions.value(0);
 
-    QString query;
-    if (!m_values.isEmpty()) {
-        if (m_values.count() == 1) {
-            query.append(QString("value = '%1' ").arg(m_values.first()));
-        } else {
-            query.append("( ");
-            foreach (const QString &value, m_values) {
-                query.append(QString("value = '%1' ").arg(value));
-                if (value != m_values.last())
-                    query.append("OR ");
-            }
-            query.append(") ");
-        }
-    }
-    return query;
+    return "( " + conditions.join("OR ") + ") ";
 }
 
 }
@@ -24,6 +24,8 @@
 
 #include <QPair>
 #include <QDateTime>
+#include <QStringList>
+#include <QVariantList>
 
 #include "logging.h"
 #include "typeutils.h"
@@ -36,7 +38,7 @@ public:
     LogFilter();
 
     QString queryString() const;
-
+    QVariantList bindValues() const;
 
     void addTimeFilter(const QDateTime &startDate = QDateTime(), const QDateTime &endDate = QDateTime());
     QList<QPair<QDateTime, QDateTime> > timeFilters() const;
@@ -63,6 +65,23 @@ public:
     QList<QString> values() const;
 
     bool isEmpty() const;
+    bool isValid() const;
+
+    // Pagination
+    void setLimit(int limit);
+    int limit() const;
+
+    void setOffset(int offset);
+    int offset() const;
+
+    void setSortOrder(Qt::SortOrder sortOrder);
+    Qt::SortOrder sortOrder() const;
+
+    void setCursor(const QString &cursor);
+    QString cursor() const;
+
+    QString orderString() const;
+    static QString createCursor(qint64 timestamp, qint64 rowId);
 
 private:
     QList<QPair<QDateTime, QDateTime > > m_timeFilters;
@@ -73,14 +92,22 @@ private:
     QList<DeviceId> m_deviceIds;
     QList<QString> m_values;
 
-    QString createDateString() const;
-    QString createTimeFilterString(QPair<QDateTime, QDateTime> timeFilter) const;
-    QString createSourcesString() const;
-    QString createLevelsString() const;
-    QString createEventTypesString() const;
-    QString createTypeIdsString() const;
-    QString createDeviceIdString() const;
-    QString createValuesString() const;
+    int m_limit;
+    int m_offset;
+    Qt::SortOrder m_sortOrder;
+    QString m_cursor;
+    bool m_cursorValid;
+    qint64 m_cursorTimestamp;
+    qint64 m_cursorRowId;
+
+    QString createQueryString(QVariantList *bindValues) const;
+    QString createDateString(QVariantList *bindValues) const;
+    QString createTimeFilterString(QPair<QDateTime, QDateTime> timeFilter, QVariantList *bindValues) const;
+    QString createListString(const QString &column, int count) const;
+    QString createValuesString(QVariantList *bindValues) const;
+    QString createValueString(const QString &value, QVariantList *bindValues) const;
+    QString createCursorString(QVariantList *bindValues) const;
+    QString joinConditions(const QStringList &conditions) const;
 };
 
 }
@@ -49,6 +49,102 @@ QString LogValueTool::convertVariantToString(const QVariant &value)
 }
 
 QString LogValueTool::serializeValue(const QVariant &value)
+{
+    return QString(streamValue(value).toBase64());
+}
+
+QVariant LogValueTool::deserializeValue(const QString &serializedValue)
+{
+    return unstreamValue(QByteArray::fromBase64(serializedValue.toUtf8()));
+}
+
+// The type tag stored in the valueType column, 0 for entries without a value
+int LogValueTool::valueType(const QVariant &value)
+{
+    if (!value.isValid())
+        return QVariant::Invalid;
+
+    return value.userType();
+}
+
+// Numbers and strings get native columns so SQLite can compare and aggregate them,
+// everything else is stored as QDataStream blob
+LogValueTool::ValueColumn LogValueTool::valueColumn(int valueType)
+{
+    switch (valueType) {
+    case QVariant::Invalid:
+        return ValueColumnNone;
+    case QVariant::Bool:
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+        return ValueColumnInteger;
+    case QVariant::Double:
+    case QMetaType::Float:
+        return ValueColumnReal;
+    case QVariant::String:
+        return ValueColumnText;
+    default:
+        return ValueColumnBlob;
+    }
+}
+
+QString LogValueTool::valueColumnName(ValueColumn column)
+{
+    switch (column) {
+    case ValueColumnInteger:
+        return "valueInt";
+    case ValueColumnReal:
+        return "valueReal";
+    case ValueColumnText:
+        return "valueText";
+    case ValueColumnBlob:
+        return "valueBlob";
+    default:
+        return QString();
+    }
+}
+
+QVariant LogValueTool::storageValue(const QVariant &value)
+{
+    switch (valueColumn(valueType(value))) {
+    case ValueColumnInteger:
+        return value.toLongLong();
+    case ValueColumnReal:
+        return value.toDouble();
+    case ValueColumnText:
+        return value.toString();
+    case ValueColumnBlob:
+        return streamValue(value);
+    default:
+        return QVariant();
+    }
+}
+
+QVariant LogValueTool::restoreValue(int valueType, const QVariant &storageValue)
+{
+    QVariant value;
+    switch (valueColumn(valueType)) {
+    case ValueColumnInteger:
+        value = storageValue.toLongLong();
+        break;
+    case ValueColumnReal:
+        value = storageValue.toDouble();
+        break;
+    case ValueColumnText:
+        return storageValue.toString();
+    case ValueColumnBlob:
+        return unstreamValue(storageValue.toByteArray());
+    default:
+        return QVariant();
+    }
+
+    value.convert(valueType);
+    return value;
+}
+
+QByteArray LogValueTool::streamValue(const QVariant &value)
 {
     QByteArray byteArray;
     QBuffer writeBuffer(&byteArray);
@@ -56,13 +152,13 @@ QString LogValueTool::serializeValue(const QVariant &value)
     QDataStream out(&writeBuffer);
     out << value;
     writeBuffer.close();
-    return QString(byteArray.toBase64());
+    return byteArray;
 }
 
-QVariant LogValueTool::deserializeValue(const QString &serializedValue)
+QVariant LogValueTool::unstreamValue(const QByteArray &data)
 {
-    QByteArray data = QByteArray::fromBase64(serializedValue.toUtf8());
-    QBuffer readBuffer(&data);
+    QByteArray buffer = data;
+    QBuffer readBuffer(&buffer);
     readBuffer.open(QIODevice::ReadOnly);
     QDataStream inputStream(&readBuffer);
     QVariant value;
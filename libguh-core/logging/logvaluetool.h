@@ -28,11 +28,29 @@ class LogValueTool : public QObject
 {
     Q_OBJECT
 public:
+    enum ValueColumn {
+        ValueColumnNone,
+        ValueColumnInteger,
+        ValueColumnReal,
+        ValueColumnText,
+        ValueColumnBlob
+    };
+
     explicit LogValueTool(QObject *parent = nullptr);
 
     static QString convertVariantToString(const QVariant &value);
     static QString serializeValue(const QVariant &value);
     static QVariant deserializeValue(const QString &serializedValue);
+
+    static int valueType(const QVariant &value);
+    static ValueColumn valueColumn(int valueType);
+    static QString valueColumnName(ValueColumn column);
+    static QVariant storageValue(const QVariant &value);
+    static QVariant restoreValue(int valueType, const QVariant &storageValue);
+
+private:
+    static QByteArray streamValue(const QVariant &value);
+    static QVariant unstreamValue(const QByteArray &data);
 };
 
 #endif // LOGVALUETOOL_H
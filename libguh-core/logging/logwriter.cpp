@@ -0,0 +1,225 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/*!
+    \class guhserver::LogWriter
+    \brief Writes the \l{LogEntry}{LogEntries} of the \l{LogEngine} to the database in a separate thread.
+
+    \ingroup logs
+    \inmodule core
+
+    The \l{LogEngine} hands new entries over to the writer using enqueue() and returns immediately.
+    The writer thread collects the queued entries until either flushInterval() passed or maxBatchSize()
+    entries are waiting, and writes them with a prepared statement in a single transaction. The writer
+    uses its own database connection, the database is expected to be initialized by the \l{LogEngine}.
+
+    Before reading from or deleting in the database, the \l{LogEngine} calls flush() so the pending
+    entries are visible to its own connection.
+
+    \sa LogEngine, LogEntry
+*/
+
+#include "logwriter.h"
+#include "logvaluetool.h"
+#include "loggingcategories.h"
+
+#include <QSqlError>
+
+namespace guhserver {
+
+/*! Constructs a \l{LogWriter} for the database file \a databaseName with the given \a parent.
+    The writer starts writing once the thread has been started. */
+LogWriter::LogWriter(const QString &databaseName, QObject *parent) :
+    QThread(parent),
+    m_databaseName(databaseName),
+    m_enqueuedCount(0),
+    m_writtenCount(0),
+    m_flushRequests(0),
+    m_stopping(false),
+    m_flushInterval(500),
+    m_maxBatchSize(200)
+{
+
+}
+
+/*! Destructs the \l{LogWriter}. All queued entries will be written before the thread stops. */
+LogWriter::~LogWriter()
+{
+    stop();
+}
+
+/*! Returns the maximum time in milliseconds a \l{LogEntry} waits in the queue before it gets written. */
+int LogWriter::flushInterval() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_flushInterval;
+}
+
+/*! Sets the maximum time in milliseconds a \l{LogEntry} waits in the queue to \a flushInterval. */
+void LogWriter::setFlushInterval(int flushInterval)
+{
+    QMutexLocker locker(&m_mutex);
+    m_flushInterval = qMax(0, flushInterval);
+}
+
+/*! Returns the number of queued entries which will be written without waiting for the flushInterval(). */
+int LogWriter::maxBatchSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxBatchSize;
+}
+
+/*! Sets the number of queued entries which will be written without waiting for the flushInterval() to \a maxBatchSize. */
+void LogWriter::setMaxBatchSize(int maxBatchSize)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxBatchSize = qMax(1, maxBatchSize);
+}
+
+/*! Adds the given \a entry to the write queue. The entries will be written in the order they have been enqueued. */
+void LogWriter::enqueue(const LogEntry &entry)
+{
+    QMutexLocker locker(&m_mutex);
+    m_queue.append(entry);
+    m_enqueuedCount++;
+
+    // Wake the writer for the first entry of a batch and once the batch is full
+    if (m_queue.count() == 1 || m_queue.count() >= m_maxBatchSize)
+        m_queueCondition.wakeAll();
+}
+
+/*! Blocks until all entries enqueued so far have been written to the database. */
+void LogWriter::flush()
+{
+    if (!isRunning())
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    quint64 target = m_enqueuedCount;
+    if (m_writtenCount >= target)
+        return;
+
+    m_flushRequests++;
+    m_queueCondition.wakeAll();
+    while (m_writtenCount < target)
+        m_writtenCondition.wait(&m_mutex);
+
+    m_flushRequests--;
+}
+
+/*! Writes all queued entries and stops the writer thread. */
+void LogWriter::stop()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_queueCondition.wakeAll();
+    }
+    wait();
+}
+
+void LogWriter::run()
+{
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "logwriter");
+        db.setDatabaseName(m_databaseName);
+        if (!db.open()) {
+            qCWarning(dcLogEngine()) << "Log writer could not open the database:" << db.lastError().driverText() << db.lastError().databaseText();
+        }
+
+        // The journal mode is set by the LogEngine, fsync only on WAL checkpoints
+        db.exec("PRAGMA synchronous = NORMAL;");
+
+        QSqlQuery query(db);
+        query.prepare("INSERT INTO entries (timestamp, loggingEventType, loggingLevel, sourceType, typeId, deviceId, valueType, valueInt, valueReal, valueText, valueBlob, active, errorCode) "
+                      "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);");
+
+        forever {
+            QList<LogEntry> entries;
+            bool stopping;
+            {
+                QMutexLocker locker(&m_mutex);
+                while (m_queue.isEmpty() && !m_stopping)
+                    m_queueCondition.wait(&m_mutex);
+
+                // Collect more entries until the batch is full or the flush interval passed
+                if (!m_stopping && m_flushRequests == 0 && m_queue.count() < m_maxBatchSize)
+                    m_queueCondition.wait(&m_mutex, m_flushInterval);
+
+                entries.swap(m_queue);
+                stopping = m_stopping;
+            }
+
+            if (!entries.isEmpty())
+                writeEntries(db, query, entries);
+
+            QMutexLocker locker(&m_mutex);
+            m_writtenCount += entries.count();
+            m_writtenCondition.wakeAll();
+            if (stopping && m_queue.isEmpty())
+                break;
+        }
+
+        query.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("logwriter");
+}
+
+bool LogWriter::writeEntries(QSqlDatabase &db, QSqlQuery &query, const QList<LogEntry> &entries)
+{
+    if (!db.transaction()) {
+        qCWarning(dcLogEngine()) << "Could not start log writer transaction:" << db.lastError().driverText() << db.lastError().databaseText();
+    }
+
+    foreach (const LogEntry &entry, entries) {
+        query.bindValue(0, static_cast<qint64>(entry.timestamp().toTime_t()));
+        query.bindValue(1, entry.eventType());
+        query.bindValue(2, entry.level());
+        query.bindValue(3, entry.source());
+        query.bindValue(4, entry.typeId().toString());
+        query.bindValue(5, entry.deviceId().toString());
+        int valueType = LogValueTool::valueType(entry.value());
+        LogValueTool::ValueColumn valueColumn = LogValueTool::valueColumn(valueType);
+        QVariant storageValue = LogValueTool::storageValue(entry.value());
+        query.bindValue(6, valueType);
+        query.bindValue(7, valueColumn == LogValueTool::ValueColumnInteger ? storageValue : QVariant());
+        query.bindValue(8, valueColumn == LogValueTool::ValueColumnReal ? storageValue : QVariant());
+        query.bindValue(9, valueColumn == LogValueTool::ValueColumnText ? storageValue : QVariant());
+        query.bindValue(10, valueColumn == LogValueTool::ValueColumnBlob ? storageValue : QVariant());
+        query.bindValue(11, entry.active());
+        query.bindValue(12, entry.errorCode());
+        if (!query.exec()) {
+            qCWarning(dcLogEngine) << "Error writing log entry. Driver error:" << query.lastError().driverText() << "Database error:" << query.lastError().databaseText();
+            qCWarning(dcLogEngine) << entry;
+        }
+    }
+
+    if (!db.commit()) {
+        qCWarning(dcLogEngine) << "Error committing" << entries.count() << "log entries. Driver error:" << db.lastError().driverText() << "Database error:" << db.lastError().databaseText();
+        db.rollback();
+        return false;
+    }
+
+    return true;
+}
+
+}
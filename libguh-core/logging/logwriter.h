@@ -0,0 +1,75 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+
+#include "logentry.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+
+namespace guhserver {
+
+class LogWriter : public QThread
+{
+    Q_OBJECT
+public:
+    explicit LogWriter(const QString &databaseName, QObject *parent = 0);
+    ~LogWriter();
+
+    int flushInterval() const;
+    void setFlushInterval(int flushInterval);
+
+    int maxBatchSize() const;
+    void setMaxBatchSize(int maxBatchSize);
+
+    void enqueue(const LogEntry &entry);
+    void flush();
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    bool writeEntries(QSqlDatabase &db, QSqlQuery &query, const QList<LogEntry> &entries);
+
+    QString m_databaseName;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_queueCondition;
+    QWaitCondition m_writtenCondition;
+    QList<LogEntry> m_queue;
+    quint64 m_enqueuedCount;
+    quint64 m_writtenCount;
+    int m_flushRequests;
+    bool m_stopping;
+
+    int m_flushInterval;
+    int m_maxBatchSize;
+};
+
+}
+
+#endif // LOGWRITER_H
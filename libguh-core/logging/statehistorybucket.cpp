@@ -0,0 +1,88 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/*!
+    \class guhserver::StateHistoryBucket
+    \brief Holds the aggregated values of a numeric state within one time bucket.
+
+    \ingroup logs
+    \inmodule core
+
+    The \l{LogEngine} aggregates the logged values of a state with SQL, so the size of a state
+    history only depends on the number of buckets and not on the number of logged samples.
+
+    \sa LogEngine::stateHistory()
+*/
+
+#include "statehistorybucket.h"
+
+namespace guhserver {
+
+/*! Constructs a bucket starting at \a timestamp which contains \a count values between \a minimum and
+    \a maximum with the given \a average. The \a last value is the most recent value in this bucket. */
+StateHistoryBucket::StateHistoryBucket(const QDateTime &timestamp, int count, double minimum, double maximum, double average, double last) :
+    m_timestamp(timestamp),
+    m_count(count),
+    m_minimum(minimum),
+    m_maximum(maximum),
+    m_average(average),
+    m_last(last)
+{
+
+}
+
+/*! Returns the start time of this bucket. */
+QDateTime StateHistoryBucket::timestamp() const
+{
+    return m_timestamp;
+}
+
+/*! Returns the number of logged values in this bucket. */
+int StateHistoryBucket::count() const
+{
+    return m_count;
+}
+
+/*! Returns the smallest value in this bucket. */
+double StateHistoryBucket::minimum() const
+{
+    return m_minimum;
+}
+
+/*! Returns the largest value in this bucket. */
+double StateHistoryBucket::maximum() const
+{
+    return m_maximum;
+}
+
+/*! Returns the average of the values in this bucket. */
+double StateHistoryBucket::average() const
+{
+    return m_average;
+}
+
+/*! Returns the most recent value in this bucket. */
+double StateHistoryBucket::last() const
+{
+    return m_last;
+}
+
+}
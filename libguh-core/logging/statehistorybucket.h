@@ -0,0 +1,52 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef STATEHISTORYBUCKET_H
+#define STATEHISTORYBUCKET_H
+
+#include <QDateTime>
+
+namespace guhserver {
+
+class StateHistoryBucket
+{
+public:
+    StateHistoryBucket(const QDateTime &timestamp = QDateTime(), int count = 0, double minimum = 0, double maximum = 0, double average = 0, double last = 0);
+
+    QDateTime timestamp() const;
+    int count() const;
+    double minimum() const;
+    double maximum() const;
+    double average() const;
+    double last() const;
+
+private:
+    QDateTime m_timestamp;
+    int m_count;
+    double m_minimum;
+    double m_maximum;
+    double m_average;
+    double m_last;
+};
+
+}
+
+#endif // STATEHISTORYBUCKET_H
@@ -0,0 +1,453 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/*!
+    \class guhserver::TimeSeriesStore
+    \brief Stores the values of high rate numeric states in append-only segment files.
+
+    \ingroup logs
+    \inmodule core
+
+    Each state of a device gets its own directory below the path of the store, containing segment files
+    named by the timestamp of their first sample. A segment starts with the magic \tt GTS1 and the start
+    timestamp in ms, followed by the samples. Each sample is encoded relative to the previous one: the
+    timestamp delta as zigzag varint, and the value as XOR of the IEEE 754 bits of the previous value,
+    shifted by its trailing zero bits. A sample of a slowly changing state usually needs only a few bytes.
+
+    A new segment is started once a segment covers segmentDuration() seconds. Range queries memory map
+    only the segments overlapping the range, and retention drops whole segments. Since segments are bounded
+    by the start of the next one, the samples of a state are kept sorted: a sample older than the previous
+    one, i.e. after the system clock stepped back, is stored with the timestamp of the previous sample.
+
+    Appended samples are written to disk at the latest flushInterval() ms later.
+
+    \sa LogEngine
+*/
+
+#include "timeseriesstore.h"
+#include "loggingcategories.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+#define SEGMENT_MAGIC "GTS1"
+#define SEGMENT_HEADER_SIZE 12
+
+namespace guhserver {
+
+static void writeVarint(QByteArray &data, quint64 value)
+{
+    while (value >= 0x80) {
+        data.append(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    data.append(static_cast<char>(value));
+}
+
+static bool readVarint(const uchar *&data, const uchar *end, quint64 *value)
+{
+    *value = 0;
+    for (int shift = 0; data < end && shift < 64; shift += 7) {
+        uchar byte = *data++;
+        *value |= static_cast<quint64>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static quint64 zigzagEncode(qint64 value)
+{
+    return (static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63);
+}
+
+static qint64 zigzagDecode(quint64 value)
+{
+    return static_cast<qint64>(value >> 1) ^ -static_cast<qint64>(value & 1);
+}
+
+/*! Constructs a \l{TimeSeriesStore} keeping its segments in the directory \a path with the given \a parent. */
+TimeSeriesStore::TimeSeriesStore(const QString &path, QObject *parent) :
+    QObject(parent),
+    m_path(path),
+    m_segmentDuration(86400)
+{
+    QDir().mkpath(m_path);
+
+    connect(&m_flushTimer, &QTimer::timeout, this, &TimeSeriesStore::flush);
+    m_flushTimer.setInterval(500);
+    m_flushTimer.setSingleShot(true);
+}
+
+/*! Destructs the \l{TimeSeriesStore} and closes all open segments. */
+TimeSeriesStore::~TimeSeriesStore()
+{
+    qDeleteAll(m_series);
+}
+
+/*! Returns the directory of this \l{TimeSeriesStore}. */
+QString TimeSeriesStore::path() const
+{
+    return m_path;
+}
+
+/*! Returns the time in seconds a segment covers at most. The default is one day. */
+int TimeSeriesStore::segmentDuration() const
+{
+    return m_segmentDuration;
+}
+
+/*! Sets the time in seconds a segment covers at most to \a segmentDuration. Retention drops whole segments,
+    so shorter segments release expired values earlier. */
+void TimeSeriesStore::setSegmentDuration(int segmentDuration)
+{
+    m_segmentDuration = qMax(1, segmentDuration);
+}
+
+/*! Returns the maximum time in ms an appended sample waits in the write buffer. The default is 500 ms. */
+int TimeSeriesStore::flushInterval() const
+{
+    return m_flushTimer.interval();
+}
+
+/*! Sets the maximum time in ms an appended sample waits in the write buffer to \a flushInterval. */
+void TimeSeriesStore::setFlushInterval(int flushInterval)
+{
+    m_flushTimer.setInterval(qMax(0, flushInterval));
+}
+
+/*! Appends the \a value of the state with the given \a stateTypeId of the device with the given \a deviceId
+    at \a timestamp. The timestamps of a state are expected to grow, an older \a timestamp is replaced by the
+    timestamp of the previous sample. */
+void TimeSeriesStore::append(const DeviceId &deviceId, const StateTypeId &stateTypeId, const QDateTime &timestamp, double value)
+{
+    Series *series = openSeries(deviceId, stateTypeId);
+    qint64 time = qMax(timestamp.toMSecsSinceEpoch(), series->lastTimestamp);
+    if (!series->file.isOpen() || time - series->segmentStart >= static_cast<qint64>(m_segmentDuration) * 1000) {
+        if (!startSegment(series, seriesPath(deviceId, stateTypeId), time))
+            return;
+    }
+
+    quint64 valueBits;
+    std::memcpy(&valueBits, &value, sizeof(valueBits));
+    quint64 valueDelta = valueBits ^ series->lastValueBits;
+
+    QByteArray record;
+    writeVarint(record, zigzagEncode(time - series->lastTimestamp));
+    if (valueDelta == 0) {
+        record.append(static_cast<char>(64));
+    } else {
+        int trailingZeros = 0;
+        while (!(valueDelta & 1)) {
+            valueDelta >>= 1;
+            trailingZeros++;
+        }
+        record.append(static_cast<char>(trailingZeros));
+        writeVarint(record, valueDelta);
+    }
+
+    if (series->file.write(record) != record.size()) {
+        qCWarning(dcLogEngine()) << "Could not write time series sample to" << series->file.fileName() << series->file.errorString();
+        return;
+    }
+    series->lastTimestamp = time;
+    series->lastValueBits = valueBits;
+
+    if (!m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+/*! Returns the samples of the state with the given \a stateTypeId of the device with the given \a deviceId
+    from \a startDate until before \a endDate, sorted by their timestamp. */
+QList<TimeSeriesStore::Sample> TimeSeriesStore::samples(const DeviceId &deviceId, const StateTypeId &stateTypeId, const QDateTime &startDate, const QDateTime &endDate)
+{
+    QString path = seriesPath(deviceId, stateTypeId);
+    if (m_series.contains(path))
+        m_series.value(path)->file.flush();
+
+    qint64 startTimestamp = startDate.toMSecsSinceEpoch();
+    qint64 endTimestamp = endDate.toMSecsSinceEpoch();
+    qint64 segmentDuration = static_cast<qint64>(m_segmentDuration) * 1000;
+
+    QList<Sample> results;
+    QList<qint64> segmentStarts = segments(path);
+    for (int i = 0; i < segmentStarts.count(); i++) {
+        qint64 segmentStart = segmentStarts.at(i);
+        qint64 segmentEnd = segmentStart + segmentDuration;
+        if (i + 1 < segmentStarts.count())
+            segmentEnd = qMin(segmentEnd, segmentStarts.at(i + 1));
+
+        if (segmentEnd <= startTimestamp || segmentStart >= endTimestamp)
+            continue;
+
+        readSegment(QString("%1/%2.seg").arg(path).arg(segmentStart), startTimestamp, endTimestamp, &results);
+    }
+    return results;
+}
+
+/*! Returns the list of devices with stored samples. */
+QList<DeviceId> TimeSeriesStore::devices() const
+{
+    QList<DeviceId> devices;
+    foreach (const QString &deviceDir, QDir(m_path).entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        DeviceId deviceId(deviceDir);
+        if (!deviceId.isNull())
+            devices.append(deviceId);
+    }
+    return devices;
+}
+
+/*! Removes all samples of the device with the given \a deviceId. */
+void TimeSeriesStore::removeSeries(const DeviceId &deviceId)
+{
+    QString devicePath = QString("%1/%2").arg(m_path).arg(deviceId.toString().mid(1, 36));
+    foreach (const QString &path, m_series.keys()) {
+        if (path.startsWith(devicePath + "/"))
+            closeSeries(path);
+    }
+    QDir(devicePath).removeRecursively();
+}
+
+/*! Deletes all segments which only contain samples older than \a before. Returns the number of deleted segments. */
+int TimeSeriesStore::dropSegments(const QDateTime &before)
+{
+    qint64 beforeTimestamp = before.toMSecsSinceEpoch();
+    qint64 segmentDuration = static_cast<qint64>(m_segmentDuration) * 1000;
+
+    int dropped = 0;
+    QDir root(m_path);
+    foreach (const QString &deviceDir, root.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QDir device(root.filePath(deviceDir));
+        foreach (const QString &stateDir, device.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+            QString path = device.filePath(stateDir);
+            QList<qint64> segmentStarts = segments(path);
+            for (int i = 0; i < segmentStarts.count(); i++) {
+                qint64 segmentEnd = segmentStarts.at(i) + segmentDuration;
+                if (i + 1 < segmentStarts.count())
+                    segmentEnd = qMin(segmentEnd, segmentStarts.at(i + 1));
+
+                if (segmentEnd > beforeTimestamp)
+                    break;
+
+                // The open segment is always the latest one
+                if (i + 1 == segmentStarts.count())
+                    closeSeries(path);
+
+                if (QFile::remove(QString("%1/%2.seg").arg(path).arg(segmentStarts.at(i))))
+                    dropped++;
+            }
+        }
+    }
+    return dropped;
+}
+
+/*! Removes all samples of this store. */
+void TimeSeriesStore::clear()
+{
+    foreach (const QString &path, m_series.keys()) {
+        closeSeries(path);
+    }
+    QDir(m_path).removeRecursively();
+    QDir().mkpath(m_path);
+}
+
+/*! Writes the buffered samples of all open segments to disk. */
+void TimeSeriesStore::flush()
+{
+    foreach (Series *series, m_series) {
+        series->file.flush();
+    }
+}
+
+QString TimeSeriesStore::seriesPath(const DeviceId &deviceId, const StateTypeId &stateTypeId) const
+{
+    return QString("%1/%2/%3").arg(m_path).arg(deviceId.toString().mid(1, 36)).arg(stateTypeId.toString().mid(1, 36));
+}
+
+QList<qint64> TimeSeriesStore::segments(const QString &seriesPath) const
+{
+    QList<qint64> segmentStarts;
+    foreach (const QString &fileName, QDir(seriesPath).entryList(QStringList() << "*.seg", QDir::Files)) {
+        bool ok = false;
+        qint64 segmentStart = fileName.left(fileName.length() - 4).toLongLong(&ok);
+        if (ok)
+            segmentStarts.append(segmentStart);
+    }
+    std::sort(segmentStarts.begin(), segmentStarts.end());
+    return segmentStarts;
+}
+
+TimeSeriesStore::Series *TimeSeriesStore::openSeries(const DeviceId &deviceId, const StateTypeId &stateTypeId)
+{
+    QString path = seriesPath(deviceId, stateTypeId);
+    Series *series = m_series.value(path);
+    if (series)
+        return series;
+
+    series = new Series();
+    m_series.insert(path, series);
+
+    // Continue the latest segment, the samples are encoded relative to its last sample
+    QList<qint64> segmentStarts = segments(path);
+    if (!segmentStarts.isEmpty()) {
+        // New samples must not be older than the latest segment, even if it can't be continued
+        series->lastTimestamp = segmentStarts.last();
+        continueSegment(series, QString("%1/%2.seg").arg(path).arg(segmentStarts.last()), segmentStarts.last());
+    }
+    return series;
+}
+
+bool TimeSeriesStore::startSegment(Series *series, const QString &seriesPath, qint64 timestamp)
+{
+    series->file.close();
+    QDir().mkpath(seriesPath);
+
+    // Never overwrite the samples of an existing segment
+    QString fileName = QString("%1/%2.seg").arg(seriesPath).arg(timestamp);
+    if (QFile::exists(fileName)) {
+        if (continueSegment(series, fileName, timestamp))
+            return true;
+
+        qCWarning(dcLogEngine()) << "Moving unreadable time series segment" << fileName << "aside";
+        QFile::remove(fileName + ".corrupt");
+        if (!QFile::rename(fileName, fileName + ".corrupt")) {
+            qCWarning(dcLogEngine()) << "Could not move time series segment" << fileName;
+            return false;
+        }
+    }
+
+    series->file.setFileName(fileName);
+    if (!series->file.open(QIODevice::WriteOnly)) {
+        qCWarning(dcLogEngine()) << "Could not create time series segment" << series->file.fileName() << series->file.errorString();
+        return false;
+    }
+
+    QByteArray header(SEGMENT_MAGIC);
+    header.resize(SEGMENT_HEADER_SIZE);
+    qToLittleEndian<qint64>(timestamp, reinterpret_cast<uchar *>(header.data() + 4));
+    series->file.write(header);
+
+    series->segmentStart = timestamp;
+    series->lastTimestamp = timestamp;
+    series->lastValueBits = 0;
+    return true;
+}
+
+bool TimeSeriesStore::continueSegment(Series *series, const QString &fileName, qint64 segmentStart)
+{
+    // The samples are encoded relative to the last sample of the segment
+    QList<Sample> samples;
+    qint64 validSize = 0;
+    if (!readSegment(fileName, 0, 0, &samples, series, &validSize))
+        return false;
+
+    // Cut off a sample truncated by a crash, new samples would be decoded together with its bytes
+    if (validSize < QFileInfo(fileName).size()) {
+        qCWarning(dcLogEngine()) << "Discarding truncated time series sample at the end of" << fileName;
+        if (!QFile::resize(fileName, validSize)) {
+            qCWarning(dcLogEngine()) << "Could not truncate time series segment" << fileName;
+            return false;
+        }
+    }
+
+    series->segmentStart = segmentStart;
+    series->file.setFileName(fileName);
+    if (!series->file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qCWarning(dcLogEngine()) << "Could not open time series segment" << fileName << series->file.errorString();
+        return false;
+    }
+    return true;
+}
+
+void TimeSeriesStore::closeSeries(const QString &seriesPath)
+{
+    delete m_series.take(seriesPath);
+}
+
+bool TimeSeriesStore::readSegment(const QString &fileName, qint64 startTimestamp, qint64 endTimestamp, QList<Sample> *samples, Series *lastState, qint64 *validSize)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < SEGMENT_HEADER_SIZE) {
+        qCWarning(dcLogEngine()) << "Could not read time series segment" << fileName;
+        return false;
+    }
+
+    uchar *data = file.map(0, file.size());
+    if (!data) {
+        qCWarning(dcLogEngine()) << "Could not map time series segment" << fileName << file.errorString();
+        return false;
+    }
+
+    if (std::memcmp(data, SEGMENT_MAGIC, 4) != 0) {
+        qCWarning(dcLogEngine()) << "Invalid time series segment" << fileName;
+        file.unmap(data);
+        return false;
+    }
+
+    qint64 timestamp = qFromLittleEndian<qint64>(data + 4);
+    quint64 valueBits = 0;
+    const uchar *position = data + SEGMENT_HEADER_SIZE;
+    const uchar *end = data + file.size();
+    const uchar *recordEnd = position;
+    while (position < end) {
+        // A truncated sample at the end is ignored
+        quint64 timestampDelta;
+        if (!readVarint(position, end, &timestampDelta) || position >= end)
+            break;
+
+        int trailingZeros = *position++;
+        quint64 valueDelta = 0;
+        if (trailingZeros < 64) {
+            if (!readVarint(position, end, &valueDelta))
+                break;
+            valueDelta <<= trailingZeros;
+        }
+
+        recordEnd = position;
+        timestamp += zigzagDecode(timestampDelta);
+        valueBits ^= valueDelta;
+        if (timestamp >= endTimestamp && !lastState)
+            break;
+
+        if (timestamp >= startTimestamp && timestamp < endTimestamp) {
+            double value;
+            std::memcpy(&value, &valueBits, sizeof(value));
+            samples->append(Sample(timestamp, value));
+        }
+    }
+
+    if (lastState) {
+        lastState->lastTimestamp = timestamp;
+        lastState->lastValueBits = valueBits;
+    }
+
+    if (validSize)
+        *validSize = recordEnd - data;
+
+    file.unmap(data);
+    return true;
+}
+
+}
@@ -0,0 +1,88 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef TIMESERIESSTORE_H
+#define TIMESERIESSTORE_H
+
+#include "typeutils.h"
+
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QPair>
+#include <QFile>
+#include <QTimer>
+
+namespace guhserver {
+
+class TimeSeriesStore : public QObject
+{
+    Q_OBJECT
+public:
+    // Timestamp in ms since epoch, value
+    typedef QPair<qint64, double> Sample;
+
+    explicit TimeSeriesStore(const QString &path, QObject *parent = 0);
+    ~TimeSeriesStore();
+
+    QString path() const;
+
+    int segmentDuration() const;
+    void setSegmentDuration(int segmentDuration);
+
+    int flushInterval() const;
+    void setFlushInterval(int flushInterval);
+
+    void append(const DeviceId &deviceId, const StateTypeId &stateTypeId, const QDateTime &timestamp, double value);
+    QList<Sample> samples(const DeviceId &deviceId, const StateTypeId &stateTypeId, const QDateTime &startDate, const QDateTime &endDate);
+
+    QList<DeviceId> devices() const;
+    void removeSeries(const DeviceId &deviceId);
+    int dropSegments(const QDateTime &before);
+    void clear();
+    void flush();
+
+private:
+    struct Series {
+        QFile file;
+        qint64 segmentStart = 0;
+        qint64 lastTimestamp = 0;
+        quint64 lastValueBits = 0;
+    };
+
+    QString seriesPath(const DeviceId &deviceId, const StateTypeId &stateTypeId) const;
+    QList<qint64> segments(const QString &seriesPath) const;
+    Series *openSeries(const DeviceId &deviceId, const StateTypeId &stateTypeId);
+    bool startSegment(Series *series, const QString &seriesPath, qint64 timestamp);
+    bool continueSegment(Series *series, const QString &fileName, qint64 segmentStart);
+    void closeSeries(const QString &seriesPath);
+
+    static bool readSegment(const QString &fileName, qint64 startTimestamp, qint64 endTimestamp, QList<Sample> *samples, Series *lastState = 0, qint64 *validSize = 0);
+
+    QString m_path;
+    int m_segmentDuration; // seconds
+    QHash<QString, Series *> m_series; // series path -> open series
+    QTimer m_flushTimer;
+};
+
+}
+
+#endif // TIMESERIESSTORE_H
@@ -0,0 +1,126 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class guhserver::RecentStateBuffer
+    \brief Keeps the most recent values of each device state in memory.
+
+    \ingroup server
+    \inmodule core
+
+    Every state change of a device is appended to a ring buffer of that state. A ring holds up to
+    capacity() samples, and samples older than maxAge() seconds are not returned any more. Reading the
+    last values of a state, for example to draw a sparkline, therefore never touches the log database.
+
+    The buffer is only accessed from the main thread, a ring is a fixed size vector which gets
+    overwritten in place and does not need any locking.
+
+    \sa LogEngine
+*/
+
+#include "recentstatebuffer.h"
+#include "plugin/device.h"
+
+namespace guhserver {
+
+/*! Constructs a new \l{RecentStateBuffer} keeping up to \a capacity samples per state, which are at
+    most \a maxAge seconds old, with the given \a parent. */
+RecentStateBuffer::RecentStateBuffer(int capacity, int maxAge, QObject *parent) :
+    QObject(parent),
+    m_capacity(qMax(1, capacity)),
+    m_maxAge(maxAge)
+{
+}
+
+/*! Returns the maximum number of samples kept for each state. */
+int RecentStateBuffer::capacity() const
+{
+    return m_capacity;
+}
+
+/*! Returns the maximum age of the returned samples in seconds. */
+int RecentStateBuffer::maxAge() const
+{
+    return m_maxAge;
+}
+
+/*! Appends the \a value of the state with the given \a stateTypeId of the device with the given
+    \a deviceId at \a timestamp. If the ring of the state is full, its oldest sample gets overwritten. */
+void RecentStateBuffer::append(const DeviceId &deviceId, const StateTypeId &stateTypeId, const QVariant &value, const QDateTime &timestamp)
+{
+    Ring &ring = m_rings[BufferKey(deviceId, stateTypeId)];
+    if (ring.samples.isEmpty())
+        ring.samples.resize(m_capacity);
+
+    ring.samples[ring.head] = Sample(timestamp.toMSecsSinceEpoch(), value);
+    ring.head = (ring.head + 1) % m_capacity;
+    ring.count = qMin(ring.count + 1, m_capacity);
+}
+
+/*! Returns the recent samples of the state with the given \a stateTypeId of the device with the given
+    \a deviceId, oldest first. If \a count is not negative, only the last \a count samples are returned.
+    If \a maxAge is not negative, only the samples of the last \a maxAge seconds are returned, but never
+    samples older than the maxAge() of the buffer.
+*/
+QList<RecentStateBuffer::Sample> RecentStateBuffer::samples(const DeviceId &deviceId, const StateTypeId &stateTypeId, int count, int maxAge) const
+{
+    QList<Sample> samples;
+    QHash<BufferKey, Ring>::const_iterator it = m_rings.constFind(BufferKey(deviceId, stateTypeId));
+    if (it == m_rings.constEnd())
+        return samples;
+
+    const Ring &ring = it.value();
+    if (maxAge < 0 || maxAge > m_maxAge)
+        maxAge = m_maxAge;
+
+    int available = (count >= 0 ? qMin(count, ring.count) : ring.count);
+    qint64 minTimestamp = QDateTime::currentDateTime().addSecs(-maxAge).toMSecsSinceEpoch();
+
+    // Walk backwards from the newest sample until the count or the age limit is reached
+    for (int i = 1; i <= available; i++) {
+        const Sample &sample = ring.samples.at((ring.head - i + m_capacity) % m_capacity);
+        if (sample.first < minTimestamp)
+            break;
+
+        samples.prepend(sample);
+    }
+    return samples;
+}
+
+/*! Appends the new \a value of the state with the given \a stateTypeId of the given \a device. */
+void RecentStateBuffer::onDeviceStateChanged(Device *device, const QUuid &stateTypeId, const QVariant &value)
+{
+    append(device->id(), StateTypeId::fromUuid(stateTypeId), value);
+}
+
+/*! Removes the samples of all states of the device with the given \a deviceId. */
+void RecentStateBuffer::removeDevice(const DeviceId &deviceId)
+{
+    QHash<BufferKey, Ring>::iterator it = m_rings.begin();
+    while (it != m_rings.end()) {
+        if (it.key().first == deviceId) {
+            it = m_rings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+}
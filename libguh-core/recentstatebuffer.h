@@ -0,0 +1,73 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef RECENTSTATEBUFFER_H
+#define RECENTSTATEBUFFER_H
+
+#include "typeutils.h"
+
+#include <QObject>
+#include <QHash>
+#include <QPair>
+#include <QVector>
+#include <QVariant>
+#include <QDateTime>
+
+class Device;
+
+namespace guhserver {
+
+class RecentStateBuffer : public QObject
+{
+    Q_OBJECT
+public:
+    // Timestamp in ms since epoch, value
+    typedef QPair<qint64, QVariant> Sample;
+
+    explicit RecentStateBuffer(int capacity = 100, int maxAge = 600, QObject *parent = 0);
+
+    int capacity() const;
+    int maxAge() const;
+
+    void append(const DeviceId &deviceId, const StateTypeId &stateTypeId, const QVariant &value, const QDateTime &timestamp = QDateTime::currentDateTime());
+    QList<Sample> samples(const DeviceId &deviceId, const StateTypeId &stateTypeId, int count = -1, int maxAge = -1) const;
+
+public slots:
+    void onDeviceStateChanged(Device *device, const QUuid &stateTypeId, const QVariant &value);
+    void removeDevice(const DeviceId &deviceId);
+
+private:
+    typedef QPair<QUuid, QUuid> BufferKey; // (DeviceId, StateTypeId)
+
+    // A ring of capacity samples, head points to the slot of the next sample
+    struct Ring {
+        QVector<Sample> samples;
+        int head = 0;
+        int count = 0;
+    };
+
+    int m_capacity;
+    int m_maxAge; // seconds
+    QHash<BufferKey, Ring> m_rings; // (DeviceId, StateTypeId) -> recent samples
+};
+
+}
+
+#endif // RECENTSTATEBUFFER_H
@@ -115,8 +115,6 @@ HttpReply *DevicesResource::proccessRequest(const HttpRequest &request, const QS
 
 HttpReply *DevicesResource::proccessGetRequest(const HttpRequest &request, const QStringList &urlTokens)
 {
-    Q_UNUSED(request)
-
     // GET /api/v1/devices
     if (urlTokens.count() == 3)
         return getConfiguredDevices();
@@ -141,6 +139,11 @@ HttpReply *DevicesResource::proccessGetRequest(const HttpRequest &request, const
             qCWarning(dcRest) << "This device has no StateTypeId:" << urlTokens.at(5);
              return createDeviceErrorReply(HttpReply::NotFound, DeviceManager::DeviceErrorStateTypeNotFound);
         }
+
+        // GET /api/v1/devices/{deviceId}/states/{stateTypeId}/recent?count=...&maxAge=...
+        if (urlTokens.count() == 7 && urlTokens.at(6) == "recent")
+            return getDeviceRecentStateValues(m_device, stateTypeId, request.urlQuery());
+
         return getDeviceStateValue(m_device, stateTypeId);
     }
     return createErrorReply(HttpReply::NotImplemented);
@@ -275,6 +278,44 @@ HttpReply *DevicesResource::getDeviceStateValue(Device *device, const StateTypeI
     return reply;
 }
 
+HttpReply *DevicesResource::getDeviceRecentStateValues(Device *device, const StateTypeId &stateTypeId, const QUrlQuery &query) const
+{
+    qCDebug(dcRest) << "Get recent values of state with id:" << stateTypeId.toString();
+
+    int count = -1;
+    if (query.hasQueryItem("count")) {
+        bool ok = false;
+        count = query.queryItemValue("count").toInt(&ok);
+        if (!ok || count < 0) {
+            qCWarning(dcRest) << "Invalid count:" << query.queryItemValue("count");
+            return createDeviceErrorReply(HttpReply::BadRequest, DeviceManager::DeviceErrorInvalidParameter);
+        }
+    }
+
+    int maxAge = -1;
+    if (query.hasQueryItem("maxAge")) {
+        bool ok = false;
+        maxAge = query.queryItemValue("maxAge").toInt(&ok);
+        if (!ok || maxAge < 0) {
+            qCWarning(dcRest) << "Invalid maxAge:" << query.queryItemValue("maxAge");
+            return createDeviceErrorReply(HttpReply::BadRequest, DeviceManager::DeviceErrorInvalidParameter);
+        }
+    }
+
+    QVariantList values;
+    foreach (const RecentStateBuffer::Sample &sample, GuhCore::instance()->recentStateBuffer()->samples(device->id(), stateTypeId, count, maxAge)) {
+        QVariantMap value;
+        value.insert("timestamp", sample.first);
+        value.insert("value", sample.second);
+        values.append(value);
+    }
+
+    HttpReply *reply = createSuccessReply();
+    reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
+    reply->setPayload(QJsonDocument::fromVariant(values).toJson());
+    return reply;
+}
+
 HttpReply *DevicesResource::removeDevice(Device *device, const QVariantMap &params) const
 {
     qCDebug(dcRest) << "Remove device with id:" << device->id().toString();
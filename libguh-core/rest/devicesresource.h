@@ -23,6 +23,7 @@
 
 #include <QObject>
 #include <QHash>
+#include <QUrlQuery>
 
 #include "jsontypes.h"
 #include "restresource.h"
@@ -62,6 +63,7 @@ private:
     HttpReply *getConfiguredDevice(Device *device) const;
     HttpReply *getDeviceStateValues(Device *device) const;
     HttpReply *getDeviceStateValue(Device *device, const StateTypeId &stateTypeId) const;
+    HttpReply *getDeviceRecentStateValues(Device *device, const StateTypeId &stateTypeId, const QUrlQuery &query) const;
 
     // Delete methods
     HttpReply *removeDevice(Device *device, const QVariantMap &params) const;
@@ -93,6 +93,11 @@ HttpReply *LogsResource::proccessGetRequest(const HttpRequest &request, const QS
         }
         return getLogEntries(filterString);
     }
+
+    // GET /api/v1/logs/statehistory?deviceId={deviceId}&stateTypeId={stateTypeId}&startDate={startDate}&endDate={endDate}&bucketSize={bucketSize}
+    if (urlTokens.count() == 4 && urlTokens.at(3) == "statehistory")
+        return getStateHistory(request.urlQuery());
+
     return createErrorReply(HttpReply::NotImplemented);}
 
 HttpReply *LogsResource::getLogEntries(const QString &filterString)
@@ -106,14 +111,86 @@ HttpReply *LogsResource::getLogEntries(const QString &filterString)
     QVariantMap filterMap = verification.second.toMap();
 
     LogFilter filter = JsonTypes::unpackLogFilter(filterMap);
+    if (!filter.isValid())
+        return createErrorReply(HttpReply::BadRequest);
+
+    // Stream the entries page by page instead of building the whole list in memory
+    LogEngine *logEngine = GuhCore::instance()->logEngine();
+    LogFilter pageFilter = filter;
+    int remaining = filter.limit();
+    bool started = false;
+    bool finished = false;
+
+    HttpReply *reply = createSuccessReply();
+    reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
+    reply->setChunkProvider([=]() mutable -> QByteArray {
+        if (finished)
+            return QByteArray();
+
+        QByteArray chunk;
+        if (!started)
+            chunk.append('[');
+
+        QString nextCursor;
+        int pageSize = remaining < 0 ? 100 : qMin(remaining, 100);
+        if (pageSize > 0) {
+            pageFilter.setLimit(pageSize);
+            QList<LogEntry> entries = logEngine->logEntries(pageFilter, &nextCursor);
+            foreach (const LogEntry &entry, entries) {
+                if (started)
+                    chunk.append(',');
+
+                chunk.append(QJsonDocument::fromVariant(JsonTypes::packLogEntry(entry)).toJson(QJsonDocument::Compact));
+                started = true;
+            }
+            if (remaining > 0)
+                remaining -= entries.count();
+        }
+        started = true;
+
+        if (nextCursor.isEmpty() || remaining == 0) {
+            chunk.append(']');
+            finished = true;
+        } else {
+            // the offset only applies to the first page
+            pageFilter.setCursor(nextCursor);
+            pageFilter.setOffset(0);
+        }
+        return chunk;
+    });
+    return reply;
+}
+
+HttpReply *LogsResource::getStateHistory(const QUrlQuery &query)
+{
+    qCDebug(dcRest) << "Get state history";
+
+    DeviceId deviceId(query.queryItemValue("deviceId"));
+    StateTypeId stateTypeId(query.queryItemValue("stateTypeId"));
+
+    bool startValid = false;
+    bool endValid = true;
+    bool bucketSizeValid = false;
+    QDateTime startDate = QDateTime::fromTime_t(query.queryItemValue("startDate").toUInt(&startValid));
+    QDateTime endDate = QDateTime::currentDateTime().addSecs(1);
+    if (query.hasQueryItem("endDate"))
+        endDate = QDateTime::fromTime_t(query.queryItemValue("endDate").toUInt(&endValid));
+
+    int bucketSize = query.queryItemValue("bucketSize").toInt(&bucketSizeValid);
+    if (!startValid || !endValid || !bucketSizeValid)
+        return createErrorReply(HttpReply::BadRequest);
+
+    QList<StateHistoryBucket> buckets;
+    if (GuhCore::instance()->logEngine()->stateHistory(deviceId, stateTypeId, startDate, endDate, bucketSize, &buckets) != Logging::LoggingErrorNoError)
+        return createErrorReply(HttpReply::BadRequest);
 
-    QVariantList entries;
-    foreach (const LogEntry &entry, GuhCore::instance()->logEngine()->logEntries(filter)) {
-        entries.append(JsonTypes::packLogEntry(entry));
+    QVariantList stateHistory;
+    foreach (const StateHistoryBucket &bucket, buckets) {
+        stateHistory.append(JsonTypes::packStateHistoryBucket(bucket));
     }
     HttpReply *reply = createSuccessReply();
     reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
-    reply->setPayload(QJsonDocument::fromVariant(entries).toJson());
+    reply->setPayload(QJsonDocument::fromVariant(stateHistory).toJson());
     return reply;
 }
 
@@ -23,6 +23,7 @@
 
 #include <QObject>
 #include <QHash>
+#include <QUrlQuery>
 
 #include "jsontypes.h"
 #include "restresource.h"
@@ -48,6 +49,7 @@ private:
 
     // Get methods
     HttpReply *getLogEntries(const QString &filterString);
+    HttpReply *getStateHistory(const QUrlQuery &query);
 
 
 };
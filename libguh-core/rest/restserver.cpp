@@ -143,7 +143,10 @@ void RestServer::processHttpRequest(const QUuid &clientId, const HttpRequest &re
         return;
     }
     m_webserver->sendHttpReply(reply);
-    reply->deleteLater();
+
+    // the web server owns chunked replies and deletes them once streamed or dropped
+    if (reply->type() != HttpReply::TypeChunked)
+        reply->deleteLater();
 }
 
 void RestServer::asyncReplyFinished()
@@ -32,6 +32,10 @@
         http://localhost:3333/api/v1/rules
     \endcode
 
+    The evaluation statistics of the rules are available at \tt {/api/v1/rules/statistics} and
+    \tt {/api/v1/rules/{ruleId}/statistics}. A DELETE request resets them, a PUT request with
+    a boolean \tt enabled property on \tt {/api/v1/rules/statistics} enables or disables the collection.
+
     \sa Rule, RestResource, RestServer
 */
 
@@ -47,7 +51,8 @@ namespace guhserver {
 
 /*! Constructs a \l RulesResource with the given \a parent. */
 RulesResource::RulesResource(QObject *parent) :
-    RestResource(parent)
+    RestResource(parent),
+    m_statisticsRequest(false)
 {
 }
 
@@ -67,8 +72,13 @@ QString RulesResource::name() const
 */
 HttpReply *RulesResource::proccessRequest(const HttpRequest &request, const QStringList &urlTokens)
 {
+    // /api/v1/rules/statistics and /api/v1/rules/{ruleId}/statistics
+    m_statisticsRequest = (urlTokens.count() == 4 && urlTokens.at(3) == "statistics")
+            || (urlTokens.count() == 5 && urlTokens.at(4) == "statistics");
+
     // /api/v1/rules/{ruleId}/
-    if (urlTokens.count() >= 4) {
+    m_ruleId = RuleId();
+    if (urlTokens.count() >= 4 && urlTokens.at(3) != "statistics") {
         m_ruleId = RuleId(urlTokens.at(3));
         if (m_ruleId.isNull()) {
             qCWarning(dcRest) << "Could not parse RuleId:" << urlTokens.at(3);
@@ -111,6 +121,10 @@ HttpReply *RulesResource::proccessGetRequest(const HttpRequest &request, const Q
 {
     Q_UNUSED(request)
 
+    // GET /api/v1/rules/statistics or /api/v1/rules/{ruleId}/statistics
+    if (m_statisticsRequest)
+        return getStatistics(m_ruleId);
+
     // GET /api/v1/rules
     if (urlTokens.count() == 3) {
         // check if we should filter for rules containing a certain device
@@ -132,11 +146,13 @@ HttpReply *RulesResource::proccessGetRequest(const HttpRequest &request, const Q
 
 HttpReply *RulesResource::proccessDeleteRequest(const HttpRequest &request, const QStringList &urlTokens)
 {
-    Q_UNUSED(request)
+    // DELETE /api/v1/rules/statistics or /api/v1/rules/{ruleId}/statistics
+    if (m_statisticsRequest)
+        return resetStatistics(m_ruleId);
 
-    // DELETE /api/v1/rules
+    // DELETE /api/v1/rules with a list of ruleIds as payload
     if (urlTokens.count() == 3)
-        return createErrorReply(HttpReply::BadRequest);
+        return removeRules(request.payload());
 
     // DELETE /api/v1/rules/{ruleId}
     if (urlTokens.count() == 4)
@@ -147,6 +163,10 @@ HttpReply *RulesResource::proccessDeleteRequest(const HttpRequest &request, cons
 
 HttpReply *RulesResource::proccessPutRequest(const HttpRequest &request, const QStringList &urlTokens)
 {
+    // PUT /api/v1/rules/statistics
+    if (m_statisticsRequest && m_ruleId.isNull())
+        return setStatisticsEnabled(request.payload());
+
     // PUT /api/v1/rules
     if (urlTokens.count() == 3)
         return createErrorReply(HttpReply::BadRequest);
@@ -225,6 +245,32 @@ HttpReply *RulesResource::getRuleDetails(const RuleId &ruleId) const
     return reply;
 }
 
+HttpReply *RulesResource::getStatistics(const RuleId &ruleId) const
+{
+    RuleEngine *ruleEngine = GuhCore::instance()->ruleEngine();
+
+    QVariant returns;
+    if (ruleId.isNull()) {
+        qCDebug(dcRest) << "Get rule statistics";
+        QVariantList ruleStatisticsList;
+        foreach (const RuleStatistics &statistics, ruleEngine->ruleStatistics()) {
+            ruleStatisticsList.append(JsonTypes::packRuleStatistics(statistics));
+        }
+        QVariantMap statisticsMap;
+        statisticsMap.insert("statisticsEnabled", ruleEngine->statisticsEnabled());
+        statisticsMap.insert("ruleStatistics", ruleStatisticsList);
+        returns = statisticsMap;
+    } else {
+        qCDebug(dcRest) << "Get statistics of rule with id" << ruleId.toString();
+        returns = JsonTypes::packRuleStatistics(ruleEngine->ruleStatistics(ruleId));
+    }
+
+    HttpReply *reply = createSuccessReply();
+    reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
+    reply->setPayload(QJsonDocument::fromVariant(returns).toJson());
+    return reply;
+}
+
 HttpReply *RulesResource::removeRule(const RuleId &ruleId) const
 {
     qCDebug(dcRest) << "Remove rule with id" << ruleId.toString();
@@ -236,6 +282,38 @@ HttpReply *RulesResource::removeRule(const RuleId &ruleId) const
     return createRuleErrorReply(HttpReply::Ok, status);
 }
 
+HttpReply *RulesResource::removeRules(const QByteArray &payload) const
+{
+    QPair<bool, QVariant> verification = RestResource::verifyPayload(payload);
+    if (!verification.first || verification.second.type() != QVariant::List)
+        return createErrorReply(HttpReply::BadRequest);
+
+    QList<RuleId> ruleIds;
+    foreach (const QVariant &ruleId, verification.second.toList()) {
+        ruleIds.append(RuleId(ruleId.toString()));
+    }
+
+    qCDebug(dcRest) << "Remove" << ruleIds.count() << "rules";
+
+    int failedIndex = -1;
+    RuleEngine::RuleError status = GuhCore::instance()->removeRules(ruleIds, &failedIndex);
+    if (status != RuleEngine::RuleErrorNoError)
+        return createBatchErrorReply(status, failedIndex);
+
+    return createRuleErrorReply(HttpReply::Ok, status);
+}
+
+HttpReply *RulesResource::resetStatistics(const RuleId &ruleId) const
+{
+    qCDebug(dcRest) << "Reset rule statistics" << (ruleId.isNull() ? QString() : ruleId.toString());
+
+    RuleEngine::RuleError status = GuhCore::instance()->ruleEngine()->resetStatistics(ruleId);
+    if (status != RuleEngine::RuleErrorNoError)
+        return createRuleErrorReply(HttpReply::NotFound, status);
+
+    return createRuleErrorReply(HttpReply::Ok, status);
+}
+
 HttpReply *RulesResource::addRule(const QByteArray &payload) const
 {
     qCDebug(dcRest) << "Add new rule";
@@ -244,6 +322,10 @@ HttpReply *RulesResource::addRule(const QByteArray &payload) const
     if (!verification.first)
         return createErrorReply(HttpReply::BadRequest);
 
+    // A list of rules will be added as one batch
+    if (verification.second.type() == QVariant::List)
+        return addRules(verification.second.toList());
+
     QVariantMap params = verification.second.toMap();
     Rule rule = JsonTypes::unpackRule(params);
     rule.setId(RuleId::createRuleId());
@@ -260,6 +342,32 @@ HttpReply *RulesResource::addRule(const QByteArray &payload) const
     return createRuleErrorReply(HttpReply::BadRequest, status);
 }
 
+HttpReply *RulesResource::addRules(const QVariantList &ruleList) const
+{
+    qCDebug(dcRest) << "Add" << ruleList.count() << "new rules";
+
+    QList<Rule> rules;
+    foreach (const QVariant &ruleVariant, ruleList) {
+        Rule rule = JsonTypes::unpackRule(ruleVariant.toMap());
+        rule.setId(RuleId::createRuleId());
+        rules.append(rule);
+    }
+
+    int failedIndex = -1;
+    RuleEngine::RuleError status = GuhCore::instance()->ruleEngine()->addRules(rules, &failedIndex);
+    if (status != RuleEngine::RuleErrorNoError)
+        return createBatchErrorReply(status, failedIndex);
+
+    QVariantList returns;
+    foreach (const Rule &rule, rules) {
+        returns.append(JsonTypes::packRule(GuhCore::instance()->ruleEngine()->findRule(rule.id())));
+    }
+    HttpReply *reply = createSuccessReply();
+    reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
+    reply->setPayload(QJsonDocument::fromVariant(returns).toJson());
+    return reply;
+}
+
 HttpReply *RulesResource::enableRule(const RuleId &ruleId) const
 {
     qCDebug(dcRest) << "Enable rule with id" << ruleId.toString();
@@ -325,5 +433,32 @@ HttpReply *RulesResource::editRule(const RuleId &ruleId, const QByteArray &paylo
     return createRuleErrorReply(HttpReply::BadRequest, status);
 }
 
+HttpReply *RulesResource::setStatisticsEnabled(const QByteArray &payload) const
+{
+    QPair<bool, QVariant> verification = RestResource::verifyPayload(payload);
+    if (!verification.first)
+        return createErrorReply(HttpReply::BadRequest);
+
+    QVariantMap params = verification.second.toMap();
+    if (!params.contains("enabled"))
+        return createErrorReply(HttpReply::BadRequest);
+
+    qCDebug(dcRest) << "Set rule statistics enabled" << params.value("enabled").toBool();
+    GuhCore::instance()->ruleEngine()->setStatisticsEnabled(params.value("enabled").toBool());
+    return createRuleErrorReply(HttpReply::Ok, RuleEngine::RuleErrorNoError);
 }
 
+HttpReply *RulesResource::createBatchErrorReply(const RuleEngine::RuleError &ruleError, int failedIndex) const
+{
+    QVariantMap response;
+    response.insert("error", JsonTypes::ruleErrorToString(ruleError));
+    if (failedIndex >= 0)
+        response.insert("failedIndex", failedIndex);
+
+    HttpReply *reply = createErrorReply(HttpReply::BadRequest);
+    reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
+    reply->setPayload(QJsonDocument::fromVariant(response).toJson());
+    return reply;
+}
+
+}
@@ -45,6 +45,7 @@ public:
 
 private:
     RuleId m_ruleId;
+    bool m_statisticsRequest;
 
     // Process method
     HttpReply *proccessGetRequest(const HttpRequest &request, const QStringList &urlTokens) override;
@@ -56,12 +57,16 @@ private:
     // Get methods
     HttpReply *getRules(const DeviceId &deviceId) const;
     HttpReply *getRuleDetails(const RuleId &ruleId) const;
+    HttpReply *getStatistics(const RuleId &ruleId) const;
 
     // Delete methods
     HttpReply *removeRule(const RuleId &ruleId) const;
+    HttpReply *removeRules(const QByteArray &payload) const;
+    HttpReply *resetStatistics(const RuleId &ruleId) const;
 
     // Post methods
     HttpReply *addRule(const QByteArray &payload) const;
+    HttpReply *addRules(const QVariantList &ruleList) const;
     HttpReply *enableRule(const RuleId &ruleId) const;
     HttpReply *disableRule(const RuleId &ruleId) const;
     HttpReply *executeActions(const RuleId &ruleId) const;
@@ -70,7 +75,9 @@ private:
 
     // Put methods
     HttpReply *editRule(const RuleId &ruleId, const QByteArray &payload) const;
+    HttpReply *setStatisticsEnabled(const QByteArray &payload) const;
 
+    HttpReply *createBatchErrorReply(const RuleEngine::RuleError &ruleError, int failedIndex) const;
 };
 
 }
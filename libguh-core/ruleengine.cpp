@@ -41,6 +41,13 @@
     \a ruleId holds the id of the removed rule. You should remove any references
     or copies you hold for this rule.*/
 
+/*! \fn void guhserver::RuleEngine::rulesAdded(const QList<Rule> &rules)
+    Will be emitted whenever a batch of \a rules is added to this Engine.*/
+
+/*! \fn void guhserver::RuleEngine::rulesRemoved(const QList<RuleId> &ruleIds)
+    Will be emitted whenever a batch of \l{Rule}{Rules} is removed from this Engine.
+    \a ruleIds holds the ids of the removed rules.*/
+
 /*! \fn void guhserver::RuleEngine::ruleConfigurationChanged(const Rule &rule)
     Will be emitted whenever a \l{Rule} changed his enable/disable status.
     The parameter \a rule holds the changed rule.*/
@@ -99,6 +106,8 @@
 
 
 #include "ruleengine.h"
+#include "sqlrulestorage.h"
+#include "settingsrulestorage.h"
 #include "guhcore.h"
 #include "loggingcategories.h"
 #include "time/calendaritem.h"
@@ -114,7 +123,9 @@
 #include <QDebug>
 #include <QStringList>
 #include <QStandardPaths>
+#include <QSet>
 #include <QCoreApplication>
+#include <QFile>
 
 namespace guhserver {
 
@@ -122,200 +133,33 @@ namespace guhserver {
     instance available from \l{GuhCore}. This one should be used instead of creating multiple ones.
  */
 RuleEngine::RuleEngine(QObject *parent) :
-    QObject(parent)
+    QObject(parent),
+    m_statisticsEnabled(false),
+    m_typeIndexValid(false)
 {
-    GuhSettings settings(GuhSettings::SettingsRoleRules);
-    qCDebug(dcRuleEngine) << "Loading rules from" << settings.fileName();
-    foreach (const QString &idString, settings.childGroups()) {
-        settings.beginGroup(idString);
-
-        QString name = settings.value("name", idString).toString();
-        bool enabled = settings.value("enabled", true).toBool();
-        bool executable = settings.value("executable", true).toBool();
-
-        qCDebug(dcRuleEngine) << "Loading rule" << name << idString;
-
-        // Load timeDescriptor
-        TimeDescriptor timeDescriptor;
-        QList<CalendarItem> calendarItems;
-        QList<TimeEventItem> timeEventItems;
-
-        settings.beginGroup("timeDescriptor");
-
-        settings.beginGroup("calendarItems");
-        foreach (const QString &childGroup, settings.childGroups()) {
-            settings.beginGroup(childGroup);
-
-            CalendarItem calendarItem;
-            calendarItem.setDateTime(QDateTime::fromTime_t(settings.value("dateTime", 0).toUInt()));
-            calendarItem.setStartTime(QTime::fromString(settings.value("startTime").toString()));
-            calendarItem.setDuration(settings.value("duration", 0).toUInt());
-
-            QList<int> weekDays;
-            QList<int> monthDays;
-            RepeatingOption::RepeatingMode mode = (RepeatingOption::RepeatingMode)settings.value("mode", 0).toInt();
-
-            // Load weekDays
-            int weekDaysCount = settings.beginReadArray("weekDays");
-            for (int i = 0; i < weekDaysCount; ++i) {
-                settings.setArrayIndex(i);
-                weekDays.append(settings.value("weekDay", 0).toInt());
-            }
-            settings.endArray();
-
-            // Load weekDays
-            int monthDaysCount = settings.beginReadArray("monthDays");
-            for (int i = 0; i < monthDaysCount; ++i) {
-                settings.setArrayIndex(i);
-                monthDays.append(settings.value("monthDay", 0).toInt());
-            }
-            settings.endArray();
-
-            settings.endGroup();
-
-            calendarItem.setRepeatingOption(RepeatingOption(mode, weekDays, monthDays));
-            calendarItems.append(calendarItem);
-        }
-        settings.endGroup();
-
-        timeDescriptor.setCalendarItems(calendarItems);
-
-        settings.beginGroup("timeEventItems");
-        foreach (const QString &childGroup, settings.childGroups()) {
-            settings.beginGroup(childGroup);
-
-            TimeEventItem timeEventItem;
-            timeEventItem.setDateTime(settings.value("dateTime", 0).toUInt());
-            timeEventItem.setTime(QTime::fromString(settings.value("time").toString()));
-
-            QList<int> weekDays;
-            QList<int> monthDays;
-            RepeatingOption::RepeatingMode mode = (RepeatingOption::RepeatingMode)settings.value("mode", 0).toInt();
-
-            // Load weekDays
-            int weekDaysCount = settings.beginReadArray("weekDays");
-            for (int i = 0; i < weekDaysCount; ++i) {
-                settings.setArrayIndex(i);
-                weekDays.append(settings.value("weekDay", 0).toInt());
-            }
-            settings.endArray();
-
-            // Load weekDays
-            int monthDaysCount = settings.beginReadArray("monthDays");
-            for (int i = 0; i < monthDaysCount; ++i) {
-                settings.setArrayIndex(i);
-                monthDays.append(settings.value("monthDay", 0).toInt());
-            }
-            settings.endArray();
-
-            settings.endGroup();
-
-            timeEventItem.setRepeatingOption(RepeatingOption(mode, weekDays, monthDays));
-            timeEventItems.append(timeEventItem);
-        }
-        settings.endGroup();
-
-        settings.endGroup();
-
-        timeDescriptor.setTimeEventItems(timeEventItems);
-
-        // Load events
-        QList<EventDescriptor> eventDescriptorList;
-        settings.beginGroup("events");
-        foreach (QString eventGroupName, settings.childGroups()) {
-            if (eventGroupName.startsWith("EventDescriptor-")) {
-                settings.beginGroup(eventGroupName);
-                EventTypeId eventTypeId(settings.value("eventTypeId").toString());
-                DeviceId deviceId(settings.value("deviceId").toString());
-
-                QList<ParamDescriptor> params;
-                foreach (QString groupName, settings.childGroups()) {
-                    if (groupName.startsWith("ParamDescriptor-")) {
-                        settings.beginGroup(groupName);
-                        ParamDescriptor paramDescriptor(ParamTypeId(groupName.remove(QRegExp("^ParamDescriptor-"))), settings.value("value"));
-                        paramDescriptor.setOperatorType((Types::ValueOperator)settings.value("operator").toInt());
-                        params.append(paramDescriptor);
-                        settings.endGroup();
-                    }
-                }
-
-                EventDescriptor eventDescriptor(eventTypeId, deviceId, params);
-                eventDescriptorList.append(eventDescriptor);
-                settings.endGroup();
-            }
-        }
-        settings.endGroup();
-
-
-        // Load stateEvaluator
-        StateEvaluator stateEvaluator = StateEvaluator::loadFromSettings(settings, "stateEvaluator");
-
-        // Load actions
-        QList<RuleAction> actions;
-        settings.beginGroup("ruleActions");
-        foreach (const QString &actionNumber, settings.childGroups()) {
-            settings.beginGroup(actionNumber);
-
-            RuleAction action = RuleAction(ActionTypeId(settings.value("actionTypeId").toString()),
-                                           DeviceId(settings.value("deviceId").toString()));
-
-            RuleActionParamList params;
-            foreach (QString paramTypeIdString, settings.childGroups()) {
-                if (paramTypeIdString.startsWith("RuleActionParam-")) {
-                    settings.beginGroup(paramTypeIdString);
-                    RuleActionParam param(ParamTypeId(paramTypeIdString.remove(QRegExp("^RuleActionParam-"))),
-                                          settings.value("value",QVariant()),
-                                          EventTypeId(settings.value("eventTypeId", EventTypeId()).toString()),
-                                          settings.value("eventParamTypeId", ParamTypeId()).toString());
-                    params.append(param);
-                    settings.endGroup();
-                }
-            }
-
-            action.setRuleActionParams(params);
-            actions.append(action);
+    m_statisticsTimer.start();
+
+    // Keep the compiled state evaluators in sync with the configured devices
+    DeviceManager *deviceManager = GuhCore::instance()->deviceManager();
+    connect(deviceManager, &DeviceManager::loaded, this, &RuleEngine::onDevicesLoaded);
+    connect(deviceManager, &DeviceManager::deviceAdded, this, &RuleEngine::onDeviceChanged);
+    connect(deviceManager, &DeviceManager::deviceChanged, this, &RuleEngine::onDeviceChanged);
+    connect(deviceManager, &DeviceManager::deviceRemoved, this, &RuleEngine::onDeviceRemoved);
+
+    // Prefer the rule database, the settings file is only a fallback
+    SqlRuleStorage *ruleStorage = new SqlRuleStorage(GuhSettings::settingsPath() + "/rules.sqlite", this);
+    if (ruleStorage->isOpen()) {
+        m_storage = ruleStorage;
+        migrateRuleSettings();
+    } else {
+        qCWarning(dcRuleEngine()) << "Could not open the rule database. Using the rule settings instead.";
+        delete ruleStorage;
+        m_storage = new SettingsRuleStorage(this);
+    }
 
-            settings.endGroup();
-        }
-        settings.endGroup();
-
-        // Load exit actions
-        QList<RuleAction> exitActions;
-        settings.beginGroup("ruleExitActions");
-        foreach (const QString &actionNumber, settings.childGroups()) {
-            settings.beginGroup(actionNumber);
-
-            RuleAction action = RuleAction(ActionTypeId(settings.value("actionTypeId").toString()),
-                                           DeviceId(settings.value("deviceId").toString()));
-
-            RuleActionParamList params;
-            foreach (QString paramTypeIdString, settings.childGroups()) {
-                if (paramTypeIdString.startsWith("RuleActionParam-")) {
-                    settings.beginGroup(paramTypeIdString);
-                    RuleActionParam param(ParamTypeId(paramTypeIdString.remove(QRegExp("^RuleActionParam-"))),
-                                          settings.value("value"));
-                    params.append(param);
-                    settings.endGroup();
-                }
-            }
-            action.setRuleActionParams(params);
-            exitActions.append(action);
-            settings.endGroup();
-        }
-        settings.endGroup();
-
-        Rule rule;
-        rule.setId(RuleId(idString));
-        rule.setName(name);
-        rule.setTimeDescriptor(timeDescriptor);
-        rule.setEventDescriptors(eventDescriptorList);
-        rule.setStateEvaluator(stateEvaluator);
-        rule.setActions(actions);
-        rule.setExitActions(exitActions);
-        rule.setEnabled(enabled);
-        rule.setExecutable(executable);
+    qCDebug(dcRuleEngine) << "Loading rules from" << m_storage->name();
+    foreach (const Rule &rule, m_storage->loadRules()) {
         appendRule(rule);
-        settings.endGroup();
     }
 }
 
@@ -337,44 +181,47 @@ QList<Rule> RuleEngine::evaluateEvent(const Event &event)
 
     qCDebug(dcRuleEngineDebug) << "Evaluate event:" << event << device->name() << event.eventTypeId();
 
+    // Only look at the rules which depend on this event or state, and the ones waiting for a check
+    QList<int> stateRuleSlots = m_stateIndex.value(IndexKey(event.deviceId(), event.eventTypeId()));
+    QList<int> candidates = m_eventIndex.value(IndexKey(event.deviceId(), event.eventTypeId()));
+    foreach (int slot, stateRuleSlots + m_pendingRules) {
+        if (!candidates.contains(slot)) {
+            candidates.append(slot);
+        }
+    }
+    m_pendingRules.clear();
+
     QList<Rule> rules;
-    foreach (const RuleId &id, ruleIds()) {
-        Rule rule = m_rules.value(id);
-        if (!rule.enabled())
+    foreach (int slot, candidates) {
+        if (!m_enabledRules.testBit(slot))
             continue;
 
+        qint64 startTime = m_statisticsEnabled ? m_statisticsTimer.nsecsElapsed() : 0;
+        bool matched = false;
+
         // If we have a state based on this event
-        if (containsState(rule.stateEvaluator(), event)) {
-            rule.setStatesActive(rule.stateEvaluator().evaluate());
-            m_rules[rule.id()] = rule;
+        if (stateRuleSlots.contains(slot)) {
+            m_statesActiveRules.setBit(slot, m_stateEvaluators[slot].updateState(event.deviceId(), StateTypeId::fromUuid(event.eventTypeId())));
         }
 
         // If this rule does not base on an event, evaluate the rule
-        if (rule.eventDescriptors().isEmpty() && rule.timeDescriptor().timeEventItems().isEmpty()) {
-            if (rule.timeActive() && rule.statesActive()) {
-                if (!m_activeRules.contains(rule.id())) {
-                    qCDebug(dcRuleEngine) << "Rule" << rule.id().toString() << "active.";
-                    rule.setActive(true);
-                    m_rules[rule.id()] = rule;
-                    m_activeRules.append(rule.id());
-                    rules.append(rule);
-                }
-            } else {
-                if (m_activeRules.contains(rule.id())) {
-                    qCDebug(dcRuleEngine) << "Rule" << rule.id().toString() << "inactive.";
-                    rule.setActive(false);
-                    m_rules[rule.id()] = rule;
-                    m_activeRules.removeAll(rule.id());
-                    rules.append(rule);
-                }
-            }
+        if (m_stateBasedRules.testBit(slot)) {
+            matched = updateActiveState(slot);
         } else {
             // Event based rule
-            if (containsEvent(rule, event) && rule.statesActive() && rule.timeActive()) {
+            const Rule &rule = m_ruleDefinitions.at(slot);
+            if (containsEvent(rule, event) && m_statesActiveRules.testBit(slot) && m_timeActiveRules.testBit(slot)) {
                 qCDebug(dcRuleEngine) << "Rule" << rule.id() << "contains event" << event.eventId() << "and all states match.";
-                rules.append(rule);
+                matched = true;
             }
         }
+
+        if (m_statisticsEnabled)
+            recordEvaluation(slot, startTime, matched, QDateTime());
+
+        if (matched) {
+            rules.append(ruleAt(slot));
+        }
     }
 
     return rules;
@@ -393,53 +240,70 @@ QList<Rule> RuleEngine::evaluateTime(const QDateTime &dateTime)
         m_lastEvaluationTime = m_lastEvaluationTime.addSecs(-1);
     }
 
+    // If the clock went backwards or the UTC offset changed (time zone or daylight saving time),
+    // the scheduled evaluation times are not reliable any more. Evaluate all time based rules.
+    if (dateTime < m_lastEvaluationTime || dateTime.offsetFromUtc() != m_lastEvaluationTime.offsetFromUtc()) {
+        foreach (const RuleId &ruleId, m_timeDeadlines.keys()) {
+            m_pendingTimeRules.append(ruleId);
+        }
+        m_timeSchedule.clear();
+        m_timeDeadlines.clear();
+    }
+
+    // Only look at the rules which are due, and the ones waiting for an evaluation
+    QList<RuleId> dueRuleIds = m_pendingTimeRules;
+    m_pendingTimeRules.clear();
+    while (!m_timeSchedule.isEmpty() && m_timeSchedule.firstKey() <= dateTime) {
+        RuleId ruleId = m_timeSchedule.first();
+        m_timeSchedule.erase(m_timeSchedule.begin());
+        m_timeDeadlines.remove(ruleId);
+        if (!dueRuleIds.contains(ruleId)) {
+            dueRuleIds.append(ruleId);
+        }
+    }
+
     QList<Rule> rules;
 
-    foreach (const Rule &r, m_rules.values()) {
-        Rule rule = m_rules.value(r.id());
-        if (!rule.enabled())
+    foreach (const RuleId &ruleId, dueRuleIds) {
+        int slot = m_ruleSlots.value(ruleId, -1);
+        if (slot < 0 || !m_enabledRules.testBit(slot))
             continue;
 
         // If no timeDescriptor, do nothing
-        if (rule.timeDescriptor().isEmpty())
+        TimeDescriptor timeDescriptor = m_ruleDefinitions.at(slot).timeDescriptor();
+        if (timeDescriptor.isEmpty())
             continue;
 
+        qint64 startTime = m_statisticsEnabled ? m_statisticsTimer.nsecsElapsed() : 0;
+        bool matched = false;
+
+        scheduleRule(ruleId, timeDescriptor.nextEvaluationTime(dateTime));
+
         // Check if this rule is based on calendarItems
-        if (!rule.timeDescriptor().calendarItems().isEmpty()) {
-            rule.setTimeActive(rule.timeDescriptor().evaluate(m_lastEvaluationTime, dateTime));
-            m_rules[rule.id()] = rule;
-
-            if (rule.timeDescriptor().timeEventItems().isEmpty() && rule.eventDescriptors().isEmpty()) {
-
-                if (rule.timeActive() && rule.statesActive()) {
-                    if (!m_activeRules.contains(rule.id())) {
-                        qCDebug(dcRuleEngine) << "Rule" << rule.id().toString() << "active.";
-                        rule.setActive(true);
-                        m_rules[rule.id()] = rule;
-                        m_activeRules.append(rule.id());
-                        rules.append(rule);
-                    }
-                } else {
-                    if (m_activeRules.contains(rule.id())) {
-                        qCDebug(dcRuleEngine) << "Rule" << rule.id().toString() << "inactive.";
-                        rule.setActive(false);
-                        m_rules[rule.id()] = rule;
-                        m_activeRules.removeAll(rule.id());
-                        rules.append(rule);
-                    }
-                }
+        if (!timeDescriptor.calendarItems().isEmpty()) {
+            m_timeActiveRules.setBit(slot, timeDescriptor.evaluate(m_lastEvaluationTime, dateTime));
+
+            if (m_stateBasedRules.testBit(slot) && updateActiveState(slot)) {
+                matched = true;
             }
         }
 
 
         // If we have timeEvent items
-        if (!rule.timeDescriptor().timeEventItems().isEmpty()) {
-            bool valid = rule.timeDescriptor().evaluate(m_lastEvaluationTime, dateTime);
-            if (valid && rule.statesActive() && rule.timeActive()) {
-                qCDebug(dcRuleEngine) << "Rule" << rule.id() << "time event triggert and all states match.";
-                rules.append(rule);
+        if (!timeDescriptor.timeEventItems().isEmpty()) {
+            bool valid = timeDescriptor.evaluate(m_lastEvaluationTime, dateTime);
+            if (valid && m_statesActiveRules.testBit(slot) && m_timeActiveRules.testBit(slot)) {
+                qCDebug(dcRuleEngine) << "Rule" << ruleId << "time event triggert and all states match.";
+                matched = true;
             }
         }
+
+        if (m_statisticsEnabled)
+            recordEvaluation(slot, startTime, matched, dateTime);
+
+        if (matched) {
+            rules.append(ruleAt(slot));
+        }
     }
 
     m_lastEvaluationTime = dateTime;
@@ -451,200 +315,56 @@ QList<Rule> RuleEngine::evaluateTime(const QDateTime &dateTime)
 */
 RuleEngine::RuleError RuleEngine::addRule(const Rule &rule, bool fromEdit)
 {
-    if (rule.id().isNull())
-        return RuleErrorInvalidRuleId;
-
-    if (!findRule(rule.id()).id().isNull()) {
-        qCWarning(dcRuleEngine) << "Already have a rule with this id.";
-        return RuleErrorInvalidRuleId;
-    }
-
-    if (!rule.isConsistent()) {
-        qCWarning(dcRuleEngine) << "Rule inconsistent.";
-        return RuleErrorInvalidRuleFormat;
-    }
-
-    // Check IDs in each EventDescriptor
-    foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
-        // check deviceId
-        Device *device = GuhCore::instance()->deviceManager()->findConfiguredDevice(eventDescriptor.deviceId());
-        if (!device) {
-            qCWarning(dcRuleEngine) << "Cannot create rule. No configured device for eventTypeId" << eventDescriptor.eventTypeId();
-            return RuleErrorDeviceNotFound;
-        }
-
-        // Check eventTypeId for this deivce
-        DeviceClass deviceClass = GuhCore::instance()->deviceManager()->findDeviceClass(device->deviceClassId());
-        bool eventTypeFound = false;
-        foreach (const EventType &eventType, deviceClass.eventTypes()) {
-            if (eventType.id() == eventDescriptor.eventTypeId()) {
-                eventTypeFound = true;
-            }
-        }
-        if (!eventTypeFound) {
-            qCWarning(dcRuleEngine) << "Cannot create rule. Device " + device->name() + " has no event type:" << eventDescriptor.eventTypeId();
-            return RuleErrorEventTypeNotFound;
-        }
-    }
-
-    // Check state evaluator
-    if (!rule.stateEvaluator().isValid()) {
-        qCWarning(dcRuleEngine) << "Cannot create rule. Got an invalid StateEvaluator.";
-        return RuleErrorInvalidStateEvaluatorValue;
-    }
-
-    // Check time descriptor
-    if (!rule.timeDescriptor().isEmpty()) {
+    RuleError error = checkRule(rule, configuredDevices());
+    if (error != RuleErrorNoError)
+        return error;
 
-        if (!rule.timeDescriptor().isValid()) {
-            qCDebug(dcRuleEngine()) << "Cannot create rule. Got invalid timeDescriptor.";
-            return RuleErrorInvalidTimeDescriptor;
-        }
-
-        // validate CalendarItems
-        if (!rule.timeDescriptor().calendarItems().isEmpty()) {
-            foreach (const CalendarItem &calendarItem, rule.timeDescriptor().calendarItems()) {
-                if (!calendarItem.isValid()) {
-                    qCDebug(dcRuleEngine()) << "Cannot create rule. Got invalid calendarItem.";
-                    return RuleErrorInvalidCalendarItem;
-                }
-
-                // validate RepeatingOptions
-                if (!calendarItem.repeatingOption().isEmtpy() && !calendarItem.repeatingOption().isValid()) {
-                    qCDebug(dcRuleEngine()) << "Cannot create rule. Got invalid repeatingOption in calendarItem.";
-                    return RuleErrorInvalidRepeatingOption;
-                }
-            }
-        }
-
-        // validate TimeEventItems
-        if (!rule.timeDescriptor().timeEventItems().isEmpty()) {
-            foreach (const TimeEventItem &timeEventItem, rule.timeDescriptor().timeEventItems()) {
-                if (!timeEventItem.isValid()) {
-                    qCDebug(dcRuleEngine()) << "Cannot create rule. Got invalid timeEventItem.";
-                    return RuleErrorInvalidTimeEventItem;
-                }
+    appendRule(rule);
+    m_storage->storeRule(rule);
 
-                // validate RepeatingOptions
-                if (!timeEventItem.repeatingOption().isEmtpy() && !timeEventItem.repeatingOption().isValid()) {
-                    qCDebug(dcRuleEngine()) << "Cannot create rule. Got invalid repeatingOption in timeEventItem.";
-                    return RuleErrorInvalidRepeatingOption;
-                }
-            }
-        }
-    }
+    if (!fromEdit)
+        emit ruleAdded(rule);
 
+    qCDebug(dcRuleEngine()) << "Rule" << rule.name() << rule.id().toString() << "added successfully.";
 
-    // Check actions
-    foreach (const RuleAction &action, rule.actions()) {
-        Device *device = GuhCore::instance()->deviceManager()->findConfiguredDevice(action.deviceId());
-        if (!device) {
-            qCWarning(dcRuleEngine) << "Cannot create rule. No configured device for action with actionTypeId" << action.actionTypeId();
-            return RuleErrorDeviceNotFound;
-        }
+    return RuleErrorNoError;
+}
 
-        DeviceClass deviceClass = GuhCore::instance()->deviceManager()->findDeviceClass(device->deviceClassId());
-        if (!deviceClass.hasActionType(action.actionTypeId())) {
-            qCWarning(dcRuleEngine) << "Cannot create rule. Device " + device->name() + " has no action type:" << action.actionTypeId();
-            return RuleErrorActionTypeNotFound;
+/*! Add all the given \a rules to the system. The whole batch will be validated
+    before any rule gets added, so either all or none of the \a rules will be added.
+    If a rule is not valid, \a failedIndex will be set to its position in \a rules.
+    The rules are stored at once and \l{rulesAdded()} will be emitted instead of
+    \l{ruleAdded()} for each rule.
+*/
+RuleEngine::RuleError RuleEngine::addRules(const QList<Rule> &rules, int *failedIndex)
+{
+    QHash<QUuid, Device *> devices = configuredDevices();
+    QSet<QUuid> batchRuleIds;
+    for (int i = 0; i < rules.count(); i++) {
+        const Rule &rule = rules.at(i);
+        RuleError error = checkRule(rule, devices);
+        if (error == RuleErrorNoError && batchRuleIds.contains(rule.id())) {
+            qCWarning(dcRuleEngine) << "Already have a rule with this id in this batch.";
+            error = RuleErrorInvalidRuleId;
         }
 
-        // check possible eventTypeIds in params
-        if (action.isEventBased()) {
-            foreach (const RuleActionParam &ruleActionParam, action.ruleActionParams()) {
-                if (ruleActionParam.eventTypeId() != EventTypeId()) {
-                    // We have an eventTypeId
-                    if (rule.eventDescriptors().isEmpty()) {
-                        qCWarning(dcRuleEngine) << "Cannot create rule. RuleAction" << action.actionTypeId() << "contains an eventTypeId, but there are no eventDescriptors.";
-                        return RuleErrorInvalidRuleActionParameter;
-                    }
-
-                    // now check if this eventType is in the eventDescriptorList of this rule
-                    if (!checkEventDescriptors(rule.eventDescriptors(), ruleActionParam.eventTypeId())) {
-                        qCWarning(dcRuleEngine) << "Cannot create rule. EventTypeId from RuleAction" << action.actionTypeId() << "not in eventDescriptors.";
-                        return RuleErrorInvalidRuleActionParameter;
-                    }
-
-                    // check if the param type of the event and the action match
-                    QVariant::Type eventParamType = getEventParamType(ruleActionParam.eventTypeId(), ruleActionParam.eventParamTypeId());
-                    QVariant::Type actionParamType = getActionParamType(action.actionTypeId(), ruleActionParam.paramTypeId());
-                    if (eventParamType != actionParamType) {
-                        qCWarning(dcRuleEngine) << "Cannot create rule. RuleActionParam" << ruleActionParam.paramTypeId().toString() << " and given event param " << ruleActionParam.eventParamTypeId().toString() << "have not the same type:";
-                        qCWarning(dcRuleEngine) << "        -> actionParamType:" << actionParamType;
-                        qCWarning(dcRuleEngine) << "        ->  eventParamType:" << eventParamType;
-                        return RuleErrorTypesNotMatching;
-                    }
-                }
-            }
-        } else {
-            // verify action params
-            foreach (const ActionType &actionType, deviceClass.actionTypes()) {
-                if (actionType.id() == action.actionTypeId()) {
-                    ParamList finalParams = action.toAction().params();
-                    DeviceManager::DeviceError paramCheck = GuhCore::instance()->deviceManager()->verifyParams(actionType.paramTypes(), finalParams);
-                    if (paramCheck != DeviceManager::DeviceErrorNoError) {
-                        qCWarning(dcRuleEngine) << "Cannot create rule. Got an invalid actionParam.";
-                        return RuleErrorInvalidRuleActionParameter;
-                    }
-                }
-            }
-        }
+        if (error != RuleErrorNoError) {
+            if (failedIndex)
+                *failedIndex = i;
 
-        foreach (const RuleActionParam &ruleActionParam, action.ruleActionParams()) {
-            if (!ruleActionParam.isValid()) {
-                qCWarning(dcRuleEngine) << "Cannot create rule. Got an actionParam with \"value\" AND \"eventTypeId\".";
-                return RuleEngine::RuleErrorInvalidRuleActionParameter;
-            }
+            return error;
         }
+        batchRuleIds.insert(rule.id());
     }
 
-    // Check exit actions
-    foreach (const RuleAction &action, rule.exitActions()) {
-        Device *device = GuhCore::instance()->deviceManager()->findConfiguredDevice(action.deviceId());
-        if (!device) {
-            qCWarning(dcRuleEngine) << "Cannot create rule. No configured device for exit action with actionTypeId" << action.actionTypeId();
-            return RuleErrorDeviceNotFound;
-        }
-
-        DeviceClass deviceClass = GuhCore::instance()->deviceManager()->findDeviceClass(device->deviceClassId());
-        if (!deviceClass.hasActionType(action.actionTypeId())) {
-            qCWarning(dcRuleEngine) << "Cannot create rule. Device " + device->name() + " has no action type:" << action.actionTypeId();
-            return RuleErrorActionTypeNotFound;
-        }
-
-        // verify action params
-        foreach (const ActionType &actionType, deviceClass.actionTypes()) {
-            if (actionType.id() == action.actionTypeId()) {
-                ParamList finalParams = action.toAction().params();
-                DeviceManager::DeviceError paramCheck = GuhCore::instance()->deviceManager()->verifyParams(actionType.paramTypes(), finalParams);
-                if (paramCheck != DeviceManager::DeviceErrorNoError) {
-                    qCWarning(dcRuleEngine) << "Cannot create rule. Got an invalid exit actionParam.";
-                    return RuleErrorInvalidRuleActionParameter;
-                }
-            }
-        }
-
-        // Exit action can never be event based.
-        if (action.isEventBased()) {
-            qCWarning(dcRuleEngine) << "Cannot create rule. Got exitAction with an actionParam containing an eventTypeId. ";
-            return RuleErrorInvalidRuleActionParameter;
-        }
-
-        foreach (const RuleActionParam &ruleActionParam, action.ruleActionParams()) {
-            if (!ruleActionParam.isValid()) {
-                qCWarning(dcRuleEngine) << "Cannot create rule. Got an actionParam with \"value\" AND \"eventTypeId\".";
-                return RuleEngine::RuleErrorInvalidRuleActionParameter;
-            }
-        }
+    foreach (const Rule &rule, rules) {
+        appendRule(rule);
     }
+    m_storage->storeRules(rules);
 
-    appendRule(rule);
-    saveRule(rule);
-
-    if (!fromEdit)
-        emit ruleAdded(rule);
+    emit rulesAdded(rules);
 
-    qCDebug(dcRuleEngine()) << "Rule" << rule.name() << rule.id().toString() << "added successfully.";
+    qCDebug(dcRuleEngine()) << rules.count() << "rules added successfully.";
 
     return RuleErrorNoError;
 }
@@ -664,6 +384,9 @@ RuleEngine::RuleError RuleEngine::editRule(const Rule &rule)
         return RuleErrorRuleNotFound;
     }
 
+    // Keep the statistics of the rule across the edit
+    RuleStatistics statistics = ruleStatistics(rule.id());
+
     // First remove old rule with this id
     RuleError removeResult = removeRule(oldRule.id(), true);
     if (removeResult != RuleErrorNoError) {
@@ -678,8 +401,10 @@ RuleEngine::RuleError RuleEngine::editRule(const Rule &rule)
         qCWarning(dcRuleEngine) << "Cannot edit rule. Could not add the new rule. Restoring the old rule.";
         // restore old rule
         appendRule(oldRule);
+        m_ruleStatistics[m_ruleSlots.value(oldRule.id())] = statistics;
         return addResult;
     }
+    m_ruleStatistics[m_ruleSlots.value(rule.id())] = statistics;
 
     // Successfully changed the rule
     emit ruleConfigurationChanged(rule);
@@ -695,7 +420,11 @@ RuleEngine::RuleError RuleEngine::editRule(const Rule &rule)
 */
 QList<Rule> RuleEngine::rules() const
 {
-    return m_rules.values();
+    QList<Rule> rules;
+    foreach (const RuleId &ruleId, m_ruleIds) {
+        rules.append(ruleAt(m_ruleSlots.value(ruleId)));
+    }
+    return rules;
 }
 
 /*! Returns a list of all ruleIds loaded in this Engine. */
@@ -717,13 +446,9 @@ RuleEngine::RuleError RuleEngine::removeRule(const RuleId &ruleId, bool fromEdit
     }
 
     m_ruleIds.takeAt(index);
-    m_rules.remove(ruleId);
-    m_activeRules.removeAll(ruleId);
+    releaseRule(ruleId);
 
-    GuhSettings settings(GuhSettings::SettingsRoleRules);
-    settings.beginGroup(ruleId.toString());
-    settings.remove("");
-    settings.endGroup();
+    m_storage->removeRule(ruleId);
 
     if (!fromEdit)
         emit ruleRemoved(ruleId);
@@ -734,24 +459,71 @@ RuleEngine::RuleError RuleEngine::removeRule(const RuleId &ruleId, bool fromEdit
     return RuleErrorNoError;
 }
 
+/*! Removes all \l{Rule}{Rules} with the given \a ruleIds from the Engine. If one of the
+    rules can not be found, none of them will be removed and \a failedIndex will be set to
+    the position of the unknown id in \a ruleIds. The rules are removed from the storage at once
+    and \l{rulesRemoved()} will be emitted instead of \l{ruleRemoved()} for each rule.
+*/
+RuleEngine::RuleError RuleEngine::removeRules(const QList<RuleId> &ruleIds, int *failedIndex)
+{
+    QSet<QUuid> removedRuleIds;
+    for (int i = 0; i < ruleIds.count(); i++) {
+        if (!m_ruleSlots.contains(ruleIds.at(i)) || removedRuleIds.contains(ruleIds.at(i))) {
+            if (failedIndex)
+                *failedIndex = i;
+
+            return RuleErrorRuleNotFound;
+        }
+        removedRuleIds.insert(ruleIds.at(i));
+    }
+
+    foreach (const RuleId &ruleId, ruleIds) {
+        releaseRule(ruleId);
+    }
+
+    // Drop the removed ids in one pass instead of searching each of them
+    QList<RuleId> remainingRuleIds;
+    foreach (const RuleId &ruleId, m_ruleIds) {
+        if (!removedRuleIds.contains(ruleId)) {
+            remainingRuleIds.append(ruleId);
+        }
+    }
+    m_ruleIds = remainingRuleIds;
+
+    m_storage->removeRules(ruleIds);
+
+    emit rulesRemoved(ruleIds);
+
+    qCDebug(dcRuleEngine()) << ruleIds.count() << "rules removed.";
+
+    return RuleErrorNoError;
+}
+
 /*! Enables the rule with the given \a ruleId that has been previously disabled.
 
     \sa disableRule()
 */
 RuleEngine::RuleError RuleEngine::enableRule(const RuleId &ruleId)
 {
-    if (!m_rules.contains(ruleId)) {
+    int slot = m_ruleSlots.value(ruleId, -1);
+    if (slot < 0) {
         qCWarning(dcRuleEngine) << "Rule not found. Can't enable it";
         return RuleErrorRuleNotFound;
     }
 
-    Rule rule = m_rules.value(ruleId);
-    if (rule.enabled())
+    if (m_enabledRules.testBit(slot))
         return RuleErrorNoError;
 
-    rule.setEnabled(true);
-    m_rules[ruleId] = rule;
-    saveRule(rule);
+    // States might have changed while the rule was disabled
+    m_stateEvaluators[slot].refresh();
+    m_ruleDefinitions[slot].setEnabled(true);
+    m_enabledRules.setBit(slot);
+    m_statesActiveRules.setBit(slot, m_stateEvaluators.at(slot).result());
+    m_pendingRules.append(slot);
+    scheduleRule(ruleId, QDateTime());
+
+    Rule rule = ruleAt(slot);
+    m_storage->storeRule(rule);
     emit ruleConfigurationChanged(rule);
 
     GuhCore::instance()->logEngine()->logRuleEnabledChanged(rule, true);
@@ -766,18 +538,21 @@ RuleEngine::RuleError RuleEngine::enableRule(const RuleId &ruleId)
 */
 RuleEngine::RuleError RuleEngine::disableRule(const RuleId &ruleId)
 {
-    if (!m_rules.contains(ruleId)) {
+    int slot = m_ruleSlots.value(ruleId, -1);
+    if (slot < 0) {
         qCWarning(dcRuleEngine) << "Rule not found. Can't disable it";
         return RuleErrorRuleNotFound;
     }
 
-    Rule rule = m_rules.value(ruleId);
-    if (!rule.enabled())
+    if (!m_enabledRules.testBit(slot))
         return RuleErrorNoError;
 
-    rule.setEnabled(false);
-    m_rules[ruleId] = rule;
-    saveRule(rule);
+    m_ruleDefinitions[slot].setEnabled(false);
+    m_enabledRules.clearBit(slot);
+    unscheduleRule(ruleId);
+
+    Rule rule = ruleAt(slot);
+    m_storage->storeRule(rule);
     emit ruleConfigurationChanged(rule);
 
     GuhCore::instance()->logEngine()->logRuleEnabledChanged(rule, false);
@@ -793,12 +568,12 @@ RuleEngine::RuleError RuleEngine::disableRule(const RuleId &ruleId)
 RuleEngine::RuleError RuleEngine::executeActions(const RuleId &ruleId)
 {
     // check if rule exits
-    if (!m_rules.contains(ruleId)) {
+    if (!m_ruleSlots.contains(ruleId)) {
         qCWarning(dcRuleEngine) << "Not executing rule actions: rule not found.";
         return RuleErrorRuleNotFound;
     }
 
-    Rule rule = m_rules.value(ruleId);
+    Rule rule = findRule(ruleId);
 
     // check if rule is executable
     if (!rule.executable()) {
@@ -817,6 +592,9 @@ RuleEngine::RuleError RuleEngine::executeActions(const RuleId &ruleId)
     qCDebug(dcRuleEngine) << "Executing rule actions of rule" << rule.name() << rule.id();
     GuhCore::instance()->logEngine()->logRuleActionsExecuted(rule);
     GuhCore::instance()->executeRuleActions(rule.actions());
+    if (m_statisticsEnabled)
+        m_ruleStatistics[m_ruleSlots.value(ruleId)].addActionsDispatched(rule.actions().count());
+
     return RuleErrorNoError;
 }
 
@@ -828,12 +606,12 @@ RuleEngine::RuleError RuleEngine::executeActions(const RuleId &ruleId)
 RuleEngine::RuleError RuleEngine::executeExitActions(const RuleId &ruleId)
 {
     // check if rule exits
-    if (!m_rules.contains(ruleId)) {
+    if (!m_ruleSlots.contains(ruleId)) {
         qCWarning(dcRuleEngine) << "Not executing rule exit actions: rule not found.";
         return RuleErrorRuleNotFound;
     }
 
-    Rule rule = m_rules.value(ruleId);
+    Rule rule = findRule(ruleId);
 
     // check if rule is executable
     if (!rule.executable()) {
@@ -849,16 +627,31 @@ RuleEngine::RuleError RuleEngine::executeExitActions(const RuleId &ruleId)
     qCDebug(dcRuleEngine) << "Executing rule exit actions of rule" << rule.name() << rule.id();
     GuhCore::instance()->logEngine()->logRuleExitActionsExecuted(rule);
     GuhCore::instance()->executeRuleActions(rule.exitActions());
+    if (m_statisticsEnabled)
+        m_ruleStatistics[m_ruleSlots.value(ruleId)].addActionsDispatched(rule.exitActions().count());
+
     return RuleErrorNoError;
 }
 
 /*! Returns the \l{Rule} with the given \a ruleId. If the \l{Rule} does not exist, it will return \l{Rule::Rule()} */
 Rule RuleEngine::findRule(const RuleId &ruleId)
 {
-    if (!m_rules.contains(ruleId))
+    int slot = m_ruleSlots.value(ruleId, -1);
+    if (slot < 0)
         return Rule();
 
-    return m_rules.value(ruleId);
+    return ruleAt(slot);
+}
+
+/*! Returns the \l{CompiledStateEvaluator} of the \l{Rule} with the given \a ruleId. The cached
+    results of the returned evaluator reflect the last evaluation of the rule states. */
+CompiledStateEvaluator RuleEngine::compiledStateEvaluator(const RuleId &ruleId) const
+{
+    int slot = m_ruleSlots.value(ruleId, -1);
+    if (slot < 0)
+        return CompiledStateEvaluator();
+
+    return m_stateEvaluators.at(slot);
 }
 
 /*! Returns a list of all \l{Rule}{Rules} loaded in this Engine, which contains a \l{Device} with the given \a deviceId. */
@@ -866,7 +659,8 @@ QList<RuleId> RuleEngine::findRules(const DeviceId &deviceId) const
 {
     // Find all offending rules
     QList<RuleId> offendingRules;
-    foreach (const Rule &rule, m_rules) {
+    foreach (const RuleId &ruleId, m_ruleIds) {
+        const Rule &rule = m_ruleDefinitions.at(m_ruleSlots.value(ruleId));
         bool offending = false;
         foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
             if (eventDescriptor.deviceId() == deviceId) {
@@ -907,7 +701,8 @@ QList<RuleId> RuleEngine::findRules(const DeviceId &deviceId) const
 QList<DeviceId> RuleEngine::devicesInRules() const
 {
     QList<DeviceId> tmp;
-    foreach (const Rule &rule, m_rules) {
+    foreach (const RuleId &ruleId, m_ruleIds) {
+        const Rule &rule = m_ruleDefinitions.at(m_ruleSlots.value(ruleId));
         foreach (const EventDescriptor &descriptor, rule.eventDescriptors()) {
             if (!tmp.contains(descriptor.deviceId()) && !descriptor.deviceId().isNull()) {
                 tmp.append(descriptor.deviceId());
@@ -935,10 +730,11 @@ QList<DeviceId> RuleEngine::devicesInRules() const
 /*! Removes a \l{Device} from a \l{Rule} with the given \a id and \a deviceId. */
 void RuleEngine::removeDeviceFromRule(const RuleId &id, const DeviceId &deviceId)
 {
-    if (!m_rules.contains(id))
+    int slot = m_ruleSlots.value(id, -1);
+    if (slot < 0)
         return;
 
-    Rule rule = m_rules.value(id);
+    Rule rule = m_ruleDefinitions.at(slot);
 
     // remove device from eventDescriptors
     QList<EventDescriptor> eventDescriptors = rule.eventDescriptors();
@@ -978,12 +774,6 @@ void RuleEngine::removeDeviceFromRule(const RuleId &id, const DeviceId &deviceId
         exitActions.takeAt(removeIndexes.takeLast());
     }
 
-    // remove the rule from settings
-    GuhSettings settings(GuhSettings::SettingsRoleRules);
-    settings.beginGroup(id.toString());
-    settings.remove("");
-    settings.endGroup();
-
     Rule newRule;
     newRule.setId(id);
     newRule.setName(rule.name());
@@ -991,32 +781,287 @@ void RuleEngine::removeDeviceFromRule(const RuleId &id, const DeviceId &deviceId
     newRule.setStateEvaluator(stateEvalatuator);
     newRule.setActions(actions);
     newRule.setExitActions(exitActions);
-    m_rules[id] = newRule;
+
+    unindexRule(slot);
+    setRuleDefinition(slot, newRule);
+    indexRule(slot);
+    compileStateEvaluator(slot);
+    m_statesActiveRules.setBit(slot, m_stateEvaluators.at(slot).result());
+    m_timeActiveRules.setBit(slot, newRule.timeActive());
+    m_pendingRules.append(slot);
+    scheduleRule(id, QDateTime());
 
     // save it
-    saveRule(newRule);
-    emit ruleConfigurationChanged(newRule);
+    m_storage->storeRule(newRule);
+    emit ruleConfigurationChanged(ruleAt(slot));
 }
 
-bool RuleEngine::containsEvent(const Rule &rule, const Event &event)
+/*! Returns true if the RuleEngine collects \l{RuleStatistics} while evaluating the rules.
+    Statistics are disabled by default.
+
+    \sa setStatisticsEnabled()
+*/
+bool RuleEngine::statisticsEnabled() const
 {
-    foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
-        if (eventDescriptor == event) {
-            return true;
+    return m_statisticsEnabled;
+}
+
+/*! Enables or disables the collection of \l{RuleStatistics} depending on the given \a enabled.
+    The statistics collected so far will be kept.
+*/
+void RuleEngine::setStatisticsEnabled(bool enabled)
+{
+    if (m_statisticsEnabled == enabled)
+        return;
+
+    qCDebug(dcRuleEngine()) << "Rule statistics" << (enabled ? "enabled" : "disabled");
+    m_statisticsEnabled = enabled;
+}
+
+/*! Returns the \l{RuleStatistics} of all rules in the order of ruleIds(). */
+QList<RuleStatistics> RuleEngine::ruleStatistics() const
+{
+    QList<RuleStatistics> statistics;
+    foreach (const RuleId &ruleId, m_ruleIds) {
+        statistics.append(m_ruleStatistics.at(m_ruleSlots.value(ruleId)));
+    }
+    return statistics;
+}
+
+/*! Returns the \l{RuleStatistics} of the rule with the given \a ruleId. If the \l{Rule} does not exist,
+    it will return \l{RuleStatistics::RuleStatistics()}.
+*/
+RuleStatistics RuleEngine::ruleStatistics(const RuleId &ruleId) const
+{
+    int slot = m_ruleSlots.value(ruleId, -1);
+    if (slot < 0)
+        return RuleStatistics();
+
+    return m_ruleStatistics.at(slot);
+}
+
+/*! Resets the \l{RuleStatistics} of the rule with the given \a ruleId. If the \a ruleId is null,
+    the statistics of all rules will be reset. Returns the corresponding RuleEngine::RuleError to
+    inform about the result.
+*/
+RuleEngine::RuleError RuleEngine::resetStatistics(const RuleId &ruleId)
+{
+    if (ruleId.isNull()) {
+        foreach (int slot, m_ruleSlots) {
+            m_ruleStatistics[slot].reset();
         }
+        return RuleErrorNoError;
     }
 
-    return false;
+    int slot = m_ruleSlots.value(ruleId, -1);
+    if (slot < 0)
+        return RuleErrorRuleNotFound;
+
+    m_ruleStatistics[slot].reset();
+    return RuleErrorNoError;
 }
 
-bool RuleEngine::containsState(const StateEvaluator &stateEvaluator, const Event &stateChangeEvent)
+RuleEngine::RuleError RuleEngine::checkRule(const Rule &rule, const QHash<QUuid, Device *> &devices)
 {
-    if (stateEvaluator.stateDescriptor().isValid() && stateEvaluator.stateDescriptor().stateTypeId().toString() == stateChangeEvent.eventTypeId().toString()) {
-        return true;
+    if (rule.id().isNull())
+        return RuleErrorInvalidRuleId;
+
+    if (m_ruleSlots.contains(rule.id())) {
+        qCWarning(dcRuleEngine) << "Already have a rule with this id.";
+        return RuleErrorInvalidRuleId;
+    }
+
+    updateTypeIndex();
+
+    if (!rule.isConsistent()) {
+        qCWarning(dcRuleEngine) << "Rule inconsistent.";
+        return RuleErrorInvalidRuleFormat;
+    }
+
+    // Check IDs in each EventDescriptor
+    foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
+        // check deviceId
+        Device *device = devices.value(eventDescriptor.deviceId());
+        if (!device) {
+            qCWarning(dcRuleEngine) << "Cannot create rule. No configured device for eventTypeId" << eventDescriptor.eventTypeId();
+            return RuleErrorDeviceNotFound;
+        }
+
+        // Check eventTypeId for this deivce
+        if (!m_eventTypeIndex.contains(IndexKey(device->deviceClassId(), eventDescriptor.eventTypeId()))) {
+            qCWarning(dcRuleEngine) << "Cannot create rule. Device " + device->name() + " has no event type:" << eventDescriptor.eventTypeId();
+            return RuleErrorEventTypeNotFound;
+        }
+    }
+
+    // Check state evaluator
+    if (!rule.stateEvaluator().isValid()) {
+        qCWarning(dcRuleEngine) << "Cannot create rule. Got an invalid StateEvaluator.";
+        return RuleErrorInvalidStateEvaluatorValue;
+    }
+
+    // Check time descriptor
+    if (!rule.timeDescriptor().isEmpty()) {
+
+        if (!rule.timeDescriptor().isValid()) {
+            qCDebug(dcRuleEngine()) << "Cannot create rule. Got invalid timeDescriptor.";
+            return RuleErrorInvalidTimeDescriptor;
+        }
+
+        // validate CalendarItems
+        if (!rule.timeDescriptor().calendarItems().isEmpty()) {
+            foreach (const CalendarItem &calendarItem, rule.timeDescriptor().calendarItems()) {
+                if (!calendarItem.isValid()) {
+                    qCDebug(dcRuleEngine()) << "Cannot create rule. Got invalid calendarItem.";
+                    return RuleErrorInvalidCalendarItem;
+                }
+
+                // validate RepeatingOptions
+                if (!calendarItem.repeatingOption().isEmtpy() && !calendarItem.repeatingOption().isValid()) {
+                    qCDebug(dcRuleEngine()) << "Cannot create rule. Got invalid repeatingOption in calendarItem.";
+                    return RuleErrorInvalidRepeatingOption;
+                }
+            }
+        }
+
+        // validate TimeEventItems
+        if (!rule.timeDescriptor().timeEventItems().isEmpty()) {
+            foreach (const TimeEventItem &timeEventItem, rule.timeDescriptor().timeEventItems()) {
+                if (!timeEventItem.isValid()) {
+                    qCDebug(dcRuleEngine()) << "Cannot create rule. Got invalid timeEventItem.";
+                    return RuleErrorInvalidTimeEventItem;
+                }
+
+                // validate RepeatingOptions
+                if (!timeEventItem.repeatingOption().isEmtpy() && !timeEventItem.repeatingOption().isValid()) {
+                    qCDebug(dcRuleEngine()) << "Cannot create rule. Got invalid repeatingOption in timeEventItem.";
+                    return RuleErrorInvalidRepeatingOption;
+                }
+            }
+        }
     }
 
-    foreach (const StateEvaluator &childEvaluator, stateEvaluator.childEvaluators()) {
-        if (containsState(childEvaluator, stateChangeEvent)) {
+
+    // Check actions
+    foreach (const RuleAction &action, rule.actions()) {
+        Device *device = devices.value(action.deviceId());
+        if (!device) {
+            qCWarning(dcRuleEngine) << "Cannot create rule. No configured device for action with actionTypeId" << action.actionTypeId();
+            return RuleErrorDeviceNotFound;
+        }
+
+        IndexKey actionTypeKey(device->deviceClassId(), action.actionTypeId());
+        if (!m_actionTypeIndex.contains(actionTypeKey)) {
+            qCWarning(dcRuleEngine) << "Cannot create rule. Device " + device->name() + " has no action type:" << action.actionTypeId();
+            return RuleErrorActionTypeNotFound;
+        }
+
+        // check possible eventTypeIds in params
+        if (action.isEventBased()) {
+            foreach (const RuleActionParam &ruleActionParam, action.ruleActionParams()) {
+                if (ruleActionParam.eventTypeId() != EventTypeId()) {
+                    // We have an eventTypeId
+                    if (rule.eventDescriptors().isEmpty()) {
+                        qCWarning(dcRuleEngine) << "Cannot create rule. RuleAction" << action.actionTypeId() << "contains an eventTypeId, but there are no eventDescriptors.";
+                        return RuleErrorInvalidRuleActionParameter;
+                    }
+
+                    // now check if this eventType is in the eventDescriptorList of this rule
+                    if (!checkEventDescriptors(rule.eventDescriptors(), ruleActionParam.eventTypeId())) {
+                        qCWarning(dcRuleEngine) << "Cannot create rule. EventTypeId from RuleAction" << action.actionTypeId() << "not in eventDescriptors.";
+                        return RuleErrorInvalidRuleActionParameter;
+                    }
+
+                    // check if the param type of the event and the action match
+                    QVariant::Type eventParamType = getEventParamType(ruleActionParam.eventTypeId(), ruleActionParam.eventParamTypeId());
+                    QVariant::Type actionParamType = getActionParamType(action.actionTypeId(), ruleActionParam.paramTypeId());
+                    if (eventParamType != actionParamType) {
+                        qCWarning(dcRuleEngine) << "Cannot create rule. RuleActionParam" << ruleActionParam.paramTypeId().toString() << " and given event param " << ruleActionParam.eventParamTypeId().toString() << "have not the same type:";
+                        qCWarning(dcRuleEngine) << "        -> actionParamType:" << actionParamType;
+                        qCWarning(dcRuleEngine) << "        ->  eventParamType:" << eventParamType;
+                        return RuleErrorTypesNotMatching;
+                    }
+                }
+            }
+        } else {
+            // verify action params
+            ParamList finalParams = action.toAction().params();
+            DeviceManager::DeviceError paramCheck = GuhCore::instance()->deviceManager()->verifyParams(m_actionTypeIndex.value(actionTypeKey), finalParams);
+            if (paramCheck != DeviceManager::DeviceErrorNoError) {
+                qCWarning(dcRuleEngine) << "Cannot create rule. Got an invalid actionParam.";
+                return RuleErrorInvalidRuleActionParameter;
+            }
+        }
+
+        foreach (const RuleActionParam &ruleActionParam, action.ruleActionParams()) {
+            if (!ruleActionParam.isValid()) {
+                qCWarning(dcRuleEngine) << "Cannot create rule. Got an actionParam with \"value\" AND \"eventTypeId\".";
+                return RuleEngine::RuleErrorInvalidRuleActionParameter;
+            }
+        }
+    }
+
+    // Check exit actions
+    foreach (const RuleAction &action, rule.exitActions()) {
+        Device *device = devices.value(action.deviceId());
+        if (!device) {
+            qCWarning(dcRuleEngine) << "Cannot create rule. No configured device for exit action with actionTypeId" << action.actionTypeId();
+            return RuleErrorDeviceNotFound;
+        }
+
+        IndexKey actionTypeKey(device->deviceClassId(), action.actionTypeId());
+        if (!m_actionTypeIndex.contains(actionTypeKey)) {
+            qCWarning(dcRuleEngine) << "Cannot create rule. Device " + device->name() + " has no action type:" << action.actionTypeId();
+            return RuleErrorActionTypeNotFound;
+        }
+
+        // verify action params
+        ParamList finalParams = action.toAction().params();
+        DeviceManager::DeviceError paramCheck = GuhCore::instance()->deviceManager()->verifyParams(m_actionTypeIndex.value(actionTypeKey), finalParams);
+        if (paramCheck != DeviceManager::DeviceErrorNoError) {
+            qCWarning(dcRuleEngine) << "Cannot create rule. Got an invalid exit actionParam.";
+            return RuleErrorInvalidRuleActionParameter;
+        }
+
+        // Exit action can never be event based.
+        if (action.isEventBased()) {
+            qCWarning(dcRuleEngine) << "Cannot create rule. Got exitAction with an actionParam containing an eventTypeId. ";
+            return RuleErrorInvalidRuleActionParameter;
+        }
+
+        foreach (const RuleActionParam &ruleActionParam, action.ruleActionParams()) {
+            if (!ruleActionParam.isValid()) {
+                qCWarning(dcRuleEngine) << "Cannot create rule. Got an actionParam with \"value\" AND \"eventTypeId\".";
+                return RuleEngine::RuleErrorInvalidRuleActionParameter;
+            }
+        }
+    }
+
+    return RuleErrorNoError;
+}
+
+/* Adds the evaluation of the rule in the given \a slot which started at \a startTime to the statistics.
+   A matching rule is counted as triggered at the given \a dateTime with the actions it will dispatch. */
+void RuleEngine::recordEvaluation(int slot, qint64 startTime, bool matched, const QDateTime &dateTime)
+{
+    RuleStatistics &statistics = m_ruleStatistics[slot];
+    statistics.addEvaluation(m_statisticsTimer.nsecsElapsed() - startTime);
+    if (!matched)
+        return;
+
+    // State based rules run their exit actions when they become inactive
+    const Rule &rule = m_ruleDefinitions.at(slot);
+    int actionsDispatched = rule.actions().count();
+    if (m_stateBasedRules.testBit(slot) && !m_activeRules.testBit(slot))
+        actionsDispatched = rule.exitActions().count();
+
+    statistics.addMatch(actionsDispatched, dateTime.isValid() ? dateTime : QDateTime::currentDateTime());
+}
+
+bool RuleEngine::containsEvent(const Rule &rule, const Event &event)
+{
+    foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
+        if (eventDescriptor == event) {
             return true;
         }
     }
@@ -1037,184 +1082,244 @@ bool RuleEngine::checkEventDescriptors(const QList<EventDescriptor> eventDescrip
 
 QVariant::Type RuleEngine::getActionParamType(const ActionTypeId &actionTypeId, const ParamTypeId &paramTypeId)
 {
-    foreach (const DeviceClass &deviceClass, GuhCore::instance()->deviceManager()->supportedDevices()) {
-        foreach (const ActionType &actionType, deviceClass.actionTypes()) {
-            if (actionType.id() == actionTypeId) {
-                foreach (const ParamType &paramType, actionType.paramTypes()) {
-                    if (paramType.id() == paramTypeId) {
-                        return paramType.type();
-                    }
-                }
-            }
-        }
-    }
-
-    return QVariant::Invalid;
+    return m_actionParamTypes.value(IndexKey(actionTypeId, paramTypeId), QVariant::Invalid);
 }
 
 QVariant::Type RuleEngine::getEventParamType(const EventTypeId &eventTypeId, const ParamTypeId &paramTypeId)
 {
+    return m_eventParamTypes.value(IndexKey(eventTypeId, paramTypeId), QVariant::Invalid);
+}
+
+QHash<QUuid, Device *> RuleEngine::configuredDevices() const
+{
+    QHash<QUuid, Device *> devices;
+    foreach (Device *device, GuhCore::instance()->deviceManager()->configuredDevices()) {
+        devices.insert(device->id(), device);
+    }
+    return devices;
+}
+
+void RuleEngine::updateTypeIndex()
+{
+    if (m_typeIndexValid)
+        return;
+
+    m_eventTypeIndex.clear();
+    m_actionTypeIndex.clear();
+    m_eventParamTypes.clear();
+    m_actionParamTypes.clear();
+
     foreach (const DeviceClass &deviceClass, GuhCore::instance()->deviceManager()->supportedDevices()) {
         foreach (const EventType &eventType, deviceClass.eventTypes()) {
-            if (eventType.id() == eventTypeId) {
-                foreach (const ParamType &paramType, eventType.paramTypes()) {
-                    if (paramType.id() == paramTypeId) {
-                        return paramType.type();
-                    }
-                }
+            m_eventTypeIndex.insert(IndexKey(deviceClass.id(), eventType.id()));
+            foreach (const ParamType &paramType, eventType.paramTypes()) {
+                m_eventParamTypes.insert(IndexKey(eventType.id(), paramType.id()), paramType.type());
+            }
+        }
+        foreach (const ActionType &actionType, deviceClass.actionTypes()) {
+            m_actionTypeIndex.insert(IndexKey(deviceClass.id(), actionType.id()), actionType.paramTypes());
+            foreach (const ParamType &paramType, actionType.paramTypes()) {
+                m_actionParamTypes.insert(IndexKey(actionType.id(), paramType.id()), paramType.type());
             }
         }
     }
+    m_typeIndexValid = true;
+}
 
-    return QVariant::Invalid;
+void RuleEngine::releaseRule(const RuleId &ruleId)
+{
+    int slot = m_ruleSlots.take(ruleId);
+    unscheduleRule(ruleId);
+    unindexRule(slot);
+    m_pendingRules.removeAll(slot);
+
+    // Free the slot for the next rule
+    setRuleDefinition(slot, Rule());
+    m_stateEvaluators[slot] = CompiledStateEvaluator();
+    m_statesActiveRules.clearBit(slot);
+    m_timeActiveRules.clearBit(slot);
+    m_activeRules.clearBit(slot);
+    m_freeRuleSlots.append(slot);
 }
 
 void RuleEngine::appendRule(const Rule &rule)
 {
-    Rule newRule = rule;
-    newRule.setStatesActive(newRule.stateEvaluator().evaluate());
-    m_rules.insert(rule.id(), newRule);
+    int slot;
+    if (!m_freeRuleSlots.isEmpty()) {
+        slot = m_freeRuleSlots.takeLast();
+    } else {
+        slot = m_ruleDefinitions.count();
+        m_ruleDefinitions.resize(slot + 1);
+        m_stateEvaluators.resize(slot + 1);
+        m_enabledRules.resize(slot + 1);
+        m_stateBasedRules.resize(slot + 1);
+        m_statesActiveRules.resize(slot + 1);
+        m_timeActiveRules.resize(slot + 1);
+        m_activeRules.resize(slot + 1);
+        m_ruleStatistics.resize(slot + 1);
+    }
+
+    setRuleDefinition(slot, rule);
+    compileStateEvaluator(slot);
+    m_statesActiveRules.setBit(slot, m_stateEvaluators.at(slot).result());
+    m_timeActiveRules.setBit(slot, rule.timeActive());
+    m_activeRules.setBit(slot, rule.active());
+    m_ruleStatistics[slot] = RuleStatistics(rule.id());
+
+    m_ruleSlots.insert(rule.id(), slot);
     m_ruleIds.append(rule.id());
+    m_pendingRules.append(slot);
+    indexRule(slot);
+    scheduleRule(rule.id(), QDateTime());
 }
 
-void RuleEngine::saveRule(const Rule &rule)
+/* Moves the rules of the rules.conf settings file into the rule storage. The settings file
+   is kept as rules.conf.migrated and cleared, so the migration only happens once. */
+void RuleEngine::migrateRuleSettings()
 {
-    GuhSettings settings(GuhSettings::SettingsRoleRules);
-    settings.beginGroup(rule.id().toString());
-    settings.setValue("name", rule.name());
-    settings.setValue("enabled", rule.enabled());
-    settings.setValue("executable", rule.executable());
-
-    // Save timeDescriptor
-    settings.beginGroup("timeDescriptor");
-    if (!rule.timeDescriptor().isEmpty()) {
-        settings.beginGroup("calendarItems");
-        for (int i = 0; i < rule.timeDescriptor().calendarItems().count(); i++) {
-            settings.beginGroup("CalendarItem-" + QString::number(i));
-
-            const CalendarItem &calendarItem = rule.timeDescriptor().calendarItems().at(i);
-            if (calendarItem.dateTime().isValid())
-                settings.setValue("dateTime", calendarItem.dateTime().toTime_t());
+    SettingsRuleStorage settingsStorage;
+    QList<Rule> rules = settingsStorage.loadRules();
+    if (rules.isEmpty())
+        return;
 
-            if (calendarItem.startTime().isValid())
-                settings.setValue("startTime", calendarItem.startTime().toString("hh:mm"));
+    qCDebug(dcRuleEngine()) << "Migrating" << rules.count() << "rules from" << settingsStorage.name() << "to" << m_storage->name();
+    if (!m_storage->storeRules(rules)) {
+        qCWarning(dcRuleEngine()) << "Could not migrate the rule settings. Keeping" << settingsStorage.name();
+        return;
+    }
 
-            settings.setValue("duration", calendarItem.duration());
-            settings.setValue("mode", calendarItem.repeatingOption().mode());
+    QString backupFileName = settingsStorage.name() + ".migrated";
+    QFile::remove(backupFileName);
+    QFile::copy(settingsStorage.name(), backupFileName);
+    settingsStorage.clear();
+}
 
-            // Save weekDays
-            settings.beginWriteArray("weekDays");
-            for (int i = 0; i < calendarItem.repeatingOption().weekDays().count(); ++i) {
-                settings.setArrayIndex(i);
-                settings.setValue("weekDay", calendarItem.repeatingOption().weekDays().at(i));
-            }
-            settings.endArray();
+/* Returns a copy of the rule definition in the given slot, including its current runtime state. */
+Rule RuleEngine::ruleAt(int slot) const
+{
+    Rule rule = m_ruleDefinitions.at(slot);
+    rule.setStatesActive(m_statesActiveRules.testBit(slot));
+    rule.setTimeActive(m_timeActiveRules.testBit(slot));
+    rule.setActive(m_activeRules.testBit(slot));
+    return rule;
+}
 
-            // Save monthDays
-            settings.beginWriteArray("monthDays");
-            for (int i = 0; i < calendarItem.repeatingOption().monthDays().count(); ++i) {
-                settings.setArrayIndex(i);
-                settings.setValue("monthDay", calendarItem.repeatingOption().monthDays().at(i));
-            }
-            settings.endArray();
+void RuleEngine::setRuleDefinition(int slot, const Rule &rule)
+{
+    m_ruleDefinitions[slot] = rule;
+    m_enabledRules.setBit(slot, rule.enabled());
+    m_stateBasedRules.setBit(slot, rule.eventDescriptors().isEmpty() && rule.timeDescriptor().timeEventItems().isEmpty());
+}
 
-            settings.endGroup();
-        }
-        settings.endGroup();
+/* Updates the active flag of the state based rule in the given slot. Returns true if it changed. */
+bool RuleEngine::updateActiveState(int slot)
+{
+    bool active = m_timeActiveRules.testBit(slot) && m_statesActiveRules.testBit(slot);
+    if (m_activeRules.testBit(slot) == active)
+        return false;
 
-        settings.beginGroup("timeEventItems");
-        for (int i = 0; i < rule.timeDescriptor().timeEventItems().count(); i++) {
-            settings.beginGroup("TimeEventItem-" + QString::number(i));
-            const TimeEventItem &timeEventItem = rule.timeDescriptor().timeEventItems().at(i);
+    qCDebug(dcRuleEngine) << "Rule" << m_ruleDefinitions.at(slot).id().toString() << (active ? "active." : "inactive.");
+    m_activeRules.setBit(slot, active);
+    return true;
+}
 
-            if (timeEventItem.dateTime().isValid())
-                settings.setValue("dateTime", timeEventItem.dateTime().toTime_t());
+void RuleEngine::indexRule(int slot)
+{
+    const Rule &rule = m_ruleDefinitions.at(slot);
+    foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
+        QList<int> &ruleSlots = m_eventIndex[IndexKey(eventDescriptor.deviceId(), eventDescriptor.eventTypeId())];
+        if (!ruleSlots.contains(slot)) {
+            ruleSlots.append(slot);
+        }
+    }
 
-            if (timeEventItem.time().isValid())
-                settings.setValue("time", timeEventItem.time().toString("hh:mm"));
+    foreach (const StateDescriptor &stateDescriptor, rule.stateEvaluator().containedStateDescriptors()) {
+        QList<int> &ruleSlots = m_stateIndex[IndexKey(stateDescriptor.deviceId(), stateDescriptor.stateTypeId())];
+        if (!ruleSlots.contains(slot)) {
+            ruleSlots.append(slot);
+        }
+    }
+}
 
-            settings.setValue("mode", timeEventItem.repeatingOption().mode());
+void RuleEngine::unindexRule(int slot)
+{
+    const Rule &rule = m_ruleDefinitions.at(slot);
+    foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
+        IndexKey key(eventDescriptor.deviceId(), eventDescriptor.eventTypeId());
+        m_eventIndex[key].removeAll(slot);
+        if (m_eventIndex.value(key).isEmpty()) {
+            m_eventIndex.remove(key);
+        }
+    }
 
-            // Save weekDays
-            settings.beginWriteArray("weekDays");
-            for (int i = 0; i < timeEventItem.repeatingOption().weekDays().count(); ++i) {
-                settings.setArrayIndex(i);
-                settings.setValue("weekDay", timeEventItem.repeatingOption().weekDays().at(i));
-            }
-            settings.endArray();
+    foreach (const StateDescriptor &stateDescriptor, rule.stateEvaluator().containedStateDescriptors()) {
+        IndexKey key(stateDescriptor.deviceId(), stateDescriptor.stateTypeId());
+        m_stateIndex[key].removeAll(slot);
+        if (m_stateIndex.value(key).isEmpty()) {
+            m_stateIndex.remove(key);
+        }
+    }
+}
 
-            // Save monthDays
-            settings.beginWriteArray("monthDays");
-            for (int i = 0; i < timeEventItem.repeatingOption().monthDays().count(); ++i) {
-                settings.setArrayIndex(i);
-                settings.setValue("monthDay", timeEventItem.repeatingOption().monthDays().at(i));
-            }
-            settings.endArray();
+void RuleEngine::compileStateEvaluator(int slot)
+{
+    m_stateEvaluators[slot] = CompiledStateEvaluator::compile(m_ruleDefinitions.at(slot).stateEvaluator());
+}
 
-            settings.endGroup();
+void RuleEngine::compileStateEvaluators(const DeviceId &deviceId)
+{
+    for (int slot = 0; slot < m_stateEvaluators.count(); slot++) {
+        if (m_stateEvaluators.at(slot).containsDevice(deviceId)) {
+            compileStateEvaluator(slot);
         }
-        settings.endGroup();
     }
-    settings.endGroup();
-
-    // Save Events / EventDescriptors
-    settings.beginGroup("events");
-    for (int i = 0; i < rule.eventDescriptors().count(); i++) {
-        const EventDescriptor &eventDescriptor = rule.eventDescriptors().at(i);
-        settings.beginGroup("EventDescriptor-" + QString::number(i));
-        settings.setValue("deviceId", eventDescriptor.deviceId().toString());
-        settings.setValue("eventTypeId", eventDescriptor.eventTypeId().toString());
-
-        foreach (const ParamDescriptor &paramDescriptor, eventDescriptor.paramDescriptors()) {
-            settings.beginGroup("ParamDescriptor-" + paramDescriptor.paramTypeId().toString());
-            settings.setValue("value", paramDescriptor.value());
-            settings.setValue("operator", paramDescriptor.operatorType());
-            settings.endGroup();
-        }
-        settings.endGroup();
+}
+
+/* Schedules the time evaluation of the rule with the given ruleId for dateTime,
+   or for the next time change if dateTime is not valid. */
+void RuleEngine::scheduleRule(const RuleId &ruleId, const QDateTime &dateTime)
+{
+    unscheduleRule(ruleId);
+
+    int slot = m_ruleSlots.value(ruleId, -1);
+    if (slot < 0 || m_ruleDefinitions.at(slot).timeDescriptor().isEmpty())
+        return;
+
+    if (!dateTime.isValid()) {
+        m_pendingTimeRules.append(ruleId);
+        return;
     }
-    settings.endGroup();
 
-    // Save StateEvaluator
-    rule.stateEvaluator().dumpToSettings(settings, "stateEvaluator");
+    m_timeSchedule.insert(dateTime, ruleId);
+    m_timeDeadlines.insert(ruleId, dateTime);
+}
 
-    // Save ruleActions
-    int i = 0;
-    settings.beginGroup("ruleActions");
-    foreach (const RuleAction &action, rule.actions()) {
-        settings.beginGroup(QString::number(i));
-        settings.setValue("deviceId", action.deviceId().toString());
-        settings.setValue("actionTypeId", action.actionTypeId().toString());
-        foreach (const RuleActionParam &param, action.ruleActionParams()) {
-            settings.beginGroup("RuleActionParam-" + param.paramTypeId().toString());
-            settings.setValue("value", param.value());
-            if (param.eventTypeId() != EventTypeId()) {
-                settings.setValue("eventTypeId", param.eventTypeId().toString());
-                settings.setValue("eventParamTypeId", param.eventParamTypeId());
-            }
-            settings.endGroup();
-        }
-        i++;
-        settings.endGroup();
+void RuleEngine::unscheduleRule(const RuleId &ruleId)
+{
+    m_pendingTimeRules.removeAll(ruleId);
+    if (m_timeDeadlines.contains(ruleId)) {
+        m_timeSchedule.remove(m_timeDeadlines.take(ruleId), ruleId);
     }
-    settings.endGroup();
+}
 
-    // Save ruleExitActions
-    settings.beginGroup("ruleExitActions");
-    i = 0;
-    foreach (const RuleAction &action, rule.exitActions()) {
-        settings.beginGroup(QString::number(i));
-        settings.setValue("deviceId", action.deviceId().toString());
-        settings.setValue("actionTypeId", action.actionTypeId().toString());
-        foreach (const RuleActionParam &param, action.ruleActionParams()) {
-            settings.beginGroup("RuleActionParam-" + param.paramTypeId().toString());
-            settings.setValue("value", param.value());
-            settings.endGroup();
-        }
-        i++;
-        settings.endGroup();
+void RuleEngine::onDevicesLoaded()
+{
+    // The supported device classes might have changed
+    m_typeIndexValid = false;
+
+    foreach (const RuleId &ruleId, m_ruleIds) {
+        compileStateEvaluator(m_ruleSlots.value(ruleId));
     }
-    settings.endGroup();
+}
+
+void RuleEngine::onDeviceChanged(Device *device)
+{
+    compileStateEvaluators(device->id());
+}
+
+void RuleEngine::onDeviceRemoved(const DeviceId &deviceId)
+{
+    compileStateEvaluators(deviceId);
 }
 
 }
@@ -26,13 +26,24 @@
 #include "types/event.h"
 #include "plugin/deviceclass.h"
 #include "stateevaluator.h"
+#include "compiledstateevaluator.h"
+#include "rulestatistics.h"
 
 #include <QObject>
 #include <QList>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QMap>
+#include <QVector>
+#include <QBitArray>
 #include <QUuid>
+#include <QElapsedTimer>
 
 namespace guhserver {
 
+class RuleStorage;
+
 class RuleEngine : public QObject
 {
     Q_OBJECT
@@ -74,12 +85,14 @@ public:
     QList<Rule> evaluateTime(const QDateTime &dateTime);
 
     RuleError addRule(const Rule &rule, bool fromEdit = false);
+    RuleError addRules(const QList<Rule> &rules, int *failedIndex = 0);
     RuleError editRule(const Rule &rule);
 
     QList<Rule> rules() const;
     QList<RuleId> ruleIds() const;
 
     RuleError removeRule(const RuleId &ruleId, bool fromEdit = false);
+    RuleError removeRules(const QList<RuleId> &ruleIds, int *failedIndex = 0);
 
     RuleError enableRule(const RuleId &ruleId);
     RuleError disableRule(const RuleId &ruleId);
@@ -88,33 +101,100 @@ public:
     RuleError executeExitActions(const RuleId &ruleId);
 
     Rule findRule(const RuleId &ruleId);
+    CompiledStateEvaluator compiledStateEvaluator(const RuleId &ruleId) const;
     QList<RuleId> findRules(const DeviceId &deviceId) const;
     QList<DeviceId> devicesInRules() const;
 
     void removeDeviceFromRule(const RuleId &id, const DeviceId &deviceId);
 
+    bool statisticsEnabled() const;
+    void setStatisticsEnabled(bool enabled);
+    QList<RuleStatistics> ruleStatistics() const;
+    RuleStatistics ruleStatistics(const RuleId &ruleId) const;
+    RuleError resetStatistics(const RuleId &ruleId = RuleId());
+
 signals:
     void ruleAdded(const Rule &rule);
     void ruleRemoved(const RuleId &ruleId);
+    void rulesAdded(const QList<Rule> &rules);
+    void rulesRemoved(const QList<RuleId> &ruleIds);
     void ruleConfigurationChanged(const Rule &rule);
 
+private slots:
+    void onDevicesLoaded();
+    void onDeviceChanged(Device *device);
+    void onDeviceRemoved(const DeviceId &deviceId);
+
 private:
+    // Plain QUuid pairs, the typed ids compare by their string representation
+    typedef QPair<QUuid, QUuid> IndexKey;
+
+    RuleError checkRule(const Rule &rule, const QHash<QUuid, Device *> &devices);
     bool containsEvent(const Rule &rule, const Event &event);
-    bool containsState(const StateEvaluator &stateEvaluator, const Event &stateChangeEvent);
 
     bool checkEventDescriptors(const QList<EventDescriptor> eventDescriptors, const EventTypeId &eventTypeId);
     QVariant::Type getActionParamType(const ActionTypeId &actionTypeId, const ParamTypeId &paramTypeId);
     QVariant::Type getEventParamType(const EventTypeId &eventTypeId, const ParamTypeId &paramTypeId);
 
+    QHash<QUuid, Device *> configuredDevices() const;
+    void updateTypeIndex();
+
     void appendRule(const Rule &rule);
-    void saveRule(const Rule &rule);
+    void releaseRule(const RuleId &ruleId);
+    void migrateRuleSettings();
+
+    Rule ruleAt(int slot) const;
+    void setRuleDefinition(int slot, const Rule &rule);
+    bool updateActiveState(int slot);
+
+    void indexRule(int slot);
+    void unindexRule(int slot);
+
+    void compileStateEvaluator(int slot);
+    void compileStateEvaluators(const DeviceId &deviceId);
+
+    void recordEvaluation(int slot, qint64 startTime, bool matched, const QDateTime &dateTime);
+
+    void scheduleRule(const RuleId &ruleId, const QDateTime &dateTime);
+    void unscheduleRule(const RuleId &ruleId);
 
 private:
+    RuleStorage *m_storage;
+
     QList<RuleId> m_ruleIds; // Keeping a list of RuleIds to keep sorting order...
-    QHash<RuleId, Rule> m_rules; // ...but use a Hash for faster finding
-    QList<RuleId> m_activeRules;
+    QHash<RuleId, int> m_ruleSlots; // ...but use a Hash for faster finding of the rule slot
+
+    // Rule definitions and their runtime state, indexed by the slot of the rule
+    QVector<Rule> m_ruleDefinitions;
+    QVector<CompiledStateEvaluator> m_stateEvaluators;
+    QBitArray m_enabledRules;
+    QBitArray m_stateBasedRules; // rules without events and time events, which become active and inactive
+    QBitArray m_statesActiveRules;
+    QBitArray m_timeActiveRules;
+    QBitArray m_activeRules;
+    QList<int> m_freeRuleSlots;
+
+    QHash<IndexKey, QList<int> > m_eventIndex; // (DeviceId, EventTypeId) -> slots of rules with a matching EventDescriptor
+    QHash<IndexKey, QList<int> > m_stateIndex; // (DeviceId, StateTypeId) -> slots of rules with a matching StateDescriptor
+    QList<int> m_pendingRules; // slots of rules which need an active state check on the next event
+
+    QMultiMap<QDateTime, RuleId> m_timeSchedule; // next evaluation time -> time based rules
+    QHash<RuleId, QDateTime> m_timeDeadlines;
+    QList<RuleId> m_pendingTimeRules; // time based rules which need an evaluation on the next time change
 
     QDateTime m_lastEvaluationTime;
+
+    // Statistics of each rule, indexed by the slot of the rule
+    bool m_statisticsEnabled;
+    QElapsedTimer m_statisticsTimer;
+    QVector<RuleStatistics> m_ruleStatistics;
+
+    // Types of the supported device classes, rebuilt after the plugins have been loaded
+    bool m_typeIndexValid;
+    QSet<IndexKey> m_eventTypeIndex; // (DeviceClassId, EventTypeId)
+    QHash<IndexKey, QList<ParamType> > m_actionTypeIndex; // (DeviceClassId, ActionTypeId) -> ParamTypes of the action
+    QHash<IndexKey, QVariant::Type> m_eventParamTypes; // (EventTypeId, ParamTypeId) -> type of the param
+    QHash<IndexKey, QVariant::Type> m_actionParamTypes; // (ActionTypeId, ParamTypeId) -> type of the param
 };
 
 }
@@ -0,0 +1,113 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/*!
+    \class guhserver::RuleStatistics
+    \brief Holds the evaluation statistics of a \l{Rule}.
+
+    \ingroup rules
+    \inmodule core
+
+    The \l{RuleEngine} collects these statistics only while \l{RuleEngine::statisticsEnabled()}
+    is true. They are kept in memory and start from zero whenever guhd starts.
+
+    \sa RuleEngine, Rule
+*/
+
+#include "rulestatistics.h"
+
+namespace guhserver {
+
+/*! Constructs empty statistics for the \l{Rule} with the given \a ruleId. */
+RuleStatistics::RuleStatistics(const RuleId &ruleId) :
+    m_ruleId(ruleId),
+    m_evaluations(0),
+    m_matches(0),
+    m_actionsDispatched(0),
+    m_evaluationTime(0)
+{
+
+}
+
+/*! Returns the id of the \l{Rule} these statistics belong to. */
+RuleId RuleStatistics::ruleId() const
+{
+    return m_ruleId;
+}
+
+/*! Returns how often the \l{Rule} has been evaluated. */
+quint64 RuleStatistics::evaluations() const
+{
+    return m_evaluations;
+}
+
+/*! Returns how often the \l{Rule} has been triggered or changed its active state. */
+quint64 RuleStatistics::matches() const
+{
+    return m_matches;
+}
+
+/*! Returns the number of \l{RuleAction}{RuleActions} handed over for execution. */
+quint64 RuleStatistics::actionsDispatched() const
+{
+    return m_actionsDispatched;
+}
+
+/*! Returns the cumulative time spent evaluating the \l{Rule} in nanoseconds. */
+qint64 RuleStatistics::evaluationTime() const
+{
+    return m_evaluationTime;
+}
+
+/*! Returns the time the \l{Rule} has been triggered the last time. Invalid if it never got triggered. */
+QDateTime RuleStatistics::lastTriggered() const
+{
+    return m_lastTriggered;
+}
+
+/*! Counts one evaluation which took \a evaluationTime nanoseconds. */
+void RuleStatistics::addEvaluation(qint64 evaluationTime)
+{
+    m_evaluations++;
+    m_evaluationTime += evaluationTime;
+}
+
+/*! Counts one match at the given \a dateTime which dispatched \a actionsDispatched actions. */
+void RuleStatistics::addMatch(int actionsDispatched, const QDateTime &dateTime)
+{
+    m_matches++;
+    m_actionsDispatched += actionsDispatched;
+    m_lastTriggered = dateTime;
+}
+
+/*! Counts \a actionsDispatched actions which have been executed without a match, i.e. on request. */
+void RuleStatistics::addActionsDispatched(int actionsDispatched)
+{
+    m_actionsDispatched += actionsDispatched;
+}
+
+/*! Sets all counters back to zero. */
+void RuleStatistics::reset()
+{
+    *this = RuleStatistics(m_ruleId);
+}
+
+}
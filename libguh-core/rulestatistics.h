@@ -0,0 +1,61 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef RULESTATISTICS_H
+#define RULESTATISTICS_H
+
+#include "typeutils.h"
+
+#include <QDateTime>
+
+namespace guhserver {
+
+class RuleStatistics
+{
+public:
+    RuleStatistics(const RuleId &ruleId = RuleId());
+
+    RuleId ruleId() const;
+
+    quint64 evaluations() const;
+    quint64 matches() const;
+    quint64 actionsDispatched() const;
+    qint64 evaluationTime() const;
+    QDateTime lastTriggered() const;
+
+    void addEvaluation(qint64 evaluationTime);
+    void addMatch(int actionsDispatched, const QDateTime &dateTime);
+    void addActionsDispatched(int actionsDispatched);
+
+    void reset();
+
+private:
+    RuleId m_ruleId;
+    quint64 m_evaluations;
+    quint64 m_matches;
+    quint64 m_actionsDispatched;
+    qint64 m_evaluationTime;
+    QDateTime m_lastTriggered;
+};
+
+}
+
+#endif // RULESTATISTICS_H
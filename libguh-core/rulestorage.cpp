@@ -0,0 +1,91 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class guhserver::RuleStorage
+    \brief The interface for the persistent storage of \l{Rule}{Rules}.
+
+    \ingroup rules
+    \inmodule core
+
+    A \l{RuleStorage} stores one record per \l{Rule}. The \l{RuleEngine} loads all rules
+    once at startup and afterwards only writes the rules which have been added, changed or removed.
+
+    \sa RuleEngine, SqlRuleStorage, SettingsRuleStorage
+*/
+
+/*! \fn QString guhserver::RuleStorage::name() const
+    Returns a human readable name of this storage, i.e. the file name.
+*/
+
+/*! \fn QList<Rule> guhserver::RuleStorage::loadRules()
+    Returns all \l{Rule}{Rules} of this storage, in the order they have been stored.
+*/
+
+/*! \fn bool guhserver::RuleStorage::storeRule(const Rule &rule)
+    Stores the given \a rule, replacing a stored rule with the same id. Returns false on failure.
+*/
+
+/*! \fn bool guhserver::RuleStorage::removeRule(const RuleId &ruleId)
+    Removes the rule with the given \a ruleId from this storage. Returns false on failure.
+*/
+
+#include "rulestorage.h"
+
+namespace guhserver {
+
+/*! Constructs a \l{RuleStorage} with the given \a parent. */
+RuleStorage::RuleStorage(QObject *parent) :
+    QObject(parent)
+{
+
+}
+
+/*! Destroys this \l{RuleStorage}. */
+RuleStorage::~RuleStorage()
+{
+
+}
+
+/*! Stores all given \a rules. The default implementation stores one rule after the other,
+    storages which support transactions should reimplement it. Returns false on failure. */
+bool RuleStorage::storeRules(const QList<Rule> &rules)
+{
+    foreach (const Rule &rule, rules) {
+        if (!storeRule(rule)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*! Removes all rules with the given \a ruleIds. The default implementation removes one rule after the other,
+    storages which support transactions should reimplement it. Returns false on failure. */
+bool RuleStorage::removeRules(const QList<RuleId> &ruleIds)
+{
+    foreach (const RuleId &ruleId, ruleIds) {
+        if (!removeRule(ruleId)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,49 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef RULESTORAGE_H
+#define RULESTORAGE_H
+
+#include "rule.h"
+
+#include <QObject>
+
+namespace guhserver {
+
+class RuleStorage : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RuleStorage(QObject *parent = 0);
+    virtual ~RuleStorage();
+
+    virtual QString name() const = 0;
+
+    virtual QList<Rule> loadRules() = 0;
+    virtual bool storeRule(const Rule &rule) = 0;
+    virtual bool storeRules(const QList<Rule> &rules);
+    virtual bool removeRule(const RuleId &ruleId) = 0;
+    virtual bool removeRules(const QList<RuleId> &ruleIds);
+
+};
+
+}
+
+#endif // RULESTORAGE_H
@@ -0,0 +1,425 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class guhserver::SettingsRuleStorage
+    \brief Stores the \l{Rule}{Rules} in the \b{rules.conf} settings file.
+
+    \ingroup rules
+    \inmodule core
+
+    This was the only rule storage of guh. The whole settings file gets parsed on startup
+    and rewritten on each change. It is used as fallback if the \l{SqlRuleStorage} is not
+    available and as source for the migration of existing rules into the \l{SqlRuleStorage}.
+
+    \sa RuleStorage, SqlRuleStorage
+*/
+
+#include "settingsrulestorage.h"
+#include "guhsettings.h"
+#include "loggingcategories.h"
+#include "time/calendaritem.h"
+#include "time/repeatingoption.h"
+#include "time/timeeventitem.h"
+#include "types/eventdescriptor.h"
+#include "types/paramdescriptor.h"
+
+#include <QStringList>
+
+namespace guhserver {
+
+/*! Constructs a \l{SettingsRuleStorage} with the given \a parent. */
+SettingsRuleStorage::SettingsRuleStorage(QObject *parent) :
+    RuleStorage(parent)
+{
+
+}
+
+/*! Returns the file name of the rule settings. */
+QString SettingsRuleStorage::name() const
+{
+    GuhSettings settings(GuhSettings::SettingsRoleRules);
+    return settings.fileName();
+}
+
+/*! Parses and returns all \l{Rule}{Rules} of the rule settings. */
+QList<Rule> SettingsRuleStorage::loadRules()
+{
+    QList<Rule> rules;
+
+    GuhSettings settings(GuhSettings::SettingsRoleRules);
+    foreach (const QString &idString, settings.childGroups()) {
+        settings.beginGroup(idString);
+
+        QString name = settings.value("name", idString).toString();
+        bool enabled = settings.value("enabled", true).toBool();
+        bool executable = settings.value("executable", true).toBool();
+
+        qCDebug(dcRuleEngine) << "Loading rule" << name << idString;
+
+        // Load timeDescriptor
+        TimeDescriptor timeDescriptor;
+        QList<CalendarItem> calendarItems;
+        QList<TimeEventItem> timeEventItems;
+
+        settings.beginGroup("timeDescriptor");
+
+        settings.beginGroup("calendarItems");
+        foreach (const QString &childGroup, settings.childGroups()) {
+            settings.beginGroup(childGroup);
+
+            CalendarItem calendarItem;
+            calendarItem.setDateTime(QDateTime::fromTime_t(settings.value("dateTime", 0).toUInt()));
+            calendarItem.setStartTime(QTime::fromString(settings.value("startTime").toString()));
+            calendarItem.setDuration(settings.value("duration", 0).toUInt());
+
+            QList<int> weekDays;
+            QList<int> monthDays;
+            RepeatingOption::RepeatingMode mode = (RepeatingOption::RepeatingMode)settings.value("mode", 0).toInt();
+
+            // Load weekDays
+            int weekDaysCount = settings.beginReadArray("weekDays");
+            for (int i = 0; i < weekDaysCount; ++i) {
+                settings.setArrayIndex(i);
+                weekDays.append(settings.value("weekDay", 0).toInt());
+            }
+            settings.endArray();
+
+            // Load weekDays
+            int monthDaysCount = settings.beginReadArray("monthDays");
+            for (int i = 0; i < monthDaysCount; ++i) {
+                settings.setArrayIndex(i);
+                monthDays.append(settings.value("monthDay", 0).toInt());
+            }
+            settings.endArray();
+
+            settings.endGroup();
+
+            calendarItem.setRepeatingOption(RepeatingOption(mode, weekDays, monthDays));
+            calendarItems.append(calendarItem);
+        }
+        settings.endGroup();
+
+        timeDescriptor.setCalendarItems(calendarItems);
+
+        settings.beginGroup("timeEventItems");
+        foreach (const QString &childGroup, settings.childGroups()) {
+            settings.beginGroup(childGroup);
+
+            TimeEventItem timeEventItem;
+            timeEventItem.setDateTime(settings.value("dateTime", 0).toUInt());
+            timeEventItem.setTime(QTime::fromString(settings.value("time").toString()));
+
+            QList<int> weekDays;
+            QList<int> monthDays;
+            RepeatingOption::RepeatingMode mode = (RepeatingOption::RepeatingMode)settings.value("mode", 0).toInt();
+
+            // Load weekDays
+            int weekDaysCount = settings.beginReadArray("weekDays");
+            for (int i = 0; i < weekDaysCount; ++i) {
+                settings.setArrayIndex(i);
+                weekDays.append(settings.value("weekDay", 0).toInt());
+            }
+            settings.endArray();
+
+            // Load weekDays
+            int monthDaysCount = settings.beginReadArray("monthDays");
+            for (int i = 0; i < monthDaysCount; ++i) {
+                settings.setArrayIndex(i);
+                monthDays.append(settings.value("monthDay", 0).toInt());
+            }
+            settings.endArray();
+
+            settings.endGroup();
+
+            timeEventItem.setRepeatingOption(RepeatingOption(mode, weekDays, monthDays));
+            timeEventItems.append(timeEventItem);
+        }
+        settings.endGroup();
+
+        settings.endGroup();
+
+        timeDescriptor.setTimeEventItems(timeEventItems);
+
+        // Load events
+        QList<EventDescriptor> eventDescriptorList;
+        settings.beginGroup("events");
+        foreach (QString eventGroupName, settings.childGroups()) {
+            if (eventGroupName.startsWith("EventDescriptor-")) {
+                settings.beginGroup(eventGroupName);
+                EventTypeId eventTypeId(settings.value("eventTypeId").toString());
+                DeviceId deviceId(settings.value("deviceId").toString());
+
+                QList<ParamDescriptor> params;
+                foreach (QString groupName, settings.childGroups()) {
+                    if (groupName.startsWith("ParamDescriptor-")) {
+                        settings.beginGroup(groupName);
+                        ParamDescriptor paramDescriptor(ParamTypeId(groupName.remove(QRegExp("^ParamDescriptor-"))), settings.value("value"));
+                        paramDescriptor.setOperatorType((Types::ValueOperator)settings.value("operator").toInt());
+                        params.append(paramDescriptor);
+                        settings.endGroup();
+                    }
+                }
+
+                EventDescriptor eventDescriptor(eventTypeId, deviceId, params);
+                eventDescriptorList.append(eventDescriptor);
+                settings.endGroup();
+            }
+        }
+        settings.endGroup();
+
+
+        // Load stateEvaluator
+        StateEvaluator stateEvaluator = StateEvaluator::loadFromSettings(settings, "stateEvaluator");
+
+        // Load actions
+        QList<RuleAction> actions;
+        settings.beginGroup("ruleActions");
+        foreach (const QString &actionNumber, settings.childGroups()) {
+            settings.beginGroup(actionNumber);
+
+            RuleAction action = RuleAction(ActionTypeId(settings.value("actionTypeId").toString()),
+                                           DeviceId(settings.value("deviceId").toString()));
+
+            RuleActionParamList params;
+            foreach (QString paramTypeIdString, settings.childGroups()) {
+                if (paramTypeIdString.startsWith("RuleActionParam-")) {
+                    settings.beginGroup(paramTypeIdString);
+                    RuleActionParam param(ParamTypeId(paramTypeIdString.remove(QRegExp("^RuleActionParam-"))),
+                                          settings.value("value",QVariant()),
+                                          EventTypeId(settings.value("eventTypeId", EventTypeId()).toString()),
+                                          settings.value("eventParamTypeId", ParamTypeId()).toString());
+                    params.append(param);
+                    settings.endGroup();
+                }
+            }
+
+            action.setRuleActionParams(params);
+            actions.append(action);
+
+            settings.endGroup();
+        }
+        settings.endGroup();
+
+        // Load exit actions
+        QList<RuleAction> exitActions;
+        settings.beginGroup("ruleExitActions");
+        foreach (const QString &actionNumber, settings.childGroups()) {
+            settings.beginGroup(actionNumber);
+
+            RuleAction action = RuleAction(ActionTypeId(settings.value("actionTypeId").toString()),
+                                           DeviceId(settings.value("deviceId").toString()));
+
+            RuleActionParamList params;
+            foreach (QString paramTypeIdString, settings.childGroups()) {
+                if (paramTypeIdString.startsWith("RuleActionParam-")) {
+                    settings.beginGroup(paramTypeIdString);
+                    RuleActionParam param(ParamTypeId(paramTypeIdString.remove(QRegExp("^RuleActionParam-"))),
+                                          settings.value("value"));
+                    params.append(param);
+                    settings.endGroup();
+                }
+            }
+            action.setRuleActionParams(params);
+            exitActions.append(action);
+            settings.endGroup();
+        }
+        settings.endGroup();
+
+        Rule rule;
+        rule.setId(RuleId(idString));
+        rule.setName(name);
+        rule.setTimeDescriptor(timeDescriptor);
+        rule.setEventDescriptors(eventDescriptorList);
+        rule.setStateEvaluator(stateEvaluator);
+        rule.setActions(actions);
+        rule.setExitActions(exitActions);
+        rule.setEnabled(enabled);
+        rule.setExecutable(executable);
+        rules.append(rule);
+        settings.endGroup();
+    }
+
+    return rules;
+}
+
+/*! Writes the given \a rule into the rule settings. */
+bool SettingsRuleStorage::storeRule(const Rule &rule)
+{
+    GuhSettings settings(GuhSettings::SettingsRoleRules);
+    settings.beginGroup(rule.id().toString());
+    settings.remove("");
+    settings.setValue("name", rule.name());
+    settings.setValue("enabled", rule.enabled());
+    settings.setValue("executable", rule.executable());
+
+    // Save timeDescriptor
+    settings.beginGroup("timeDescriptor");
+    if (!rule.timeDescriptor().isEmpty()) {
+        settings.beginGroup("calendarItems");
+        for (int i = 0; i < rule.timeDescriptor().calendarItems().count(); i++) {
+            settings.beginGroup("CalendarItem-" + QString::number(i));
+
+            const CalendarItem &calendarItem = rule.timeDescriptor().calendarItems().at(i);
+            if (calendarItem.dateTime().isValid())
+                settings.setValue("dateTime", calendarItem.dateTime().toTime_t());
+
+            if (calendarItem.startTime().isValid())
+                settings.setValue("startTime", calendarItem.startTime().toString("hh:mm"));
+
+            settings.setValue("duration", calendarItem.duration());
+            settings.setValue("mode", calendarItem.repeatingOption().mode());
+
+            // Save weekDays
+            settings.beginWriteArray("weekDays");
+            for (int i = 0; i < calendarItem.repeatingOption().weekDays().count(); ++i) {
+                settings.setArrayIndex(i);
+                settings.setValue("weekDay", calendarItem.repeatingOption().weekDays().at(i));
+            }
+            settings.endArray();
+
+            // Save monthDays
+            settings.beginWriteArray("monthDays");
+            for (int i = 0; i < calendarItem.repeatingOption().monthDays().count(); ++i) {
+                settings.setArrayIndex(i);
+                settings.setValue("monthDay", calendarItem.repeatingOption().monthDays().at(i));
+            }
+            settings.endArray();
+
+            settings.endGroup();
+        }
+        settings.endGroup();
+
+        settings.beginGroup("timeEventItems");
+        for (int i = 0; i < rule.timeDescriptor().timeEventItems().count(); i++) {
+            settings.beginGroup("TimeEventItem-" + QString::number(i));
+            const TimeEventItem &timeEventItem = rule.timeDescriptor().timeEventItems().at(i);
+
+            if (timeEventItem.dateTime().isValid())
+                settings.setValue("dateTime", timeEventItem.dateTime().toTime_t());
+
+            if (timeEventItem.time().isValid())
+                settings.setValue("time", timeEventItem.time().toString("hh:mm"));
+
+            settings.setValue("mode", timeEventItem.repeatingOption().mode());
+
+            // Save weekDays
+            settings.beginWriteArray("weekDays");
+            for (int i = 0; i < timeEventItem.repeatingOption().weekDays().count(); ++i) {
+                settings.setArrayIndex(i);
+                settings.setValue("weekDay", timeEventItem.repeatingOption().weekDays().at(i));
+            }
+            settings.endArray();
+
+            // Save monthDays
+            settings.beginWriteArray("monthDays");
+            for (int i = 0; i < timeEventItem.repeatingOption().monthDays().count(); ++i) {
+                settings.setArrayIndex(i);
+                settings.setValue("monthDay", timeEventItem.repeatingOption().monthDays().at(i));
+            }
+            settings.endArray();
+
+            settings.endGroup();
+        }
+        settings.endGroup();
+    }
+    settings.endGroup();
+
+    // Save Events / EventDescriptors
+    settings.beginGroup("events");
+    for (int i = 0; i < rule.eventDescriptors().count(); i++) {
+        const EventDescriptor &eventDescriptor = rule.eventDescriptors().at(i);
+        settings.beginGroup("EventDescriptor-" + QString::number(i));
+        settings.setValue("deviceId", eventDescriptor.deviceId().toString());
+        settings.setValue("eventTypeId", eventDescriptor.eventTypeId().toString());
+
+        foreach (const ParamDescriptor &paramDescriptor, eventDescriptor.paramDescriptors()) {
+            settings.beginGroup("ParamDescriptor-" + paramDescriptor.paramTypeId().toString());
+            settings.setValue("value", paramDescriptor.value());
+            settings.setValue("operator", paramDescriptor.operatorType());
+            settings.endGroup();
+        }
+        settings.endGroup();
+    }
+    settings.endGroup();
+
+    // Save StateEvaluator
+    rule.stateEvaluator().dumpToSettings(settings, "stateEvaluator");
+
+    // Save ruleActions
+    int i = 0;
+    settings.beginGroup("ruleActions");
+    foreach (const RuleAction &action, rule.actions()) {
+        settings.beginGroup(QString::number(i));
+        settings.setValue("deviceId", action.deviceId().toString());
+        settings.setValue("actionTypeId", action.actionTypeId().toString());
+        foreach (const RuleActionParam &param, action.ruleActionParams()) {
+            settings.beginGroup("RuleActionParam-" + param.paramTypeId().toString());
+            settings.setValue("value", param.value());
+            if (param.eventTypeId() != EventTypeId()) {
+                settings.setValue("eventTypeId", param.eventTypeId().toString());
+                settings.setValue("eventParamTypeId", param.eventParamTypeId());
+            }
+            settings.endGroup();
+        }
+        i++;
+        settings.endGroup();
+    }
+    settings.endGroup();
+
+    // Save ruleExitActions
+    settings.beginGroup("ruleExitActions");
+    i = 0;
+    foreach (const RuleAction &action, rule.exitActions()) {
+        settings.beginGroup(QString::number(i));
+        settings.setValue("deviceId", action.deviceId().toString());
+        settings.setValue("actionTypeId", action.actionTypeId().toString());
+        foreach (const RuleActionParam &param, action.ruleActionParams()) {
+            settings.beginGroup("RuleActionParam-" + param.paramTypeId().toString());
+            settings.setValue("value", param.value());
+            settings.endGroup();
+        }
+        i++;
+        settings.endGroup();
+    }
+    settings.endGroup();
+    settings.endGroup();
+
+    return settings.isWritable();
+}
+
+/*! Removes the rule with the given \a ruleId from the rule settings. */
+bool SettingsRuleStorage::removeRule(const RuleId &ruleId)
+{
+    GuhSettings settings(GuhSettings::SettingsRoleRules);
+    settings.beginGroup(ruleId.toString());
+    settings.remove("");
+    settings.endGroup();
+    return settings.isWritable();
+}
+
+/*! Removes all rules from the rule settings. */
+void SettingsRuleStorage::clear()
+{
+    GuhSettings settings(GuhSettings::SettingsRoleRules);
+    settings.clear();
+}
+
+}
@@ -0,0 +1,46 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SETTINGSRULESTORAGE_H
+#define SETTINGSRULESTORAGE_H
+
+#include "rulestorage.h"
+
+namespace guhserver {
+
+class SettingsRuleStorage : public RuleStorage
+{
+    Q_OBJECT
+public:
+    explicit SettingsRuleStorage(QObject *parent = 0);
+
+    QString name() const override;
+
+    QList<Rule> loadRules() override;
+    bool storeRule(const Rule &rule) override;
+    bool removeRule(const RuleId &ruleId) override;
+
+    void clear();
+
+};
+
+}
+
+#endif // SETTINGSRULESTORAGE_H
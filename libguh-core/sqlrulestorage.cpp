@@ -0,0 +1,429 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class guhserver::SqlRuleStorage
+    \brief Stores the \l{Rule}{Rules} in a SQLite database.
+
+    \ingroup rules
+    \inmodule core
+
+    Each \l{Rule} is stored as one row containing the serialized rule. Adding, editing or
+    removing a rule only touches the row of that rule, and each write is atomic.
+
+    \sa RuleStorage, SettingsRuleStorage
+*/
+
+#include "sqlrulestorage.h"
+#include "loggingcategories.h"
+#include "time/calendaritem.h"
+#include "time/timeeventitem.h"
+#include "types/eventdescriptor.h"
+#include "types/paramdescriptor.h"
+
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDataStream>
+
+#define DB_SCHEMA_VERSION 1
+
+namespace guhserver {
+
+/*! Constructs a \l{SqlRuleStorage} using the SQLite database with the given \a databaseName and \a parent. */
+SqlRuleStorage::SqlRuleStorage(const QString &databaseName, QObject *parent) :
+    RuleStorage(parent),
+    m_open(false)
+{
+    m_db = QSqlDatabase::addDatabase("QSQLITE", "rules");
+    m_db.setDatabaseName(databaseName);
+
+    if (!m_db.open()) {
+        qCWarning(dcRuleEngine()) << "Error opening rule database:" << m_db.lastError().driverText() << m_db.lastError().databaseText();
+        return;
+    }
+
+    m_open = initDB();
+}
+
+/*! Destroys this \l{SqlRuleStorage} and closes the database. */
+SqlRuleStorage::~SqlRuleStorage()
+{
+    m_db.close();
+}
+
+/*! Returns true if the database could be opened and initialized. */
+bool SqlRuleStorage::isOpen() const
+{
+    return m_open;
+}
+
+/*! Returns the file name of the rule database. */
+QString SqlRuleStorage::name() const
+{
+    return m_db.databaseName();
+}
+
+/*! Returns all \l{Rule}{Rules} of the database in the order they have been added. */
+QList<Rule> SqlRuleStorage::loadRules()
+{
+    QList<Rule> rules;
+
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT id, data FROM rules ORDER BY rowid;")) {
+        qCWarning(dcRuleEngine()) << "Error loading rules:" << query.lastError().databaseText();
+        return rules;
+    }
+
+    while (query.next()) {
+        Rule rule = deserializeRule(query.value("data").toByteArray());
+        rule.setId(RuleId(query.value("id").toString()));
+        qCDebug(dcRuleEngine) << "Loading rule" << rule.name() << rule.id().toString();
+        rules.append(rule);
+    }
+
+    return rules;
+}
+
+/*! Stores the given \a rule. An existing rule keeps its position. */
+bool SqlRuleStorage::storeRule(const Rule &rule)
+{
+    return writeRule(rule);
+}
+
+/*! Stores all given \a rules within one transaction. */
+bool SqlRuleStorage::storeRules(const QList<Rule> &rules)
+{
+    if (!m_db.transaction()) {
+        qCWarning(dcRuleEngine()) << "Error starting transaction:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    foreach (const Rule &rule, rules) {
+        if (!writeRule(rule)) {
+            m_db.rollback();
+            return false;
+        }
+    }
+
+    return m_db.commit();
+}
+
+/*! Removes the rule with the given \a ruleId from the database. */
+bool SqlRuleStorage::removeRule(const RuleId &ruleId)
+{
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM rules WHERE id = ?;");
+    query.addBindValue(ruleId.toString());
+    if (!query.exec()) {
+        qCWarning(dcRuleEngine()) << "Error removing rule" << ruleId.toString() << query.lastError().databaseText();
+        return false;
+    }
+    return true;
+}
+
+/*! Removes all rules with the given \a ruleIds from the database in a single transaction. */
+bool SqlRuleStorage::removeRules(const QList<RuleId> &ruleIds)
+{
+    if (!m_db.transaction()) {
+        qCWarning(dcRuleEngine()) << "Error starting transaction:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    foreach (const RuleId &ruleId, ruleIds) {
+        if (!removeRule(ruleId)) {
+            m_db.rollback();
+            return false;
+        }
+    }
+
+    return m_db.commit();
+}
+
+bool SqlRuleStorage::initDB()
+{
+    if (!m_db.tables().contains("metadata")) {
+        m_db.exec("CREATE TABLE metadata (key varchar(10), data varchar(40));");
+        m_db.exec(QString("INSERT INTO metadata (key, data) VALUES('version', '%1');").arg(DB_SCHEMA_VERSION));
+    }
+
+    QSqlQuery query = m_db.exec("SELECT data FROM metadata WHERE key = 'version';");
+    if (!query.next()) {
+        qCWarning(dcRuleEngine()) << "Broken rule database. Version not found in metadata table.";
+        return false;
+    }
+
+    if (query.value("data").toInt() != DB_SCHEMA_VERSION) {
+        qCWarning(dcRuleEngine()) << "Rule database schema version not matching:" << query.value("data").toInt();
+        return false;
+    }
+
+    if (!m_db.tables().contains("rules")) {
+        m_db.exec("CREATE TABLE rules (id varchar(38) PRIMARY KEY, data blob);");
+        if (m_db.lastError().isValid()) {
+            qCWarning(dcRuleEngine()) << "Error creating rule table:" << m_db.lastError().driverText() << m_db.lastError().databaseText();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool SqlRuleStorage::writeRule(const Rule &rule)
+{
+    QByteArray data = serializeRule(rule);
+
+    // Update in place to keep the position of the rule, insert if it is new
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE rules SET data = ? WHERE id = ?;");
+    query.addBindValue(data);
+    query.addBindValue(rule.id().toString());
+    if (query.exec() && query.numRowsAffected() > 0)
+        return true;
+
+    query.prepare("INSERT INTO rules (id, data) VALUES (?, ?);");
+    query.addBindValue(rule.id().toString());
+    query.addBindValue(data);
+    if (!query.exec()) {
+        qCWarning(dcRuleEngine()) << "Error storing rule" << rule.id().toString() << query.lastError().databaseText();
+        return false;
+    }
+    return true;
+}
+
+QByteArray SqlRuleStorage::serializeRule(const Rule &rule)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    stream << rule.name() << rule.enabled() << rule.executable();
+
+    stream << rule.timeDescriptor().calendarItems().count();
+    foreach (const CalendarItem &calendarItem, rule.timeDescriptor().calendarItems()) {
+        stream << calendarItem.dateTime() << calendarItem.startTime() << calendarItem.duration();
+        writeRepeatingOption(stream, calendarItem.repeatingOption());
+    }
+
+    stream << rule.timeDescriptor().timeEventItems().count();
+    foreach (const TimeEventItem &timeEventItem, rule.timeDescriptor().timeEventItems()) {
+        stream << timeEventItem.dateTime().isValid() << timeEventItem.dateTime().toTime_t() << timeEventItem.time();
+        writeRepeatingOption(stream, timeEventItem.repeatingOption());
+    }
+
+    stream << rule.eventDescriptors().count();
+    foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
+        stream << QUuid(eventDescriptor.eventTypeId()) << QUuid(eventDescriptor.deviceId());
+        stream << eventDescriptor.paramDescriptors().count();
+        foreach (const ParamDescriptor &paramDescriptor, eventDescriptor.paramDescriptors()) {
+            stream << QUuid(paramDescriptor.paramTypeId()) << paramDescriptor.value() << (qint32)paramDescriptor.operatorType();
+        }
+    }
+
+    writeStateEvaluator(stream, rule.stateEvaluator());
+    writeRuleActions(stream, rule.actions());
+    writeRuleActions(stream, rule.exitActions());
+    return data;
+}
+
+Rule SqlRuleStorage::deserializeRule(const QByteArray &data)
+{
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    QString name;
+    bool enabled;
+    bool executable;
+    stream >> name >> enabled >> executable;
+
+    int count;
+    QList<CalendarItem> calendarItems;
+    stream >> count;
+    for (int i = 0; i < count; i++) {
+        QDateTime dateTime;
+        QTime startTime;
+        uint duration;
+        stream >> dateTime >> startTime >> duration;
+
+        CalendarItem calendarItem;
+        calendarItem.setDateTime(dateTime);
+        calendarItem.setStartTime(startTime);
+        calendarItem.setDuration(duration);
+        calendarItem.setRepeatingOption(readRepeatingOption(stream));
+        calendarItems.append(calendarItem);
+    }
+
+    QList<TimeEventItem> timeEventItems;
+    stream >> count;
+    for (int i = 0; i < count; i++) {
+        bool dateTimeValid;
+        uint timeStamp;
+        QTime time;
+        stream >> dateTimeValid >> timeStamp >> time;
+
+        TimeEventItem timeEventItem;
+        if (dateTimeValid)
+            timeEventItem.setDateTime(timeStamp);
+
+        timeEventItem.setTime(time);
+        timeEventItem.setRepeatingOption(readRepeatingOption(stream));
+        timeEventItems.append(timeEventItem);
+    }
+
+    TimeDescriptor timeDescriptor;
+    timeDescriptor.setCalendarItems(calendarItems);
+    timeDescriptor.setTimeEventItems(timeEventItems);
+
+    QList<EventDescriptor> eventDescriptors;
+    stream >> count;
+    for (int i = 0; i < count; i++) {
+        QUuid eventTypeId;
+        QUuid deviceId;
+        int paramCount;
+        stream >> eventTypeId >> deviceId >> paramCount;
+
+        QList<ParamDescriptor> paramDescriptors;
+        for (int j = 0; j < paramCount; j++) {
+            QUuid paramTypeId;
+            QVariant value;
+            qint32 operatorType;
+            stream >> paramTypeId >> value >> operatorType;
+
+            ParamDescriptor paramDescriptor(ParamTypeId::fromUuid(paramTypeId), value);
+            paramDescriptor.setOperatorType((Types::ValueOperator)operatorType);
+            paramDescriptors.append(paramDescriptor);
+        }
+        eventDescriptors.append(EventDescriptor(EventTypeId::fromUuid(eventTypeId), DeviceId::fromUuid(deviceId), paramDescriptors));
+    }
+
+    Rule rule;
+    rule.setName(name);
+    rule.setEnabled(enabled);
+    rule.setExecutable(executable);
+    rule.setTimeDescriptor(timeDescriptor);
+    rule.setEventDescriptors(eventDescriptors);
+    rule.setStateEvaluator(readStateEvaluator(stream));
+    rule.setActions(readRuleActions(stream));
+    rule.setExitActions(readRuleActions(stream));
+    return rule;
+}
+
+void SqlRuleStorage::writeRepeatingOption(QDataStream &stream, const RepeatingOption &repeatingOption)
+{
+    stream << (qint32)repeatingOption.mode() << repeatingOption.weekDays() << repeatingOption.monthDays();
+}
+
+RepeatingOption SqlRuleStorage::readRepeatingOption(QDataStream &stream)
+{
+    qint32 mode;
+    QList<int> weekDays;
+    QList<int> monthDays;
+    stream >> mode >> weekDays >> monthDays;
+    return RepeatingOption((RepeatingOption::RepeatingMode)mode, weekDays, monthDays);
+}
+
+void SqlRuleStorage::writeStateEvaluator(QDataStream &stream, const StateEvaluator &stateEvaluator)
+{
+    StateDescriptor stateDescriptor = stateEvaluator.stateDescriptor();
+    stream << stateDescriptor.isValid();
+    if (stateDescriptor.isValid()) {
+        stream << QUuid(stateDescriptor.stateTypeId()) << QUuid(stateDescriptor.deviceId());
+        stream << stateDescriptor.stateValue() << (qint32)stateDescriptor.operatorType();
+    }
+
+    stream << (qint32)stateEvaluator.operatorType() << stateEvaluator.childEvaluators().count();
+    foreach (const StateEvaluator &childEvaluator, stateEvaluator.childEvaluators()) {
+        writeStateEvaluator(stream, childEvaluator);
+    }
+}
+
+StateEvaluator SqlRuleStorage::readStateEvaluator(QDataStream &stream)
+{
+    StateEvaluator stateEvaluator;
+
+    bool hasStateDescriptor;
+    stream >> hasStateDescriptor;
+    if (hasStateDescriptor) {
+        QUuid stateTypeId;
+        QUuid deviceId;
+        QVariant value;
+        qint32 operatorType;
+        stream >> stateTypeId >> deviceId >> value >> operatorType;
+        stateEvaluator = StateEvaluator(StateDescriptor(StateTypeId::fromUuid(stateTypeId), DeviceId::fromUuid(deviceId), value, (Types::ValueOperator)operatorType));
+    }
+
+    qint32 operatorType;
+    int childCount;
+    stream >> operatorType >> childCount;
+
+    QList<StateEvaluator> childEvaluators;
+    for (int i = 0; i < childCount; i++) {
+        childEvaluators.append(readStateEvaluator(stream));
+    }
+
+    stateEvaluator.setOperatorType((Types::StateOperator)operatorType);
+    stateEvaluator.setChildEvaluators(childEvaluators);
+    return stateEvaluator;
+}
+
+void SqlRuleStorage::writeRuleActions(QDataStream &stream, const QList<RuleAction> &ruleActions)
+{
+    stream << ruleActions.count();
+    foreach (const RuleAction &ruleAction, ruleActions) {
+        stream << QUuid(ruleAction.actionTypeId()) << QUuid(ruleAction.deviceId());
+        stream << ruleAction.ruleActionParams().count();
+        foreach (const RuleActionParam &ruleActionParam, ruleAction.ruleActionParams()) {
+            stream << QUuid(ruleActionParam.paramTypeId()) << ruleActionParam.value();
+            stream << QUuid(ruleActionParam.eventTypeId()) << QUuid(ruleActionParam.eventParamTypeId());
+        }
+    }
+}
+
+QList<RuleAction> SqlRuleStorage::readRuleActions(QDataStream &stream)
+{
+    QList<RuleAction> ruleActions;
+
+    int count;
+    stream >> count;
+    for (int i = 0; i < count; i++) {
+        QUuid actionTypeId;
+        QUuid deviceId;
+        int paramCount;
+        stream >> actionTypeId >> deviceId >> paramCount;
+
+        RuleActionParamList ruleActionParams;
+        for (int j = 0; j < paramCount; j++) {
+            QUuid paramTypeId;
+            QVariant value;
+            QUuid eventTypeId;
+            QUuid eventParamTypeId;
+            stream >> paramTypeId >> value >> eventTypeId >> eventParamTypeId;
+            ruleActionParams.append(RuleActionParam(ParamTypeId::fromUuid(paramTypeId), value, EventTypeId::fromUuid(eventTypeId), ParamTypeId::fromUuid(eventParamTypeId)));
+        }
+
+        RuleAction ruleAction(ActionTypeId::fromUuid(actionTypeId), DeviceId::fromUuid(deviceId));
+        ruleAction.setRuleActionParams(ruleActionParams);
+        ruleActions.append(ruleAction);
+    }
+
+    return ruleActions;
+}
+
+}
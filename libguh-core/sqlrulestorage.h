@@ -0,0 +1,69 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SQLRULESTORAGE_H
+#define SQLRULESTORAGE_H
+
+#include "rulestorage.h"
+
+#include <QSqlDatabase>
+#include <QDataStream>
+
+namespace guhserver {
+
+class SqlRuleStorage : public RuleStorage
+{
+    Q_OBJECT
+public:
+    explicit SqlRuleStorage(const QString &databaseName, QObject *parent = 0);
+    ~SqlRuleStorage();
+
+    bool isOpen() const;
+
+    QString name() const override;
+
+    QList<Rule> loadRules() override;
+    bool storeRule(const Rule &rule) override;
+    bool storeRules(const QList<Rule> &rules) override;
+    bool removeRule(const RuleId &ruleId) override;
+    bool removeRules(const QList<RuleId> &ruleIds) override;
+
+private:
+    QSqlDatabase m_db;
+    bool m_open;
+
+    bool initDB();
+    bool writeRule(const Rule &rule);
+
+    static QByteArray serializeRule(const Rule &rule);
+    static Rule deserializeRule(const QByteArray &data);
+
+    static void writeRepeatingOption(QDataStream &stream, const RepeatingOption &repeatingOption);
+    static RepeatingOption readRepeatingOption(QDataStream &stream);
+    static void writeStateEvaluator(QDataStream &stream, const StateEvaluator &stateEvaluator);
+    static StateEvaluator readStateEvaluator(QDataStream &stream);
+    static void writeRuleActions(QDataStream &stream, const QList<RuleAction> &ruleActions);
+    static QList<RuleAction> readRuleActions(QDataStream &stream);
+
+};
+
+}
+
+#endif // SQLRULESTORAGE_H
@@ -167,6 +167,19 @@ QList<DeviceId> StateEvaluator::containedDevices() const
     return ret;
 }
 
+/*! Returns all valid \l{StateDescriptor}{StateDescriptors} of this \l StateEvaluator and its child evaluators. */
+QList<StateDescriptor> StateEvaluator::containedStateDescriptors() const
+{
+    QList<StateDescriptor> ret;
+    if (m_stateDescriptor.isValid())
+        ret.append(m_stateDescriptor);
+
+    foreach (const StateEvaluator &childEvaluator, m_childEvaluators) {
+        ret.append(childEvaluator.containedStateDescriptors());
+    }
+    return ret;
+}
+
 /*! This method will be used to save this \l StateEvaluator to the given \a settings.
     The \a groupName will normally be the corresponding \l Rule. */
 void StateEvaluator::dumpToSettings(GuhSettings &settings, const QString &groupName) const
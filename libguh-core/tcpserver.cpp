@@ -66,7 +66,7 @@ QUrl TcpServer::serverUrl() const
     return QUrl(QString("%1://%2:%3").arg((configuration().sslEnabled ? "guhs" : "guh")).arg(configuration().address.toString()).arg(configuration().port));
 }
 
-/*! Sending \a data to a list of \a clients.*/
+/*! Sending \a data to a list of \a clients. The \a data is shared by all clients.*/
 void TcpServer::sendData(const QList<QUuid> &clients, const QByteArray &data)
 {
     foreach (const QUuid &client, clients) {
@@ -80,7 +80,9 @@ void TcpServer::sendData(const QUuid &clientId, const QByteArray &data)
     QTcpSocket *client = 0;
     client = m_clientList.value(clientId);
     if (client) {
-        client->write(data + '\n');
+        // Write the delimiter separately instead of copying the data
+        client->write(data);
+        client->write("\n", 1);
     } else {
         qWarning(dcTcpServer()) << "Client" << clientId << "unknown to this transport";
     }
@@ -130,6 +130,34 @@ bool CalendarItem::evaluate(const QDateTime &dateTime) const
     return dateTime >= m_dateTime && dateTime < m_dateTime.addSecs(duration() * 60);
 }
 
+/*! Returns the first point in time after the given \a dateTime at which the result of
+    \l{evaluate()} can change, or an invalid QDateTime if it will not change any more.
+
+    The returned time is a conservative guess: the result of \l{evaluate()} does not
+    change between \a dateTime and the returned time, but it is not guaranteed to
+    change at the returned time.
+*/
+QDateTime CalendarItem::nextTransition(const QDateTime &dateTime) const
+{
+    QDateTime nextTransition;
+    foreach (const QDateTime &startDateTime, startDateTimes(dateTime)) {
+        if (!startDateTime.isValid())
+            continue;
+
+        QList<QDateTime> transitions;
+        transitions.append(startDateTime);
+        transitions.append(startDateTime.addSecs(duration() * 60));
+
+        foreach (const QDateTime &transition, transitions) {
+            if (transition > dateTime && (!nextTransition.isValid() || transition < nextTransition)) {
+                nextTransition = transition;
+            }
+        }
+    }
+
+    return nextTransition;
+}
+
 bool CalendarItem::evaluateHourly(const QDateTime &dateTime) const
 {
     // If the duration is longer than a hour, this calendar item is always true
@@ -266,5 +294,107 @@ bool CalendarItem::evaluateYearly(const QDateTime &dateTime) const
     return false;
 }
 
+// Returns the start times around dateTime the evaluate methods are looking at, including the
+// points in time where they switch to another period (next hour, day, month or year).
+QList<QDateTime> CalendarItem::startDateTimes(const QDateTime &dateTime) const
+{
+    QList<QDateTime> startDateTimes;
+
+    RepeatingOption::RepeatingMode mode = m_repeatingOption.mode();
+    if (!m_startTime.isValid() && mode != RepeatingOption::RepeatingModeYearly) {
+        startDateTimes.append(m_dateTime);
+        return startDateTimes;
+    }
+
+    switch (mode) {
+    case RepeatingOption::RepeatingModeHourly: {
+        // Always true
+        if (duration() >= 60)
+            break;
+
+        for (int i = -1; i <= 1; i++) {
+            QDateTime hourDateTime = dateTime.addSecs(i * 3600);
+            startDateTimes.append(QDateTime(hourDateTime.date(), QTime(hourDateTime.time().hour(), startTime().minute())));
+        }
+
+        QDateTime nextHour = dateTime.addSecs(3600);
+        nextHour.setTime(QTime(nextHour.time().hour(), 0));
+        startDateTimes.append(nextHour);
+
+        // The week and month day filters switch at midnight
+        if (!repeatingOption().weekDays().isEmpty() || !repeatingOption().monthDays().isEmpty()) {
+            QDateTime nextDay = dateTime.addDays(1);
+            nextDay.setTime(QTime(0, 0));
+            startDateTimes.append(nextDay);
+        }
+        break;
+    }
+    case RepeatingOption::RepeatingModeNone:
+    case RepeatingOption::RepeatingModeDaily: {
+        // Always true
+        if (duration() >= 1440)
+            break;
+
+        for (int i = -1; i <= 1; i++) {
+            QDateTime startDateTime = dateTime.addDays(i);
+            startDateTime.setTime(startTime());
+            startDateTimes.append(startDateTime);
+        }
+        break;
+    }
+    case RepeatingOption::RepeatingModeWeekly: {
+        // Always true
+        if (duration() >= 10080)
+            break;
+
+        for (int i = -7; i <= 1; i++) {
+            QDateTime startDateTime = dateTime.addDays(i);
+            if (!repeatingOption().weekDays().contains(startDateTime.date().dayOfWeek()))
+                continue;
+
+            startDateTime.setTime(startTime());
+            startDateTimes.append(startDateTime);
+        }
+        break;
+    }
+    case RepeatingOption::RepeatingModeMonthly: {
+        QDate firstDayOfMonth(dateTime.date().year(), dateTime.date().month(), 1);
+        for (int i = -2; i <= 1; i++) {
+            QDateTime monthStartDateTime = dateTime;
+            monthStartDateTime.setDate(firstDayOfMonth.addMonths(i));
+            monthStartDateTime.setTime(startTime());
+
+            foreach (const int &monthDay, repeatingOption().monthDays()) {
+                QDateTime startDateTime = monthStartDateTime.addDays(monthDay - 1);
+                startDateTimes.append(startDateTime);
+                startDateTimes.append(startDateTime.addMonths(-1));
+            }
+        }
+
+        QDateTime nextMonth = dateTime;
+        nextMonth.setDate(firstDayOfMonth.addMonths(1));
+        nextMonth.setTime(QTime(0, 0));
+        startDateTimes.append(nextMonth);
+        break;
+    }
+    case RepeatingOption::RepeatingModeYearly: {
+        for (int i = -1; i <= 1; i++) {
+            QDateTime startDateTime = dateTime;
+            startDateTime.setDate(QDate(dateTime.date().year() + i, m_dateTime.date().month(), m_dateTime.date().day()));
+            startDateTime.setTime(m_dateTime.time());
+            startDateTimes.append(startDateTime);
+        }
+
+        QDateTime nextYear = dateTime;
+        nextYear.setDate(QDate(dateTime.date().year() + 1, 1, 1));
+        nextYear.setTime(QTime(0, 0));
+        startDateTimes.append(nextYear);
+        break;
+    }
+    }
+
+    return startDateTimes;
+}
+
 }
 
@@ -22,6 +22,7 @@
 #define CALENDARITEM_H
 
 #include <QTime>
+#include <QDateTime>
 
 #include "repeatingoption.h"
 
@@ -46,6 +47,7 @@ public:
 
     bool isValid() const;
     bool evaluate(const QDateTime &dateTime) const;
+    QDateTime nextTransition(const QDateTime &dateTime) const;
 
 private:
     QDateTime m_dateTime;
@@ -61,6 +63,8 @@ private:
     bool evaluateMonthly(const QDateTime &dateTime) const;
     bool evaluateYearly(const QDateTime &dateTime) const;
 
+    QList<QDateTime> startDateTimes(const QDateTime &dateTime) const;
+
 };
 
 }
@@ -105,4 +105,30 @@ bool TimeDescriptor::evaluate(const QDateTime &lastEvaluationTime, const QDateTi
     return false;
 }
 
+/*! Returns the point in time after the given \a dateTime at which this \l{TimeDescriptor} has to
+    be evaluated again. Until then, \l{evaluate()} will return the same result for all
+    \l{CalendarItem}{CalendarItems} and false for all \l{TimeEventItem}{TimeEventItems}.
+*/
+QDateTime TimeDescriptor::nextEvaluationTime(const QDateTime &dateTime) const
+{
+    // Evaluate at least once a day, daylight saving time changes can shift the transitions
+    QDateTime nextEvaluationTime = dateTime.addDays(1);
+
+    foreach (const CalendarItem &calendarItem, m_calendarItems) {
+        QDateTime transition = calendarItem.nextTransition(dateTime);
+        if (transition.isValid() && transition < nextEvaluationTime) {
+            nextEvaluationTime = transition;
+        }
+    }
+
+    foreach (const TimeEventItem &timeEventItem, m_timeEventItems) {
+        QDateTime occurrence = timeEventItem.nextOccurrence(dateTime);
+        if (occurrence.isValid() && occurrence < nextEvaluationTime) {
+            nextEvaluationTime = occurrence;
+        }
+    }
+
+    return nextEvaluationTime;
+}
+
 }
@@ -42,6 +42,7 @@ public:
     bool isEmpty() const;
 
     bool evaluate(const QDateTime &lastEvaluationTime, const QDateTime &dateTime) const;
+    QDateTime nextEvaluationTime(const QDateTime &dateTime) const;
 
 //    void dumpToSettings(GuhSettings &settings, const QString &groupName) const;
 //    static TimeDescriptor loadFromSettings(GuhSettings &settings, const QString &groupPrefix);
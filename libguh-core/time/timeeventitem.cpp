@@ -132,4 +132,45 @@ bool TimeEventItem::evaluate(const QDateTime &lastEvaluationTime, const QDateTim
     return lastEvaluationTime < m_dateTime && m_dateTime <= dateTime;
 }
 
+/*! Returns the first point in time after the given \a dateTime at which this \l{TimeEventItem}
+    can match, or an invalid QDateTime if it will never match again. Week and month day
+    restrictions are not taken into account, they are checked in \l{evaluate()}.
+*/
+QDateTime TimeEventItem::nextOccurrence(const QDateTime &dateTime) const
+{
+    if (m_time.isValid()) {
+        QDateTime occurrence = dateTime;
+        switch (m_repeatingOption.mode()) {
+        case RepeatingOption::RepeatingModeYearly:
+            return QDateTime();
+        case RepeatingOption::RepeatingModeHourly:
+            occurrence.setTime(QTime(dateTime.time().hour(), m_time.minute(), m_time.second()));
+            if (occurrence <= dateTime)
+                occurrence = occurrence.addSecs(3600);
+
+            return occurrence;
+        default:
+            occurrence.setTime(m_time);
+            if (occurrence <= dateTime)
+                occurrence = occurrence.addDays(1);
+
+            return occurrence;
+        }
+    }
+
+    if (m_repeatingOption.mode() == RepeatingOption::RepeatingModeYearly) {
+        QDateTime occurrence = m_dateTime;
+        occurrence.setDate(QDate(dateTime.date().year(), m_dateTime.date().month(), m_dateTime.date().day()));
+        if (!occurrence.isValid() || occurrence <= dateTime)
+            occurrence.setDate(QDate(dateTime.date().year() + 1, m_dateTime.date().month(), m_dateTime.date().day()));
+
+        return occurrence;
+    }
+
+    if (m_dateTime > dateTime)
+        return m_dateTime;
+
+    return QDateTime();
+}
+
 }
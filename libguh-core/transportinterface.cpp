@@ -54,12 +54,14 @@
     \sa WebSocketServer::stopServer(), TcpServer::stopServer()
 */
 
-/*! \fn void guhserver::TransportInterface::sendData(const QUuid &clientId, const QVariantMap &data);
+/*! \fn void guhserver::TransportInterface::sendData(const QUuid &clientId, const QByteArray &data);
     Pure virtual method for sending \a data to the client with the id \a clientId over the corresponding \l{TransportInterface}.
+    The transport adds its own message framing.
 */
 
-/*! \fn void guhserver::TransportInterface::sendData(const QList<QUuid> &clients, const QVariantMap &data);
-    Pure virtual method for sending \a data to \a clients over the corresponding \l{TransportInterface}.
+/*! \fn void guhserver::TransportInterface::sendData(const QList<QUuid> &clients, const QByteArray &data);
+    Pure virtual method for sending the same \a data to all \a clients over the corresponding \l{TransportInterface}.
+    The \a data is encoded once by the caller and shared by all clients, implementations must not copy it per client.
 */
 
 /*! \fn void guhserver::TransportInterface::dataAvailable(const QUuid &clientId, const QString &targetNamespace, const QString &method, const QVariantMap &message);
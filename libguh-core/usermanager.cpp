@@ -45,6 +45,7 @@ UserManager::UserManager(QObject *parent) : QObject(parent)
         return;
     }
     initDB();
+    loadCache();
 
     m_pushButtonDBusService = new PushButtonDBusService("/io/guh/nymead/UserManager", this);
     connect(m_pushButtonDBusService, &PushButtonDBusService::pushButtonPressed, this, &UserManager::onPushButtonPressed);
@@ -53,13 +54,7 @@ UserManager::UserManager(QObject *parent) : QObject(parent)
 
 QStringList UserManager::users() const
 {
-    QString userQuery("SELECT username FROM users;");
-    QSqlQuery result = m_db.exec(userQuery);
-    QStringList ret;
-    while (result.next()) {
-        ret << result.value("username").toString();
-    }
-    return ret;
+    return m_users;
 }
 
 UserManager::UserError UserManager::createUser(const QString &username, const QString &password)
@@ -93,6 +88,7 @@ UserManager::UserError UserManager::createUser(const QString &username, const QS
         qCWarning(dcUserManager) << "Error creating user:" << m_db.lastError().databaseText() << m_db.lastError().driverText();
         return UserErrorBackendError;
     }
+    loadCache();
     return UserErrorNoError;
 }
 
@@ -107,6 +103,8 @@ UserManager::UserError UserManager::removeUser(const QString &username)
     QString dropTokensQuery = QString("DELETE FROM tokens WHERE lower(username) = \"%1\";").arg(username.toLower());
     m_db.exec(dropTokensQuery);
 
+    loadCache();
+    emit tokensRevoked();
     return UserErrorNoError;
 }
 
@@ -149,6 +147,7 @@ QByteArray UserManager::authenticate(const QString &username, const QString &pas
         qCWarning(dcUserManager) << "Error storing token in DB:" << m_db.lastError().databaseText() << m_db.lastError().driverText();
         return QByteArray();
     }
+    loadCache();
     return token;
 }
 
@@ -183,23 +182,13 @@ void UserManager::cancelPushButtonAuth(int transactionId)
 
 QString UserManager::userForToken(const QByteArray &token) const
 {
-    if (!validateToken(token)) {
-        qCWarning(dcUserManager) << "Token failed character validation:" << token;
-        return QString();
-    }
-    QString getUserQuery = QString("SELECT * FROM tokens WHERE token = \"%1\";")
-            .arg(QString::fromUtf8(token));
-    QSqlQuery result = m_db.exec(getUserQuery);
-    if (m_db.lastError().type() != QSqlError::NoError) {
-        qCWarning(dcUserManager) << "Error fetching username for token:" << m_db.lastError().databaseText() << m_db.lastError().driverText() << getUserQuery;
-        return QString();
-    }
-    if (!result.first()) {
+    QHash<QByteArray, QString>::const_iterator it = m_tokens.constFind(token);
+    if (it == m_tokens.constEnd()) {
         qCWarning(dcUserManager) << "No such token in DB:" << token;
         return QString();
     }
 
-    return result.value("username").toString();
+    return it.value();
 }
 
 QList<TokenInfo> UserManager::tokens(const QString &username) const
@@ -239,27 +228,17 @@ UserManager::UserError UserManager::removeToken(const QUuid &tokenId)
     }
 
     qCDebug(dcUserManager) << "Token" << tokenId << "removed from DB";
+    loadCache();
+    emit tokensRevoked();
     return UserErrorNoError;
 }
 
 bool UserManager::verifyToken(const QByteArray &token)
 {
-    if (!validateToken(token)) {
-        qCWarning(dcUserManager) << "Token failed character validation" << token;
-        return false;
-    }
-    QString getTokenQuery = QString("SELECT * FROM tokens WHERE token = \"%1\";")
-            .arg(QString::fromUtf8(token));
-    QSqlQuery result = m_db.exec(getTokenQuery);
-    if (m_db.lastError().type() != QSqlError::NoError) {
-        qCWarning(dcUserManager) << "Query for token failed:" << m_db.lastError().databaseText() << m_db.lastError().driverText() << getTokenQuery;
-        return false;
-    }
-    if (!result.first()) {
+    if (!m_tokens.contains(token)) {
         qCDebug(dcUserManager) << "Authorisation failed for token" << token;
         return false;
     }
-    //qCDebug(dcUserManager) << "Token authorized for user" << result.value("username").toString();
     return true;
 }
 
@@ -273,16 +252,25 @@ void UserManager::initDB()
     }
 }
 
-bool UserManager::validateUsername(const QString &username) const
+void UserManager::loadCache()
 {
-    QRegExp validator("(^[a-zA-Z0-9_.+-]+@[a-zA-Z0-9-]+.[a-zA-Z0-9-.]+$)");
-    return validator.exactMatch(username);
+    m_users.clear();
+    QSqlQuery users = m_db.exec("SELECT username FROM users;");
+    while (users.next()) {
+        m_users << users.value("username").toString();
+    }
+
+    m_tokens.clear();
+    QSqlQuery tokens = m_db.exec("SELECT username, token FROM tokens;");
+    while (tokens.next()) {
+        m_tokens.insert(tokens.value("token").toByteArray(), tokens.value("username").toString());
+    }
 }
 
-bool UserManager::validateToken(const QByteArray &token) const
+bool UserManager::validateUsername(const QString &username) const
 {
-    QRegExp validator(QRegExp("(^[a-zA-Z0-9_.+-/=]+$)"));
-    return validator.exactMatch(token);
+    QRegExp validator("(^[a-zA-Z0-9_.+-]+@[a-zA-Z0-9-]+.[a-zA-Z0-9-.]+$)");
+    return validator.exactMatch(username);
 }
 
 void UserManager::onPushButtonPressed()
@@ -305,6 +293,7 @@ void UserManager::onPushButtonPressed()
         qCWarning(dcUserManager) << "Error storing token in DB:" << m_db.lastError().databaseText() << m_db.lastError().driverText();
         emit pushButtonAuthFinished(m_pushButtonTransaction.first, false, QByteArray());
     }
+    loadCache();
     qCDebug(dcUserManager()) << "PushButton Auth succeeded";
     emit pushButtonAuthFinished(m_pushButtonTransaction.first, true, token);
 
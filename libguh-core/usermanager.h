@@ -24,6 +24,8 @@
 #include "tokeninfo.h"
 
 #include <QObject>
+#include <QHash>
+#include <QStringList>
 #include <QSqlDatabase>
 
 namespace guhserver {
@@ -65,11 +67,12 @@ public:
 
 signals:
     void pushButtonAuthFinished(int transactionId, bool success, const QByteArray &token);
+    void tokensRevoked();
 
 private:
     void initDB();
+    void loadCache();
     bool validateUsername(const QString &username) const;
-    bool validateToken(const QByteArray &token) const;
 
 private slots:
     void onPushButtonPressed();
@@ -80,6 +83,10 @@ private:
     int m_pushButtonTransactionIdCounter = 0;
     QPair<int, QString> m_pushButtonTransaction;
 
+    // The users and tokens in the DB, reloaded whenever they change
+    QStringList m_users;
+    QHash<QByteArray, QString> m_tokens; // token -> username
+
 };
 
 }
@@ -137,6 +137,19 @@ void WebServer::sendHttpReply(HttpReply *reply)
     socket = m_clientList.value(reply->clientId());
     if (!socket) {
         qCWarning(dcWebServer) << "Invalid socket pointer! This should never happen!!! Missing clientId in reply?";
+        // nobody else owns chunked replies
+        if (reply->type() == HttpReply::TypeChunked)
+            reply->deleteLater();
+
+        return;
+    }
+
+    // a reply written now would end up in the middle of the streamed payload, the connection gets closed after it
+    if (m_chunkedReplies.contains(socket)) {
+        qCWarning(dcWebServer) << "Dropping reply" << reply->httpStatusCode() << "while streaming a chunked reply on the same connection.";
+        if (reply->type() == HttpReply::TypeChunked)
+            reply->deleteLater();
+
         return;
     }
 
@@ -144,6 +157,32 @@ void WebServer::sendHttpReply(HttpReply *reply)
     reply->packReply();
     qCDebug(dcWebServer) << "respond" << reply->httpStatusCode() << reply->httpReasonPhrase();
     socket->write(reply->data());
+
+    // chunked replies are owned by the server until the last chunk has been written
+    if (reply->type() == HttpReply::TypeChunked) {
+        m_chunkedReplies.insert(socket, reply);
+        connect(socket, &QSslSocket::bytesWritten, this, &WebServer::onBytesWritten, Qt::UniqueConnection);
+        writeChunks(socket);
+    }
+}
+
+void WebServer::writeChunks(QSslSocket *socket)
+{
+    HttpReply *reply = m_chunkedReplies.value(socket);
+    if (!reply)
+        return;
+
+    // only fetch the next chunks if the client keeps up, the rest of the payload stays with the provider
+    while (!reply->chunksFinished() && socket->bytesToWrite() + socket->encryptedBytesToWrite() < 64 * 1024)
+        socket->write(reply->nextChunk());
+
+    if (reply->chunksFinished()) {
+        m_chunkedReplies.remove(socket);
+        if (reply->closeConnection())
+            socket->disconnectFromHost();
+
+        reply->deleteLater();
+    }
 }
 
 bool WebServer::verifyFile(QSslSocket *socket, const QString &fileName)
@@ -292,6 +331,12 @@ void WebServer::readClient()
     // read HTTP request
     QByteArray data = socket->readAll();
 
+    // the connection gets closed once the chunked reply has been streamed, further requests are not answered
+    if (m_chunkedReplies.contains(socket)) {
+        qCWarning(dcWebServer) << "Ignoring request while streaming a chunked reply on the same connection.";
+        return;
+    }
+
     HttpRequest request;
     if (m_incompleteRequests.contains(socket)) {
         qCDebug(dcWebServer) << "Append data to incomlete request";
@@ -438,6 +483,11 @@ void WebServer::readClient()
     reply->deleteLater();
 }
 
+void WebServer::onBytesWritten()
+{
+    writeChunks(static_cast<QSslSocket *>(sender()));
+}
+
 void WebServer::onDisconnected()
 {    
     QSslSocket* socket = static_cast<QSslSocket *>(sender());
@@ -461,6 +511,8 @@ void WebServer::onDisconnected()
     QUuid clientId = m_clientList.key(socket);
     m_clientList.remove(clientId);
     m_incompleteRequests.remove(socket);
+    if (m_chunkedReplies.contains(socket))
+        m_chunkedReplies.take(socket)->deleteLater();
     emit clientDisconnected(clientId);
 
     socket->deleteLater();
@@ -85,6 +85,7 @@ private:
     QHash<QUuid, QSslSocket *> m_clientList;
     QList<WebServerClient *> m_webServerClients;
     QHash<QSslSocket *, HttpRequest> m_incompleteRequests;
+    QHash<QSslSocket *, HttpReply *> m_chunkedReplies;
 
     QtAvahiService *m_avahiService;
     QString m_serverName;
@@ -94,6 +95,7 @@ private:
     bool m_enabled;
 
     bool verifyFile(QSslSocket *socket, const QString &fileName);
+    void writeChunks(QSslSocket *socket);
     QString fileName(const QString &query);
 
     QByteArray createServerXmlDocument(QHostAddress address);
@@ -111,6 +113,7 @@ private slots:
     void readClient();
     void onDisconnected();
     void onEncrypted();
+    void onBytesWritten();
     void onError(QAbstractSocket::SocketError error);
 
     void onAvahiServiceStateChanged(const QtAvahiService::QtAvahiServiceState &state);
@@ -92,7 +92,7 @@ void WebSocketServer::sendData(const QUuid &clientId, const QByteArray &data)
     client = m_clientList.value(clientId);
     if (client) {
         qCDebug(dcWebSocketServerTraffic()) << "Sending data to client" << data;
-        client->sendTextMessage(data + '\n');
+        client->sendTextMessage(QString::fromUtf8(data) + '\n');
     } else {
         qCWarning(dcWebSocketServer()) << "Client" << clientId << "unknown to this transport";
     }
@@ -104,9 +104,17 @@ void WebSocketServer::sendData(const QUuid &clientId, const QByteArray &data)
  */
 void WebSocketServer::sendData(const QList<QUuid> &clients, const QByteArray &data)
 {
-    foreach (const QUuid &client, clients) {
-        sendData(client, data);
+    // Convert the message only once for all clients
+    QString message = QString::fromUtf8(data) + '\n';
+    foreach (const QUuid &clientId, clients) {
+        QWebSocket *client = m_clientList.value(clientId);
+        if (!client) {
+            qCWarning(dcWebSocketServer()) << "Client" << clientId << "unknown to this transport";
+            continue;
+        }
+        client->sendTextMessage(message);
     }
+    qCDebug(dcWebSocketServerTraffic()) << "Sent data to" << clients.count() << "clients" << data;
 }
 
 QHash<QString, QString> WebSocketServer::createTxtRecord()
@@ -758,6 +758,9 @@ void DevicePlugin::loadMetaData()
                 if (st.contains("cached")) {
                     stateType.setCached(st.value("cached").toBool());
                 }
+
+                if (st.contains("timeSeries"))
+                    stateType.setTimeSeries(st.value("timeSeries").toBool());
                 stateTypes.append(stateType);
 
                 // Events for state changed
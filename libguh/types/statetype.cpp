@@ -184,6 +184,19 @@ void StateType::setCached(bool cached)
     m_cached = cached;
 }
 
+/*! Returns true if the values of this StateType are logged in the time series store instead of the log database.
+    This is meant for numeric states changing at a high rate. By default no state is a time series. */
+bool StateType::timeSeries() const
+{
+    return m_timeSeries;
+}
+
+/*! Sets whether the values of this StateType are logged in the time series store to \a timeSeries. */
+void StateType::setTimeSeries(bool timeSeries)
+{
+    m_timeSeries = timeSeries;
+}
+
 StateTypes::StateTypes(const QList<StateType> &other)
 {
     foreach (const StateType &st, other) {
@@ -70,6 +70,9 @@ public:
     bool cached() const;
     void setCached(bool cached);
 
+    bool timeSeries() const;
+    void setTimeSeries(bool timeSeries);
+
 private:
     StateTypeId m_id;
     QString m_name;
@@ -83,6 +86,7 @@ private:
     bool m_ruleRelevant = true;
     bool m_graphRelevant = false;
     bool m_cached = true;
+    bool m_timeSeries = false;
 };
 
 class StateTypes: public QList<StateType>
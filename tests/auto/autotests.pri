@@ -9,9 +9,9 @@ INCLUDEPATH += $$top_srcdir/libguh \
 LIBS += -L$$top_builddir/libguh/ -lguh -L$$top_builddir/plugins/mock/ \
         -L$$top_builddir/libguh-core/ -lguh-core -lssl -lcrypto -laws-iot-sdk-cpp -lmbedtls -lmbedx509 -lmbedcrypto
 
-SOURCES += ../guhtestbase.cpp \
+SOURCES += $$PWD/guhtestbase.cpp \
 
-HEADERS += ../guhtestbase.h \
+HEADERS += $$PWD/guhtestbase.h \
 
 target.path = /usr/tests
 INSTALLS += target
@@ -89,6 +89,8 @@ private slots:
     void getStateValues_data();
     void getStateValues();
 
+    void getRecentStateValues();
+
     void editDevices_data();
     void editDevices();
 
@@ -788,6 +790,52 @@ void TestDevices::getStateValues()
     }
 }
 
+void TestDevices::getRecentStateValues()
+{
+    // Change the int state a few times
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+    foreach (int value, QList<int>() << 111 << 222 << 333) {
+        spy.clear();
+        QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockDevice1Port).arg(mockIntStateId.toString()).arg(value)));
+        QNetworkReply *reply = nam.get(request);
+        connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+        spy.wait();
+    }
+
+    QVariantMap params;
+    params.insert("deviceId", m_mockDeviceId);
+    params.insert("stateTypeId", mockIntStateId);
+    QVariant response = injectAndWait("Devices.GetRecentStateValues", params);
+    verifyDeviceError(response);
+    QVariantList values = response.toMap().value("params").toMap().value("values").toList();
+    QVERIFY(values.count() >= 3);
+    QCOMPARE(values.last().toMap().value("value").toInt(), 333);
+
+    // Only the last two values, oldest first
+    params.insert("count", 2);
+    response = injectAndWait("Devices.GetRecentStateValues", params);
+    verifyDeviceError(response);
+    values = response.toMap().value("params").toMap().value("values").toList();
+    QCOMPARE(values.count(), 2);
+    QCOMPARE(values.first().toMap().value("value").toInt(), 222);
+    QCOMPARE(values.last().toMap().value("value").toInt(), 333);
+    QVERIFY(values.first().toMap().value("timestamp").toLongLong() <= values.last().toMap().value("timestamp").toLongLong());
+
+    params.insert("count", -1);
+    response = injectAndWait("Devices.GetRecentStateValues", params);
+    verifyDeviceError(response, DeviceManager::DeviceErrorInvalidParameter);
+
+    params.remove("count");
+    params.insert("stateTypeId", StateTypeId::createStateTypeId());
+    response = injectAndWait("Devices.GetRecentStateValues", params);
+    verifyDeviceError(response, DeviceManager::DeviceErrorStateTypeNotFound);
+
+    params.insert("deviceId", DeviceId::createDeviceId());
+    response = injectAndWait("Devices.GetRecentStateValues", params);
+    verifyDeviceError(response, DeviceManager::DeviceErrorDeviceNotFound);
+}
+
 void TestDevices::editDevices_data()
 {
     QTest::addColumn<QString>("name");
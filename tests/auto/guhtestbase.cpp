@@ -36,6 +36,7 @@
 #include <QDebug>
 #include <QMetaType>
 #include <QNetworkReply>
+#include <QFile>
 
 using namespace guhserver;
 
@@ -129,6 +130,7 @@ void GuhTestBase::initTestCase()
     qDebug() << "Reset test settings";
     GuhSettings rulesSettings(GuhSettings::SettingsRoleRules);
     rulesSettings.clear();
+    QFile::remove(GuhSettings::settingsPath() + "/rules.sqlite");
     GuhSettings deviceSettings(GuhSettings::SettingsRoleDevices);
     deviceSettings.clear();
     GuhSettings pluginSettings(GuhSettings::SettingsRolePlugins);
@@ -224,6 +226,14 @@ void GuhTestBase::cleanup()
     }
 }
 
+void GuhTestBase::setDebugLoggingEnabled(const QString &category, bool enabled)
+{
+    s_loggingFilters.insert(category, enabled);
+
+    // Installing the filter again applies it to all existing categories
+    QLoggingCategory::installFilter(loggingCategoryFilter);
+}
+
 QVariant GuhTestBase::injectAndWait(const QString &method, const QVariantMap &params, const QUuid &clientId)
 {
     QVariantMap call;
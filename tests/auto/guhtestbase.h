@@ -118,6 +118,8 @@ protected:
     bool enableNotifications();
     bool disableNotifications();
 
+    void setDebugLoggingEnabled(const QString &category, bool enabled);
+
     inline void verifyError(const QVariant &response, const QString &fieldName, const QString &error)
     {
         QJsonDocument jsonDoc = QJsonDocument::fromVariant(response);
@@ -23,6 +23,7 @@
 #include "guhcore.h"
 #include "devicemanager.h"
 #include "mocktcpserver.h"
+#include "jsonvalidator.h"
 #include "../../utils/pushbuttonagent.h"
 
 #include <QtTest/QtTest>
@@ -52,6 +53,11 @@ private slots:
 
     void introspect();
 
+    void batchRequest();
+
+    void compiledValidator_data();
+    void compiledValidator();
+
     void enableDisableNotifications_data();
     void enableDisableNotifications();
 
@@ -64,6 +70,11 @@ private slots:
 
     void stateChangeEmitsNotifications();
 
+    void notificationFanOut();
+
+    void notificationSubscription();
+    void notificationSubscriptionDeviceFilter();
+
     void pluginConfigChangeEmitsNotification();
 
     /*
@@ -415,6 +426,51 @@ void TestJSONRPC::testRevokeToken()
     response = jsonDoc.toVariant().toMap();
     qWarning() << "Calling Version with valid token:" << response.value("status").toString() << response.value("error").toString();
     QCOMPARE(response.value("status").toString(), QStringLiteral("unauthorized"));
+
+    // A token bound to another connection must be revoked as well
+    QVariantMap params;
+    params.insert("username", "dummy@guh.io");
+    params.insert("password", "DummyPW1!");
+    params.insert("deviceName", "testcase");
+    response = injectAndWait("JSONRPC.Authenticate", params).toMap();
+    QCOMPARE(response.value("params").toMap().value("success").toBool(), true);
+    QByteArray boundToken = response.value("params").toMap().value("token").toByteArray();
+
+    QUuid otherClientId = QUuid::createUuid();
+    m_mockTcpServer->clientConnected(otherClientId);
+    spy.clear();
+    m_mockTcpServer->injectData(otherClientId, "{\"id\": 555, \"token\": \"" + boundToken + "\", \"method\": \"JSONRPC.Version\"}");
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QVERIFY(spy.count() == 1);
+    response = QJsonDocument::fromJson(spy.first().at(1).toByteArray()).toVariant().toMap();
+    QCOMPARE(response.value("status").toString(), QStringLiteral("success"));
+
+    response = injectAndWait("JSONRPC.Tokens").toMap();
+    QUuid boundTokenId;
+    foreach (const QVariant &tokenInfo, response.value("params").toMap().value("tokenInfoList").toList()) {
+        if (tokenInfo.toMap().value("id").toUuid() != oldTokenId) {
+            boundTokenId = tokenInfo.toMap().value("id").toUuid();
+        }
+    }
+    QVERIFY(!boundTokenId.isNull());
+
+    params.clear();
+    params.insert("tokenId", boundTokenId);
+    response = injectAndWait("JSONRPC.RemoveToken", params).toMap();
+    QCOMPARE(response.value("params").toMap().value("error").toString(), QString("UserErrorNoError"));
+
+    spy.clear();
+    m_mockTcpServer->injectData(otherClientId, "{\"id\": 555, \"token\": \"" + boundToken + "\", \"method\": \"JSONRPC.Version\"}");
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QVERIFY(spy.count() == 1);
+    response = QJsonDocument::fromJson(spy.first().at(1).toByteArray()).toVariant().toMap();
+    QCOMPARE(response.value("status").toString(), QStringLiteral("unauthorized"));
+
+    m_mockTcpServer->clientDisconnected(otherClientId);
 }
 
 void TestJSONRPC::testBasicCall_data()
@@ -490,6 +546,143 @@ void TestJSONRPC::introspect()
     }
 }
 
+void TestJSONRPC::batchRequest()
+{
+    QVariantMap versionCall;
+    versionCall.insert("id", 1);
+    versionCall.insert("method", "JSONRPC.Version");
+    versionCall.insert("token", m_apiToken);
+
+    QVariantMap actionParams;
+    actionParams.insert("actionTypeId", mockActionIdAsync);
+    actionParams.insert("deviceId", m_mockDeviceId);
+    QVariantMap asyncCall;
+    asyncCall.insert("id", 2);
+    asyncCall.insert("method", "Actions.ExecuteAction");
+    asyncCall.insert("params", actionParams);
+    asyncCall.insert("token", m_apiToken);
+
+    QVariantMap invalidCall;
+    invalidCall.insert("id", 3);
+    invalidCall.insert("method", "JSONRPC.NoSuchMethod");
+    invalidCall.insert("token", m_apiToken);
+
+    QVariantMap unauthorizedCall;
+    unauthorizedCall.insert("id", 4);
+    unauthorizedCall.insert("method", "JSONRPC.Version");
+
+    QVariantList batch;
+    batch << versionCall << asyncCall << invalidCall << unauthorizedCall;
+
+    QSignalSpy spy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    m_mockTcpServer->injectData(m_clientId, QJsonDocument::fromVariant(batch).toJson(QJsonDocument::Compact));
+
+    // All responses arrive together, once the async action has finished
+    QVariantList responses;
+    for (int i = 0; i < 50 && responses.isEmpty(); i++) {
+        if (spy.count() == 0)
+            spy.wait(100);
+
+        while (spy.count() > 0) {
+            QJsonDocument jsonDoc = QJsonDocument::fromJson(spy.takeFirst().at(1).toByteArray());
+            if (jsonDoc.isArray()) {
+                responses = jsonDoc.toVariant().toList();
+            }
+        }
+    }
+    QCOMPARE(responses.count(), 4);
+
+    QCOMPARE(responses.at(0).toMap().value("id").toInt(), 1);
+    QCOMPARE(responses.at(0).toMap().value("status").toString(), QString("success"));
+    QCOMPARE(responses.at(0).toMap().value("params").toMap().value("protocol version").toString(), QString(JSON_PROTOCOL_VERSION));
+
+    QCOMPARE(responses.at(1).toMap().value("id").toInt(), 2);
+    QCOMPARE(responses.at(1).toMap().value("status").toString(), QString("success"));
+    verifyDeviceError(responses.at(1));
+
+    QCOMPARE(responses.at(2).toMap().value("id").toInt(), 3);
+    QCOMPARE(responses.at(2).toMap().value("status").toString(), QString("error"));
+
+    QCOMPARE(responses.at(3).toMap().value("id").toInt(), 4);
+    QCOMPARE(responses.at(3).toMap().value("status").toString(), QString("unauthorized"));
+
+    // An empty batch is an error
+    spy.clear();
+    m_mockTcpServer->injectData(m_clientId, "[]");
+    if (spy.count() == 0)
+        spy.wait();
+    QCOMPARE(spy.count(), 1);
+    QVariantMap response = QJsonDocument::fromJson(spy.first().at(1).toByteArray()).toVariant().toMap();
+    QCOMPARE(response.value("status").toString(), QString("error"));
+}
+
+void TestJSONRPC::compiledValidator_data()
+{
+    QTest::addColumn<QVariantMap>("templateMap");
+    QTest::addColumn<QVariantMap>("map");
+
+    QVariantMap action;
+    action.insert("actionTypeId", mockActionIdNoParams);
+    action.insert("deviceId", m_mockDeviceId);
+
+    QVariantMap stateDescriptor;
+    stateDescriptor.insert("stateTypeId", mockIntStateId);
+    stateDescriptor.insert("deviceId", m_mockDeviceId);
+    stateDescriptor.insert("value", 20);
+    stateDescriptor.insert("operator", JsonTypes::valueOperatorToString(Types::ValueOperatorGreater));
+
+    QVariantMap childEvaluator;
+    childEvaluator.insert("stateDescriptor", stateDescriptor);
+
+    QVariantMap stateEvaluator;
+    stateEvaluator.insert("operator", JsonTypes::stateOperatorToString(Types::StateOperatorAnd));
+    stateEvaluator.insert("childEvaluators", QVariantList() << childEvaluator << childEvaluator);
+
+    QVariantMap rule;
+    rule.insert("name", "Compiled");
+    rule.insert("actions", QVariantList() << action);
+    rule.insert("stateEvaluator", stateEvaluator);
+
+    QVariantMap missingActions = rule;
+    missingActions.remove("actions");
+
+    QVariantMap forbiddenKey = rule;
+    forbiddenKey.insert("foo", "bar");
+
+    QVariantMap invalidChild = childEvaluator;
+    invalidChild.insert("foo", "bar");
+    QVariantMap invalidStateEvaluator = stateEvaluator;
+    invalidStateEvaluator.insert("childEvaluators", QVariantList() << childEvaluator << invalidChild);
+    QVariantMap nestedForbiddenKey = rule;
+    nestedForbiddenKey.insert("stateEvaluator", invalidStateEvaluator);
+
+    QVariantMap invalidOperator = stateEvaluator;
+    invalidOperator.insert("operator", "StateOperatorXor");
+    QVariantMap invalidEnum = rule;
+    invalidEnum.insert("stateEvaluator", invalidOperator);
+
+    QTest::newRow("valid rule") << JsonTypes::newRuleDescription() << rule;
+    QTest::newRow("missing key") << JsonTypes::newRuleDescription() << missingActions;
+    QTest::newRow("forbidden key") << JsonTypes::newRuleDescription() << forbiddenKey;
+    QTest::newRow("nested forbidden key") << JsonTypes::newRuleDescription() << nestedForbiddenKey;
+    QTest::newRow("invalid enum value") << JsonTypes::newRuleDescription() << invalidEnum;
+    QTest::newRow("empty map") << JsonTypes::newRuleDescription() << QVariantMap();
+}
+
+void TestJSONRPC::compiledValidator()
+{
+    QFETCH(QVariantMap, templateMap);
+    QFETCH(QVariantMap, map);
+
+    // The compiled validator must give the very same result as walking the template
+    JsonValidator validator(templateMap);
+    QVERIFY(validator.isValid());
+    QPair<bool, QString> expected = JsonTypes::validateMap(templateMap, map);
+    QPair<bool, QString> result = validator.validate(map);
+    QCOMPARE(result.first, expected.first);
+    QCOMPARE(result.second, expected.second);
+}
+
 void TestJSONRPC::enableDisableNotifications_data()
 {
     QTest::addColumn<QString>("enabled");
@@ -896,6 +1089,163 @@ void TestJSONRPC::stateChangeEmitsNotifications()
     QCOMPARE(response.toMap().value("params").toMap().value("value").toInt(), newVal);
 }
 
+void TestJSONRPC::notificationFanOut()
+{
+    QCOMPARE(enableNotifications(), true);
+
+    // Connect a second client and enable notifications for it too
+    QUuid secondClientId = QUuid::createUuid();
+    m_mockTcpServer->clientConnected(secondClientId);
+    QVariantMap params;
+    params.insert("enabled", true);
+    QVariant response = injectAndWait("JSONRPC.SetNotificationStatus", params, secondClientId);
+    QCOMPARE(response.toMap().value("params").toMap().value("enabled").toBool(), true);
+
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    // trigger state change in mock device
+    QNetworkAccessManager nam;
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockDevice1Port).arg(mockIntStateId.toString()).arg(67)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    QSignalSpy replySpy(reply, SIGNAL(finished()));
+    replySpy.wait();
+
+    // Both clients must receive the very same payload for each notification
+    QList<QByteArray> firstClientData;
+    QList<QByteArray> secondClientData;
+    for (int i = 0; i < clientSpy.count(); i++) {
+        QUuid clientId = clientSpy.at(i).at(0).toUuid();
+        if (clientId == m_clientId) {
+            firstClientData.append(clientSpy.at(i).at(1).toByteArray());
+        } else if (clientId == secondClientId) {
+            secondClientData.append(clientSpy.at(i).at(1).toByteArray());
+        }
+    }
+    QVERIFY2(!firstClientData.isEmpty(), "Did not get any notification on the first client.");
+    QCOMPARE(firstClientData, secondClientData);
+
+    m_mockTcpServer->clientDisconnected(secondClientId);
+    QCOMPARE(disableNotifications(), true);
+}
+
+void TestJSONRPC::notificationSubscription()
+{
+    // Connect a client which is only interested in the int state of the mock device
+    QUuid panelId = QUuid::createUuid();
+    m_mockTcpServer->clientConnected(panelId);
+    QVariantMap params;
+    params.insert("namespaces", QVariantList() << "Devices");
+    params.insert("deviceIds", QVariantList() << m_mockDeviceId);
+    params.insert("stateTypeIds", QVariantList() << mockIntStateId);
+    QVariant response = injectAndWait("JSONRPC.SetNotificationSubscription", params, panelId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+    QCOMPARE(response.toMap().value("params").toMap().value("enabled").toBool(), true);
+
+    QNetworkAccessManager nam;
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    // Change the int state, the panel gets the state change but no events or log entries
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockDevice1Port).arg(mockIntStateId.toString()).arg(73)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    QSignalSpy replySpy(reply, SIGNAL(finished()));
+    replySpy.wait();
+
+    QStringList notifications;
+    for (int i = 0; i < clientSpy.count(); i++) {
+        if (clientSpy.at(i).at(0).toUuid() != panelId)
+            continue;
+
+        QVariantMap notification = QJsonDocument::fromJson(clientSpy.at(i).at(1).toByteArray()).toVariant().toMap();
+        notifications.append(notification.value("notification").toString());
+        QCOMPARE(notification.value("params").toMap().value("stateTypeId").toUuid(), QUuid(mockIntStateId));
+    }
+    QCOMPARE(notifications, QStringList() << "Devices.StateChanged");
+
+    // Change the bool state, the panel is not subscribed to it
+    params.clear();
+    params.insert("deviceId", m_mockDeviceId);
+    params.insert("stateTypeId", mockBoolStateId);
+    response = injectAndWait("Devices.GetStateValue", params);
+    bool boolValue = response.toMap().value("params").toMap().value("value").toBool();
+
+    clientSpy.clear();
+    request.setUrl(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockDevice1Port).arg(mockBoolStateId.toString()).arg(!boolValue)));
+    reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    QSignalSpy replySpy2(reply, SIGNAL(finished()));
+    replySpy2.wait();
+
+    for (int i = 0; i < clientSpy.count(); i++) {
+        QVERIFY2(clientSpy.at(i).at(0).toUuid() != panelId, "Got a notification the panel is not subscribed to.");
+    }
+
+    // Enabling all notifications again drops the filter
+    params.clear();
+    params.insert("enabled", true);
+    response = injectAndWait("JSONRPC.SetNotificationStatus", params, panelId);
+    QCOMPARE(response.toMap().value("params").toMap().value("enabled").toBool(), true);
+
+    clientSpy.clear();
+    request.setUrl(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockDevice1Port).arg(mockBoolStateId.toString()).arg(boolValue)));
+    reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    QSignalSpy replySpy3(reply, SIGNAL(finished()));
+    replySpy3.wait();
+
+    bool found = false;
+    for (int i = 0; i < clientSpy.count(); i++) {
+        if (clientSpy.at(i).at(0).toUuid() == panelId && clientSpy.at(i).at(1).toByteArray().contains("Events.EventTriggered"))
+            found = true;
+    }
+    QVERIFY2(found, "Did not get the Events.EventTriggered notification after enabling all notifications.");
+
+    m_mockTcpServer->clientDisconnected(panelId);
+}
+
+void TestJSONRPC::notificationSubscriptionDeviceFilter()
+{
+    // Connect many panels, each one only interested in its own device
+    QList<QUuid> panelIds;
+    for (int i = 0; i < 50; i++) {
+        QUuid panelId = QUuid::createUuid();
+        m_mockTcpServer->clientConnected(panelId);
+        QVariantMap params;
+        params.insert("deviceIds", QVariantList() << (i == 25 ? QUuid(m_mockDeviceId) : QUuid::createUuid()));
+        QVariant response = injectAndWait("JSONRPC.SetNotificationSubscription", params, panelId);
+        QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+        panelIds.append(panelId);
+    }
+    QUuid matchingPanelId = panelIds.at(25);
+
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    QNetworkAccessManager nam;
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockDevice1Port).arg(mockIntStateId.toString()).arg(74)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    QSignalSpy replySpy(reply, SIGNAL(finished()));
+    replySpy.wait();
+
+    // Only the panel of the mock device gets the notifications
+    QStringList notifications;
+    for (int i = 0; i < clientSpy.count(); i++) {
+        QUuid clientId = clientSpy.at(i).at(0).toUuid();
+        if (clientId == matchingPanelId) {
+            QVariantMap notification = QJsonDocument::fromJson(clientSpy.at(i).at(1).toByteArray()).toVariant().toMap();
+            notifications.append(notification.value("notification").toString());
+            continue;
+        }
+        QVERIFY2(!panelIds.contains(clientId), "Got a notification for a device the panel is not subscribed to.");
+    }
+    QVERIFY2(notifications.contains("Devices.StateChanged"), "Did not get the Devices.StateChanged notification of the subscribed device.");
+
+    foreach (const QUuid &panelId, panelIds) {
+        m_mockTcpServer->clientDisconnected(panelId);
+    }
+}
+
 void TestJSONRPC::pluginConfigChangeEmitsNotification()
 {
     QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
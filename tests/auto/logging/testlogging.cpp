@@ -51,6 +51,8 @@ private slots:
 
     void systemLogs();
 
+    void paginatedLogs();
+
     void invalidFilter_data();
     void invalidFilter();
 
@@ -62,6 +64,11 @@ private slots:
 
     void testDoubleValues();
 
+    void stateHistory();
+
+    void logSubscription();
+    void logSubscriptionNotificationScope();
+
     void testHouseKeeping();
 
 
@@ -166,6 +173,59 @@ void TestLogging::systemLogs()
     QCOMPARE(logEntryStartup.value("loggingLevel").toString(), JsonTypes::loggingLevelToString(Logging::LoggingLevelInfo));
 }
 
+void TestLogging::paginatedLogs()
+{
+    QVariantMap params;
+    params.insert("loggingSources", QVariantList() << JsonTypes::loggingSourceToString(Logging::LoggingSourceSystem));
+
+    QVariant response = injectAndWait("Logging.GetLogEntries", params);
+    verifyLoggingError(response);
+    QVariantList allEntries = response.toMap().value("params").toMap().value("logEntries").toList();
+    QVERIFY(allEntries.count() >= 2);
+    QVERIFY(!response.toMap().value("params").toMap().contains("nextCursor"));
+
+    // walk through the entries page by page
+    QVariantList pagedEntries;
+    params.insert("limit", 1);
+    forever {
+        response = injectAndWait("Logging.GetLogEntries", params);
+        verifyLoggingError(response);
+        QVariantList page = response.toMap().value("params").toMap().value("logEntries").toList();
+        QVERIFY(page.count() <= 1);
+        pagedEntries.append(page);
+
+        QString nextCursor = response.toMap().value("params").toMap().value("nextCursor").toString();
+        if (nextCursor.isEmpty())
+            break;
+
+        QVERIFY(pagedEntries.count() < allEntries.count());
+        params.insert("cursor", nextCursor);
+    }
+    QCOMPARE(pagedEntries, allEntries);
+
+    // offset
+    params.remove("cursor");
+    params.insert("offset", 1);
+    response = injectAndWait("Logging.GetLogEntries", params);
+    verifyLoggingError(response);
+    QCOMPARE(response.toMap().value("params").toMap().value("logEntries").toList().first(), allEntries.at(1));
+
+    // descending order
+    params.remove("limit");
+    params.remove("offset");
+    params.insert("descending", true);
+    response = injectAndWait("Logging.GetLogEntries", params);
+    verifyLoggingError(response);
+    QVariantList descendingEntries = response.toMap().value("params").toMap().value("logEntries").toList();
+    QCOMPARE(descendingEntries.count(), allEntries.count());
+    QCOMPARE(descendingEntries.first().toMap().value("timestamp"), allEntries.last().toMap().value("timestamp"));
+
+    // invalid cursor
+    params.insert("cursor", "bla");
+    response = injectAndWait("Logging.GetLogEntries", params);
+    verifyLoggingError(response, Logging::LoggingErrorInvalidFilterParameter);
+}
+
 void TestLogging::invalidFilter_data()
 {
     QVariantMap invalidSourcesFilter;
@@ -553,6 +613,196 @@ void TestLogging::testDoubleValues()
     verifyDeviceError(response);
 }
 
+void TestLogging::stateHistory()
+{
+    uint startDate = QDateTime::currentDateTime().toTime_t() - 60;
+
+    // Log two values of the int state
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+    foreach (int value, QList<int>() << 4321 << 1234) {
+        spy.clear();
+        QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockDevice1Port).arg(mockIntStateId.toString()).arg(value)));
+        QNetworkReply *reply = nam.get(request);
+        connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+        spy.wait();
+    }
+
+    QVariantMap params;
+    params.insert("deviceId", m_mockDeviceId);
+    params.insert("stateTypeId", mockIntStateId);
+    params.insert("startDate", startDate);
+    params.insert("bucketSize", 120);
+    QVariant response = injectAndWait("Logging.GetStateHistory", params);
+    verifyLoggingError(response);
+
+    QVariantList stateHistory = response.toMap().value("params").toMap().value("stateHistory").toList();
+    QCOMPARE(stateHistory.count(), 1);
+    QVariantMap bucket = stateHistory.first().toMap();
+    QCOMPARE(bucket.value("timestamp").toUInt(), startDate);
+    QVERIFY(bucket.value("count").toInt() >= 2);
+    QVERIFY(bucket.value("min").toDouble() <= 1234);
+    QVERIFY(bucket.value("max").toDouble() >= 4321);
+    QCOMPARE(bucket.value("last").toDouble(), 1234.0);
+
+    // Invalid bucket size
+    params.insert("bucketSize", 0);
+    response = injectAndWait("Logging.GetStateHistory", params);
+    verifyLoggingError(response, Logging::LoggingErrorInvalidFilterParameter);
+
+    // Too many buckets
+    params.insert("bucketSize", 1);
+    params.insert("startDate", startDate - 3600);
+    response = injectAndWait("Logging.GetStateHistory", params);
+    verifyLoggingError(response, Logging::LoggingErrorInvalidFilterParameter);
+}
+
+void TestLogging::logSubscription()
+{
+    QCOMPARE(enableNotifications(), true);
+
+    // Subscribe to the state changes of the mock device
+    QVariantMap params;
+    params.insert("enabled", true);
+    params.insert("loggingSources", QVariantList() << JsonTypes::loggingSourceToString(Logging::LoggingSourceStates));
+    params.insert("deviceIds", QVariantList() << m_mockDeviceId);
+    QVariant response = injectAndWait("Logging.SetLogSubscription", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("enabled").toBool(), true);
+
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    // Change the state twice and execute an action, only the state changes should arrive in batches
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+    foreach (int value, QList<int>() << 42 << 43) {
+        spy.clear();
+        QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockDevice1Port).arg(mockIntStateId.toString()).arg(value)));
+        QNetworkReply *reply = nam.get(request);
+        connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+        spy.wait();
+    }
+
+    params.clear();
+    params.insert("actionTypeId", mockActionIdNoParams);
+    params.insert("deviceId", m_mockDeviceId);
+    response = injectAndWait("Actions.ExecuteAction", params);
+    verifyDeviceError(response);
+
+    // Give the batch interval time to pass
+    QTest::qWait(1000);
+
+    QVERIFY2(checkNotifications(clientSpy, "Logging.LogEntryAdded").isEmpty(), "Got a Logging.LogEntryAdded notification while subscribed.");
+
+    QVariantList logEntries;
+    foreach (const QVariant &notification, checkNotifications(clientSpy, "Logging.LogEntriesAdded")) {
+        logEntries.append(notification.toMap().value("params").toMap().value("logEntries").toList());
+    }
+    QVERIFY2(logEntries.count() >= 2, "Did not get the state changes in Logging.LogEntriesAdded notifications.");
+    foreach (const QVariant &logEntry, logEntries) {
+        QCOMPARE(logEntry.toMap().value("source").toString(), JsonTypes::loggingSourceToString(Logging::LoggingSourceStates));
+        QCOMPARE(DeviceId(logEntry.toMap().value("deviceId").toString()), m_mockDeviceId);
+    }
+
+    // Remove the subscription, the entries are notified one by one again
+    params.clear();
+    params.insert("enabled", false);
+    response = injectAndWait("Logging.SetLogSubscription", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("enabled").toBool(), false);
+
+    clientSpy.clear();
+    spy.clear();
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockDevice1Port).arg(mockIntStateId.toString()).arg(44)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    spy.wait();
+    clientSpy.wait(1000);
+
+    QVERIFY2(!checkNotifications(clientSpy, "Logging.LogEntryAdded").isEmpty(), "Did not get Logging.LogEntryAdded notification.");
+    QVERIFY(checkNotifications(clientSpy, "Logging.LogEntriesAdded").isEmpty());
+
+    QCOMPARE(disableNotifications(), true);
+}
+
+void TestLogging::logSubscriptionNotificationScope()
+{
+    // Connect a panel which is only interested in the int state of the mock device and subscribe to its log
+    QUuid panelId = QUuid::createUuid();
+    m_mockTcpServer->clientConnected(panelId);
+    QVariantMap params;
+    params.insert("namespaces", QVariantList() << "Logging");
+    params.insert("deviceIds", QVariantList() << m_mockDeviceId);
+    params.insert("stateTypeIds", QVariantList() << mockIntStateId);
+    QVariant response = injectAndWait("JSONRPC.SetNotificationSubscription", params, panelId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    params.clear();
+    params.insert("enabled", true);
+    params.insert("loggingSources", QVariantList() << JsonTypes::loggingSourceToString(Logging::LoggingSourceStates));
+    response = injectAndWait("Logging.SetLogSubscription", params, panelId);
+    QCOMPARE(response.toMap().value("params").toMap().value("enabled").toBool(), true);
+
+    params.clear();
+    params.insert("deviceId", m_mockDeviceId);
+    params.insert("stateTypeId", mockBoolStateId);
+    response = injectAndWait("Devices.GetStateValue", params);
+    bool boolValue = response.toMap().value("params").toMap().value("value").toBool();
+
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    // Change the int and the bool state, only the int state change should reach the panel
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+    QStringList states;
+    states << QString("%1=%2").arg(mockIntStateId.toString()).arg(45);
+    states << QString("%1=%2").arg(mockBoolStateId.toString()).arg(!boolValue);
+    foreach (const QString &state, states) {
+        spy.clear();
+        QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2").arg(m_mockDevice1Port).arg(state)));
+        QNetworkReply *reply = nam.get(request);
+        connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+        spy.wait();
+    }
+
+    // Give the batch interval time to pass
+    QTest::qWait(1000);
+
+    QVariantList logEntries;
+    for (int i = 0; i < clientSpy.count(); i++) {
+        if (clientSpy.at(i).at(0).toUuid() != panelId)
+            continue;
+
+        QVariantMap notification = QJsonDocument::fromJson(clientSpy.at(i).at(1).toByteArray()).toVariant().toMap();
+        QCOMPARE(notification.value("notification").toString(), QString("Logging.LogEntriesAdded"));
+        logEntries.append(notification.value("params").toMap().value("logEntries").toList());
+    }
+    QVERIFY2(!logEntries.isEmpty(), "Did not get the int state change in a Logging.LogEntriesAdded notification.");
+    foreach (const QVariant &logEntry, logEntries) {
+        QCOMPARE(DeviceId(logEntry.toMap().value("deviceId").toString()), m_mockDeviceId);
+        QCOMPARE(StateTypeId(logEntry.toMap().value("typeId").toString()), mockIntStateId);
+    }
+
+    // Limit the panel to another device, no log entries of the mock device should reach it anymore
+    params.clear();
+    params.insert("namespaces", QVariantList() << "Logging");
+    params.insert("deviceIds", QVariantList() << QUuid::createUuid());
+    response = injectAndWait("JSONRPC.SetNotificationSubscription", params, panelId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    clientSpy.clear();
+    spy.clear();
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockDevice1Port).arg(mockIntStateId.toString()).arg(46)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    spy.wait();
+    QTest::qWait(1000);
+
+    for (int i = 0; i < clientSpy.count(); i++) {
+        QVERIFY2(clientSpy.at(i).at(0).toUuid() != panelId, "Got a log entry of a device the panel is not subscribed to.");
+    }
+
+    m_mockTcpServer->clientDisconnected(panelId);
+}
+
 void TestLogging::testHouseKeeping()
 {
     QVariantMap params;
@@ -589,6 +839,13 @@ void TestLogging::testHouseKeeping()
 
     restartServer();
 
+    // The logs of unknown devices are purged in the background
+    LogEngine *logEngine = GuhCore::instance()->logEngine();
+    QSignalSpy purgeSpy(logEngine, SIGNAL(purgeFinished(QUuid,int)));
+    while (logEngine->pendingPurges() > 0) {
+        QVERIFY(purgeSpy.wait());
+    }
+
     response = injectAndWait("Logging.GetLogEntries", params);
     QVERIFY2(response.toMap().value("params").toMap().value("logEntries").toList().count() == 0, "Device state change event still in log. Should've been cleaned by housekeeping.");
 }
@@ -23,6 +23,12 @@
 #include "logging/logengine.h"
 #include "logging/logvaluetool.h"
 
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSqlRecord>
+#include <QDir>
+
 using namespace guhserver;
 
 class TestLoggingLoading: public QObject
@@ -38,8 +44,32 @@ private slots:
     void testLogMigration();
     void testLogfileRotation();
 
+    void testAsyncWriter();
+
+    void testQueryPlan_data();
+    void testQueryPlan();
+
     void databaseSerializationTest_data();
     void databaseSerializationTest();
+
+    void typedValueTest_data();
+    void typedValueTest();
+
+    void valueFilter();
+
+    void stateHistory();
+
+    void retention();
+
+    void purgeDeviceLogs();
+    void purgeKeepsNewEntries();
+    void purgeRetry();
+
+    void timeSeriesStore();
+    void timeSeriesTruncatedSample();
+    void timeSeriesFlushInterval();
+    void timeSeriesClockStep();
+    void timeSeriesRouting();
 };
 
 TestLoggingLoading::TestLoggingLoading(QObject *parent): QObject(parent)
@@ -74,6 +104,41 @@ void TestLoggingLoading::testLogMigration()
 
     delete logEngine;
 
+    // Check the migrated database got the indexes
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "migrationcheck");
+        db.setDatabaseName(temporaryDbName);
+        QVERIFY(db.open());
+        QSqlQuery query = db.exec("SELECT name FROM sqlite_master WHERE type = 'index' AND tbl_name = 'entries';");
+        QStringList indexes;
+        while (query.next()) {
+            indexes.append(query.value("name").toString());
+        }
+        QVERIFY(indexes.contains("entries_deviceId_timestamp"));
+        QVERIFY(indexes.contains("entries_typeId_timestamp"));
+        QVERIFY(indexes.contains("entries_timestamp"));
+        QVERIFY(indexes.contains("entries_sourceType_timestamp"));
+
+        // All values moved into the typed columns, the legacy value column is gone
+        QSqlRecord columns = db.record("entries");
+        QVERIFY(!columns.contains("value"));
+        QVERIFY(columns.contains("id"));
+        query = db.exec(QString("SELECT COUNT(*) FROM entries WHERE valueType = %1 AND valueText IS NOT NULL;").arg(QVariant::String));
+        QVERIFY(query.next());
+        QVERIFY(query.value(0).toInt() > 0);
+
+        query = db.exec("SELECT data FROM metadata WHERE key = 'version';");
+        QVERIFY(query.next());
+        QCOMPARE(query.value("data").toInt(), 7);
+
+        // The ids of deleted entries are never reused
+        query = db.exec("SELECT name FROM sqlite_sequence WHERE name = 'entries';");
+        QVERIFY(query.next());
+        query.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("migrationcheck");
+
     QVERIFY(QFile(temporaryDbName).remove());
 }
 
@@ -105,6 +170,138 @@ void TestLoggingLoading::testLogfileRotation()
     QVERIFY(QFile(rotatedDbName).remove());
 }
 
+void TestLoggingLoading::testAsyncWriter()
+{
+    QString temporaryDbName = GuhSettings::settingsPath() + "/guhd-writer.sqlite";
+    if (QFile::exists(temporaryDbName))
+        QVERIFY(QFile(temporaryDbName).remove());
+
+    ActionTypeId actionTypeId = ActionTypeId::createActionTypeId();
+    ParamTypeId paramTypeId = ParamTypeId::createParamTypeId();
+    DeviceId deviceId = DeviceId::createDeviceId();
+    int entryCount = 100;
+
+    LogEngine *logEngine = new LogEngine(temporaryDbName, this);
+    QList<int> notifiedValues;
+    connect(logEngine, &LogEngine::logEntryAdded, this, [&notifiedValues](const LogEntry &entry) {
+        notifiedValues.append(entry.value().toInt());
+    });
+
+    // Log a burst of actions, the notifications have to arrive in order
+    for (int i = 0; i < entryCount; i++) {
+        Action action(actionTypeId, deviceId);
+        action.setParams(ParamList() << Param(paramTypeId, i));
+        logEngine->logAction(action);
+    }
+    QCOMPARE(notifiedValues.count(), entryCount);
+    for (int i = 0; i < entryCount; i++) {
+        QCOMPARE(notifiedValues.at(i), i);
+    }
+
+    // Reading includes the entries still waiting in the queue
+    LogFilter filter;
+    filter.addDeviceId(deviceId);
+    QCOMPARE(logEngine->logEntries(filter).count(), entryCount);
+
+    // Queued entries are written on shutdown
+    Action action(actionTypeId, deviceId);
+    action.setParams(ParamList() << Param(paramTypeId, entryCount));
+    logEngine->logAction(action);
+    delete logEngine;
+
+    logEngine = new LogEngine(temporaryDbName, this);
+    QCOMPARE(logEngine->logEntries(filter).count(), entryCount + 1);
+    delete logEngine;
+
+    QVERIFY(QFile(temporaryDbName).remove());
+}
+
+void TestLoggingLoading::testQueryPlan_data()
+{
+    QTest::addColumn<QString>("queryString");
+    QTest::addColumn<QVariantList>("bindValues");
+    QTest::addColumn<QString>("index");
+
+    DeviceId deviceId = DeviceId::createDeviceId();
+
+    LogFilter deviceFilter;
+    deviceFilter.addDeviceId(deviceId);
+
+    LogFilter devicesFilter;
+    devicesFilter.addDeviceId(deviceId);
+    devicesFilter.addDeviceId(DeviceId::createDeviceId());
+
+    LogFilter typeFilter;
+    typeFilter.addTypeId(QUuid::createUuid());
+
+    LogFilter timeFilter;
+    timeFilter.addTimeFilter(QDateTime::currentDateTime().addDays(-1), QDateTime::currentDateTime());
+
+    LogFilter deviceTimeFilter;
+    deviceTimeFilter.addDeviceId(deviceId);
+    deviceTimeFilter.addTimeFilter(QDateTime::currentDateTime().addDays(-1), QDateTime::currentDateTime());
+
+    QString selectString = "SELECT * FROM entries WHERE %1 ORDER BY timestamp;";
+    QTest::newRow("device") << selectString.arg(deviceFilter.queryString()) << deviceFilter.bindValues() << "entries_deviceId_timestamp";
+    QTest::newRow("devices") << selectString.arg(devicesFilter.queryString()) << devicesFilter.bindValues() << "entries_deviceId_timestamp";
+    QTest::newRow("type") << selectString.arg(typeFilter.queryString()) << typeFilter.bindValues() << "entries_typeId_timestamp";
+    QTest::newRow("time") << selectString.arg(timeFilter.queryString()) << timeFilter.bindValues() << "entries_timestamp";
+    QTest::newRow("device and time") << selectString.arg(deviceTimeFilter.queryString()) << deviceTimeFilter.bindValues() << "entries_deviceId_timestamp";
+    QTest::newRow("all") << "SELECT * FROM entries ORDER BY timestamp;" << QVariantList() << "entries_timestamp";
+    QTest::newRow("devices in logs") << QString("SELECT deviceId FROM entries WHERE deviceId != \"%1\" GROUP BY deviceId;").arg(QUuid().toString()) << QVariantList() << "entries_deviceId_timestamp";
+    QTest::newRow("remove device logs") << QString("DELETE FROM entries WHERE deviceId = '%1';").arg(deviceId.toString()) << QVariantList() << "entries_deviceId_timestamp";
+    QTest::newRow("remove rule logs") << QString("DELETE FROM entries WHERE typeId = '%1';").arg(QUuid::createUuid().toString()) << QVariantList() << "entries_typeId_timestamp";
+}
+
+void TestLoggingLoading::testQueryPlan()
+{
+    QFETCH(QString, queryString);
+    QFETCH(QVariantList, bindValues);
+    QFETCH(QString, index);
+
+    QString temporaryDbName = GuhSettings::settingsPath() + "/guhd-queryplan.sqlite";
+    if (QFile::exists(temporaryDbName))
+        QVERIFY(QFile(temporaryDbName).remove());
+
+    LogEngine *logEngine = new LogEngine(temporaryDbName, this);
+    delete logEngine;
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "queryplan");
+        db.setDatabaseName(temporaryDbName);
+        QVERIFY(db.open());
+
+        QSqlQuery query(db);
+        QVERIFY2(query.prepare("EXPLAIN QUERY PLAN " + queryString), qPrintable(query.lastError().databaseText()));
+        for (int i = 0; i < bindValues.count(); i++) {
+            query.bindValue(i, bindValues.at(i));
+        }
+        QVERIFY2(query.exec(), qPrintable(query.lastError().databaseText()));
+
+        QStringList details;
+        while (query.next()) {
+            details.append(query.value("detail").toString());
+        }
+        qDebug() << queryString << details;
+
+        // The query has to use the index instead of a full table scan
+        bool indexUsed = false;
+        foreach (const QString &detail, details) {
+            if (detail.contains(QString("INDEX %1").arg(index)))
+                indexUsed = true;
+
+            QVERIFY2(!detail.startsWith("SCAN") || detail.contains("INDEX"), qPrintable(detail));
+        }
+        QVERIFY2(indexUsed, qPrintable(details.join("; ")));
+
+        query.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("queryplan");
+
+    QVERIFY(QFile(temporaryDbName).remove());
+}
+
 void TestLoggingLoading::databaseSerializationTest_data()
 {
     QUuid uuid = QUuid("3782732b-61b4-48e8-8d6d-b5205159d7cd");
@@ -146,5 +343,646 @@ void TestLoggingLoading::databaseSerializationTest()
     QCOMPARE(deserializedValue, value);
 }
 
+void TestLoggingLoading::typedValueTest_data()
+{
+    databaseSerializationTest_data();
+
+    QTest::newRow("Bool") << QVariant(true);
+    QTest::newRow("UInt") << QVariant((uint)42);
+    QTest::newRow("Invalid") << QVariant();
+}
+
+void TestLoggingLoading::typedValueTest()
+{
+    QFETCH(QVariant, value);
+
+    int valueType = LogValueTool::valueType(value);
+    QVariant storageValue = LogValueTool::storageValue(value);
+    QVariant restoredValue = LogValueTool::restoreValue(valueType, storageValue);
+
+    qDebug() << "Stored:" << value << "in" << LogValueTool::valueColumnName(LogValueTool::valueColumn(valueType));
+    qDebug() << "Loaded:" << restoredValue;
+    QCOMPARE(restoredValue.userType(), value.userType());
+    QCOMPARE(restoredValue, value);
+}
+
+void TestLoggingLoading::valueFilter()
+{
+    QString temporaryDbName = GuhSettings::settingsPath() + "/guhd-values.sqlite";
+    if (QFile::exists(temporaryDbName))
+        QVERIFY(QFile(temporaryDbName).remove());
+
+    ActionTypeId actionTypeId = ActionTypeId::createActionTypeId();
+    ParamTypeId paramTypeId = ParamTypeId::createParamTypeId();
+    DeviceId deviceId = DeviceId::createDeviceId();
+
+    LogEngine *logEngine = new LogEngine(temporaryDbName, this);
+    QVariantList values;
+    values << 7 << 21.5 << true << "hello" << "it's";
+    foreach (const QVariant &value, values) {
+        Action action(actionTypeId, deviceId);
+        action.setParams(ParamList() << Param(paramTypeId, value));
+        logEngine->logAction(action);
+    }
+
+    foreach (const QVariant &value, values) {
+        LogFilter filter;
+        filter.addDeviceId(deviceId);
+        filter.addValue(value.toString());
+        QList<LogEntry> entries = logEngine->logEntries(filter);
+        QCOMPARE(entries.count(), 1);
+        QCOMPARE(entries.first().value().toString(), value.toString());
+    }
+
+    LogFilter filter;
+    filter.addDeviceId(deviceId);
+    filter.addValue("7");
+    filter.addValue("hello");
+    QCOMPARE(logEngine->logEntries(filter).count(), 2);
+
+    // Filters of the same shape share the statement, only the bound values differ
+    LogFilter otherFilter;
+    otherFilter.addDeviceId(DeviceId::createDeviceId());
+    otherFilter.addValue("8");
+    otherFilter.addValue("world");
+    QCOMPARE(otherFilter.queryString(), filter.queryString());
+    QVERIFY(otherFilter.bindValues() != filter.bindValues());
+    QCOMPARE(logEngine->logEntries(otherFilter).count(), 0);
+    QCOMPARE(logEngine->logEntries(filter).count(), 2);
+
+    // Values are never part of the statement
+    LogFilter injectionFilter;
+    injectionFilter.addValue("' OR 1=1 --");
+    QVERIFY(!injectionFilter.queryString().contains("1=1"));
+    QCOMPARE(logEngine->logEntries(injectionFilter).count(), 0);
+
+    delete logEngine;
+    QVERIFY(QFile(temporaryDbName).remove());
+}
+
+void TestLoggingLoading::stateHistory()
+{
+    QString temporaryDbName = GuhSettings::settingsPath() + "/guhd-history.sqlite";
+    if (QFile::exists(temporaryDbName))
+        QVERIFY(QFile(temporaryDbName).remove());
+
+    DeviceId deviceId = DeviceId::createDeviceId();
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+    qint64 startDate = 1500000000;
+
+    // Create the schema and insert samples with known timestamps
+    delete new LogEngine(temporaryDbName, this);
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "history");
+        db.setDatabaseName(temporaryDbName);
+        QVERIFY(db.open());
+        QSqlQuery query(db);
+        query.prepare("INSERT INTO entries (timestamp, loggingLevel, sourceType, typeId, deviceId, valueType, valueInt, valueReal, valueText, loggingEventType, active, errorCode) "
+                      "VALUES (?, 0, ?, ?, ?, ?, ?, ?, ?, 0, 0, 0);");
+
+        // timestamp, device, value
+        QList<QVariantList> samples;
+        samples << (QVariantList() << startDate << deviceId.toString() << 1);
+        samples << (QVariantList() << startDate + 30 << deviceId.toString() << 3.5);
+        samples << (QVariantList() << startDate + 59 << deviceId.toString() << 2);
+        samples << (QVariantList() << startDate + 130 << deviceId.toString() << 10);
+        samples << (QVariantList() << startDate + 130 << deviceId.toString() << 12);
+        samples << (QVariantList() << startDate + 140 << DeviceId::createDeviceId().toString() << 100);
+        samples << (QVariantList() << startDate + 150 << deviceId.toString() << "text");
+        samples << (QVariantList() << startDate + 300 << deviceId.toString() << 1000);
+        foreach (const QVariantList &sample, samples) {
+            QVariant value = sample.at(2);
+            LogValueTool::ValueColumn valueColumn = LogValueTool::valueColumn(LogValueTool::valueType(value));
+            query.bindValue(0, sample.at(0));
+            query.bindValue(1, Logging::LoggingSourceStates);
+            query.bindValue(2, stateTypeId.toString());
+            query.bindValue(3, sample.at(1));
+            query.bindValue(4, LogValueTool::valueType(value));
+            query.bindValue(5, valueColumn == LogValueTool::ValueColumnInteger ? value : QVariant());
+            query.bindValue(6, valueColumn == LogValueTool::ValueColumnReal ? value : QVariant());
+            query.bindValue(7, valueColumn == LogValueTool::ValueColumnText ? value : QVariant());
+            QVERIFY2(query.exec(), query.lastError().databaseText().toUtf8());
+        }
+        query.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("history");
+
+    LogEngine *logEngine = new LogEngine(temporaryDbName, this);
+    QList<StateHistoryBucket> buckets;
+    QCOMPARE(logEngine->stateHistory(deviceId, stateTypeId, QDateTime::fromTime_t(startDate), QDateTime::fromTime_t(startDate + 180), 60, &buckets), Logging::LoggingErrorNoError);
+    QCOMPARE(buckets.count(), 2);
+
+    QCOMPARE(buckets.at(0).timestamp().toTime_t(), (uint)startDate);
+    QCOMPARE(buckets.at(0).count(), 3);
+    QCOMPARE(buckets.at(0).minimum(), 1.0);
+    QCOMPARE(buckets.at(0).maximum(), 3.5);
+    QCOMPARE(buckets.at(0).average(), 6.5 / 3);
+    QCOMPARE(buckets.at(0).last(), 2.0);
+
+    QCOMPARE(buckets.at(1).timestamp().toTime_t(), (uint)startDate + 120);
+    QCOMPARE(buckets.at(1).count(), 2);
+    QCOMPARE(buckets.at(1).minimum(), 10.0);
+    QCOMPARE(buckets.at(1).maximum(), 12.0);
+
+    // Entries within the same second keep the order they have been written
+    QCOMPARE(buckets.at(1).last(), 12.0);
+
+    // Invalid ranges
+    QCOMPARE(logEngine->stateHistory(deviceId, stateTypeId, QDateTime::fromTime_t(startDate), QDateTime::fromTime_t(startDate + 180), 0, &buckets), Logging::LoggingErrorInvalidFilterParameter);
+    QCOMPARE(logEngine->stateHistory(deviceId, stateTypeId, QDateTime::fromTime_t(startDate + 180), QDateTime::fromTime_t(startDate), 60, &buckets), Logging::LoggingErrorInvalidFilterParameter);
+    QCOMPARE(logEngine->stateHistory(deviceId, stateTypeId, QDateTime::fromTime_t(startDate), QDateTime::fromTime_t(startDate + 100000), 1, &buckets), Logging::LoggingErrorInvalidFilterParameter);
+
+    delete logEngine;
+    QVERIFY(QFile(temporaryDbName).remove());
+}
+
+void TestLoggingLoading::retention()
+{
+    QString temporaryDbName = GuhSettings::settingsPath() + "/guhd-retention.sqlite";
+    if (QFile::exists(temporaryDbName))
+        QVERIFY(QFile(temporaryDbName).remove());
+
+    qint64 now = QDateTime::currentDateTime().toTime_t();
+
+    // Create the schema and insert old and new entries of two sources
+    delete new LogEngine(temporaryDbName, this);
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "retention");
+        db.setDatabaseName(temporaryDbName);
+        QVERIFY(db.open());
+        QVERIFY(db.transaction());
+        QSqlQuery query(db);
+        query.prepare("INSERT INTO entries (timestamp, loggingLevel, sourceType, loggingEventType, active, errorCode) VALUES (?, 0, ?, 0, 0, 0);");
+        for (int i = 0; i < 1000; i++) {
+            query.bindValue(0, now - 2 * 86400 + i);
+            query.bindValue(1, i % 2 == 0 ? Logging::LoggingSourceStates : Logging::LoggingSourceActions);
+            QVERIFY(query.exec());
+        }
+        for (int i = 0; i < 10; i++) {
+            query.bindValue(0, now - 60 + i);
+            query.bindValue(1, Logging::LoggingSourceStates);
+            QVERIFY(query.exec());
+        }
+        query.finish();
+        QVERIFY(db.commit());
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("retention");
+
+    LogEngine *logEngine = new LogEngine(temporaryDbName, this);
+    logEngine->setMaxLogEntries(100000, 100);
+    QCOMPARE(logEngine->logEntries().count(), 1010);
+
+    // Expired state changes are removed in chunks in the background
+    QSignalSpy spy(logEngine, SIGNAL(logDatabaseUpdated()));
+    logEngine->setRetentionPolicy(Logging::LoggingSourceStates, 86400);
+    QCOMPARE(logEngine->retentionPolicy(Logging::LoggingSourceStates), 86400);
+    QVERIFY(spy.wait());
+
+    LogFilter statesFilter;
+    statesFilter.addLoggingSource(Logging::LoggingSourceStates);
+    QCOMPARE(logEngine->logEntries(statesFilter).count(), 10);
+
+    LogFilter actionsFilter;
+    actionsFilter.addLoggingSource(Logging::LoggingSourceActions);
+    QCOMPARE(logEngine->logEntries(actionsFilter).count(), 500);
+
+    // Only the latest entries are kept
+    logEngine->setMaxLogEntries(100, 10);
+    QList<LogEntry> entries = logEngine->logEntries();
+    QVERIFY(entries.count() <= 100);
+    QCOMPARE(entries.last().timestamp().toTime_t(), (uint)now - 51);
+
+    delete logEngine;
+    QVERIFY(QFile(temporaryDbName).remove());
+}
+
+void TestLoggingLoading::purgeDeviceLogs()
+{
+    QString temporaryDbName = GuhSettings::settingsPath() + "/guhd-purge.sqlite";
+    if (QFile::exists(temporaryDbName))
+        QVERIFY(QFile(temporaryDbName).remove());
+
+    DeviceId removedDeviceId = DeviceId::createDeviceId();
+    DeviceId otherDeviceId = DeviceId::createDeviceId();
+    qint64 now = QDateTime::currentDateTime().toTime_t();
+
+    // Create the schema and insert the entries of two devices
+    delete new LogEngine(temporaryDbName, this);
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "purge");
+        db.setDatabaseName(temporaryDbName);
+        QVERIFY(db.open());
+        QVERIFY(db.transaction());
+        QSqlQuery query(db);
+        query.prepare("INSERT INTO entries (timestamp, loggingLevel, sourceType, typeId, deviceId, loggingEventType, active, errorCode) VALUES (?, 0, ?, ?, ?, 0, 0, 0);");
+        for (int i = 0; i < 1210; i++) {
+            query.bindValue(0, now - 1210 + i);
+            query.bindValue(1, Logging::LoggingSourceStates);
+            query.bindValue(2, QUuid::createUuid().toString());
+            query.bindValue(3, i < 1200 ? removedDeviceId.toString() : otherDeviceId.toString());
+            QVERIFY(query.exec());
+        }
+        query.finish();
+        QVERIFY(db.commit());
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("purge");
+
+    LogEngine *logEngine = new LogEngine(temporaryDbName, this);
+    logEngine->setMaxLogEntries(100000, 100);
+
+    QSignalSpy progressSpy(logEngine, SIGNAL(purgeProgress(QUuid,int)));
+    QSignalSpy finishedSpy(logEngine, SIGNAL(purgeFinished(QUuid,int)));
+
+    // The purge is only queued, the device is gone from the logs immediately
+    logEngine->removeDeviceLogs(removedDeviceId);
+    QCOMPARE(logEngine->pendingPurges(), 1);
+    QVERIFY(!logEngine->devicesInLogs().contains(removedDeviceId));
+    QVERIFY(logEngine->devicesInLogs().contains(otherDeviceId));
+
+    // Entries logged after the purge was queued are kept
+    Action action(ActionTypeId::createActionTypeId(), removedDeviceId);
+    logEngine->logAction(action);
+
+    // The entries are deleted in chunks of 500 entries
+    QVERIFY(finishedSpy.wait());
+    QCOMPARE(finishedSpy.first().at(0).toUuid(), QUuid(removedDeviceId));
+    QCOMPARE(finishedSpy.first().at(1).toInt(), 1200);
+    QCOMPARE(progressSpy.count(), 3);
+    QCOMPARE(progressSpy.last().at(1).toInt(), 1200);
+    QCOMPARE(logEngine->pendingPurges(), 0);
+
+    LogFilter removedFilter;
+    removedFilter.addDeviceId(removedDeviceId);
+    QCOMPARE(logEngine->logEntries(removedFilter).count(), 1);
+
+    LogFilter otherFilter;
+    otherFilter.addDeviceId(otherDeviceId);
+    QCOMPARE(logEngine->logEntries(otherFilter).count(), 10);
+
+    delete logEngine;
+    QVERIFY(QFile(temporaryDbName).remove());
+}
+
+void TestLoggingLoading::purgeKeepsNewEntries()
+{
+    QString temporaryDbName = GuhSettings::settingsPath() + "/guhd-purge.sqlite";
+    if (QFile::exists(temporaryDbName))
+        QVERIFY(QFile(temporaryDbName).remove());
+
+    DeviceId readdedDeviceId = DeviceId::createDeviceId();
+    DeviceId newestDeviceId = DeviceId::createDeviceId();
+    qint64 now = QDateTime::currentDateTime().toTime_t();
+
+    // The entries of the second device are the newest ones in the database
+    delete new LogEngine(temporaryDbName, this);
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "purge");
+        db.setDatabaseName(temporaryDbName);
+        QVERIFY(db.open());
+        QVERIFY(db.transaction());
+        QSqlQuery query(db);
+        query.prepare("INSERT INTO entries (timestamp, loggingLevel, sourceType, typeId, deviceId, loggingEventType, active, errorCode) VALUES (?, 0, ?, ?, ?, 0, 0, 0);");
+        for (int i = 0; i < 1210; i++) {
+            query.bindValue(0, now - 1210 + i);
+            query.bindValue(1, Logging::LoggingSourceStates);
+            query.bindValue(2, QUuid::createUuid().toString());
+            query.bindValue(3, i < 1200 ? readdedDeviceId.toString() : newestDeviceId.toString());
+            QVERIFY(query.exec());
+        }
+        query.finish();
+        QVERIFY(db.commit());
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("purge");
+
+    LogEngine *logEngine = new LogEngine(temporaryDbName, this);
+    logEngine->setMaxLogEntries(100000, 100);
+
+    QSignalSpy finishedSpy(logEngine, SIGNAL(purgeFinished(QUuid,int)));
+    logEngine->removeDeviceLogs(newestDeviceId);
+    logEngine->removeDeviceLogs(readdedDeviceId);
+    QCOMPARE(logEngine->pendingPurges(), 2);
+
+    // Once the newest entries are gone, the device comes back with the same id while its purge is still pending
+    QVERIFY(finishedSpy.wait());
+    QCOMPARE(finishedSpy.first().at(0).toUuid(), QUuid(newestDeviceId));
+    QCOMPARE(logEngine->pendingPurges(), 1);
+
+    Action action(ActionTypeId::createActionTypeId(), readdedDeviceId);
+    logEngine->logAction(action);
+    logEngine->flush();
+
+    // The new entry does not get the id of a deleted entry, so the pending purge keeps it
+    QVERIFY(finishedSpy.wait());
+    QCOMPARE(finishedSpy.last().at(0).toUuid(), QUuid(readdedDeviceId));
+    QCOMPARE(finishedSpy.last().at(1).toInt(), 1200);
+
+    LogFilter readdedFilter;
+    readdedFilter.addDeviceId(readdedDeviceId);
+    QCOMPARE(logEngine->logEntries(readdedFilter).count(), 1);
+
+    delete logEngine;
+    QVERIFY(QFile(temporaryDbName).remove());
+}
+
+void TestLoggingLoading::purgeRetry()
+{
+    QString temporaryDbName = GuhSettings::settingsPath() + "/guhd-purge.sqlite";
+    if (QFile::exists(temporaryDbName))
+        QVERIFY(QFile(temporaryDbName).remove());
+
+    DeviceId deviceId = DeviceId::createDeviceId();
+    qint64 now = QDateTime::currentDateTime().toTime_t();
+
+    // Insert the entries of a device and make deleting them fail
+    delete new LogEngine(temporaryDbName, this);
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "purge");
+        db.setDatabaseName(temporaryDbName);
+        QVERIFY(db.open());
+        QSqlQuery query(db);
+        query.prepare("INSERT INTO entries (timestamp, loggingLevel, sourceType, typeId, deviceId, loggingEventType, active, errorCode) VALUES (?, 0, ?, ?, ?, 0, 0, 0);");
+        for (int i = 0; i < 10; i++) {
+            query.bindValue(0, now - 10 + i);
+            query.bindValue(1, Logging::LoggingSourceStates);
+            query.bindValue(2, QUuid::createUuid().toString());
+            query.bindValue(3, deviceId.toString());
+            QVERIFY(query.exec());
+        }
+        query.finish();
+        QVERIFY(query.exec("CREATE TRIGGER blockDelete BEFORE DELETE ON entries BEGIN SELECT RAISE(ABORT, 'blocked'); END;"));
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("purge");
+
+    LogEngine *logEngine = new LogEngine(temporaryDbName, this);
+    logEngine->setMaxLogEntries(100000, 100);
+
+    QSignalSpy finishedSpy(logEngine, SIGNAL(purgeFinished(QUuid,int)));
+    logEngine->removeDeviceLogs(deviceId);
+
+    // The failed purge stays pending
+    QTest::qWait(500);
+    QCOMPARE(finishedSpy.count(), 0);
+    QCOMPARE(logEngine->pendingPurges(), 1);
+    QVERIFY(!logEngine->devicesInLogs().contains(deviceId));
+
+    // Once the database accepts the deletion again, the retry finishes the purge
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "purge");
+        db.setDatabaseName(temporaryDbName);
+        QVERIFY(db.open());
+        QSqlQuery query(db);
+        QVERIFY(query.exec("DROP TRIGGER blockDelete;"));
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("purge");
+
+    QVERIFY(finishedSpy.wait(5000));
+    QCOMPARE(finishedSpy.first().at(0).toUuid(), QUuid(deviceId));
+    QCOMPARE(finishedSpy.first().at(1).toInt(), 10);
+    QCOMPARE(logEngine->pendingPurges(), 0);
+
+    LogFilter filter;
+    filter.addDeviceId(deviceId);
+    QVERIFY(logEngine->logEntries(filter).isEmpty());
+
+    delete logEngine;
+    QVERIFY(QFile(temporaryDbName).remove());
+}
+
+void TestLoggingLoading::timeSeriesStore()
+{
+    QString path = GuhSettings::settingsPath() + "/guhd-test.timeseries";
+    QDir(path).removeRecursively();
+
+    DeviceId deviceId = DeviceId::createDeviceId();
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+    QDateTime startDate = QDateTime::fromMSecsSinceEpoch(1500000000000);
+
+    // One sample per second over 5 minutes, in segments of one minute
+    TimeSeriesStore *store = new TimeSeriesStore(path, this);
+    store->setSegmentDuration(60);
+    for (int i = 0; i < 300; i++) {
+        store->append(deviceId, stateTypeId, startDate.addSecs(i), 20.0 + (i % 10) * 0.5);
+    }
+    store->flush();
+
+    QString seriesPath = QString("%1/%2/%3").arg(path).arg(deviceId.toString().mid(1, 36)).arg(stateTypeId.toString().mid(1, 36));
+    QFileInfoList segments = QDir(seriesPath).entryInfoList(QStringList() << "*.seg", QDir::Files);
+    QCOMPARE(segments.count(), 5);
+    qint64 size = 0;
+    foreach (const QFileInfo &segment, segments) {
+        size += segment.size();
+    }
+    qDebug() << "Stored 300 samples in" << size << "bytes";
+    QVERIFY(size < 300 * 8);
+
+    QList<TimeSeriesStore::Sample> samples = store->samples(deviceId, stateTypeId, startDate.addSecs(30), startDate.addSecs(150));
+    QCOMPARE(samples.count(), 120);
+    for (int i = 0; i < samples.count(); i++) {
+        QCOMPARE(samples.at(i).first, startDate.addSecs(30 + i).toMSecsSinceEpoch());
+        QCOMPARE(samples.at(i).second, 20.0 + ((30 + i) % 10) * 0.5);
+    }
+    delete store;
+
+    // Appending continues the latest segment after a restart
+    store = new TimeSeriesStore(path, this);
+    store->setSegmentDuration(60);
+    store->append(deviceId, stateTypeId, startDate.addMSecs(299500), 42);
+    QCOMPARE(QDir(seriesPath).entryList(QStringList() << "*.seg", QDir::Files).count(), 5);
+    samples = store->samples(deviceId, stateTypeId, startDate.addSecs(299), startDate.addSecs(400));
+    QCOMPARE(samples.count(), 2);
+    QCOMPARE(samples.last().second, 42.0);
+    QCOMPARE(store->devices(), QList<DeviceId>() << deviceId);
+
+    // Retention drops whole segments only
+    QCOMPARE(store->dropSegments(startDate.addSecs(150)), 2);
+    samples = store->samples(deviceId, stateTypeId, startDate, startDate.addSecs(400));
+    QCOMPARE(samples.count(), 181);
+    QCOMPARE(samples.first().first, startDate.addSecs(120).toMSecsSinceEpoch());
+
+    store->removeSeries(deviceId);
+    QVERIFY(store->devices().isEmpty());
+    QVERIFY(store->samples(deviceId, stateTypeId, startDate, startDate.addSecs(400)).isEmpty());
+
+    delete store;
+    QVERIFY(QDir(path).removeRecursively());
+}
+
+void TestLoggingLoading::timeSeriesTruncatedSample()
+{
+    QString path = GuhSettings::settingsPath() + "/guhd-test.timeseries";
+    QDir(path).removeRecursively();
+
+    DeviceId deviceId = DeviceId::createDeviceId();
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+    QDateTime startDate = QDateTime::fromMSecsSinceEpoch(1500000000000);
+
+    TimeSeriesStore *store = new TimeSeriesStore(path, this);
+    for (int i = 0; i < 10; i++) {
+        store->append(deviceId, stateTypeId, startDate.addSecs(i), 20.0 + i);
+    }
+    delete store;
+
+    QString seriesPath = QString("%1/%2/%3").arg(path).arg(deviceId.toString().mid(1, 36)).arg(stateTypeId.toString().mid(1, 36));
+    QStringList segments = QDir(seriesPath).entryList(QStringList() << "*.seg", QDir::Files);
+    QCOMPARE(segments.count(), 1);
+
+    // Simulate a crash in the middle of writing a sample: the timestamp delta is written, the value is cut off
+    QFile segment(seriesPath + "/" + segments.first());
+    qint64 validSize = segment.size();
+    QVERIFY(segment.open(QIODevice::WriteOnly | QIODevice::Append));
+    segment.write(QByteArray::fromHex("d00f05ff"));
+    segment.close();
+
+    // Appending after the restart drops the partial sample
+    store = new TimeSeriesStore(path, this);
+    store->append(deviceId, stateTypeId, startDate.addSecs(10), 42);
+    store->flush();
+    QVERIFY(QFileInfo(segment.fileName()).size() > validSize);
+
+    QList<TimeSeriesStore::Sample> samples = store->samples(deviceId, stateTypeId, startDate, startDate.addSecs(60));
+    QCOMPARE(samples.count(), 11);
+    for (int i = 0; i < 10; i++) {
+        QCOMPARE(samples.at(i).first, startDate.addSecs(i).toMSecsSinceEpoch());
+        QCOMPARE(samples.at(i).second, 20.0 + i);
+    }
+    QCOMPARE(samples.last().first, startDate.addSecs(10).toMSecsSinceEpoch());
+    QCOMPARE(samples.last().second, 42.0);
+    delete store;
+
+    // The state resumed after the next restart is intact
+    store = new TimeSeriesStore(path, this);
+    store->append(deviceId, stateTypeId, startDate.addSecs(11), 43);
+    samples = store->samples(deviceId, stateTypeId, startDate.addSecs(10), startDate.addSecs(60));
+    QCOMPARE(samples.count(), 2);
+    QCOMPARE(samples.first().second, 42.0);
+    QCOMPARE(samples.last().first, startDate.addSecs(11).toMSecsSinceEpoch());
+    QCOMPARE(samples.last().second, 43.0);
+
+    delete store;
+    QVERIFY(QDir(path).removeRecursively());
+}
+
+void TestLoggingLoading::timeSeriesFlushInterval()
+{
+    QString path = GuhSettings::settingsPath() + "/guhd-test.timeseries";
+    QDir(path).removeRecursively();
+
+    DeviceId deviceId = DeviceId::createDeviceId();
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+    QDateTime startDate = QDateTime::fromMSecsSinceEpoch(1500000000000);
+
+    TimeSeriesStore *store = new TimeSeriesStore(path, this);
+    store->setFlushInterval(100);
+    QCOMPARE(store->flushInterval(), 100);
+    for (int i = 0; i < 10; i++) {
+        store->append(deviceId, stateTypeId, startDate.addSecs(i), 20.0 + i);
+    }
+
+    // The samples reach the disk without an explicit flush
+    QString seriesPath = QString("%1/%2/%3").arg(path).arg(deviceId.toString().mid(1, 36)).arg(stateTypeId.toString().mid(1, 36));
+    QStringList segments = QDir(seriesPath).entryList(QStringList() << "*.seg", QDir::Files);
+    QCOMPARE(segments.count(), 1);
+    QFileInfo segment(seriesPath + "/" + segments.first());
+    QTRY_VERIFY_WITH_TIMEOUT((segment.refresh(), segment.size() >= 12 + 10 * 3), 2000);
+
+    delete store;
+    QVERIFY(QDir(path).removeRecursively());
+}
+
+void TestLoggingLoading::timeSeriesClockStep()
+{
+    QString path = GuhSettings::settingsPath() + "/guhd-test.timeseries";
+    QDir(path).removeRecursively();
+
+    DeviceId deviceId = DeviceId::createDeviceId();
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+    QDateTime startDate = QDateTime::fromMSecsSinceEpoch(1500000000000);
+
+    TimeSeriesStore *store = new TimeSeriesStore(path, this);
+    store->setSegmentDuration(60);
+    for (int i = 0; i < 90; i++) {
+        store->append(deviceId, stateTypeId, startDate.addSecs(i), i);
+    }
+
+    // The clock steps back by two minutes and recovers
+    for (int i = 0; i < 150; i++) {
+        store->append(deviceId, stateTypeId, startDate.addSecs(-30 + i), 1000 + i);
+    }
+
+    // No segment before the latest one got started, all samples are found and sorted
+    QString seriesPath = QString("%1/%2/%3").arg(path).arg(deviceId.toString().mid(1, 36)).arg(stateTypeId.toString().mid(1, 36));
+    QStringList segments = QDir(seriesPath).entryList(QStringList() << "*.seg", QDir::Files, QDir::Name);
+    QCOMPARE(segments.count(), 2);
+    QCOMPARE(segments.first(), QString("%1.seg").arg(startDate.toMSecsSinceEpoch()));
+
+    QList<TimeSeriesStore::Sample> samples = store->samples(deviceId, stateTypeId, startDate.addSecs(-60), startDate.addSecs(300));
+    QCOMPARE(samples.count(), 240);
+    for (int i = 1; i < samples.count(); i++) {
+        QVERIFY(samples.at(i).first >= samples.at(i - 1).first);
+    }
+
+    // The samples from before the clock recovered keep the latest timestamp
+    QCOMPARE(samples.at(90).first, startDate.addSecs(89).toMSecsSinceEpoch());
+    QCOMPARE(samples.at(90).second, 1000.0);
+    QCOMPARE(samples.last().first, startDate.addSecs(119).toMSecsSinceEpoch());
+    QCOMPARE(samples.last().second, 1149.0);
+
+    delete store;
+    QVERIFY(QDir(path).removeRecursively());
+}
+
+void TestLoggingLoading::timeSeriesRouting()
+{
+    QString temporaryDbName = GuhSettings::settingsPath() + "/guhd-timeseries.sqlite";
+    if (QFile::exists(temporaryDbName))
+        QVERIFY(QFile(temporaryDbName).remove());
+
+    DeviceId deviceId = DeviceId::createDeviceId();
+    StateTypeId stateTypeId = StateTypeId::createStateTypeId();
+
+    LogEngine *logEngine = new LogEngine(temporaryDbName, this);
+    logEngine->setTimeSeriesStateTypes(QList<StateTypeId>() << stateTypeId);
+    QCOMPARE(logEngine->timeSeriesStateTypes(), QList<StateTypeId>() << stateTypeId);
+
+    int notifications = 0;
+    connect(logEngine, &LogEngine::logEntryAdded, this, [&notifications](const LogEntry &) {
+        notifications++;
+    });
+
+    QDateTime startDate = QDateTime::currentDateTime();
+    foreach (double value, QList<double>() << 1 << 5 << 3) {
+        logEngine->logEvent(Event(EventTypeId(stateTypeId.toString()), deviceId, ParamList() << Param(ParamTypeId(stateTypeId.toString()), value), true));
+    }
+    QCOMPARE(notifications, 3);
+
+    // Not in the database, but in the state history
+    LogFilter filter;
+    filter.addDeviceId(deviceId);
+    QVERIFY(logEngine->logEntries(filter).isEmpty());
+    QVERIFY(logEngine->devicesInLogs().contains(deviceId));
+
+    QList<StateHistoryBucket> buckets;
+    QCOMPARE(logEngine->stateHistory(deviceId, stateTypeId, startDate.addSecs(-1), startDate.addSecs(60), 120, &buckets), Logging::LoggingErrorNoError);
+    QCOMPARE(buckets.count(), 1);
+    QCOMPARE(buckets.first().count(), 3);
+    QCOMPARE(buckets.first().minimum(), 1.0);
+    QCOMPARE(buckets.first().maximum(), 5.0);
+    QCOMPARE(buckets.first().average(), 3.0);
+    QCOMPARE(buckets.first().last(), 3.0);
+
+    logEngine->removeDeviceLogs(deviceId);
+    QVERIFY(!logEngine->devicesInLogs().contains(deviceId));
+
+    delete logEngine;
+    QVERIFY(QFile(temporaryDbName).remove());
+    QVERIFY(QDir(temporaryDbName + ".timeseries").removeRecursively());
+}
+
 #include "testloggingloading.moc"
 QTEST_MAIN(TestLoggingLoading)
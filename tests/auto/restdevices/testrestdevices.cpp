@@ -63,6 +63,8 @@ private slots:
     void getStateValue_data();
     void getStateValue();
 
+    void getRecentStateValues();
+
     void editDevices_data();
     void editDevices();
 
@@ -545,6 +547,31 @@ void TestRestDevices::getStateValue()
 
 }
 
+void TestRestDevices::getRecentStateValues()
+{
+    // Change the int state
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+    QNetworkRequest setStateRequest(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockDevice1Port).arg(mockIntStateId.toString()).arg(444)));
+    QNetworkReply *reply = nam.get(setStateRequest);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    spy.wait();
+
+    QNetworkRequest request;
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "text/json");
+    request.setUrl(QUrl(QString("https://localhost:3333/api/v1/devices/%1/states/%2/recent?count=1").arg(m_mockDeviceId.toString()).arg(mockIntStateId.toString())));
+    QVariant response = getAndWait(request);
+    QVariantList values = response.toList();
+    QCOMPARE(values.count(), 1);
+    QCOMPARE(values.first().toMap().value("value").toInt(), 444);
+    QVERIFY(values.first().toMap().contains("timestamp"));
+
+    // Invalid count
+    request.setUrl(QUrl(QString("https://localhost:3333/api/v1/devices/%1/states/%2/recent?count=foo").arg(m_mockDeviceId.toString()).arg(mockIntStateId.toString())));
+    response = getAndWait(request, 400);
+    QCOMPARE(response.toMap().value("error").toString(), JsonTypes::deviceErrorToString(DeviceManager::DeviceErrorInvalidParameter));
+}
+
 void TestRestDevices::editDevices_data()
 {
     QTest::addColumn<QString>("name");
@@ -53,6 +53,8 @@ private slots:
 
     void actionLog();
 
+    void streamedLogs();
+
     // this has to be the last test
     void removeDevice();
 };
@@ -345,6 +347,53 @@ void TestRestLogging::actionLog()
     QCOMPARE(disableNotifications(), true);
 }
 
+void TestRestLogging::streamedLogs()
+{
+    QNetworkRequest request(QUrl("https://localhost:3333/api/v1/logs"));
+    QVariantList allEntries = getAndWait(request).toList();
+    QVERIFY(allEntries.count() >= 2);
+
+    // The connection gets closed after the streamed payload
+    QNetworkAccessManager nam;
+    connect(&nam, &QNetworkAccessManager::sslErrors, [](QNetworkReply *reply, const QList<QSslError> &) {
+        reply->ignoreSslErrors();
+    });
+    QSignalSpy finishedSpy(&nam, SIGNAL(finished(QNetworkReply*)));
+    QNetworkReply *reply = nam.get(request);
+    QVERIFY(finishedSpy.wait());
+    QCOMPARE(reply->rawHeader("Transfer-Encoding"), QByteArray("chunked"));
+    QCOMPARE(reply->rawHeader("Connection"), QByteArray("close"));
+    QCOMPARE(QJsonDocument::fromJson(reply->readAll()).toVariant().toList().count(), allEntries.count());
+    reply->deleteLater();
+
+    QVariantMap filter;
+    filter.insert("limit", 1);
+    QUrl url("https://localhost:3333/api/v1/logs");
+    QUrlQuery query;
+    query.addQueryItem("filter", QJsonDocument::fromVariant(filter).toJson(QJsonDocument::Compact));
+    url.setQuery(query);
+    QVariantList logEntries = getAndWait(QNetworkRequest(url)).toList();
+    QCOMPARE(logEntries.count(), 1);
+    QCOMPARE(logEntries.first(), allEntries.first());
+
+    filter.clear();
+    filter.insert("offset", 1);
+    filter.insert("descending", true);
+    query.clear();
+    query.addQueryItem("filter", QJsonDocument::fromVariant(filter).toJson(QJsonDocument::Compact));
+    url.setQuery(query);
+    logEntries = getAndWait(QNetworkRequest(url)).toList();
+    QCOMPARE(logEntries.count(), allEntries.count() - 1);
+    QCOMPARE(logEntries.last().toMap().value("timestamp"), allEntries.first().toMap().value("timestamp"));
+
+    filter.clear();
+    filter.insert("cursor", "bla");
+    query.clear();
+    query.addQueryItem("filter", QJsonDocument::fromVariant(filter).toJson(QJsonDocument::Compact));
+    url.setQuery(query);
+    getAndWait(QNetworkRequest(url), 400);
+}
+
 void TestRestLogging::removeDevice()
 {
     // enable notifications
@@ -68,11 +68,15 @@ private slots:
 
     void emptyRule();
 
+    void addRemoveRuleBatch();
+
     void editRules_data();
     void editRules();
 
     void enableDisableRule();
 
+    void ruleStatistics();
+
     void executeRuleActions_data();
     void executeRuleActions();
 
@@ -583,6 +587,48 @@ void TestRestRules::emptyRule()
     QCOMPARE(response.toMap().value("error").toString(), JsonTypes::ruleErrorToString(RuleEngine::RuleErrorInvalidRuleFormat));
 }
 
+void TestRestRules::addRemoveRuleBatch()
+{
+    QVariantList rules;
+    rules.append(validIntStateBasedRule("Batch 1", true, true));
+    rules.append(validIntStateBasedRule("Batch 2", true, false));
+
+    // POST a list of rules
+    QNetworkRequest request(QUrl(QString("https://localhost:3333/api/v1/rules")));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "text/json");
+    QVariant response = postAndWait(request, rules);
+    QVariantList addedRules = response.toList();
+    QCOMPARE(addedRules.count(), 2);
+
+    QVariantList ruleIds;
+    for (int i = 0; i < addedRules.count(); i++) {
+        QCOMPARE(addedRules.at(i).toMap().value("name").toString(), rules.at(i).toMap().value("name").toString());
+        ruleIds.append(addedRules.at(i).toMap().value("id"));
+    }
+
+    response = getAndWait(request);
+    QCOMPARE(response.toList().count(), 2);
+
+    // DELETE the list of rules
+    QNetworkAccessManager nam;
+    connect(&nam, &QNetworkAccessManager::sslErrors, [this, &nam](QNetworkReply *reply, const QList<QSslError> &) {
+        reply->ignoreSslErrors();
+    });
+    QSignalSpy clientSpy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    QNetworkReply *reply = nam.sendCustomRequest(request, "DELETE", QJsonDocument::fromVariant(ruleIds).toJson(QJsonDocument::Compact));
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() != 0, "expected at least 1 response from webserver");
+
+    QByteArray data = reply->readAll();
+    verifyReply(reply, data, 200);
+    reply->deleteLater();
+    QCOMPARE(QJsonDocument::fromJson(data).toVariant().toMap().value("error").toString(), JsonTypes::ruleErrorToString(RuleEngine::RuleErrorNoError));
+
+    response = getAndWait(request);
+    QCOMPARE(response.toList().count(), 0);
+}
+
 void TestRestRules::editRules_data()
 {
     // RuleAction
@@ -952,6 +998,73 @@ void TestRestRules::enableDisableRule()
     cleanupRules();
 }
 
+void TestRestRules::ruleStatistics()
+{
+    // ENABLE statistics
+    QNetworkRequest request = QNetworkRequest(QUrl(QString("https://localhost:3333/api/v1/rules/statistics")));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "text/json");
+    QVariantMap enableParams;
+    enableParams.insert("enabled", true);
+    QVariant response = putAndWait(request, enableParams);
+    QVERIFY2(!response.isNull(), "Could not read response");
+
+    QVariantMap addRuleParams;
+    QVariantList events;
+    QVariantMap event1;
+    event1.insert("eventTypeId", mockEvent1Id);
+    event1.insert("deviceId", m_mockDeviceId);
+    events.append(event1);
+    addRuleParams.insert("eventDescriptors", events);
+    addRuleParams.insert("name", "TestRule");
+
+    QVariantList actions;
+    QVariantMap action;
+    action.insert("actionTypeId", mockActionIdNoParams);
+    action.insert("deviceId", m_mockDeviceId);
+    actions.append(action);
+    addRuleParams.insert("actions", actions);
+
+    // ADD rule
+    request = QNetworkRequest(QUrl(QString("https://localhost:3333/api/v1/rules")));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "text/json");
+    response = postAndWait(request, addRuleParams);
+    RuleId ruleId = RuleId(response.toMap().value("id").toString());
+    QVERIFY(!ruleId.isNull());
+
+    // Trigger an event
+    triggerMockEvent();
+    verifyRuleExecuted(mockActionIdNoParams);
+
+    // GET the statistics of all rules
+    request = QNetworkRequest(QUrl(QString("https://localhost:3333/api/v1/rules/statistics")));
+    response = getAndWait(request);
+    QCOMPARE(response.toMap().value("statisticsEnabled").toBool(), true);
+    QCOMPARE(response.toMap().value("ruleStatistics").toList().count(), 1);
+
+    // GET the statistics of the rule
+    request = QNetworkRequest(QUrl(QString("https://localhost:3333/api/v1/rules/%1/statistics").arg(ruleId.toString())));
+    response = getAndWait(request);
+    QCOMPARE(response.toMap().value("evaluations").toInt(), 1);
+    QCOMPARE(response.toMap().value("matches").toInt(), 1);
+    QCOMPARE(response.toMap().value("actionsDispatched").toInt(), 1);
+
+    // DELETE resets the statistics
+    response = deleteAndWait(request);
+    QVERIFY2(!response.isNull(), "Could not read response");
+    response = getAndWait(request);
+    QCOMPARE(response.toMap().value("evaluations").toInt(), 0);
+    QCOMPARE(response.toMap().value("matches").toInt(), 0);
+
+    // DISABLE statistics
+    request = QNetworkRequest(QUrl(QString("https://localhost:3333/api/v1/rules/statistics")));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "text/json");
+    enableParams.insert("enabled", false);
+    response = putAndWait(request, enableParams);
+    QVERIFY2(!response.isNull(), "Could not read response");
+
+    cleanupRules();
+}
+
 void TestRestRules::executeRuleActions_data()
 {
     QTest::addColumn<QVariant>("params");
@@ -23,6 +23,8 @@
 #include "guhcore.h"
 #include "devicemanager.h"
 #include "mocktcpserver.h"
+#include "compiledstateevaluator.h"
+#include "settingsrulestorage.h"
 
 #include <QtTest/QtTest>
 #include <QCoreApplication>
@@ -74,21 +76,31 @@ private slots:
 
     void removeInvalidRule();
 
+    void addRemoveRuleBatch();
+
     void loadStoreConfig();
+    void migrateRuleSettings();
 
     void evaluateEvent();
 
+    void ruleStatistics();
+
     void testStateEvaluator_data();
     void testStateEvaluator();
 
     void testStateEvaluator2_data();
     void testStateEvaluator2();
 
+    void testCompiledStateEvaluator_data();
+    void testCompiledStateEvaluator();
+
     void testChildEvaluator_data();
     void testChildEvaluator();
 
     void testStateChange();
 
+    void getStateEvaluatorResult();
+
     void enableDisableRule();
 
     void testEventBasedAction();
@@ -1032,6 +1044,93 @@ void TestRules::removeInvalidRule()
     verifyRuleError(response, RuleEngine::RuleErrorRuleNotFound);
 }
 
+void TestRules::addRemoveRuleBatch()
+{
+    QCOMPARE(enableNotifications(), true);
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    QVariantMap eventDescriptor;
+    eventDescriptor.insert("eventTypeId", mockEvent1Id);
+    eventDescriptor.insert("deviceId", m_mockDeviceId);
+
+    QVariantMap action;
+    action.insert("actionTypeId", mockActionIdNoParams);
+    action.insert("deviceId", m_mockDeviceId);
+    action.insert("ruleActionParams", QVariantList());
+
+    QVariantList rules;
+    for (int i = 0; i < 3; i++) {
+        QVariantMap rule;
+        rule.insert("name", QString("Batch rule %1").arg(i));
+        rule.insert("eventDescriptors", QVariantList() << eventDescriptor);
+        rule.insert("actions", QVariantList() << action);
+        rules.append(rule);
+    }
+
+    // A single invalid rule rejects the whole batch
+    QVariantMap invalidAction = action;
+    invalidAction.insert("deviceId", DeviceId::createDeviceId());
+    QVariantMap invalidRule = rules.at(1).toMap();
+    invalidRule.insert("actions", QVariantList() << invalidAction);
+
+    QVariantMap params;
+    params.insert("rules", QVariantList() << rules.at(0) << invalidRule << rules.at(2));
+    QVariant response = injectAndWait("Rules.AddRules", params);
+    verifyRuleError(response, RuleEngine::RuleErrorDeviceNotFound);
+    QCOMPARE(response.toMap().value("params").toMap().value("failedIndex").toInt(), 1);
+
+    response = injectAndWait("Rules.GetRules");
+    QCOMPARE(response.toMap().value("params").toMap().value("ruleDescriptions").toList().count(), 0);
+
+    // Add the valid batch
+    clientSpy.clear();
+    params.clear();
+    params.insert("rules", rules);
+    response = injectAndWait("Rules.AddRules", params);
+    clientSpy.wait(2000);
+    verifyRuleError(response);
+
+    QVariantList ruleIds = response.toMap().value("params").toMap().value("ruleIds").toList();
+    QCOMPARE(ruleIds.count(), 3);
+
+    QVariantList notificationRules = checkNotification(clientSpy, "Rules.RulesAdded").toMap().value("params").toMap().value("rules").toList();
+    QCOMPARE(notificationRules.count(), 3);
+    for (int i = 0; i < 3; i++) {
+        QCOMPARE(notificationRules.at(i).toMap().value("id").toString(), ruleIds.at(i).toString());
+        QCOMPARE(notificationRules.at(i).toMap().value("name").toString(), rules.at(i).toMap().value("name").toString());
+    }
+    QVERIFY2(checkNotifications(clientSpy, "Rules.RuleAdded").isEmpty(), "Got a single notification for a batch rule.");
+
+    response = injectAndWait("Rules.GetRules");
+    QCOMPARE(response.toMap().value("params").toMap().value("ruleDescriptions").toList().count(), 3);
+
+    // An unknown id rejects the whole batch
+    params.clear();
+    params.insert("ruleIds", QVariantList() << ruleIds.at(0) << RuleId::createRuleId().toString());
+    response = injectAndWait("Rules.RemoveRules", params);
+    verifyRuleError(response, RuleEngine::RuleErrorRuleNotFound);
+    QCOMPARE(response.toMap().value("params").toMap().value("failedIndex").toInt(), 1);
+
+    response = injectAndWait("Rules.GetRules");
+    QCOMPARE(response.toMap().value("params").toMap().value("ruleDescriptions").toList().count(), 3);
+
+    // Remove the batch
+    clientSpy.clear();
+    params.clear();
+    params.insert("ruleIds", ruleIds);
+    response = injectAndWait("Rules.RemoveRules", params);
+    clientSpy.wait(2000);
+    verifyRuleError(response);
+
+    QVariantList removedRuleIds = checkNotification(clientSpy, "Rules.RulesRemoved").toMap().value("params").toMap().value("ruleIds").toList();
+    QCOMPARE(removedRuleIds.count(), 3);
+
+    response = injectAndWait("Rules.GetRules");
+    QCOMPARE(response.toMap().value("params").toMap().value("ruleDescriptions").toList().count(), 0);
+
+    QCOMPARE(disableNotifications(), true);
+}
+
 void TestRules::loadStoreConfig()
 {
     QVariantMap eventDescriptor1;
@@ -1365,6 +1464,35 @@ void TestRules::loadStoreConfig()
     QVERIFY2(rules.count() == 0, "There should be no rules.");
 }
 
+void TestRules::migrateRuleSettings()
+{
+    // Store a rule the old way, in the rules.conf settings file
+    Rule rule;
+    rule.setId(RuleId::createRuleId());
+    rule.setName("Migrated rule");
+    rule.setEnabled(true);
+    rule.setExecutable(true);
+    rule.setActions(QList<RuleAction>() << RuleAction(mockActionIdNoParams, m_mockDeviceId));
+
+    SettingsRuleStorage settingsStorage;
+    QVERIFY(settingsStorage.storeRule(rule));
+
+    restartServer();
+
+    QVariantMap params;
+    params.insert("ruleId", rule.id());
+    QVariant response = injectAndWait("Rules.GetRuleDetails", params);
+    verifyRuleError(response);
+    QCOMPARE(response.toMap().value("params").toMap().value("rule").toMap().value("name").toString(), QString("Migrated rule"));
+    QVERIFY2(settingsStorage.loadRules().isEmpty(), "The rule settings should be empty after the migration.");
+
+    // The migrated rule is stored in the rule database now
+    restartServer();
+
+    response = injectAndWait("Rules.GetRuleDetails", params);
+    verifyRuleError(response);
+}
+
 void TestRules::evaluateEvent()
 {
     // Add a rule
@@ -1401,6 +1529,113 @@ void TestRules::evaluateEvent()
     verifyRuleExecuted(mockActionIdNoParams);
 }
 
+void TestRules::ruleStatistics()
+{
+    // Statistics are disabled by default
+    QVariant response = injectAndWait("Rules.GetStatistics");
+    verifyRuleError(response);
+    QCOMPARE(response.toMap().value("params").toMap().value("statisticsEnabled").toBool(), false);
+
+    QVariantMap enableParams;
+    enableParams.insert("enabled", true);
+    response = injectAndWait("Rules.SetStatisticsEnabled", enableParams);
+    verifyRuleError(response);
+
+    // Add a rule
+    QVariantMap addRuleParams;
+    addRuleParams.insert("name", "TestRule");
+
+    QVariantList events;
+    QVariantMap event1;
+    event1.insert("eventTypeId", mockEvent1Id);
+    event1.insert("deviceId", m_mockDeviceId);
+    events.append(event1);
+    addRuleParams.insert("eventDescriptors", events);
+
+    QVariantList actions;
+    QVariantMap action;
+    action.insert("actionTypeId", mockActionIdNoParams);
+    action.insert("deviceId", m_mockDeviceId);
+    actions.append(action);
+    addRuleParams.insert("actions", actions);
+    response = injectAndWait("Rules.AddRule", addRuleParams);
+    verifyRuleError(response);
+    RuleId ruleId = RuleId(response.toMap().value("params").toMap().value("ruleId").toString());
+
+    // Trigger an event
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    // trigger event in mock device
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/generateevent?eventtypeid=%2").arg(m_mockDevice1Port).arg(mockEvent1Id.toString())));
+    QNetworkReply *reply = nam.get(request);
+    spy.wait();
+    QCOMPARE(spy.count(), 1);
+    reply->deleteLater();
+
+    verifyRuleExecuted(mockActionIdNoParams);
+
+    // Get the statistics of the rule
+    QVariantMap params;
+    params.insert("ruleId", ruleId);
+    response = injectAndWait("Rules.GetStatistics", params);
+    verifyRuleError(response);
+    QVariantList ruleStatisticsList = response.toMap().value("params").toMap().value("ruleStatistics").toList();
+    QCOMPARE(ruleStatisticsList.count(), 1);
+    QVariantMap ruleStatistics = ruleStatisticsList.first().toMap();
+    QCOMPARE(RuleId(ruleStatistics.value("ruleId").toString()), ruleId);
+    QCOMPARE(ruleStatistics.value("evaluations").toInt(), 1);
+    QCOMPARE(ruleStatistics.value("matches").toInt(), 1);
+    QCOMPARE(ruleStatistics.value("actionsDispatched").toInt(), 1);
+    QVERIFY(ruleStatistics.contains("lastTriggered"));
+
+    // Executing the actions manually counts the dispatched actions only
+    response = injectAndWait("Rules.ExecuteActions", params);
+    verifyRuleError(response);
+    response = injectAndWait("Rules.GetStatistics", params);
+    ruleStatistics = response.toMap().value("params").toMap().value("ruleStatistics").toList().first().toMap();
+    QCOMPARE(ruleStatistics.value("matches").toInt(), 1);
+    QCOMPARE(ruleStatistics.value("actionsDispatched").toInt(), 2);
+
+    // Reset the statistics
+    response = injectAndWait("Rules.ResetStatistics", params);
+    verifyRuleError(response);
+    response = injectAndWait("Rules.GetStatistics", params);
+    ruleStatistics = response.toMap().value("params").toMap().value("ruleStatistics").toList().first().toMap();
+    QCOMPARE(ruleStatistics.value("evaluations").toInt(), 0);
+    QCOMPARE(ruleStatistics.value("matches").toInt(), 0);
+    QCOMPARE(ruleStatistics.value("actionsDispatched").toInt(), 0);
+    QVERIFY(!ruleStatistics.contains("lastTriggered"));
+
+    // Unknown rules
+    QVariantMap invalidParams;
+    invalidParams.insert("ruleId", QUuid::createUuid());
+    response = injectAndWait("Rules.GetStatistics", invalidParams);
+    verifyRuleError(response, RuleEngine::RuleErrorRuleNotFound);
+    response = injectAndWait("Rules.ResetStatistics", invalidParams);
+    verifyRuleError(response, RuleEngine::RuleErrorRuleNotFound);
+
+    // Disabled statistics are not collected
+    enableParams.insert("enabled", false);
+    response = injectAndWait("Rules.SetStatisticsEnabled", enableParams);
+    verifyRuleError(response);
+
+    cleanupMockHistory();
+    spy.clear();
+    reply = nam.get(request);
+    spy.wait();
+    QCOMPARE(spy.count(), 1);
+    reply->deleteLater();
+
+    verifyRuleExecuted(mockActionIdNoParams);
+
+    response = injectAndWait("Rules.GetStatistics", params);
+    verifyRuleError(response);
+    QCOMPARE(response.toMap().value("params").toMap().value("statisticsEnabled").toBool(), false);
+    ruleStatistics = response.toMap().value("params").toMap().value("ruleStatistics").toList().first().toMap();
+    QCOMPARE(ruleStatistics.value("evaluations").toInt(), 0);
+}
+
 void TestRules::testStateChange() {
     // Add a rule
     QVariantMap addRuleParams;
@@ -1478,6 +1713,65 @@ void TestRules::testStateChange() {
     reply->deleteLater();
 }
 
+void TestRules::getStateEvaluatorResult()
+{
+    // Add a rule
+    QVariantMap addRuleParams;
+    QVariantMap stateEvaluator;
+    QVariantMap stateDescriptor;
+    stateDescriptor.insert("deviceId", m_mockDeviceId);
+    stateDescriptor.insert("operator", JsonTypes::valueOperatorToString(Types::ValueOperatorGreaterOrEqual));
+    stateDescriptor.insert("stateTypeId", mockIntStateId);
+    stateDescriptor.insert("value", 42);
+    stateEvaluator.insert("stateDescriptor", stateDescriptor);
+    addRuleParams.insert("stateEvaluator", stateEvaluator);
+    addRuleParams.insert("name", "TestRule");
+
+    QVariantMap action;
+    action.insert("actionTypeId", mockActionIdNoParams);
+    action.insert("deviceId", m_mockDeviceId);
+    addRuleParams.insert("actions", QVariantList() << action);
+    QVariant response = injectAndWait("Rules.AddRule", addRuleParams);
+    verifyRuleError(response);
+    RuleId ruleId = RuleId(response.toMap().value("params").toMap().value("ruleId").toString());
+
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    // set state to 100
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockDevice1Port).arg(mockIntStateId.toString()).arg(100)));
+    QNetworkReply *reply = nam.get(request);
+    spy.wait();
+    QCOMPARE(spy.count(), 1);
+    reply->deleteLater();
+
+    QVariantMap params;
+    params.insert("ruleId", ruleId);
+    response = injectAndWait("Rules.GetStateEvaluatorResult", params);
+    verifyRuleError(response);
+    QVariantMap result = response.toMap().value("params").toMap().value("stateEvaluatorResult").toMap();
+    QVERIFY2(result.value("result").toBool(), "State evaluator result should be true");
+    QCOMPARE(result.value("stateDescriptor").toMap().value("stateTypeId").toString(), mockIntStateId.toString());
+
+    // set state to 30
+    spy.clear();
+    request.setUrl(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockDevice1Port).arg(mockIntStateId.toString()).arg(30)));
+    reply = nam.get(request);
+    spy.wait();
+    QCOMPARE(spy.count(), 1);
+    reply->deleteLater();
+
+    response = injectAndWait("Rules.GetStateEvaluatorResult", params);
+    verifyRuleError(response);
+    result = response.toMap().value("params").toMap().value("stateEvaluatorResult").toMap();
+    QVERIFY2(!result.value("result").toBool(), "State evaluator result should be false");
+
+    verifyRuleError(injectAndWait("Rules.RemoveRule", params));
+
+    response = injectAndWait("Rules.GetStateEvaluatorResult", params);
+    verifyRuleError(response, RuleEngine::RuleErrorRuleNotFound);
+}
+
 void TestRules::testStateEvaluator_data()
 {
     QTest::addColumn<DeviceId>("deviceId");
@@ -1568,6 +1862,41 @@ void TestRules::testStateEvaluator2()
     QVERIFY2(mainEvaluator.evaluate() == shouldMatch, shouldMatch ? "State should match" : "State shouldn't match");
 }
 
+void TestRules::testCompiledStateEvaluator_data()
+{
+    testStateEvaluator2_data();
+}
+
+void TestRules::testCompiledStateEvaluator()
+{
+    QFETCH(int, intValue);
+    QFETCH(Types::ValueOperator, intOperator);
+    QFETCH(bool, boolValue);
+    QFETCH(Types::ValueOperator, boolOperator);
+    QFETCH(Types::StateOperator, stateOperator);
+    QFETCH(bool, shouldMatch);
+
+    StateEvaluator evaluator1(StateDescriptor(mockIntStateId, m_mockDeviceId, intValue, intOperator));
+    StateEvaluator evaluator2(StateDescriptor(mockBoolStateId, m_mockDeviceId, boolValue, boolOperator));
+
+    // Nest the evaluators to make sure the child ranges are resolved correctly
+    QList<StateEvaluator> childEvaluators;
+    childEvaluators.append(StateEvaluator(QList<StateEvaluator>() << evaluator1, Types::StateOperatorAnd));
+    childEvaluators.append(StateEvaluator(QList<StateEvaluator>() << evaluator2, Types::StateOperatorOr));
+
+    StateEvaluator mainEvaluator(childEvaluators);
+    mainEvaluator.setOperatorType(stateOperator);
+
+    CompiledStateEvaluator compiledEvaluator = CompiledStateEvaluator::compile(mainEvaluator);
+    QVERIFY2(!compiledEvaluator.isEmpty(), "Compiled evaluator should not be empty");
+    QVERIFY2(compiledEvaluator.containsDevice(m_mockDeviceId), "Compiled evaluator should contain the mock device");
+    QCOMPARE(compiledEvaluator.evaluate(), mainEvaluator.evaluate());
+    QCOMPARE(compiledEvaluator.result(), compiledEvaluator.evaluate());
+    QCOMPARE(compiledEvaluator.results().count(), 5);
+    QCOMPARE(compiledEvaluator.results().last(), compiledEvaluator.result());
+    QVERIFY2(compiledEvaluator.evaluate() == shouldMatch, shouldMatch ? "State should match" : "State shouldn't match");
+}
+
 void TestRules::testChildEvaluator_data()
 {
     cleanup();
@@ -22,6 +22,7 @@
 #include "guhtestbase.h"
 #include "guhcore.h"
 #include "time/timemanager.h"
+#include "time/calendaritem.h"
 #include "devicemanager.h"
 #include "mocktcpserver.h"
 
@@ -72,6 +73,9 @@ private slots:
     void testCalendarItemStates_data();
     void testCalendarItemStates();
 
+    void testCalendarItemNextTransition_data();
+    void testCalendarItemNextTransition();
+
     void testCalendarItemEvent_data();
     void testCalendarItemEvent();
 
@@ -1038,6 +1042,67 @@ void TestTimeManager::testCalendarYearlyDateTime()
     verifyRuleError(response);
 }
 
+void TestTimeManager::testCalendarItemNextTransition_data()
+{
+    QTest::addColumn<QDateTime>("dateTime");
+    QTest::addColumn<QTime>("startTime");
+    QTest::addColumn<int>("duration");
+    QTest::addColumn<int>("repeatingMode");
+    QTest::addColumn<QList<int> >("weekDays");
+    QTest::addColumn<QList<int> >("monthDays");
+
+    QDateTime yearlyDateTime(QDate(2016, 12, 31), QTime(20, 0));
+    QDateTime onceDateTime(QDate(2017, 1, 5), QTime(10, 0));
+
+    QTest::newRow("hourly") << QDateTime() << QTime(0, 10) << 30 << (int)RepeatingOption::RepeatingModeHourly << QList<int>() << QList<int>();
+    QTest::newRow("daily") << QDateTime() << QTime(22, 0) << 180 << (int)RepeatingOption::RepeatingModeDaily << QList<int>() << QList<int>();
+    QTest::newRow("daily, no repeating option") << QDateTime() << QTime(8, 35) << 20 << (int)RepeatingOption::RepeatingModeNone << QList<int>() << QList<int>();
+    QTest::newRow("weekly") << QDateTime() << QTime(20, 0) << 2000 << (int)RepeatingOption::RepeatingModeWeekly << (QList<int>() << 3 << 7) << QList<int>();
+    QTest::newRow("monthly") << QDateTime() << QTime(8, 0) << 3000 << (int)RepeatingOption::RepeatingModeMonthly << QList<int>() << (QList<int>() << 1 << 31);
+    QTest::newRow("yearly") << yearlyDateTime << QTime() << 600 << (int)RepeatingOption::RepeatingModeYearly << QList<int>() << QList<int>();
+    QTest::newRow("once") << onceDateTime << QTime() << 90 << (int)RepeatingOption::RepeatingModeNone << QList<int>() << QList<int>();
+}
+
+void TestTimeManager::testCalendarItemNextTransition()
+{
+    QFETCH(QDateTime, dateTime);
+    QFETCH(QTime, startTime);
+    QFETCH(int, duration);
+    QFETCH(int, repeatingMode);
+    QFETCH(QList<int>, weekDays);
+    QFETCH(QList<int>, monthDays);
+
+    CalendarItem calendarItem;
+    calendarItem.setDateTime(dateTime);
+    calendarItem.setStartTime(startTime);
+    calendarItem.setDuration(duration);
+    calendarItem.setRepeatingOption(RepeatingOption((RepeatingOption::RepeatingMode)repeatingMode, weekDays, monthDays));
+    QVERIFY(calendarItem.isValid());
+
+    // Walk through 40 days in 5 minute steps, the result may only change at the announced transitions
+    QDateTime currentDateTime(QDate(2016, 12, 20), QTime(0, 0));
+    bool result = calendarItem.evaluate(currentDateTime);
+    QDateTime nextTransition = calendarItem.nextTransition(currentDateTime);
+    int changes = 0;
+
+    for (int i = 0; i < 40 * 24 * 12; i++) {
+        currentDateTime = currentDateTime.addSecs(300);
+        bool currentResult = calendarItem.evaluate(currentDateTime);
+        if (!nextTransition.isValid() || currentDateTime < nextTransition) {
+            QCOMPARE(currentResult, result);
+            continue;
+        }
+
+        if (currentResult != result)
+            changes++;
+
+        result = currentResult;
+        nextTransition = calendarItem.nextTransition(currentDateTime);
+    }
+
+    QVERIFY(changes > 0);
+}
+
 void TestTimeManager::testCalendarItemStates_data()
 {
     initTimeManager();
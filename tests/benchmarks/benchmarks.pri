@@ -0,0 +1,4 @@
+include(../auto/autotests.pri)
+
+# The benchmarks are run on demand, not by "make check"
+CONFIG -= testcase
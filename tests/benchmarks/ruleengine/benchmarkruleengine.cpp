@@ -0,0 +1,344 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2017 Simon Stürz <simon.stuerz@guh.io>                   *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "guhtestbase.h"
+#include "guhcore.h"
+#include "devicemanager.h"
+#include "ruleengine.h"
+#include "time/calendaritem.h"
+#include "time/timeeventitem.h"
+#include "time/repeatingoption.h"
+#include "time/timedescriptor.h"
+#include "time/timemanager.h"
+
+#include <QtTest/QtTest>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QVector>
+
+#include <algorithm>
+
+using namespace guhserver;
+
+// A synthetic setup: rules are spread round robin over the devices. Every fourth rule is
+// time based if the topology has time items, the others are event based and state based.
+struct Topology {
+    int devices;
+    int rules;
+    int depth;
+    bool timeItems;
+};
+Q_DECLARE_METATYPE(Topology)
+
+class BenchmarkRuleEngine : public GuhTestBase
+{
+    Q_OBJECT
+
+private:
+    QList<DeviceId> m_devices;
+
+    void addTopologyRows();
+    QList<Rule> createRules(const Topology &topology);
+    StateEvaluator createStateEvaluator(const Topology &topology, int seed, int depth);
+    TimeDescriptor createTimeDescriptor(int seed);
+    void removeAllRules();
+
+    void report(const QString &name, QVector<qint64> samples, const QString &unit);
+
+private slots:
+    void initTestCase();
+
+    void evaluateEvent_data();
+    void evaluateEvent();
+
+    void evaluateTime_data();
+    void evaluateTime();
+
+    void addRule_data();
+    void addRule();
+
+    void startup_data();
+    void startup();
+};
+
+void BenchmarkRuleEngine::initTestCase()
+{
+    GuhTestBase::initTestCase();
+
+    // Logging each rule would dominate the measurement
+    setDebugLoggingEnabled("RuleEngine", false);
+    setDebugLoggingEnabled("DeviceManager", false);
+
+    // Create as many devices as the biggest topology needs
+    int deviceCount = qMax(100, qgetenv("GUH_BENCHMARK_DEVICES").toInt());
+    m_devices.append(m_mockDeviceId);
+    for (int i = 1; i < deviceCount; i++) {
+        ParamList params;
+        params.append(Param(httpportParamTypeId, m_mockDevice2Port + 1000 + i));
+        DeviceId deviceId = DeviceId::createDeviceId();
+        DeviceManager::DeviceError error = GuhCore::instance()->deviceManager()->addConfiguredDevice(mockDeviceClassId, QString("Benchmark device %1").arg(i), params, deviceId);
+        QCOMPARE(error, DeviceManager::DeviceErrorNoError);
+        m_devices.append(deviceId);
+    }
+}
+
+void BenchmarkRuleEngine::addTopologyRows()
+{
+    QTest::addColumn<Topology>("topology");
+
+    QTest::newRow("10 devices, 100 rules, depth 2") << Topology { 10, 100, 2, true };
+    QTest::newRow("50 devices, 1000 rules, depth 4") << Topology { 50, 1000, 4, true };
+    QTest::newRow("100 devices, 5000 rules, depth 8") << Topology { 100, 5000, 8, true };
+    QTest::newRow("100 devices, 5000 rules, no time items") << Topology { 100, 5000, 4, false };
+
+    // GUH_BENCHMARK_TOPOLOGY="devices,rules,depth,timeItems" adds a custom setup
+    QStringList custom = QString(qgetenv("GUH_BENCHMARK_TOPOLOGY")).split(",");
+    if (custom.count() == 4) {
+        Topology topology = { qMin(custom.at(0).toInt(), m_devices.count()), custom.at(1).toInt(), custom.at(2).toInt(), custom.at(3).toInt() != 0 };
+        QTest::newRow("custom") << topology;
+    }
+}
+
+QList<Rule> BenchmarkRuleEngine::createRules(const Topology &topology)
+{
+    qsrand(topology.rules);
+
+    QList<Rule> rules;
+    for (int i = 0; i < topology.rules; i++) {
+        DeviceId deviceId = m_devices.at(i % topology.devices);
+
+        Rule rule;
+        rule.setId(RuleId::createRuleId());
+        rule.setName(QString("Benchmark rule %1").arg(i));
+        rule.setStateEvaluator(createStateEvaluator(topology, i, topology.depth));
+        rule.setActions(QList<RuleAction>() << RuleAction(mockActionIdNoParams, deviceId));
+
+        if (topology.timeItems && i % 4 == 3) {
+            TimeDescriptor timeDescriptor = createTimeDescriptor(i);
+            rule.setTimeDescriptor(timeDescriptor);
+            if (timeDescriptor.timeEventItems().isEmpty())
+                rule.setExitActions(QList<RuleAction>() << RuleAction(mockActionIdNoParams, deviceId));
+        } else if (i % 2 == 0) {
+            rule.setEventDescriptors(QList<EventDescriptor>() << EventDescriptor(mockEvent1Id, deviceId));
+        } else {
+            rule.setExitActions(QList<RuleAction>() << RuleAction(mockActionIdNoParams, deviceId));
+        }
+        rules.append(rule);
+    }
+    return rules;
+}
+
+StateEvaluator BenchmarkRuleEngine::createStateEvaluator(const Topology &topology, int seed, int depth)
+{
+    if (depth <= 0)
+        return StateEvaluator();
+
+    DeviceId deviceId = m_devices.at((seed + depth) % topology.devices);
+    Types::ValueOperator valueOperator = qrand() % 2 ? Types::ValueOperatorLess : Types::ValueOperatorGreaterOrEqual;
+    StateEvaluator leaf(StateDescriptor(mockIntStateId, deviceId, qrand() % 100, valueOperator));
+    if (depth == 1)
+        return leaf;
+
+    QList<StateEvaluator> childEvaluators;
+    childEvaluators.append(leaf);
+    childEvaluators.append(createStateEvaluator(topology, seed, depth - 1));
+    return StateEvaluator(childEvaluators, depth % 2 ? Types::StateOperatorOr : Types::StateOperatorAnd);
+}
+
+TimeDescriptor BenchmarkRuleEngine::createTimeDescriptor(int seed)
+{
+    TimeDescriptor timeDescriptor;
+    QTime time(qrand() % 24, qrand() % 60);
+    if (seed % 8 == 3) {
+        CalendarItem calendarItem;
+        calendarItem.setStartTime(time);
+        calendarItem.setDuration(1 + qrand() % 120);
+        if (seed % 16 == 3) {
+            calendarItem.setRepeatingOption(RepeatingOption(RepeatingOption::RepeatingModeDaily));
+        } else {
+            calendarItem.setRepeatingOption(RepeatingOption(RepeatingOption::RepeatingModeWeekly, QList<int>() << 1 << 3 << 5));
+        }
+        timeDescriptor.setCalendarItems(QList<CalendarItem>() << calendarItem);
+    } else {
+        TimeEventItem timeEventItem;
+        timeEventItem.setTime(time);
+        timeEventItem.setRepeatingOption(RepeatingOption(RepeatingOption::RepeatingModeDaily));
+        timeDescriptor.setTimeEventItems(QList<TimeEventItem>() << timeEventItem);
+    }
+    return timeDescriptor;
+}
+
+void BenchmarkRuleEngine::removeAllRules()
+{
+    RuleEngine *ruleEngine = GuhCore::instance()->ruleEngine();
+    QCOMPARE(GuhCore::instance()->removeRules(ruleEngine->ruleIds()), RuleEngine::RuleErrorNoError);
+}
+
+void BenchmarkRuleEngine::report(const QString &name, QVector<qint64> samples, const QString &unit)
+{
+    if (samples.isEmpty())
+        return;
+
+    qint64 total = 0;
+    foreach (qint64 sample, samples) {
+        total += sample;
+    }
+    std::sort(samples.begin(), samples.end());
+    qint64 p50 = samples.at(samples.count() / 2);
+    qint64 p99 = samples.at(qMin(samples.count() - 1, samples.count() * 99 / 100));
+
+    qDebug() << qPrintable(QString("%1: %2 %3/s, p50 %4 us, p99 %5 us, max %6 us")
+                           .arg(name)
+                           .arg(samples.count() * 1000000000.0 / qMax(total, qint64(1)), 0, 'f', 1)
+                           .arg(unit)
+                           .arg(p50 / 1000.0, 0, 'f', 1)
+                           .arg(p99 / 1000.0, 0, 'f', 1)
+                           .arg(samples.last() / 1000.0, 0, 'f', 1));
+}
+
+void BenchmarkRuleEngine::evaluateEvent_data()
+{
+    addTopologyRows();
+}
+
+void BenchmarkRuleEngine::evaluateEvent()
+{
+    QFETCH(Topology, topology);
+
+    RuleEngine *ruleEngine = GuhCore::instance()->ruleEngine();
+    QCOMPARE(ruleEngine->addRules(createRules(topology)), RuleEngine::RuleErrorNoError);
+
+    // Mix of plain events and state changes on all devices
+    QList<Event> events;
+    for (int i = 0; i < 10000; i++) {
+        DeviceId deviceId = m_devices.at(qrand() % topology.devices);
+        if (i % 2) {
+            ParamList params;
+            params.append(Param(ParamTypeId(mockIntStateId.toString()), qrand() % 100));
+            events.append(Event(EventTypeId(mockIntStateId.toString()), deviceId, params, true));
+        } else {
+            events.append(Event(mockEvent1Id, deviceId));
+        }
+    }
+
+    QVector<qint64> samples;
+    samples.reserve(events.count());
+    QElapsedTimer timer;
+    QBENCHMARK_ONCE {
+        foreach (const Event &event, events) {
+            timer.start();
+            ruleEngine->evaluateEvent(event);
+            samples.append(timer.nsecsElapsed());
+        }
+    }
+    report("evaluateEvent", samples, "events");
+
+    removeAllRules();
+}
+
+void BenchmarkRuleEngine::evaluateTime_data()
+{
+    addTopologyRows();
+}
+
+void BenchmarkRuleEngine::evaluateTime()
+{
+    QFETCH(Topology, topology);
+
+    RuleEngine *ruleEngine = GuhCore::instance()->ruleEngine();
+    QCOMPARE(ruleEngine->addRules(createRules(topology)), RuleEngine::RuleErrorNoError);
+
+    // One week, minute by minute, starting after the last evaluation of the time manager
+    QDateTime dateTime = GuhCore::instance()->timeManager()->currentDateTime().addDays(1);
+    dateTime.setTime(QTime(0, 0));
+    ruleEngine->evaluateTime(dateTime);
+
+    QVector<qint64> samples;
+    samples.reserve(7 * 24 * 60);
+    QElapsedTimer timer;
+    QBENCHMARK_ONCE {
+        for (int i = 0; i < 7 * 24 * 60; i++) {
+            dateTime = dateTime.addSecs(60);
+            timer.start();
+            ruleEngine->evaluateTime(dateTime);
+            samples.append(timer.nsecsElapsed());
+        }
+    }
+    report("evaluateTime", samples, "evaluations");
+
+    removeAllRules();
+}
+
+void BenchmarkRuleEngine::addRule_data()
+{
+    addTopologyRows();
+}
+
+void BenchmarkRuleEngine::addRule()
+{
+    QFETCH(Topology, topology);
+
+    RuleEngine *ruleEngine = GuhCore::instance()->ruleEngine();
+    QList<Rule> rules = createRules(topology);
+
+    QVector<qint64> samples;
+    samples.reserve(rules.count());
+    QElapsedTimer timer;
+    QBENCHMARK_ONCE {
+        foreach (const Rule &rule, rules) {
+            timer.start();
+            RuleEngine::RuleError error = ruleEngine->addRule(rule);
+            samples.append(timer.nsecsElapsed());
+            QCOMPARE(error, RuleEngine::RuleErrorNoError);
+        }
+    }
+    report("addRule", samples, "rules");
+
+    removeAllRules();
+}
+
+void BenchmarkRuleEngine::startup_data()
+{
+    addTopologyRows();
+}
+
+void BenchmarkRuleEngine::startup()
+{
+    QFETCH(Topology, topology);
+
+    QCOMPARE(GuhCore::instance()->ruleEngine()->addRules(createRules(topology)), RuleEngine::RuleErrorNoError);
+
+    QVector<qint64> samples;
+    QElapsedTimer timer;
+    QBENCHMARK_ONCE {
+        for (int i = 0; i < 5; i++) {
+            timer.start();
+            restartServer();
+            samples.append(timer.nsecsElapsed());
+        }
+    }
+    QCOMPARE(GuhCore::instance()->ruleEngine()->ruleIds().count(), topology.rules);
+    report("startup", samples, "startups");
+
+    removeAllRules();
+}
+
+#include "benchmarkruleengine.moc"
+QTEST_MAIN(BenchmarkRuleEngine)
@@ -0,0 +1,5 @@
+include(../../../guh.pri)
+include(../benchmarks.pri)
+
+TARGET = benchmarkruleengine
+SOURCES += benchmarkruleengine.cpp
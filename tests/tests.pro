@@ -1,3 +1,3 @@
 TEMPLATE = subdirs
 
-SUBDIRS = auto tools/simplepushbuttonhandler
+SUBDIRS = auto benchmarks tools/simplepushbuttonhandler